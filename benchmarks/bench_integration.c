@@ -0,0 +1,612 @@
+#define _GNU_SOURCE
+
+/*
+ * Benchmarks for the integration library, run by "meson benchmark". Each
+ * invocation runs one benchmark against the fake-dosemu stand-in and
+ * prints one JSON object per measured quantity on stdout:
+ *
+ *   {"benchmark":"start_latency","unit":"ms","count":50,"mean":...,"p50":...,"p99":...,"max":...}
+ *   {"benchmark":"log_throughput","unit":"lines/s","value":...}
+ *
+ * Usage: bench-integration start-stop|round-trip|log-throughput|log-record|log-search|itrace|
+ *                          replay [--dosemu PATH] [--runs N] [--output FILE]
+ */
+
+#include "../include/common.h"
+#include "../include/headless.h"
+#include "../include/io_loop.h"
+#include "../include/dosemu_integration.h"
+#include "../include/dbg_client.h"
+#include "../include/capture.h"
+#include "../include/itrace.h"
+#include "../include/latency.h"
+#include "../include/logger.h"
+#include "../include/sessionlog.h"
+#include "../include/trace.h"
+#include "../include/transcript.h"
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+/* Upper bound on any single wait, so a broken build fails instead of hanging */
+#define BENCH_TIMEOUT_MS 15000
+
+AppState app;
+
+static FILE *results;
+static FILE *results_copy;
+
+/* Completion flag shared with the callbacks */
+typedef struct Waiter {
+    bool done;
+    bool success;
+} Waiter;
+
+static void emit(const char *line) {
+    fputs(line, results);
+    fflush(results);
+    if (results_copy) {
+        fputs(line, results_copy);
+        fflush(results_copy);
+    }
+}
+
+static void report_histogram(const char *name, const LatencyHistogram *histogram) {
+    char line[512];
+
+    snprintf(line, sizeof(line),
+             "{\"benchmark\":\"%s\",\"unit\":\"ms\",\"count\":%llu,\"mean\":%.4f,"
+             "\"p50\":%.4f,\"p99\":%.4f,\"max\":%.4f}\n",
+             name, (unsigned long long)histogram->total, latency_mean(histogram),
+             latency_percentile(histogram, 0.50), latency_percentile(histogram, 0.99),
+             histogram->max_ms);
+    emit(line);
+}
+
+static void report_value(const char *name, const char *unit, double value) {
+    char line[256];
+
+    snprintf(line, sizeof(line), "{\"benchmark\":\"%s\",\"unit\":\"%s\",\"value\":%.4f}\n",
+             name, unit, value);
+    emit(line);
+}
+
+static double ms_since(uint64_t start_ns) {
+    return (double)(trace_now() - start_ns) / 1000000.0;
+}
+
+static void on_session_done(DosemuSession *session, bool success, void *data) {
+    Waiter *waiter = data;
+
+    waiter->success = success;
+    waiter->done = true;
+}
+
+static DosemuSession *start_session(const char *dosemu_path, LatencyHistogram *latency) {
+    Waiter waiter = {false, false};
+    uint64_t start = trace_now();
+    DosemuSession *session = start_dosemu(dosemu_path, NULL, on_session_done, &waiter);
+
+    if (!session || !headless_run_until(&waiter.done, BENCH_TIMEOUT_MS) || !waiter.success) {
+        fprintf(stderr, "bench: session failed to start\n");
+        return NULL;
+    }
+    if (latency) {
+        latency_record(latency, ms_since(start));
+    }
+    return session;
+}
+
+static bool stop_session(DosemuSession *session, LatencyHistogram *latency) {
+    Waiter waiter = {false, false};
+    uint64_t start = trace_now();
+
+    if (!stop_dosemu(session, on_session_done, &waiter) ||
+        !headless_run_until(&waiter.done, BENCH_TIMEOUT_MS)) {
+        fprintf(stderr, "bench: session failed to stop\n");
+        return false;
+    }
+    if (latency) {
+        latency_record(latency, ms_since(start));
+    }
+
+    /* Let the session's deferred free run before the next one starts */
+    bool idle = false;
+    headless_run_until(&idle, 1);
+    return waiter.success;
+}
+
+/* Time from start_dosemu() to controllable, and from stop_dosemu() to exited */
+static bool bench_start_stop(const char *dosemu_path, int runs) {
+    LatencyHistogram start_latency = {0}, stop_latency = {0};
+
+    for (int i = 0; i < runs; i++) {
+        DosemuSession *session = start_session(dosemu_path, &start_latency);
+        if (!session || !stop_session(session, &stop_latency)) {
+            return false;
+        }
+    }
+
+    report_histogram("start_latency", &start_latency);
+    report_histogram("stop_latency", &stop_latency);
+    return true;
+}
+
+typedef struct RoundTrip {
+    uint64_t issued_ns;
+    LatencyHistogram *latency;
+    int *remaining;
+    bool *done;
+} RoundTrip;
+
+static void on_regs(bool ok, const DbgRegs *regs, void *data) {
+    RoundTrip *trip = data;
+
+    if (ok) {
+        latency_record(trip->latency, ms_since(trip->issued_ns));
+    }
+    if (--*trip->remaining == 0) {
+        *trip->done = true;
+    }
+}
+
+/* Register reads one at a time, then all issued at once */
+static bool bench_round_trip(const char *dosemu_path, int runs) {
+    LatencyHistogram sequential = {0}, pipelined = {0};
+    RoundTrip *trips = calloc((size_t)runs, sizeof(*trips));
+    DosemuSession *session = start_session(dosemu_path, NULL);
+    DbgClient *debugger;
+    uint64_t start;
+    int remaining;
+    bool done;
+
+    if (!trips || !session) {
+        free(trips);
+        return false;
+    }
+    debugger = dosemu_session_debugger(session);
+
+    for (int i = 0; i < runs; i++) {
+        remaining = 1;
+        done = false;
+        trips[i] = (RoundTrip){trace_now(), &sequential, &remaining, &done};
+        if (!dbg_regs(debugger, on_regs, &trips[i]) ||
+            !headless_run_until(&done, BENCH_TIMEOUT_MS)) {
+            free(trips);
+            return false;
+        }
+    }
+
+    remaining = runs;
+    done = false;
+    start = trace_now();
+    for (int i = 0; i < runs; i++) {
+        trips[i] = (RoundTrip){trace_now(), &pipelined, &remaining, &done};
+        dbg_regs(debugger, on_regs, &trips[i]);
+    }
+    if (!headless_run_until(&done, BENCH_TIMEOUT_MS)) {
+        free(trips);
+        return false;
+    }
+
+    report_histogram("round_trip_sequential", &sequential);
+    report_histogram("round_trip_pipelined", &pipelined);
+    report_value("pipelined_throughput", "commands/s", (double)runs * 1000.0 / ms_since(start));
+
+    free(trips);
+    return stop_session(session, NULL);
+}
+
+typedef struct Writer {
+    int fd;
+    int lines;
+} Writer;
+
+static void *write_lines(void *data) {
+    Writer *writer = data;
+    char line[80];
+
+    memset(line, 'x', sizeof(line) - 1);
+    line[sizeof(line) - 1] = '\n';
+    for (int i = 0; i < writer->lines; i++) {
+        const char *p = line;
+        size_t left = sizeof(line);
+        while (left > 0) {
+            ssize_t n = write(writer->fd, p, left);
+            if (n <= 0) {
+                return NULL;
+            }
+            p += n;
+            left -= (size_t)n;
+        }
+    }
+    close(writer->fd);
+    return NULL;
+}
+
+/* Lines per second through the capture stage into the console ring */
+static bool bench_log_throughput(int lines) {
+    int out_pipe[2], err_pipe[2];
+    Writer writer;
+    pthread_t thread;
+    OutputCapture *capture;
+    uint64_t start;
+    double elapsed;
+
+    if (pipe2(out_pipe, O_CLOEXEC) != 0 || pipe2(err_pipe, O_CLOEXEC) != 0) {
+        return false;
+    }
+    close(err_pipe[1]);
+
+    start = trace_now();
+    capture = capture_open(0, out_pipe[0], err_pipe[0], NULL);
+    if (!capture) {
+        return false;
+    }
+
+    writer.fd = out_pipe[1];
+    writer.lines = lines;
+    pthread_create(&thread, NULL, write_lines, &writer);
+    pthread_join(thread, NULL);
+    capture_close(capture);
+    elapsed = ms_since(start);
+
+    close(out_pipe[0]);
+    close(err_pipe[0]);
+
+    report_value("log_throughput", "lines/s", (double)lines * 1000.0 / elapsed);
+    report_value("log_bandwidth", "MB/s", (double)lines * 80.0 / 1000.0 / elapsed);
+    return true;
+}
+
+/* What a log call costs the thread making it, as on the I/O thread per line */
+static bool bench_log_record(int records) {
+    static const char line[] = "C:\\>echo the quick brown fox jumps over the lazy dog";
+    uint64_t spent = 0;
+    int done = 0;
+
+    /* Batches stay well inside the queue, so this is never the cost of a drop */
+    while (done < records) {
+        int batch = records - done < LOG_QUEUE_SLOTS / 4 ? records - done : LOG_QUEUE_SLOTS / 4;
+        uint64_t start = trace_now();
+
+        for (int i = 0; i < batch; i++) {
+            log_record(LOG_LEVEL_INFO, 1, "%s +%.3f: %.*s\n", "stdout", i * 0.001,
+                       (int)sizeof(line) - 1, line);
+        }
+        spent += trace_now() - start;
+        done += batch;
+        logger_flush();
+    }
+
+    report_value("log_record_cost", "ns", (double)spent / records);
+    report_value("log_records_dropped", "records", (double)logger_dropped());
+    return true;
+}
+
+/* Time a search over a session log to completion */
+static double time_search(SessionLog *log, const char *query, uint64_t *matches,
+                          uint64_t *scanned) {
+    SessionLogSearch *search = sessionlog_search_start(log, query);
+    uint64_t start = trace_now();
+    double elapsed;
+
+    while (!sessionlog_search_caught_up(search)) {
+        sessionlog_search_step(search, SIZE_MAX);
+    }
+    elapsed = ms_since(start);
+    *matches = sessionlog_search_count(search);
+    *scanned = sessionlog_search_scanned(search);
+    sessionlog_search_free(search);
+    return elapsed;
+}
+
+/* Index megabytes of synthetic output, then search it for a rare and a common string */
+static bool bench_log_search(int megabytes) {
+    SessionLog *log = sessionlog_open(1, NULL);
+    uint64_t target = (uint64_t)megabytes << 20;
+    uint64_t written = 0;
+    uint64_t matches, scanned;
+    uint64_t start;
+    char line[160];
+    double ms;
+
+    if (!log) {
+        return false;
+    }
+
+    for (uint64_t i = 0; written < target; i++) {
+        int length = snprintf(line, sizeof(line),
+                              "%.6f stdout C:\\GAMES>run level %llu seg %04llX:%04llX %s\n",
+                              (double)i / 1000.0, (unsigned long long)(i % 977),
+                              (unsigned long long)(i * 7 % 0xffff),
+                              (unsigned long long)(i * 13 % 0xffff),
+                              i % 5000011 == 4999999 ? "General protection fault" : "ok");
+        sessionlog_append(log, line, (size_t)length);
+        written += (uint64_t)length;
+    }
+    sessionlog_flush(log);
+
+    start = trace_now();
+    while (sessionlog_bytes(log) < written) {
+        sessionlog_update_all();
+    }
+    ms = ms_since(start);
+    report_value("log_index_rate", "MB/s", (double)megabytes * 1000.0 / ms);
+    report_value("log_index_size", "MB", (double)sessionlog_index_bytes(log) / 1048576.0);
+
+    ms = time_search(log, "protection fault", &matches, &scanned);
+    report_value("log_search_rare", "ms", ms);
+    report_value("log_search_rare_matches", "lines", (double)matches);
+    report_value("log_search_rare_read", "MB", (double)scanned / 1048576.0);
+
+    ms = time_search(log, "level 976 ", &matches, &scanned);
+    report_value("log_search_common", "ms", ms);
+    report_value("log_search_common_matches", "lines", (double)matches);
+
+    sessionlog_release(log);
+    return true;
+}
+
+/* Instruction i of a synthetic trace: a copy loop with a far call every 64 iterations */
+static void synthetic_instruction(uint64_t i, ItraceRecord *record) {
+    static const uint8_t loop[][4] = {
+        {2, 0xAC}, {3, 0x34, 0x5A}, {2, 0xAA}, {2, 0x49}, {3, 0x75, 0xF9}
+    };
+    uint64_t iteration = i / 5;
+    int step = (int)(i % 5);
+    bool far = iteration % 64 == 63;
+
+    memset(record, 0, sizeof(*record));
+    record->cs = far ? 0xF000 : 0x1234;
+    record->ip = (uint32_t)(far ? 0xE000 + step * 2 : 0x0100 + step);
+    record->opcode_length = (uint8_t)(loop[step][0] - 1);
+    memcpy(record->opcode, &loop[step][1], record->opcode_length);
+    record->regs.cs = record->cs;
+    record->regs.eip = record->ip + record->opcode_length;
+    record->regs.eax = (uint32_t)(0x4100 + (iteration & 0xFF));
+    record->regs.ecx = (uint32_t)(0xFFFF - iteration);
+    record->regs.esi = (uint32_t)(0x0200 + iteration);
+    record->regs.edi = (uint32_t)(0x8000 + iteration);
+    record->regs.esp = 0xFFFE;
+    record->regs.eflags = step == 3 ? 0x0206 : 0x0202;
+    record->regs.ds = record->regs.ss = 0x1234;
+    record->regs.es = 0xB800;
+}
+
+/* Write and read back runs synthetic instructions through the trace format */
+static bool bench_itrace(int runs) {
+    char path[] = "/tmp/dosemu2-bench-itrace-XXXXXX";
+    int fd = mkstemp(path);
+    ItraceWriter *writer;
+    ItraceReader *reader;
+    ItraceRecord record, expected;
+    uint64_t file_bytes, stalls, start, read = 0;
+    double ms;
+    bool ok = true;
+
+    if (fd < 0) {
+        return false;
+    }
+    close(fd);
+
+    writer = itrace_writer_open(path);
+    if (!writer) {
+        unlink(path);
+        return false;
+    }
+    start = trace_now();
+    for (int i = 0; i < runs; i++) {
+        synthetic_instruction((uint64_t)i, &record);
+        ok = itrace_writer_add(writer, &record) && ok;
+    }
+    file_bytes = itrace_writer_file_bytes(writer);
+    stalls = itrace_writer_stalls(writer);
+    ok = itrace_writer_close(writer) && ok;
+    ms = ms_since(start);
+    report_value("itrace_write_cost", "ns", ms * 1e6 / runs);
+    report_value("itrace_writer_stalls", "blocks", (double)stalls);
+
+    reader = itrace_reader_open(path);
+    if (!reader) {
+        unlink(path);
+        return false;
+    }
+    start = trace_now();
+    while (itrace_reader_next(reader, &record)) {
+        synthetic_instruction(read++, &expected);
+        if (memcmp(&record, &expected, sizeof(record)) != 0) {
+            ok = false;
+        }
+    }
+    ms = ms_since(start);
+    ok = ok && !itrace_reader_failed(reader) && read == (uint64_t)runs;
+    itrace_reader_close(reader);
+
+    /* The last block was still on its way when the size was sampled */
+    fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        file_bytes = (uint64_t)lseek(fd, 0, SEEK_END);
+        close(fd);
+    }
+    unlink(path);
+
+    report_value("itrace_read_cost", "ns", ms * 1e6 / runs);
+    report_value("itrace_file_size", "bytes/instruction", (double)file_bytes / runs);
+    return ok;
+}
+
+/* Debugger exchanges per session in the synthetic transcript */
+#define REPLAY_EXCHANGES 1000
+
+static const char replay_regs[] =
+    "EAX: 00004C00 EBX: 00000000 ECX: 000000FF EDX: 00000000\n"
+    "ESI: 00000000 EDI: 00000000 EBP: 00000000 DS: 0070 ES: 0070 FS: 0000 GS: 0000\n"
+    "SS:SP: 0030:0100 CS:IP: 1234:0100 FLAGS: 00003202\n";
+
+static void on_replayed(const TranscriptReplayStats *stats, void *data) {
+    Waiter *waiter = data;
+
+    waiter->success = !stats->corrupt && stats->skipped == 0 && stats->failed == 0;
+    waiter->done = true;
+}
+
+/*
+ * Record a transcript of sessions that each boot, answer REPLAY_EXCHANGES
+ * register and memory reads and stop, then replay it as fast as possible
+ * through the integration layer, about runs events in all.
+ */
+static bool bench_replay(int runs) {
+    char path[] = "/tmp/dosemu2-bench-transcript-XXXXXX";
+    int sessions = runs / (2 * REPLAY_EXCHANGES + 7);
+    int fd = mkstemp(path);
+    ShutdownResult result = {"DOSEmu", SHUTDOWN_GRACEFUL, 2.5};
+    TranscriptReplayStats stats;
+    Waiter waiter = {false, false};
+    char dump[1024];
+    size_t used = 0;
+    uint64_t events, file_bytes, start;
+    double ms;
+
+    if (fd < 0) {
+        return false;
+    }
+    close(fd);
+    if (sessions < 1) {
+        sessions = 1;
+    }
+    for (int row = 0; row < 128; row += 16) {
+        used += (size_t)snprintf(dump + used, sizeof(dump) - used, "B800:%04X", row);
+        for (int i = 0; i < 16; i++) {
+            used += (size_t)snprintf(dump + used, sizeof(dump) - used, " %02X", (row + i) & 0xFF);
+        }
+        used += (size_t)snprintf(dump + used, sizeof(dump) - used, "  ................\n");
+    }
+
+    if (!transcript_record_start(path)) {
+        unlink(path);
+        return false;
+    }
+    start = trace_now();
+    for (int id = 1; id <= sessions; id++) {
+        ExitInfo info = {1000 + id, 0, 0, 120.0, 30.0, 40960};
+
+        transcript_launch(id, 1000 + id, "");
+        transcript_endpoint(id, READINESS_READY, "/run/user/0/dosemu2/dosemu.dbgin.1000", 18.5);
+        transcript_command(id, TRANSCRIPT_COMMAND_TEXT, 0, 0, 0, "r");
+        transcript_output(id, replay_regs);
+        for (int i = 0; i < REPLAY_EXCHANGES; i++) {
+            if (i % 2 == 0) {
+                transcript_command(id, TRANSCRIPT_COMMAND_REGS, 0, 0, 0, "r");
+                transcript_output(id, replay_regs);
+            } else {
+                transcript_command(id, TRANSCRIPT_COMMAND_MEM, 0xB800, 0, 128, "d b800:0000 80");
+                transcript_output(id, dump);
+            }
+        }
+        transcript_stop(id);
+        transcript_shutdown(id, &result, 1, 2.5);
+        transcript_exited(id, &info);
+    }
+    events = transcript_recorded_events();
+    transcript_record_stop();
+    ms = ms_since(start);
+    report_value("transcript_record_cost", "ns", ms * 1e6 / (double)events);
+
+    fd = open(path, O_RDONLY);
+    file_bytes = fd >= 0 ? (uint64_t)lseek(fd, 0, SEEK_END) : 0;
+    if (fd >= 0) {
+        close(fd);
+    }
+    report_value("transcript_size", "bytes/event", (double)file_bytes / (double)events);
+
+    if (!transcript_replay_start(path, false, on_replayed, &waiter) ||
+        !headless_run_until(&waiter.done, BENCH_TIMEOUT_MS)) {
+        unlink(path);
+        return false;
+    }
+    unlink(path);
+
+    transcript_replay_stats(&stats);
+    report_value("replay_throughput", "events/s", (double)stats.events * 1000.0 / stats.elapsed_ms);
+    report_value("replay_event_cost", "ns", stats.elapsed_ms * 1e6 / (double)stats.events);
+    return waiter.success && stats.events == events && stats.launched == sessions;
+}
+
+/* Keep the fake's FIFOs out of the user's real runtime directory */
+static bool use_private_runtime_dir(void) {
+    char template[] = "/tmp/dosemu2-bench-XXXXXX";
+    char dir[sizeof(template) + 16];
+
+    if (!mkdtemp(template)) {
+        return false;
+    }
+    snprintf(dir, sizeof(dir), "%s/dosemu2", template);
+    return mkdir(dir, 0700) == 0 && setenv("XDG_RUNTIME_DIR", template, 1) == 0;
+}
+
+int main(int argc, char **argv) {
+    const char *benchmark = argc > 1 ? argv[1] : "";
+    const char *dosemu_path = "fake-dosemu";
+    int runs = 20;
+    bool ok;
+
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--dosemu") == 0 && i + 1 < argc) {
+            dosemu_path = argv[++i];
+        } else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            runs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            results_copy = fopen(argv[++i], "a");
+        } else {
+            fprintf(stderr, "bench: unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (runs <= 0) {
+        runs = 1;
+    }
+
+    /* Results keep stdout; the library's console echo goes nowhere */
+    results = fdopen(dup(STDOUT_FILENO), "w");
+    int devnull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if (!results || devnull < 0 || dup2(devnull, STDOUT_FILENO) < 0) {
+        return 1;
+    }
+    close(devnull);
+
+    app.attach_timeout_ms = BENCH_TIMEOUT_MS;
+
+    headless_enable();
+    if (!use_private_runtime_dir() || !io_loop_start()) {
+        fprintf(stderr, "bench: setup failed\n");
+        return 1;
+    }
+
+    if (strcmp(benchmark, "start-stop") == 0) {
+        ok = bench_start_stop(dosemu_path, runs);
+    } else if (strcmp(benchmark, "round-trip") == 0) {
+        ok = bench_round_trip(dosemu_path, runs);
+    } else if (strcmp(benchmark, "log-throughput") == 0) {
+        ok = bench_log_throughput(runs);
+    } else if (strcmp(benchmark, "log-record") == 0) {
+        ok = bench_log_record(runs);
+    } else if (strcmp(benchmark, "log-search") == 0) {
+        ok = bench_log_search(runs);
+    } else if (strcmp(benchmark, "itrace") == 0) {
+        ok = bench_itrace(runs);
+    } else if (strcmp(benchmark, "replay") == 0) {
+        ok = bench_replay(runs);
+    } else {
+        fprintf(stderr, "usage: %s start-stop|round-trip|log-throughput|log-record|log-search|"
+                "itrace|replay [--dosemu PATH] [--runs N] [--output FILE]\n", argv[0]);
+        ok = false;
+    }
+
+    io_loop_stop();
+    if (results_copy) {
+        fclose(results_copy);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,132 @@
+#define _GNU_SOURCE
+
+/*
+ * Spawn latency of each spawn backend as our heap grows, run by "meson
+ * benchmark". The time measured is spawn_process_with() returning, i.e.
+ * the child has exec'd; one JSON object per backend and heap size:
+ *
+ *   {"benchmark":"spawn_vfork","heap_mb":256,"unit":"ms","count":200,"mean":...,...}
+ *
+ * Usage: bench-spawn [--target PATH] [--runs N] [--max-heap-mb MB] [--output FILE]
+ */
+
+#include "../include/common.h"
+#include "../include/latency.h"
+#include "../include/spawn.h"
+#include "../include/trace.h"
+#include <unistd.h>
+#include <errno.h>
+#include <sys/wait.h>
+
+/* Heap is grown in blocks of this size, every page touched */
+#define HEAP_BLOCK_MB 16
+
+AppState app;
+
+static FILE *results_copy;
+
+static void emit(const char *line) {
+    fputs(line, stdout);
+    fflush(stdout);
+    if (results_copy) {
+        fputs(line, results_copy);
+        fflush(results_copy);
+    }
+}
+
+static void report_histogram(const char *name, int heap_mb, const LatencyHistogram *histogram) {
+    char line[512];
+
+    snprintf(line, sizeof(line),
+             "{\"benchmark\":\"%s\",\"heap_mb\":%d,\"unit\":\"ms\",\"count\":%llu,"
+             "\"mean\":%.4f,\"p50\":%.4f,\"p99\":%.4f,\"max\":%.4f}\n",
+             name, heap_mb, (unsigned long long)histogram->total, latency_mean(histogram),
+             latency_percentile(histogram, 0.50), latency_percentile(histogram, 0.99),
+             histogram->max_ms);
+    emit(line);
+}
+
+/* Spawn and reap the target runs times, timing only the spawn */
+static bool measure(SpawnBackend backend, const char *target, int runs,
+                    LatencyHistogram *latency) {
+    const char *argv[] = {target, NULL};
+
+    for (int i = 0; i < runs; i++) {
+        SpawnedProcess process;
+        uint64_t start = trace_now();
+
+        if (!spawn_process_with(backend, argv, NULL, &process)) {
+            fprintf(stderr, "bench: cannot spawn %s: %s\n", target, strerror(errno));
+            return false;
+        }
+        latency_record(latency, (double)(trace_now() - start) / 1000000.0);
+
+        spawn_release(&process);
+        while (waitpid(process.pid, NULL, 0) < 0 && errno == EINTR) {
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    const char *target = "/bin/true";
+    int runs = 200;
+    int max_heap_mb = 1024;
+    char **blocks;
+    int block_count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--target") == 0 && i + 1 < argc) {
+            target = argv[++i];
+        } else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            runs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max-heap-mb") == 0 && i + 1 < argc) {
+            max_heap_mb = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            results_copy = fopen(argv[++i], "a");
+        } else {
+            fprintf(stderr, "usage: %s [--target PATH] [--runs N] [--max-heap-mb MB] "
+                    "[--output FILE]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (runs <= 0) {
+        runs = 1;
+    }
+
+    blocks = calloc((size_t)(max_heap_mb / HEAP_BLOCK_MB + 1), sizeof(*blocks));
+    if (!blocks) {
+        return 1;
+    }
+
+    /* 0 MB, then doubling from one block up to the maximum */
+    for (int heap_mb = 0; heap_mb <= max_heap_mb;
+         heap_mb = heap_mb ? heap_mb * 2 : HEAP_BLOCK_MB) {
+        LatencyHistogram vfork_latency = {0}, fork_latency = {0};
+
+        while (block_count * HEAP_BLOCK_MB < heap_mb) {
+            blocks[block_count] = malloc((size_t)HEAP_BLOCK_MB << 20);
+            if (!blocks[block_count]) {
+                fprintf(stderr, "bench: cannot grow heap to %d MB\n", heap_mb);
+                return 1;
+            }
+            memset(blocks[block_count++], 0x5a, (size_t)HEAP_BLOCK_MB << 20);
+        }
+
+        if (!measure(SPAWN_FORK, target, runs, &fork_latency) ||
+            !measure(SPAWN_VFORK, target, runs, &vfork_latency)) {
+            return 1;
+        }
+        report_histogram("spawn_fork", heap_mb, &fork_latency);
+        report_histogram("spawn_vfork", heap_mb, &vfork_latency);
+    }
+
+    for (int i = 0; i < block_count; i++) {
+        free(blocks[i]);
+    }
+    free(blocks);
+    if (results_copy) {
+        fclose(results_copy);
+    }
+    return 0;
+}
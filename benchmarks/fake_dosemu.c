@@ -0,0 +1,219 @@
+#define _GNU_SOURCE
+
+/*
+ * Stand-in for dosemu used by the benchmarks. It follows DOSEmu's
+ * lifecycle as the integration layer sees it: after a start-up delay it
+ * prints some output, creates its dosemu.dbgin.<pid>/dosemu.dbgout.<pid>
+ * debugger FIFOs and answers debugger commands, each reply terminated by
+ * \001, until it is told to go away. Behaviour is set through environment
+ * variables so the same binary serves every benchmark:
+ *
+ *   FAKE_DOSEMU_STARTUP_MS   delay before the FIFOs appear (default 50)
+ *   FAKE_DOSEMU_OUTPUT_LINES lines printed to stdout at start-up (default 0)
+ *   FAKE_DOSEMU_LINE_BYTES   length of each of those lines (default 80)
+ *   FAKE_DOSEMU_REPLY_US     delay before each debugger reply (default 0)
+ *   FAKE_DOSEMU_EXIT_MS      delay between SIGTERM and exiting (default 0)
+ *   FAKE_DOSEMU_IGNORE_TERM  if set, only SIGKILL ends the process
+ *   FAKE_DOSEMU_JOB_MS       run time of a "-E command" job (default 0)
+ *
+ * Given "-E command" it behaves like an unattended job instead: it echoes
+ * the command, runs for FAKE_DOSEMU_JOB_MS and exits, with status N if the
+ * command is "exit N".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+static volatile sig_atomic_t terminate = 0;
+static char in_path[PATH_MAX];
+static char out_path[PATH_MAX];
+
+static long env_long(const char *name, long fallback) {
+    const char *value = getenv(name);
+    return value && *value ? strtol(value, NULL, 10) : fallback;
+}
+
+static void on_sigterm(int sig) {
+    terminate = 1;
+}
+
+/* Same search order as the GUI's readiness watch */
+static bool make_run_dir(char *dir, size_t size) {
+    const char *runtime = getenv("XDG_RUNTIME_DIR");
+    const char *home = getenv("HOME");
+
+    if (runtime && *runtime) {
+        snprintf(dir, size, "%s/dosemu2", runtime);
+    } else if (home && *home) {
+        snprintf(dir, size, "%s/.dosemu/run", home);
+    } else {
+        return false;
+    }
+    return mkdir(dir, 0700) == 0 || errno == EEXIST;
+}
+
+static void write_all(int fd, const char *text, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, text, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return;
+        }
+        text += n;
+        len -= (size_t)n;
+    }
+}
+
+/* Answer one command line the way DOSEmu's debugger would */
+static void answer(int out_fd, const char *line) {
+    char reply[32768];
+    size_t used = 0;
+    long reply_us = env_long("FAKE_DOSEMU_REPLY_US", 0);
+
+    if (reply_us > 0) {
+        usleep((useconds_t)reply_us);
+    }
+
+    /* DOSEmu leaves without answering */
+    if (strcmp(line, "kill") == 0) {
+        terminate = 1;
+        return;
+    }
+
+    if (strcmp(line, "r") == 0) {
+        used = (size_t)snprintf(reply, sizeof(reply),
+            "EAX: 00000000 EBX: 00000000 ECX: 000000FF EDX: 00000000\n"
+            "ESI: 00000000 EDI: 00000000 EBP: 00000000 DS: 0070 ES: 0070 FS: 0000 GS: 0000\n"
+            "SS:SP: 0030:0100 CS:IP: F000:FFF0 FLAGS: 00003202\n");
+    } else if (line[0] == 'd' && line[1] == ' ') {
+        unsigned segment = 0, offset = 0;
+        unsigned long length = 0x80;
+
+        sscanf(line + 2, "%x:%x %lx", &segment, &offset, &length);
+        for (unsigned long row = 0; row < length && used + 100 < sizeof(reply); row += 16) {
+            used += (size_t)snprintf(reply + used, sizeof(reply) - used, "%04X:%04lX",
+                                     segment, (unsigned long)offset + row);
+            for (unsigned long i = row; i < row + 16 && i < length; i++) {
+                used += (size_t)snprintf(reply + used, sizeof(reply) - used, " %02lX",
+                                         (unsigned long)((offset + i) & 0xff));
+            }
+            reply[used++] = '\n';
+        }
+    } else {
+        used = (size_t)snprintf(reply, sizeof(reply), "%s\n", line);
+    }
+
+    reply[used++] = '\001';
+    write_all(out_fd, reply, used);
+}
+
+/* Stand in for "dosemu -E command" */
+static int run_job(const char *command) {
+    long job_ms = env_long("FAKE_DOSEMU_JOB_MS", 0);
+    int status = 0;
+
+    printf("C:\\>%s\n", command);
+    fflush(stdout);
+    sscanf(command, "exit %d", &status);
+    for (long waited = 0; waited < job_ms && !terminate; waited += 10) {
+        usleep(10000);
+    }
+    return status;
+}
+
+int main(int argc, char **argv) {
+    char dir[PATH_MAX];
+    char buffer[4096];
+    size_t buffered = 0;
+    long lines = env_long("FAKE_DOSEMU_OUTPUT_LINES", 0);
+    long line_bytes = env_long("FAKE_DOSEMU_LINE_BYTES", 80);
+    int in_fd, out_fd;
+
+    if (env_long("FAKE_DOSEMU_IGNORE_TERM", 0)) {
+        signal(SIGTERM, SIG_IGN);
+    } else {
+        signal(SIGTERM, on_sigterm);
+    }
+
+    usleep((useconds_t)env_long("FAKE_DOSEMU_STARTUP_MS", 50) * 1000);
+
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "-E") == 0) {
+            return run_job(argv[i + 1]);
+        }
+    }
+
+    /* Boot chatter */
+    if (line_bytes < 1 || line_bytes >= (long)sizeof(buffer)) {
+        line_bytes = 80;
+    }
+    memset(buffer, 'x', (size_t)line_bytes - 1);
+    buffer[line_bytes - 1] = '\n';
+    for (long i = 0; i < lines; i++) {
+        write_all(STDOUT_FILENO, buffer, (size_t)line_bytes);
+    }
+
+    if (!make_run_dir(dir, sizeof(dir))) {
+        fprintf(stderr, "fake-dosemu: no runtime directory\n");
+        return 1;
+    }
+    if (snprintf(out_path, sizeof(out_path), "%s/dosemu.dbgout.%d", dir, (int)getpid()) >=
+            (int)sizeof(out_path) ||
+        snprintf(in_path, sizeof(in_path), "%s/dosemu.dbgin.%d", dir, (int)getpid()) >=
+            (int)sizeof(in_path)) {
+        fprintf(stderr, "fake-dosemu: runtime directory path too long\n");
+        return 1;
+    }
+
+    /* dbgout first: the GUI attaches as soon as dbgin appears */
+    if (mkfifo(out_path, 0600) != 0 || mkfifo(in_path, 0600) != 0) {
+        fprintf(stderr, "fake-dosemu: mkfifo: %s\n", strerror(errno));
+        unlink(out_path);
+        return 1;
+    }
+    in_fd = open(in_path, O_RDWR | O_CLOEXEC);
+    out_fd = open(out_path, O_RDWR | O_CLOEXEC);
+
+    buffered = 0;
+    while (!terminate && in_fd >= 0 && out_fd >= 0) {
+        struct pollfd pfd = {in_fd, POLLIN, 0};
+        ssize_t n;
+        char *newline;
+
+        if (poll(&pfd, 1, 50) <= 0) {
+            continue;
+        }
+        n = read(in_fd, buffer + buffered, sizeof(buffer) - buffered - 1);
+        if (n <= 0) {
+            continue;
+        }
+        buffered += (size_t)n;
+        buffer[buffered] = '\0';
+
+        while ((newline = memchr(buffer, '\n', buffered)) != NULL) {
+            *newline = '\0';
+            answer(out_fd, buffer);
+            buffered -= (size_t)(newline + 1 - buffer);
+            memmove(buffer, newline + 1, buffered);
+        }
+        if (buffered == sizeof(buffer) - 1) {
+            buffered = 0;
+        }
+    }
+
+    usleep((useconds_t)env_long("FAKE_DOSEMU_EXIT_MS", 0) * 1000);
+    unlink(in_path);
+    unlink(out_path);
+    return 0;
+}
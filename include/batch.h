@@ -0,0 +1,32 @@
+#ifndef DOSEMU2_GUI_BATCH_H
+#define DOSEMU2_GUI_BATCH_H
+
+#include "common.h"
+#include "placement.h"
+
+/* Per-job time limit unless --timeout says otherwise */
+#define BATCH_DEFAULT_TIMEOUT_S 600
+
+/* How a batch run is set up, from the command line */
+typedef struct BatchOptions {
+    const char *jobs_path;     /* one DOS command per line */
+    const char *dos_path;
+    const char *config_path;
+    const char *output_dir;    /* each job's captured output goes here */
+    const char *drive_dir;     /* DOS drive each job gets a staged copy of, or NULL */
+    int slots;                 /* jobs run at once; 0 means one per core */
+    int timeout_s;             /* per job */
+    PlacementConfig placement; /* applied to every job */
+} BatchOptions;
+
+/*
+ * Run every job in jobs_path without the GUI, at most slots at a time,
+ * then print each job's outcome and the aggregate throughput and latency.
+ * Returns the process exit code: 0 if every job exited with status 0.
+ */
+int batch_run(const BatchOptions *options);
+
+/* Parse "--batch FILE [-j N] ..." arguments; false on a usage error */
+bool batch_parse_args(int argc, char **argv, BatchOptions *options);
+
+#endif /* DOSEMU2_GUI_BATCH_H */
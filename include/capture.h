@@ -0,0 +1,26 @@
+#ifndef DOSEMU2_GUI_CAPTURE_H
+#define DOSEMU2_GUI_CAPTURE_H
+
+#include "common.h"
+
+/* Size of the shared read buffer used to drain child output */
+#define CAPTURE_READ_SIZE (256 * 1024)
+
+/* Longest line kept whole; longer lines are split */
+#define CAPTURE_LINE_SIZE 4096
+
+typedef struct OutputCapture OutputCapture;
+
+/*
+ * Continuously drain a child's stdout and stderr on the I/O thread. Each
+ * line is tagged with its stream and time since the capture started, sent
+ * to the console and appended to the session's log (see sessionlog.h):
+ * log_path, or an unlinked temporary file if it is NULL or empty.
+ */
+OutputCapture *capture_open(int session_id, int stdout_fd, int stderr_fd,
+                            const char *log_path);
+
+/* Drain what is left, stop watching and free; the fds are left open */
+void capture_close(OutputCapture *capture);
+
+#endif /* DOSEMU2_GUI_CAPTURE_H */
@@ -22,19 +22,64 @@ typedef struct AppState {
     int ems_size;
     bool use_console;
     bool use_vga;
+    int attach_timeout_ms;
+    char *capture_log_dir;
+    char *drive_dir;
 
     /* UI controls */
     uiEntry *dos_path_entry;
     uiEntry *config_path_entry;
+    uiEntry *drive_dir_entry;
     uiEntry *memory_size_entry;
     uiEntry *xms_size_entry;
     uiEntry *ems_size_entry;
+    uiEntry *attach_timeout_entry;
+    uiEntry *capture_log_entry;
+    uiEntry *pool_size_entry;
+    uiEntry *pool_refill_entry;
+    uiEntry *pool_budget_entry;
+    uiEntry *cpu_affinity_entry;
+    uiCheckbox *auto_spread_checkbox;
+    uiCombobox *sched_class_combobox;
+    uiEntry *nice_entry;
+    uiEntry *cgroup_entry;
+    uiEntry *cpu_max_entry;
+    uiEntry *memory_max_entry;
     uiCheckbox *auto_start_checkbox;
     uiCheckbox *console_checkbox;
     uiCheckbox *vga_checkbox;
     uiButton *start_button;
     uiButton *stop_button;
+    uiLabel *status_label;
+    uiLabel *pool_status_label;
+    uiLabel *drive_status_label;
+    uiTable *session_table;
+    uiTableModel *session_model;
+    uiTableModel *latency_model;
+    uiEntry *profile_rate_entry;
+    uiCheckbox *profile_regs_checkbox;
+    uiButton *profile_start_button;
+    uiButton *profile_stop_button;
+    uiLabel *profile_stats_label;
+    uiTableModel *profile_model;
+    uiButton *itrace_start_button;
+    uiButton *itrace_stop_button;
+    uiLabel *itrace_stats_label;
+    uiArea *memory_area;
+    uiEntry *memory_goto_entry;
+    uiLabel *memory_status_label;
+    uiArea *resources_area;
+    uiLabel *resources_status_label;
+    uiArea *screen_area;
+    uiSpinbox *screen_fps_spinbox;
+    uiLabel *screen_status_label;
     uiMultilineEntry *console;
+    uiButton *transcript_record_button;
+    uiButton *transcript_replay_button;
+    uiCheckbox *transcript_realtime_checkbox;
+    uiEntry *log_search_entry;
+    uiLabel *log_status_label;
+    uiArea *log_area;
 } AppState;
 
 /* Global application state */
@@ -0,0 +1,33 @@
+#ifndef DOSEMU2_GUI_CONSOLE_H
+#define DOSEMU2_GUI_CONSOLE_H
+
+#include "common.h"
+
+/* Bytes of message text kept in memory for export */
+#define CONSOLE_RING_BYTES (4 * 1024 * 1024)
+
+/* Messages kept in memory for export */
+#define CONSOLE_RING_ENTRIES 65536
+
+/* Messages shown in the console widget; older ones drop off */
+#define CONSOLE_VIEW_ENTRIES 2000
+
+/* Widget refresh interval, about one frame */
+#define CONSOLE_FLUSH_MS 16
+
+/* Start mirroring the ring buffer into a console widget */
+void console_attach(uiMultilineEntry *widget);
+
+/* Add log entry to both console and stdout; safe from any thread, formatted later */
+void log_message(const char *format, ...);
+
+/* Add error log entry to both console and stderr; safe from any thread */
+void log_error(const char *format, ...);
+
+/* Store formatted text in the ring buffer; called by the logger thread */
+void console_append(const char *text, size_t length);
+
+/* Write every message still held in the ring buffer to a file */
+bool console_export(const char *path);
+
+#endif /* DOSEMU2_GUI_CONSOLE_H */
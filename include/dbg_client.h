@@ -0,0 +1,103 @@
+#ifndef DOSEMU2_GUI_DBG_CLIENT_H
+#define DOSEMU2_GUI_DBG_CLIENT_H
+
+#include "common.h"
+#include "latency.h"
+#include <stdint.h>
+#include <sys/types.h>
+
+/* Prefix of the FIFO DOSEmu writes debugger output to */
+#define DOSEMU_DEBUG_OUT_PREFIX "dosemu.dbgout."
+
+/* Byte DOSEmu's debugger sends after the output of each command */
+#define DBG_RESPONSE_END "\001"
+
+/* Largest memory read a single dbg_read_mem() request may ask for */
+#define DBG_MAX_READ 4096
+
+/* Commands written to the debugger ahead of their responses */
+#define DBG_PIPELINE_DEPTH 16
+
+/* Distinct command verbs tracked in the latency statistics */
+#define DBG_MAX_STATS 32
+
+/* Register file as reported by the "r" command */
+typedef struct DbgRegs {
+    uint32_t eax, ebx, ecx, edx;
+    uint32_t esi, edi, ebp, esp;
+    uint32_t eip, eflags;
+    uint16_t cs, ds, es, ss, fs, gs;
+} DbgRegs;
+
+typedef struct DbgClient DbgClient;
+
+/* Round-trip latency of one command verb, across all clients */
+typedef struct DbgCommandStats {
+    char verb[16];
+    LatencyHistogram latency;
+} DbgCommandStats;
+
+/* Raw command output; text is NULL if the debugger went away first */
+typedef void (*dbg_text_callback)(const char *text, void *data);
+
+/* Parsed "r" output */
+typedef void (*dbg_regs_callback)(bool ok, const DbgRegs *regs, void *data);
+
+/* Parsed "d" output; len may be short if the dump was truncated */
+typedef void (*dbg_mem_callback)(bool ok, uint16_t segment, uint32_t offset,
+                                 const uint8_t *bytes, size_t len, void *data);
+
+/*
+ * Connect to the debugger FIFOs of a running DOSEmu. endpoint is the
+ * dosemu.dbgin.<pid> path found by the readiness watch. Commands are
+ * pipelined, up to DBG_PIPELINE_DEPTH at a time, and answered in the order
+ * they were issued. All callbacks run on the UI thread.
+ */
+DbgClient *dbg_open(const char *endpoint);
+
+/* Disconnect; callbacks of unanswered commands get a failure */
+void dbg_close(DbgClient *client);
+
+/* pid of the DOSEmu process that owns the endpoint */
+pid_t dbg_pid(const DbgClient *client);
+
+/* Session the client's exchanges are recorded against in transcripts */
+void dbg_set_session(DbgClient *client, int session_id);
+
+/* Commands issued so far, answered or not */
+uint64_t dbg_commands_issued(const DbgClient *client);
+
+/*
+ * A client with no FIFOs for replaying a transcript: commands queue as
+ * usual and dbg_replay_output() answers them in order, on the UI thread,
+ * through the same parsing and callbacks as DOSEmu's output would.
+ */
+DbgClient *dbg_open_replay(pid_t pid);
+void dbg_replay_output(DbgClient *client, const char *response);
+
+/* Send any debugger command line and receive its raw output */
+bool dbg_command(DbgClient *client, const char *line, dbg_text_callback callback, void *data);
+
+/* Read the register file */
+bool dbg_regs(DbgClient *client, dbg_regs_callback callback, void *data);
+
+/* Read len bytes of guest memory at segment:offset */
+bool dbg_read_mem(DbgClient *client, uint16_t segment, uint32_t offset, size_t len,
+                  dbg_mem_callback callback, void *data);
+
+/* Ask DOSEmu to leave via the debugger's "kill" command */
+bool dbg_kill(DbgClient *client);
+
+/* Parsers for debugger output, exposed for reuse by other views */
+bool dbg_parse_regs(const char *text, DbgRegs *regs);
+size_t dbg_parse_dump(const char *text, uint8_t *bytes, size_t capacity);
+
+/* Bytes of the instruction at cs:ip where the output disassembles it; 0 if it does not */
+size_t dbg_parse_code(const char *text, uint16_t cs, uint32_t ip, uint8_t *bytes,
+                      size_t capacity);
+
+/* Per-command latency statistics; UI thread only */
+int dbg_stats_count(void);
+const DbgCommandStats *dbg_stats_at(int index);
+
+#endif /* DOSEMU2_GUI_DBG_CLIENT_H */
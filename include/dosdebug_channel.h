@@ -0,0 +1,45 @@
+#ifndef DOSEMU2_GUI_DOSDEBUG_CHANNEL_H
+#define DOSEMU2_GUI_DOSDEBUG_CHANNEL_H
+
+#include "common.h"
+
+/* Prompt printed by dosdebug when it is ready for the next command */
+#define DOSDEBUG_PROMPT "dosdebug> "
+
+/* Longest response delivered; anything longer is reported as overflowed */
+#define DOSDEBUG_MAX_RESPONSE (1024 * 1024)
+
+/*
+ * Called on the UI thread with the text dosdebug printed before each
+ * prompt (or other terminator). response is NULL once the output closes,
+ * and also, with overflowed set, in place of a response longer than
+ * DOSDEBUG_MAX_RESPONSE, which is discarded up to its terminator so the
+ * responses after it still line up.
+ */
+typedef void (*dosdebug_response_callback)(const char *response, bool overflowed, void *data);
+
+typedef struct DosdebugChannel DosdebugChannel;
+
+/* Longest supported response terminator */
+#define CHANNEL_MAX_TERMINATOR 16
+
+/* Attach a channel to dosdebug's stdin/stdout and start reading on the I/O thread */
+DosdebugChannel *dosdebug_channel_open(int in_fd, int out_fd,
+                                       dosdebug_response_callback on_response,
+                                       void *data);
+
+/* As dosdebug_channel_open(), framing responses on terminator instead of the prompt */
+DosdebugChannel *dosdebug_channel_open_framed(int in_fd, int out_fd, const char *terminator,
+                                              dosdebug_response_callback on_response,
+                                              void *data);
+
+/* Queue a command line (without trailing newline) for dosdebug */
+void dosdebug_channel_send(DosdebugChannel *channel, const char *command);
+
+/* Queue raw bytes for dosdebug, e.g. a Ctrl-C */
+void dosdebug_channel_send_raw(DosdebugChannel *channel, const char *bytes, size_t len);
+
+/* Detach from the I/O thread and free the channel; the fds are left open */
+void dosdebug_channel_close(DosdebugChannel *channel);
+
+#endif /* DOSEMU2_GUI_DOSDEBUG_CHANNEL_H */
@@ -2,14 +2,113 @@
 #define DOSEMU2_GUI_DOSEMU_INTEGRATION_H
 
 #include "common.h"
+#include "dbg_client.h"
+#include "exit_watch.h"
+#include "readiness.h"
+#include "shutdown.h"
+#include <sys/types.h>
 
-/* Start DOSEmu with the given paths */
-bool start_dosemu(const char *dos_path, const char *config_path);
+/* Maximum number of concurrently managed DOSEmu instances */
+#define MAX_SESSIONS 128
 
-/* Stop the running DOSEmu instance */
-bool stop_dosemu(void);
+/* Lifecycle of one DOSEmu instance */
+typedef enum SessionState {
+    SESSION_STARTING,   /* waiting for the debug endpoint or first prompt */
+    SESSION_RUNNING,    /* debugger attached */
+    SESSION_IDLE,       /* debugger attached, held unused in the pre-warm pool */
+    SESSION_STOPPING,   /* shutdown in progress */
+    SESSION_STOPPED     /* gone; about to leave the session table */
+} SessionState;
 
-/* Check if DOSEmu is currently running */
-bool is_dosemu_running(void);
+/* One DOSEmu instance with its own process, buffers and debugger client */
+typedef struct DosemuSession DosemuSession;
+
+/* Called on the UI thread when an asynchronous start or stop completes */
+typedef void (*dosemu_done_callback)(DosemuSession *session, bool success, void *data);
+
+/* How the session table changed, for list views */
+typedef enum SessionEvent {
+    SESSION_ADDED,
+    SESSION_CHANGED,
+    SESSION_REMOVED
+} SessionEvent;
+
+/* Called on the UI thread with the table index the event applies to */
+typedef void (*session_listener)(SessionEvent event, int index, void *data);
+
+/*
+ * Start a new DOSEmu session with the given paths. Returns NULL if the
+ * launch failed outright; otherwise on_started is called once the debugger is
+ * attached, or when DOSEmu fails to come up within app.attach_timeout_ms.
+ */
+DosemuSession *start_dosemu(const char *dos_path, const char *config_path,
+                            dosemu_done_callback on_started, void *data);
+
+/*
+ * As start_dosemu(), but if dos_command is non-NULL DOSEmu runs it on the
+ * dumb terminal and exits when it finishes, as for unattended batch jobs.
+ */
+DosemuSession *start_dosemu_command(const char *dos_path, const char *config_path,
+                                    const char *dos_command, dosemu_done_callback on_started,
+                                    void *data);
+
+/*
+ * A session with no DOSEmu process behind it, for transcript replay
+ * (transcript.h). The replay delivers what the readiness watch, the
+ * shutdown machine and the exit watch reported when the transcript was
+ * recorded; each returns false if the session is not in a state to take
+ * it. Everything else, including stop_dosemu() and the debugger, works as
+ * for a real session.
+ */
+DosemuSession *dosemu_replay_launch(pid_t pid, const char *dos_command,
+                                    dosemu_done_callback on_started, void *data);
+bool dosemu_replay_endpoint(DosemuSession *session, ReadinessResult result,
+                            const char *endpoint, double elapsed_ms);
+bool dosemu_replay_shutdown(DosemuSession *session, const ShutdownResult *results, int count,
+                            double total_ms);
+bool dosemu_replay_exited(DosemuSession *session, const ExitInfo *info);
+
+/*
+ * Stop a DOSEmu session without blocking. Returns false if it is not
+ * running; otherwise on_stopped is called once DOSEmu has exited
+ * (success) or could not be stopped even with SIGKILL.
+ */
+bool stop_dosemu(DosemuSession *session, dosemu_done_callback on_stopped, void *data);
+
+/* Check if a session's DOSEmu is currently running */
+bool is_dosemu_running(DosemuSession *session);
+
+/*
+ * Call on_exit on the UI thread if DOSEmu exits on its own after its launch
+ * completed; success means exit status 0. The session leaves the table
+ * right after the call. Launch failures and stop_dosemu() report through
+ * their own callbacks instead.
+ */
+void dosemu_session_on_exit(DosemuSession *session, dosemu_done_callback on_exit, void *data);
+
+/* Session table, in start order */
+int dosemu_session_count(void);
+DosemuSession *dosemu_session_at(int index);
+DosemuSession *dosemu_session_find(int id);
+void dosemu_set_session_listener(session_listener listener, void *data);
+
+/* Session accessors */
+int dosemu_session_id(const DosemuSession *session);
+SessionState dosemu_session_state(const DosemuSession *session);
+pid_t dosemu_session_pid(const DosemuSession *session);
+/* Signal DOSEmu through the pidfd taken at spawn; false if it is not running */
+bool dosemu_session_signal(const DosemuSession *session, int sig);
+DbgClient *dosemu_session_debugger(const DosemuSession *session);
+/* DOSEmu's exit status once it has been reaped, otherwise -1 */
+int dosemu_session_exit_status(const DosemuSession *session);
+/* Exit status and resource usage once DOSEmu has been reaped, otherwise NULL */
+const ExitInfo *dosemu_session_exit_info(const DosemuSession *session);
+/* Move a running session into or out of the pre-warm pool */
+void dosemu_session_set_idle(DosemuSession *session, bool idle);
+/* Milliseconds from launch until the debugger answered, or -1 */
+double dosemu_session_ready_ms(const DosemuSession *session);
+/* Whether the config file the session was launched from changed since */
+bool dosemu_session_config_stale(const DosemuSession *session);
+const char *dosemu_session_state_name(SessionState state);
 
 #endif /* DOSEMU2_GUI_DOSEMU_INTEGRATION_H */
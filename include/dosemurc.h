@@ -0,0 +1,69 @@
+#ifndef DOSEMU2_GUI_DOSEMURC_H
+#define DOSEMU2_GUI_DOSEMURC_H
+
+#include "common.h"
+#include <stdint.h>
+
+/* Generated configs are kept under <runtime dir>/dosemu2-gui/config */
+#define DOSEMURC_CACHE_SUBDIR "dosemu2-gui/config"
+
+/* Launch configs remembered in memory, and config files watched */
+#define DOSEMURC_CACHE_ENTRIES 64
+#define DOSEMURC_MAX_SOURCES 32
+
+/* Change callbacks that can be registered */
+#define DOSEMURC_MAX_CALLBACKS 4
+
+/* Largest config file read */
+#define DOSEMURC_MAX_SOURCE_BYTES (1024 * 1024)
+
+/* Limits of the Configuration tab settings, in KB */
+#define DOSEMURC_MAX_MEMORY_KB (1024 * 1024)
+#define DOSEMURC_MAX_XMS_KB (3 * 1024 * 1024)
+#define DOSEMURC_MAX_EMS_KB (64 * 1024)
+#define DOSEMURC_EMS_PAGE_KB 16
+
+/* Settings from the Configuration tab; 0 or false leaves DOSEmu's own value */
+typedef struct DosemurcSettings {
+    int memory_kb;     /* $_dpmi */
+    int xms_kb;        /* $_xms */
+    int ems_kb;        /* $_ems */
+    bool console;      /* $_console = (on) */
+    bool vga;          /* $_video = "vga" */
+} DosemurcSettings;
+
+typedef struct DosemurcStats {
+    uint64_t hits;          /* launches served from the in-memory cache */
+    uint64_t generated;     /* configs parsed, validated and written */
+    uint64_t reused;        /* generated, but an identical file was already cached */
+    uint64_t invalidated;   /* cache entries dropped because a config file changed */
+} DosemurcStats;
+
+/* Called on the UI thread when the config of sessions launched from source changed */
+typedef void (*dosemurc_change_callback)(const char *source, void *data);
+
+/*
+ * Settings merged into every following launch config. If they differ
+ * from the previous ones the change callback runs with an empty source,
+ * since every generated config changed. UI thread only, like the rest.
+ */
+void dosemurc_configure(const DosemurcSettings *settings);
+
+/*
+ * The file to pass to DOSEmu with -f: config_path (NULL, empty or
+ * "~/.dosemurc" for the user's own file) with the settings merged in, in
+ * a content-addressed file on tmpfs. A drive directory, if given,
+ * replaces $_hdimage. path is left empty if there is nothing to merge
+ * and DOSEmu should read its config itself. source gets
+ * the absolute path of the file read, for the change callback. Returns
+ * false, after logging why, if the config does not validate.
+ */
+bool dosemurc_launch_config(const char *config_path, const char *drive, char *path,
+                            size_t path_size, char *source, size_t source_size);
+
+/* Register a change callback; they run in registration order. Files are watched with inotify */
+bool dosemurc_add_change_callback(dosemurc_change_callback callback, void *data);
+
+void dosemurc_stats(DosemurcStats *stats);
+
+#endif /* DOSEMU2_GUI_DOSEMURC_H */
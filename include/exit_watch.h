@@ -0,0 +1,34 @@
+#ifndef DOSEMU2_GUI_EXIT_WATCH_H
+#define DOSEMU2_GUI_EXIT_WATCH_H
+
+#include "common.h"
+#include <sys/types.h>
+
+/* Check interval for kernels without pidfd */
+#define EXIT_WATCH_POLL_MS 100
+
+/* How a child ended and what it used, from wait4() */
+typedef struct ExitInfo {
+    pid_t pid;
+    int status;          /* exit code, or 128 + signal like a shell; -1 if unknown */
+    int signal;          /* terminating signal, or 0 */
+    double user_ms;
+    double system_ms;
+    long max_rss_kb;
+} ExitInfo;
+
+/* Called on the UI thread once the child has exited and been reaped */
+typedef void (*exit_callback)(const ExitInfo *info, void *data);
+
+typedef struct ExitWatch ExitWatch;
+
+/*
+ * Reap pid on the I/O thread as soon as it exits, using its pidfd in the
+ * epoll set, and report its status and resource usage.
+ */
+ExitWatch *exit_watch_start(pid_t pid, exit_callback callback, void *data);
+
+/* Stop reporting; the child is still reaped when it exits. UI thread only */
+void exit_watch_release(ExitWatch *watch);
+
+#endif /* DOSEMU2_GUI_EXIT_WATCH_H */
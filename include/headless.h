@@ -0,0 +1,22 @@
+#ifndef DOSEMU2_GUI_HEADLESS_H
+#define DOSEMU2_GUI_HEADLESS_H
+
+#include "common.h"
+
+/*
+ * The integration layer hands results to "the UI thread" with main_queue().
+ * Normally that is libui's main loop. After headless_enable() it is
+ * whichever thread calls headless_run_until(), so batch runs and the
+ * benchmarks can drive sessions without initialising libui.
+ */
+
+/* Queue fn(data) for the UI thread; safe from any thread */
+void main_queue(void (*fn)(void *data), void *data);
+
+/* Route main_queue() to headless_run_until(); call before io_loop_start() */
+void headless_enable(void);
+
+/* Run queued work until *done is set or timeout_ms passes */
+bool headless_run_until(const bool *done, int timeout_ms);
+
+#endif /* DOSEMU2_GUI_HEADLESS_H */
@@ -0,0 +1,41 @@
+#ifndef DOSEMU2_GUI_IO_LOOP_H
+#define DOSEMU2_GUI_IO_LOOP_H
+
+#include "common.h"
+#include <stdint.h>
+
+/* Called on the I/O thread when a watched descriptor is ready */
+typedef void (*io_fd_callback)(int fd, uint32_t events, void *data);
+
+/* Start the I/O thread; must be called before any other io_loop function */
+bool io_loop_start(void);
+
+/* Stop the I/O thread and release its resources */
+void io_loop_stop(void);
+
+/* Check whether the caller is running on the I/O thread */
+bool io_loop_is_current(void);
+
+/*
+ * Descriptor watches. These must only be called on the I/O thread, either
+ * from an fd callback or from a function handed to io_loop_post().
+ */
+bool io_loop_add_fd(int fd, uint32_t events, io_fd_callback callback, void *data);
+bool io_loop_modify_fd(int fd, uint32_t events);
+void io_loop_remove_fd(int fd);
+
+/*
+ * One-shot timeouts backed by a timerfd. The returned id is passed to
+ * io_loop_cancel_timeout(); the callback's fd argument is that id. Like the
+ * descriptor watches these are I/O thread only.
+ */
+int io_loop_add_timeout(int milliseconds, io_fd_callback callback, void *data);
+void io_loop_cancel_timeout(int id);
+
+/* Run fn(data) on the I/O thread; safe to call from any thread */
+bool io_loop_post(void (*fn)(void *data), void *data);
+
+/* Run fn(data) on the I/O thread and wait for it to return */
+bool io_loop_call(void (*fn)(void *data), void *data);
+
+#endif /* DOSEMU2_GUI_IO_LOOP_H */
@@ -0,0 +1,84 @@
+#ifndef DOSEMU2_GUI_ITRACE_H
+#define DOSEMU2_GUI_ITRACE_H
+
+#include "common.h"
+#include "dbg_client.h"
+#include "dosemu_integration.h"
+#include <stdint.h>
+
+/* Single-step commands queued on the debugger ahead of their answers */
+#define ITRACE_STEPS_AHEAD 256
+
+/* Encoded records per compressed block, before compression */
+#define ITRACE_BLOCK_BYTES (256 * 1024)
+
+/* Longest x86 instruction */
+#define ITRACE_MAX_OPCODE 15
+
+/* First bytes of a trace file */
+#define ITRACE_MAGIC "DGITRC1\n"
+
+/* One executed instruction and the register file it left behind */
+typedef struct ItraceRecord {
+    uint16_t cs;
+    uint32_t ip;
+    uint8_t opcode_length;     /* 0 if the debugger did not show the bytes */
+    uint8_t opcode[ITRACE_MAX_OPCODE];
+    DbgRegs regs;
+} ItraceRecord;
+
+/* Progress of the running (or last) trace */
+typedef struct ItraceStats {
+    int session_id;
+    uint64_t instructions;
+    uint64_t failed;           /* steps whose answer could not be parsed */
+    uint64_t encoded_bytes;    /* before compression */
+    uint64_t file_bytes;
+    uint64_t writer_stalls;    /* full blocks that waited for the writer thread */
+    double instructions_per_second;
+} ItraceStats;
+
+/*
+ * Single-step a running session through its debugger and record every
+ * instruction to path, keeping ITRACE_STEPS_AHEAD steps in flight. The
+ * guest resumes when tracing stops; itrace_stop() first records the steps
+ * still in flight, so itrace_running() stays true until they are back.
+ * UI thread only.
+ */
+bool itrace_start(DosemuSession *session, const char *path);
+void itrace_stop(void);
+bool itrace_running(void);
+void itrace_stats(ItraceStats *stats);
+
+/*
+ * Trace file writer. Records are delta-encoded against the one before
+ * them into a block; a full block is handed to a writer thread, which
+ * deflates and writes it while the next block fills. Each block starts
+ * from a clean state so it decodes on its own. One thread adds records.
+ */
+typedef struct ItraceWriter ItraceWriter;
+
+ItraceWriter *itrace_writer_open(const char *path);
+bool itrace_writer_add(ItraceWriter *writer, const ItraceRecord *record);
+
+/* Write the last block, stop the thread and close; false if anything failed */
+bool itrace_writer_close(ItraceWriter *writer);
+
+uint64_t itrace_writer_encoded_bytes(const ItraceWriter *writer);
+uint64_t itrace_writer_file_bytes(const ItraceWriter *writer);
+uint64_t itrace_writer_stalls(const ItraceWriter *writer);
+
+/* Trace file reader over a read-only mapping of the file */
+typedef struct ItraceReader ItraceReader;
+
+ItraceReader *itrace_reader_open(const char *path);
+
+/* The next record, in execution order; false at the end or on a corrupt block */
+bool itrace_reader_next(ItraceReader *reader, ItraceRecord *record);
+
+/* Whether reading stopped on a corrupt or truncated block */
+bool itrace_reader_failed(const ItraceReader *reader);
+
+void itrace_reader_close(ItraceReader *reader);
+
+#endif /* DOSEMU2_GUI_ITRACE_H */
@@ -0,0 +1,32 @@
+#ifndef DOSEMU2_GUI_LATENCY_H
+#define DOSEMU2_GUI_LATENCY_H
+
+#include "common.h"
+#include <stdint.h>
+
+/* Buckets per power of two; bounds the percentile error to about 19% */
+#define LATENCY_SUBBUCKETS 4
+
+/* Powers of two covered, from 1 us up to about 16 s */
+#define LATENCY_OCTAVES 24
+
+#define LATENCY_BUCKETS (1 + LATENCY_OCTAVES * LATENCY_SUBBUCKETS)
+
+/* Log-scale histogram of durations, fixed size and allocation free */
+typedef struct LatencyHistogram {
+    uint64_t counts[LATENCY_BUCKETS];
+    uint64_t total;
+    double sum_ms;
+    double max_ms;
+} LatencyHistogram;
+
+/* Add one duration */
+void latency_record(LatencyHistogram *histogram, double ms);
+
+/* Duration below which the given fraction (0..1) of samples fall */
+double latency_percentile(const LatencyHistogram *histogram, double fraction);
+
+/* Mean of all samples, or 0 if there are none */
+double latency_mean(const LatencyHistogram *histogram);
+
+#endif /* DOSEMU2_GUI_LATENCY_H */
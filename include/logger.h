@@ -0,0 +1,50 @@
+#ifndef DOSEMU2_GUI_LOGGER_H
+#define DOSEMU2_GUI_LOGGER_H
+
+#include "common.h"
+#include <stdarg.h>
+#include <stdint.h>
+
+/* Queue between logging threads and the logger thread: slots of 64 bytes, 4 MB */
+#define LOG_QUEUE_SLOTS 65536
+
+/* Largest encoded record; string arguments are cut to fit */
+#define LOG_MAX_RECORD 4096
+
+/* Conversions a format may have; formats with more are formatted eagerly */
+#define LOG_MAX_ARGS 16
+
+/* Distinct format strings remembered; later ones are formatted eagerly */
+#define LOG_MAX_FORMATS 1024
+
+/* How long the logger thread sleeps when nothing is queued */
+#define LOG_IDLE_WAIT_MS 100
+
+typedef enum LogLevel {
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_ERROR
+} LogLevel;
+
+/*
+ * Queue a record: a timestamp, the session it concerns (0 for none), the
+ * level, the format's id and the raw arguments. Safe from any thread and
+ * never blocks; the logger thread formats it for the console later. When
+ * the queue is full the record is dropped and counted. The format must be
+ * a string literal, since records refer to it by address.
+ */
+void log_record(LogLevel level, int session_id, const char *format, ...);
+void log_vrecord(LogLevel level, int session_id, const char *format, va_list args);
+
+/* Also append every record to a binary log file; NULL or empty stops that */
+bool logger_open_file(const char *path);
+
+/* Wait until everything queued so far reached the console and the log file */
+void logger_flush(void);
+
+/* Records lost to a full queue */
+uint64_t logger_dropped(void);
+
+/* Print a binary log file as text, one line per record; false if it is not one */
+bool logger_decode(FILE *in, FILE *out);
+
+#endif /* DOSEMU2_GUI_LOGGER_H */
@@ -0,0 +1,40 @@
+#ifndef DOSEMU2_GUI_MEMVIEW_H
+#define DOSEMU2_GUI_MEMVIEW_H
+
+#include "common.h"
+#include <stdint.h>
+
+/* Guest memory is fetched and cached in pages of this size */
+#define MEMVIEW_PAGE_SIZE 4096
+
+/* Pages kept in the LRU cache */
+#define MEMVIEW_CACHE_PAGES 256
+
+/* A cached page of guest memory */
+typedef struct MemoryPage {
+    uint32_t address;        /* linear address of the first byte */
+    size_t length;           /* bytes the debugger returned, up to a page */
+    uint8_t bytes[MEMVIEW_PAGE_SIZE];
+    uint64_t changed_blocks; /* 64-byte blocks that differ from the previous fetch */
+    uint8_t changed[MEMVIEW_PAGE_SIZE / 8];   /* the differing bytes, one bit each */
+} MemoryPage;
+
+/* Called on the UI thread whenever a page is (re)loaded */
+typedef void (*memview_listener)(uint32_t address, void *data);
+
+/* Browse the memory of a session; drops pages cached for another one */
+void memview_attach(int session_id, memview_listener listener, void *data);
+
+/*
+ * The cached page containing address, or NULL if it is not loaded yet. A
+ * miss starts an asynchronous fetch and the listener fires when it lands.
+ */
+const MemoryPage *memview_page(uint32_t address);
+
+/* Whether a byte changed between the last two fetches of its page */
+bool memview_byte_changed(const MemoryPage *page, size_t index);
+
+/* Re-fetch the cached pages overlapping [first, last] to pick up changes */
+void memview_refresh(uint32_t first, uint32_t last);
+
+#endif /* DOSEMU2_GUI_MEMVIEW_H */
@@ -0,0 +1,75 @@
+#ifndef DOSEMU2_GUI_OVERLAY_H
+#define DOSEMU2_GUI_OVERLAY_H
+
+#include "common.h"
+#include <stdint.h>
+
+/*
+ * Staged drives live in <runtime dir>/dosemu2-gui/drives/<pid>-XXXXXX/<slot>,
+ * a directory each process holds a flock on, so concurrent GUIs and batch
+ * runs never share slots. Overlays kept after a conflict move to
+ * drives/kept-<pid>-session-<id>.
+ */
+#define OVERLAY_SUBDIR "dosemu2-gui/drives"
+
+/* Drives staged at once; one per session at most */
+#define OVERLAY_MAX_SLOTS 128
+
+/* Cost and payoff of one overlay, or of all of them in overlay_totals() */
+typedef struct OverlayStats {
+    uint64_t overlays;         /* overlays staged; totals only */
+    uint64_t files;
+    uint64_t directories;
+    uint64_t bytes_copied;
+    uint64_t bytes_cloned;     /* shared with the base drive through reflinks */
+    double stage_ms;
+    uint64_t harvested_files;  /* new or changed files copied back */
+    uint64_t harvested_bytes;
+    uint64_t deleted_files;    /* files and directories removed from the base drive */
+    uint64_t conflicts;        /* changed in the base drive too, so left alone */
+    double harvest_ms;
+} OverlayStats;
+
+/* A private copy of a DOS drive directory for one session */
+typedef struct DriveOverlay DriveOverlay;
+
+/* Called on the UI thread once staging finished */
+typedef void (*overlay_staged_callback)(DriveOverlay *overlay, bool success, void *data);
+
+/* Called on the UI thread once harvesting finished; success is false if anything was left */
+typedef void (*overlay_harvested_callback)(DriveOverlay *overlay, bool success, void *data);
+
+/*
+ * Reserve an empty staging directory on tmpfs for the drive at base. Its
+ * path is final from here on, so a config can name it before it is
+ * populated. NULL, after logging why, if base is not a directory or no
+ * slot is free. UI thread only, like the rest.
+ */
+DriveOverlay *overlay_create(const char *base, int session_id);
+const char *overlay_path(const DriveOverlay *overlay);
+
+/*
+ * Copy the base drive into the overlay on a worker thread: reflinked where
+ * the filesystems allow it, copied in the kernel otherwise, with file
+ * times kept so DOS sees the same dates and changes can be told apart.
+ * Symbolic links are pointed at the overlay's copy of their target; links
+ * that leave the drive are not staged.
+ */
+bool overlay_stage(DriveOverlay *overlay, overlay_staged_callback callback, void *data);
+
+/*
+ * Write back what DOS changed once it has exited, on a worker thread: new
+ * and modified files, and deleted files and directories. Files that also
+ * changed in the base drive since staging are conflicts and are left
+ * alone. Only changed files are copied. Leave the overlay alone until
+ * callback runs; false if the worker could not be started.
+ */
+bool overlay_harvest(DriveOverlay *overlay, overlay_harvested_callback callback, void *data);
+
+/* Remove the staged copy, or with keep move it aside for inspection; frees overlay */
+void overlay_close(DriveOverlay *overlay, bool keep);
+
+void overlay_stats(const DriveOverlay *overlay, OverlayStats *stats);
+void overlay_totals(OverlayStats *stats);
+
+#endif /* DOSEMU2_GUI_OVERLAY_H */
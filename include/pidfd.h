@@ -0,0 +1,12 @@
+#ifndef DOSEMU2_GUI_PIDFD_H
+#define DOSEMU2_GUI_PIDFD_H
+
+#include <sys/types.h>
+
+/* Open a pidfd for pid, or return -1 (errno set) */
+int pidfd_open_pid(pid_t pid);
+
+/* Signal a process through its pidfd, falling back to kill() without one */
+int pidfd_signal(int pidfd, pid_t pid, int sig);
+
+#endif /* DOSEMU2_GUI_PIDFD_H */
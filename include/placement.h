@@ -0,0 +1,68 @@
+#ifndef DOSEMU2_GUI_PLACEMENT_H
+#define DOSEMU2_GUI_PLACEMENT_H
+
+#include "common.h"
+#include <stdint.h>
+
+/* CPUs an affinity list may name, as glibc's cpu_set_t */
+#define PLACEMENT_MAX_CPUS 1024
+
+/* Scheduling class DOSEmu instances run in */
+typedef enum SchedClass {
+    SCHED_CLASS_NORMAL,
+    SCHED_CLASS_BATCH,
+    SCHED_CLASS_IDLE
+} SchedClass;
+
+/* Where and how instances run, from the Configuration tab or the command line */
+typedef struct PlacementConfig {
+    const char *cpus;          /* affinity list such as "2-3,6"; NULL or empty inherits ours */
+    bool auto_spread;          /* one instance per physical core, least loaded first */
+    SchedClass sched_class;
+    int nice;                  /* added to our nice value; 0 keeps it */
+    const char *cgroup_parent; /* delegated cgroup v2 directory; NULL or empty for none */
+    int cpu_max_percent;       /* of one core; 0 is unlimited */
+    size_t memory_max_mb;      /* 0 is unlimited */
+} PlacementConfig;
+
+/* What one launch was given; filled in by placement_prepare() */
+typedef struct Placement {
+    bool pin;
+    uint64_t cpus[PLACEMENT_MAX_CPUS / 64];   /* one bit per CPU */
+    int core;                  /* auto-spread core held, or -1 */
+    SchedClass sched_class;
+    int nice;
+    int cgroup_procs_fd;       /* -1 when not placed in a cgroup */
+    char *cgroup_path;         /* NULL when not placed in a cgroup */
+} Placement;
+
+/*
+ * Use config for every launch from now on; instances already running, such
+ * as pre-warmed ones, keep what they were started with. False, with the
+ * previous configuration kept, if the CPU list does not parse.
+ */
+bool placement_configure(const PlacementConfig *config);
+
+/* Bumped by each placement_configure() that changes anything, so launches can be told apart */
+int placement_generation(void);
+
+/*
+ * Resolve the configuration for a new instance: pick its CPUs and create
+ * and limit its cgroup. UI thread only.
+ */
+bool placement_prepare(int session_id, Placement *placement);
+
+/*
+ * Apply a prepared placement to the calling process. Runs in the child
+ * between fork and exec, so it only makes system calls. Returns 0 or an
+ * errno value.
+ */
+int placement_apply(const Placement *placement);
+
+/* Give back the instance's core and remove its cgroup once it has exited */
+void placement_release(Placement *placement);
+
+/* One-line summary for the session log; empty when nothing is placed */
+void placement_describe(const Placement *placement, char *buffer, size_t size);
+
+#endif /* DOSEMU2_GUI_PLACEMENT_H */
@@ -0,0 +1,52 @@
+#ifndef DOSEMU2_GUI_POOL_H
+#define DOSEMU2_GUI_POOL_H
+
+#include "common.h"
+#include "dosemu_integration.h"
+#include "latency.h"
+#include <stdint.h>
+
+/* Launches that fail in a row before the pool stops refilling */
+#define POOL_MAX_FAILURES 3
+
+/* How the pre-warm pool is set up */
+typedef struct PoolConfig {
+    const char *dos_path;
+    const char *config_path;
+    int size;                  /* idle instances to keep ready; 0 disables the pool */
+    int refill_concurrency;    /* instances booting at once */
+    size_t memory_budget_kb;   /* resident memory of all idle instances; 0 is unlimited */
+} PoolConfig;
+
+/* Pool activity, for display */
+typedef struct PoolStats {
+    int ready;
+    int warming;
+    uint64_t hits;
+    uint64_t misses;
+    size_t idle_rss_kb;
+    LatencyHistogram boot;          /* pool instance launch to debugger attached */
+    LatencyHistogram time_to_ready; /* pool_start() to a controllable session */
+} PoolStats;
+
+/*
+ * Keep instances booted with their debugger attached. Idle instances
+ * started with other paths, staged from another app.drive_dir or placed
+ * under another placement_configure(), are stopped. UI thread only, like the rest of the pool.
+ */
+void pool_configure(const PoolConfig *config);
+
+/*
+ * Start a session, handing over an idle instance when one was booted with
+ * the same paths, drive and placement and refilling behind it; otherwise
+ * falls back to start_dosemu(). on_started is called on the UI thread either way.
+ */
+DosemuSession *pool_start(const char *dos_path, const char *config_path,
+                          dosemu_done_callback on_started, void *data);
+
+void pool_stats(PoolStats *stats);
+
+/* Terminate idle instances without waiting; for application exit */
+void pool_shutdown(void);
+
+#endif /* DOSEMU2_GUI_POOL_H */
@@ -0,0 +1,63 @@
+#ifndef DOSEMU2_GUI_PROFILER_H
+#define DOSEMU2_GUI_PROFILER_H
+
+#include "common.h"
+#include "dbg_client.h"
+#include "dosemu_integration.h"
+#include <stdint.h>
+
+#define PROFILE_DEFAULT_RATE_HZ 100
+#define PROFILE_MAX_RATE_HZ 1000
+
+/* Samples buffered between the sampler and the aggregator; a power of two */
+#define PROFILE_RING_SIZE 4096
+
+/* Raw samples kept for export when the full register file is recorded */
+#define PROFILE_HISTORY_SIZE 65536
+
+/* One guest address and how often it was sampled */
+typedef struct ProfileEntry {
+    uint16_t segment;
+    uint32_t offset;
+    uint64_t samples;
+} ProfileEntry;
+
+/* What sampling costs, so the rate can be tuned */
+typedef struct ProfileStats {
+    int requested_hz;
+    double achieved_hz;
+    uint64_t samples;        /* aggregated so far */
+    uint64_t skipped;        /* ticks where the previous read was still outstanding */
+    uint64_t dropped;        /* samples lost to a full ring */
+    uint64_t failed;         /* register reads that failed */
+    double round_trip_p50_ms;
+    double round_trip_p99_ms;
+    double debugger_busy_percent;   /* share of wall time spent in register reads */
+    double sampler_us;       /* UI-thread time per sample */
+} ProfileStats;
+
+/*
+ * Sample CS:IP of a running session rate_hz times a second over its
+ * debugger connection; with full_regs the whole register file is kept for
+ * export as well. Starting clears the previous profile. UI thread only.
+ */
+bool profiler_start(DosemuSession *session, int rate_hz, bool full_regs);
+void profiler_stop(void);
+bool profiler_running(void);
+
+/* Move buffered samples into the histogram */
+void profiler_collect(void);
+
+/* Most sampled addresses, hottest first; returns how many were filled in */
+size_t profiler_top(ProfileEntry *entries, size_t max);
+
+uint64_t profiler_total_samples(void);
+uint64_t profiler_segment_samples(uint16_t segment);
+void profiler_stats(ProfileStats *stats);
+
+/* Exports: folded stacks, pprof -top style text and raw register samples */
+bool profiler_export_folded(const char *path);
+bool profiler_export_pprof(const char *path);
+bool profiler_export_samples(const char *path);
+
+#endif /* DOSEMU2_GUI_PROFILER_H */
@@ -0,0 +1,40 @@
+#ifndef DOSEMU2_GUI_READINESS_H
+#define DOSEMU2_GUI_READINESS_H
+
+#include "common.h"
+#include <sys/types.h>
+
+/* Prefix of the debugger FIFO DOSEmu creates in its runtime directory */
+#define DOSEMU_DEBUG_FIFO_PREFIX "dosemu.dbgin."
+
+/* Default time to wait for the debugger endpoint */
+#define DEFAULT_ATTACH_TIMEOUT_MS 10000
+
+typedef enum ReadinessResult {
+    READINESS_READY,     /* debugger endpoint exists */
+    READINESS_EXITED,    /* DOSEmu exited before creating it */
+    READINESS_TIMEOUT,   /* it did not appear in time */
+    READINESS_ERROR      /* the watch could not be set up */
+} ReadinessResult;
+
+/*
+ * Called on the UI thread when a watch finishes. endpoint is the FIFO path
+ * for READINESS_READY and NULL otherwise; elapsed_ms is measured from
+ * readiness_watch_start().
+ */
+typedef void (*readiness_callback)(ReadinessResult result, const char *endpoint,
+                                   double elapsed_ms, void *data);
+
+typedef struct ReadinessWatch ReadinessWatch;
+
+/* Wait for DOSEmu (pid or one of its descendants) to create its debug FIFO */
+ReadinessWatch *readiness_watch_start(pid_t pid, int timeout_ms,
+                                      readiness_callback callback, void *data);
+
+/* Stop waiting; the callback will not be called afterwards */
+void readiness_watch_cancel(ReadinessWatch *watch);
+
+/* Human-readable name of a result */
+const char *readiness_result_name(ReadinessResult result);
+
+#endif /* DOSEMU2_GUI_READINESS_H */
@@ -0,0 +1,61 @@
+#ifndef DOSEMU2_GUI_RESMON_H
+#define DOSEMU2_GUI_RESMON_H
+
+#include "common.h"
+#include <stdint.h>
+#include <sys/types.h>
+
+/* Samples kept per series; the sparklines show one point per sample */
+#define RESMON_HISTORY 120
+
+/* Sampling interval of an instance that is busy, and of one that is idle */
+#define RESMON_FAST_MS 250
+#define RESMON_SLOW_MS 2000
+
+/* An instance above either rate is busy */
+#define RESMON_BUSY_CPU_PERCENT 2.0
+#define RESMON_BUSY_IO_KB_S 16.0
+
+/* Quiet samples in a row before a busy instance drops to the slow rate */
+#define RESMON_QUIET_SAMPLES 4
+
+/* What is sampled for each instance */
+typedef enum ResourceSeries {
+    RESOURCE_CPU,      /* percent of one core */
+    RESOURCE_RSS,      /* resident MiB */
+    RESOURCE_IO,       /* KiB/s read plus written */
+    RESOURCE_SERIES_COUNT
+} ResourceSeries;
+
+/* The recent history of one monitored DOSEmu process */
+typedef struct ResourceHistory {
+    int session_id;
+    pid_t pid;
+    float values[RESOURCE_SERIES_COUNT][RESMON_HISTORY];
+    uint32_t samples;   /* taken so far; the newest is at (samples - 1) % RESMON_HISTORY */
+    int interval_ms;    /* current adaptive interval */
+} ResourceHistory;
+
+/*
+ * Pick up new sessions, forget ended ones and sample every instance that
+ * is due. Call every RESMON_FAST_MS or so from the UI thread; the
+ * /proc files stay open between calls and nothing is allocated. True if
+ * there is anything new to draw.
+ */
+bool resmon_sample(void);
+
+/* Monitored instances, in session table order */
+int resmon_count(void);
+const ResourceHistory *resmon_at(int index);
+
+/* The i-th oldest of the samples still held, i < resmon_filled() */
+float resmon_value(const ResourceHistory *history, ResourceSeries series, int i);
+int resmon_filled(const ResourceHistory *history);
+
+/* CPU time spent in resmon_sample() as a share of one core, over the last few seconds */
+double resmon_overhead_percent(void);
+
+/* Close every /proc file; for application exit */
+void resmon_close(void);
+
+#endif /* DOSEMU2_GUI_RESMON_H */
@@ -0,0 +1,49 @@
+#ifndef DOSEMU2_GUI_SCREEN_H
+#define DOSEMU2_GUI_SCREEN_H
+
+#include "common.h"
+#include <stdint.h>
+
+/* Largest text mode mirrored; the BIOS data area says what the guest uses */
+#define SCREEN_MAX_COLUMNS 132
+#define SCREEN_MAX_ROWS 60
+
+/* Running sessions mirrored at once, in session table order */
+#define SCREEN_MAX_MIRRORS 16
+
+/* Frame rate cap unless the caller asks for another */
+#define SCREEN_DEFAULT_FPS 10
+
+/* The last frame of one session's text screen */
+typedef struct ScreenMirror {
+    int session_id;
+    bool valid;             /* a frame has arrived */
+    bool text_mode;         /* false while the guest is in a graphics mode */
+    uint8_t video_mode;
+    int columns;
+    int rows;
+    uint16_t cells[SCREEN_MAX_ROWS * SCREEN_MAX_COLUMNS];  /* character | attribute << 8 */
+    uint64_t frames;        /* frames fetched */
+    uint64_t changed_frames;
+} ScreenMirror;
+
+/*
+ * Follow the session table and start fetching a frame of every mirrored
+ * screen that is due, at most fps times a second each and never while its
+ * previous frame is still on the way. Frames are read through the debugger:
+ * the BIOS data area for the mode and size, then the text buffer at
+ * B800:page (B000 in mode 7). Call from a UI timer; true if the set of
+ * mirrors changed.
+ */
+bool screen_poll(int fps);
+
+int screen_count(void);
+const ScreenMirror *screen_at(int index);
+
+/* Rows of a mirror that changed since the last call, one bit each; clears them */
+uint64_t screen_take_dirty(int index);
+
+/* A code page 437 character as UTF-8; returns the bytes written, at most 3 */
+size_t screen_char_utf8(uint8_t character, char *out);
+
+#endif /* DOSEMU2_GUI_SCREEN_H */
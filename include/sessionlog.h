@@ -0,0 +1,96 @@
+#ifndef DOSEMU2_GUI_SESSIONLOG_H
+#define DOSEMU2_GUI_SESSIONLOG_H
+
+#include "common.h"
+#include <stdint.h>
+
+/* Every this many lines the line index records where a line starts */
+#define SESSIONLOG_LINE_STRIDE 64
+
+/* Lines per block of the trigram index; a multiple of the stride */
+#define SESSIONLOG_BLOCK_LINES 4096
+
+/* Appended text is written to the file in chunks of up to this size */
+#define SESSIONLOG_WRITE_BUFFER (64 * 1024)
+
+/* The file mapping grows in steps of this size */
+#define SESSIONLOG_MAP_STEP (64ULL * 1024 * 1024)
+
+/* Bytes indexed per sessionlog_update_all() call, over all logs */
+#define SESSIONLOG_INDEX_BUDGET (4 * 1024 * 1024)
+
+/* Distinct trigrams of a query used to pick candidate blocks */
+#define SESSIONLOG_QUERY_TRIGRAMS 32
+
+/*
+ * An append-only log of one session's output, read back through mmap. A
+ * line index and a trigram index over blocks of lines are built on the
+ * UI thread as the file grows, so a search only reads the blocks that can
+ * hold a match. Opening, indexing, reading and searching happen on the UI
+ * thread; appending and flushing on whichever single thread produces the
+ * output (the I/O thread for captured output).
+ */
+typedef struct SessionLog SessionLog;
+
+/* An incremental search of one log; matches accumulate as it steps */
+typedef struct SessionLogSearch SessionLogSearch;
+
+/*
+ * Open a log for a session, appending to path, or to an unlinked
+ * temporary file if path is NULL or empty. The caller holds one reference.
+ */
+SessionLog *sessionlog_open(int session_id, const char *path);
+
+/* Add text to the write buffer; complete lines must end in '\n' */
+void sessionlog_append(SessionLog *log, const char *text, size_t length);
+
+/* Write out the buffer and let the indexer see it */
+void sessionlog_flush(SessionLog *log);
+
+/* The log of a session with a new reference, or NULL */
+SessionLog *sessionlog_find(int session_id);
+
+/* Drop a reference; the last one unmaps, frees the index and closes the file */
+void sessionlog_release(SessionLog *log);
+
+/*
+ * Index what has been written to every open log since the last call, up
+ * to SESSIONLOG_INDEX_BUDGET bytes. True if any log gained lines.
+ */
+bool sessionlog_update_all(void);
+
+int sessionlog_session_id(const SessionLog *log);
+
+/* Complete lines indexed so far, and the bytes they take */
+uint64_t sessionlog_lines(const SessionLog *log);
+uint64_t sessionlog_bytes(const SessionLog *log);
+
+/* Memory the line and trigram indexes take */
+size_t sessionlog_index_bytes(const SessionLog *log);
+
+/* Line number line without its newline; valid until the next update */
+const char *sessionlog_line(const SessionLog *log, uint64_t line, size_t *length);
+
+/* Start looking for lines containing query, ignoring ASCII case */
+SessionLogSearch *sessionlog_search_start(SessionLog *log, const char *query);
+
+/*
+ * Scan up to budget bytes of candidate lines, including lines indexed
+ * since the last step. True if matches were added.
+ */
+bool sessionlog_search_step(SessionLogSearch *search, size_t budget);
+
+/* Whether every line indexed so far has been searched */
+bool sessionlog_search_caught_up(const SessionLogSearch *search);
+
+/* Matching lines found so far, and the text of one of them */
+uint64_t sessionlog_search_count(const SessionLogSearch *search);
+const char *sessionlog_search_match(const SessionLogSearch *search, uint64_t index,
+                                    size_t *length);
+
+/* Bytes actually scanned so far, to show what the trigram index saved */
+uint64_t sessionlog_search_scanned(const SessionLogSearch *search);
+
+void sessionlog_search_free(SessionLogSearch *search);
+
+#endif /* DOSEMU2_GUI_SESSIONLOG_H */
@@ -0,0 +1,55 @@
+#ifndef DOSEMU2_GUI_SHUTDOWN_H
+#define DOSEMU2_GUI_SHUTDOWN_H
+
+#include "common.h"
+#include <sys/types.h>
+
+/* Maximum number of processes one shutdown can stop */
+#define SHUTDOWN_MAX_TARGETS 4
+
+/* Deadlines for the escalation steps after the graceful request */
+#define SHUTDOWN_TERM_DEADLINE_MS 1000
+#define SHUTDOWN_KILL_DEADLINE_MS 1000
+
+typedef enum ShutdownOutcome {
+    SHUTDOWN_ALREADY_EXITED,  /* gone before we asked */
+    SHUTDOWN_GRACEFUL,        /* exited after the graceful request */
+    SHUTDOWN_TERMINATED,      /* needed SIGTERM */
+    SHUTDOWN_KILLED,          /* needed SIGKILL */
+    SHUTDOWN_UNRESPONSIVE     /* survived SIGKILL's deadline */
+} ShutdownOutcome;
+
+/* A process to stop, in the order given */
+typedef struct ShutdownTarget {
+    const char *name;
+    pid_t pid;
+    int pid_fd;                   /* taken at spawn; -1 falls back to signalling pid */
+    void (*request)(void *data);  /* graceful request, run on the I/O thread; may be NULL */
+    void *request_data;
+    int grace_ms;                 /* how long to wait before SIGTERM */
+    int trace_id;                 /* session the phase spans are traced against */
+} ShutdownTarget;
+
+typedef struct ShutdownResult {
+    const char *name;
+    ShutdownOutcome outcome;
+    double elapsed_ms;
+} ShutdownResult;
+
+/* Called on the UI thread once every target has exited or been given up on */
+typedef void (*shutdown_callback)(const ShutdownResult *results, int count,
+                                  double total_ms, void *data);
+
+/*
+ * Stop each target in turn: run its graceful request and wait for the exit,
+ * escalating to SIGTERM and SIGKILL when the deadlines pass. Exits are
+ * observed and signals sent through each target's pidfd, duplicated here,
+ * so nothing blocks, children are not reaped and a reused pid is never hit.
+ */
+bool shutdown_start(const ShutdownTarget *targets, int count,
+                    shutdown_callback callback, void *data);
+
+/* Human-readable description of an outcome */
+const char *shutdown_outcome_name(ShutdownOutcome outcome);
+
+#endif /* DOSEMU2_GUI_SHUTDOWN_H */
@@ -0,0 +1,40 @@
+#ifndef DOSEMU2_GUI_SPAWN_H
+#define DOSEMU2_GUI_SPAWN_H
+
+#include "common.h"
+#include "placement.h"
+#include <sys/types.h>
+
+/* A launched child, our ends of its standard streams and its pidfd */
+typedef struct SpawnedProcess {
+    pid_t pid;
+    int pid_fd;      /* taken before anyone could reap pid; -1 without pidfd support */
+    int stdin_fd;
+    int stdout_fd;
+    int stderr_fd;
+} SpawnedProcess;
+
+/* How the child is created */
+typedef enum SpawnBackend {
+    SPAWN_VFORK,   /* clone(CLONE_VM | CLONE_VFORK): nothing copied; the default */
+    SPAWN_FORK     /* fork(): copies our page tables, for comparison */
+} SpawnBackend;
+
+/*
+ * Run argv[0] with our environment and its output on pipes, after applying
+ * placement (which may be NULL) in the child before exec. Only the three
+ * pipes are inherited; every other descriptor is closed on exec. Failures
+ * up to and including exec are reported here: false, with errno set and
+ * nothing left running.
+ */
+bool spawn_process(const char *const argv[], const Placement *placement,
+                   SpawnedProcess *process);
+
+/* spawn_process() with a particular backend, for benchmarking */
+bool spawn_process_with(SpawnBackend backend, const char *const argv[],
+                        const Placement *placement, SpawnedProcess *process);
+
+/* Close our ends of the child's streams and its pidfd; reaping is the caller's business */
+void spawn_release(SpawnedProcess *process);
+
+#endif /* DOSEMU2_GUI_SPAWN_H */
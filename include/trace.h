@@ -0,0 +1,29 @@
+#ifndef DOSEMU2_GUI_TRACE_H
+#define DOSEMU2_GUI_TRACE_H
+
+#include "common.h"
+#include <stdint.h>
+
+/* Events kept per thread; the oldest are overwritten once it fills */
+#define TRACE_BUFFER_EVENTS 65536
+
+/* Threads that can record events */
+#define TRACE_MAX_THREADS 16
+
+/* Monotonic clock in nanoseconds, the time base of every event */
+uint64_t trace_now(void);
+
+/*
+ * Record a span from start_ns to end_ns against a session (0 for none).
+ * name must outlive the trace, e.g. a string literal. Recording takes no
+ * lock and does not allocate after a thread's first event.
+ */
+void trace_span(const char *name, int session, uint64_t start_ns, uint64_t end_ns);
+
+/* Record a point in time */
+void trace_instant(const char *name, int session);
+
+/* Write every held event as Chrome trace-event JSON, one process per session */
+bool trace_export_chrome(const char *path);
+
+#endif /* DOSEMU2_GUI_TRACE_H */
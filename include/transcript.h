@@ -0,0 +1,132 @@
+#ifndef DOSEMU2_GUI_TRANSCRIPT_H
+#define DOSEMU2_GUI_TRANSCRIPT_H
+
+#include "common.h"
+#include "exit_watch.h"
+#include "shutdown.h"
+#include <stdint.h>
+#include <sys/types.h>
+
+/* First bytes of a transcript file */
+#define TRANSCRIPT_MAGIC "DGTRNS1\n"
+
+/* Bytes encoded before the recorder writes them out */
+#define TRANSCRIPT_BUFFER_BYTES (256 * 1024)
+
+/* Events replayed per UI-thread turn when replaying as fast as possible */
+#define TRANSCRIPT_REPLAY_BATCH 4096
+
+/* What happened; the numbers are part of the file format */
+typedef enum TranscriptEventType {
+    TRANSCRIPT_LAUNCH = 1,      /* DOSEmu spawned */
+    TRANSCRIPT_ENDPOINT = 2,    /* readiness watch finished */
+    TRANSCRIPT_COMMAND = 3,     /* debugger command issued */
+    TRANSCRIPT_OUTPUT = 4,      /* debugger output framed */
+    TRANSCRIPT_STOP = 5,        /* stop_dosemu() called */
+    TRANSCRIPT_SHUTDOWN = 6,    /* shutdown machine finished */
+    TRANSCRIPT_EXITED = 7       /* DOSEmu reaped */
+} TranscriptEventType;
+
+/* How a debugger command was issued, so replay parses its answer the same way */
+typedef enum TranscriptCommandKind {
+    TRANSCRIPT_COMMAND_TEXT,    /* dbg_command() */
+    TRANSCRIPT_COMMAND_REGS,    /* dbg_regs() */
+    TRANSCRIPT_COMMAND_MEM      /* dbg_read_mem() */
+} TranscriptCommandKind;
+
+/* One decoded event; strings point into the reader's mapping of the file */
+typedef struct TranscriptEvent {
+    TranscriptEventType type;
+    uint64_t time_ns;           /* since recording started */
+    int session;                /* session id at recording time */
+
+    pid_t pid;                  /* LAUNCH */
+    const char *text;           /* LAUNCH: DOS command or ""; ENDPOINT: path;
+                                   COMMAND: line; OUTPUT: output, NULL once closed */
+
+    /* ENDPOINT */
+    int readiness;              /* ReadinessResult */
+    double elapsed_ms;
+
+    /* COMMAND */
+    TranscriptCommandKind kind;
+    uint16_t segment;
+    uint32_t offset;
+    uint32_t len;
+
+    /* SHUTDOWN */
+    ShutdownResult results[SHUTDOWN_MAX_TARGETS];
+    int result_count;
+    double total_ms;
+
+    /* EXITED */
+    ExitInfo exit;
+} TranscriptEvent;
+
+/*
+ * Record every lifecycle event and debugger exchange of every session to
+ * path until transcript_record_stop(). Events are encoded into a buffer on
+ * the UI thread, which is where all of them happen, and written out when it
+ * fills. UI thread only, like the hooks below.
+ */
+bool transcript_record_start(const char *path);
+void transcript_record_stop(void);
+bool transcript_recording(void);
+uint64_t transcript_recorded_events(void);
+
+/* Recording hooks for the integration layer; they return at once when not recording */
+void transcript_launch(int session, pid_t pid, const char *dos_command);
+void transcript_endpoint(int session, int readiness, const char *endpoint, double elapsed_ms);
+void transcript_command(int session, TranscriptCommandKind kind, uint16_t segment,
+                        uint32_t offset, size_t len, const char *line);
+void transcript_output(int session, const char *text);
+void transcript_stop(int session);
+void transcript_shutdown(int session, const ShutdownResult *results, int count,
+                         double total_ms);
+void transcript_exited(int session, const ExitInfo *info);
+
+/* Transcript reader over a read-only mapping of the file */
+typedef struct TranscriptReader TranscriptReader;
+
+TranscriptReader *transcript_reader_open(const char *path);
+
+/* The next event; false at the end or on a truncated or corrupt event */
+bool transcript_reader_next(TranscriptReader *reader, TranscriptEvent *event);
+
+/* Whether reading stopped on a truncated or corrupt event */
+bool transcript_reader_failed(const TranscriptReader *reader);
+
+void transcript_reader_close(TranscriptReader *reader);
+
+const char *transcript_event_name(TranscriptEventType type);
+
+/* Progress of the running (or last) replay */
+typedef struct TranscriptReplayStats {
+    uint64_t events;
+    uint64_t skipped;           /* events for sessions that were not in a state to take them */
+    int launched;
+    int failed;                 /* replayed launches that did not come up */
+    double elapsed_ms;
+    double max_lag_ms;          /* furthest behind the recorded time, at recorded speed */
+    bool corrupt;
+} TranscriptReplayStats;
+
+/* Called on the UI thread when a replay reaches the end of its transcript */
+typedef void (*transcript_done_callback)(const TranscriptReplayStats *stats, void *data);
+
+/*
+ * Feed a transcript back through start_dosemu()'s and stop_dosemu()'s
+ * machinery in place of DOSEmu processes: sessions appear in the session
+ * table, their debugger answers come from the transcript, and every
+ * callback runs as it did when recorded. With realtime the events keep
+ * their recorded spacing; otherwise they are replayed as fast as possible
+ * in batches of TRANSCRIPT_REPLAY_BATCH. Sessions still open at the end
+ * are made to exit. UI thread only.
+ */
+bool transcript_replay_start(const char *path, bool realtime, transcript_done_callback done,
+                             void *data);
+void transcript_replay_stop(void);
+bool transcript_replay_running(void);
+void transcript_replay_stats(TranscriptReplayStats *stats);
+
+#endif /* DOSEMU2_GUI_TRANSCRIPT_H */
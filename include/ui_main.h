@@ -9,6 +9,18 @@ void create_ui(void);
 /* UI callbacks */
 void on_start_button_clicked(uiButton *button, void *data);
 void on_stop_button_clicked(uiButton *button, void *data);
+void on_pool_apply_clicked(uiButton *button, void *data);
+void on_save_log_clicked(uiButton *button, void *data);
+void on_save_trace_clicked(uiButton *button, void *data);
+void on_transcript_record_clicked(uiButton *button, void *data);
+void on_transcript_replay_clicked(uiButton *button, void *data);
+void on_profile_start_clicked(uiButton *button, void *data);
+void on_profile_stop_clicked(uiButton *button, void *data);
+void on_profile_export_clicked(uiButton *button, void *data);
+void on_itrace_start_clicked(uiButton *button, void *data);
+void on_itrace_stop_clicked(uiButton *button, void *data);
+void on_memory_browse_clicked(uiButton *button, void *data);
+void on_memory_goto_clicked(uiButton *button, void *data);
 void on_browse_dos_path_clicked(uiButton *button, void *data);
 void on_browse_config_path_clicked(uiButton *button, void *data);
 
@@ -0,0 +1,402 @@
+#define _GNU_SOURCE
+
+#include "../include/batch.h"
+#include "../include/console.h"
+#include "../include/dosemu_integration.h"
+#include "../include/headless.h"
+#include "../include/io_loop.h"
+#include "../include/logger.h"
+#include "../include/overlay.h"
+#include "../include/trace.h"
+#include <sched.h>
+#include <unistd.h>
+#include <errno.h>
+#include <math.h>
+#include <sys/stat.h>
+
+/* Longest wait between timeout checks */
+#define BATCH_MAX_WAIT_MS 1000
+
+/* Debugger attach timeout, as the GUI's default */
+#define BATCH_ATTACH_TIMEOUT_MS 10000
+
+typedef enum JobState {
+    JOB_PENDING,
+    JOB_STARTING,
+    JOB_RUNNING,
+    JOB_STOPPING,
+    JOB_DONE
+} JobState;
+
+/* One line of the jobs file; owned by the batch thread */
+typedef struct BatchJob {
+    char *command;
+    JobState state;
+    DosemuSession *session;
+    int session_id;
+    uint64_t start_ns;
+    uint64_t end_ns;
+    int exit_status;     /* -1 if DOSEmu never exited on its own terms */
+    ExitInfo usage;
+    bool timed_out;
+} BatchJob;
+
+static BatchJob *jobs = NULL;
+static int job_count = 0;
+static int active_jobs = 0;
+static bool jobs_changed = false;
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: dosemu2-gui --batch JOBS [-j N] [--timeout SECONDS]\n"
+            "                   [--dosemu PATH] [--config PATH] [--output-dir DIR]\n"
+            "                   [--drive DIR]\n"
+            "                   [--cpus LIST|spread] [--sched normal|batch|idle] [--nice N]\n"
+            "                   [--cgroup DIR] [--cpu-max PERCENT] [--memory-max MB]\n");
+}
+
+/* Parse "--batch FILE [-j N] ..." arguments; false on a usage error */
+bool batch_parse_args(int argc, char **argv, BatchOptions *options) {
+    memset(options, 0, sizeof(*options));
+    options->dos_path = "/usr/bin/dosemu";
+    options->output_dir = "batch-output";
+    options->timeout_s = BATCH_DEFAULT_TIMEOUT_S;
+
+    for (int i = 1; i < argc; i++) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (!value) {
+            usage();
+            return false;
+        }
+        if (strcmp(argv[i], "--batch") == 0) {
+            options->jobs_path = value;
+        } else if (strcmp(argv[i], "-j") == 0) {
+            options->slots = atoi(value);
+        } else if (strcmp(argv[i], "--timeout") == 0) {
+            options->timeout_s = atoi(value);
+        } else if (strcmp(argv[i], "--dosemu") == 0) {
+            options->dos_path = value;
+        } else if (strcmp(argv[i], "--config") == 0) {
+            options->config_path = value;
+        } else if (strcmp(argv[i], "--output-dir") == 0) {
+            options->output_dir = value;
+        } else if (strcmp(argv[i], "--drive") == 0) {
+            options->drive_dir = value;
+        } else if (strcmp(argv[i], "--cpus") == 0) {
+            if (strcmp(value, "spread") == 0) {
+                options->placement.auto_spread = true;
+            } else {
+                options->placement.cpus = value;
+            }
+        } else if (strcmp(argv[i], "--sched") == 0) {
+            if (strcmp(value, "batch") == 0) {
+                options->placement.sched_class = SCHED_CLASS_BATCH;
+            } else if (strcmp(value, "idle") == 0) {
+                options->placement.sched_class = SCHED_CLASS_IDLE;
+            } else if (strcmp(value, "normal") != 0) {
+                usage();
+                return false;
+            }
+        } else if (strcmp(argv[i], "--nice") == 0) {
+            options->placement.nice = atoi(value);
+        } else if (strcmp(argv[i], "--cgroup") == 0) {
+            options->placement.cgroup_parent = value;
+        } else if (strcmp(argv[i], "--cpu-max") == 0) {
+            options->placement.cpu_max_percent = atoi(value);
+        } else if (strcmp(argv[i], "--memory-max") == 0) {
+            options->placement.memory_max_mb = (size_t)strtoul(value, NULL, 10);
+        } else {
+            usage();
+            return false;
+        }
+        i++;
+    }
+
+    if (!options->jobs_path || options->slots < 0 || options->timeout_s <= 0) {
+        usage();
+        return false;
+    }
+    return true;
+}
+
+/* Cores this process may run on */
+static int available_cores(void) {
+    cpu_set_t set;
+    long online;
+
+    if (sched_getaffinity(0, sizeof(set), &set) == 0 && CPU_COUNT(&set) > 0) {
+        return CPU_COUNT(&set);
+    }
+    online = sysconf(_SC_NPROCESSORS_ONLN);
+    return online > 0 ? (int)online : 1;
+}
+
+/* Read one job per non-blank line; '#' starts a comment line */
+static bool load_jobs(const char *path) {
+    FILE *file = fopen(path, "r");
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t length;
+    int capacity = 0;
+
+    if (!file) {
+        log_error("Cannot open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    while ((length = getline(&line, &size, file)) >= 0) {
+        char *start = line;
+
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r' ||
+                              line[length - 1] == ' ' || line[length - 1] == '\t')) {
+            line[--length] = '\0';
+        }
+        while (*start == ' ' || *start == '\t') {
+            start++;
+        }
+        if (!*start || *start == '#') {
+            continue;
+        }
+
+        if (job_count == capacity) {
+            int grown_capacity = capacity ? capacity * 2 : 64;
+            BatchJob *grown = realloc(jobs, (size_t)grown_capacity * sizeof(*jobs));
+            if (!grown) {
+                break;
+            }
+            jobs = grown;
+            capacity = grown_capacity;
+        }
+        memset(&jobs[job_count], 0, sizeof(jobs[0]));
+        jobs[job_count].command = strdup(start);
+        jobs[job_count].exit_status = -1;
+        if (jobs[job_count].command) {
+            job_count++;
+        }
+    }
+
+    free(line);
+    fclose(file);
+    return true;
+}
+
+static void finish_job(BatchJob *job, DosemuSession *session) {
+    const ExitInfo *info = session ? dosemu_session_exit_info(session) : NULL;
+
+    if (info) {
+        job->exit_status = info->status;
+        job->usage = *info;
+    }
+    job->end_ns = trace_now();
+    job->session = NULL;
+    job->state = JOB_DONE;
+    active_jobs--;
+    jobs_changed = true;
+}
+
+static void on_job_started(DosemuSession *session, bool success, void *data) {
+    BatchJob *job = data;
+
+    /* A timed-out launch is finished by on_job_stopped() */
+    if (job->state != JOB_STARTING) {
+        return;
+    }
+
+    if (success) {
+        job->state = JOB_RUNNING;
+        jobs_changed = true;
+    } else {
+        /* Short jobs can finish before the debugger attaches */
+        finish_job(job, session);
+    }
+}
+
+static void on_job_stopped(DosemuSession *session, bool success, void *data) {
+    finish_job(data, session);
+}
+
+static void on_job_exited(DosemuSession *session, bool success, void *data) {
+    finish_job(data, session);
+}
+
+static void launch_job(BatchJob *job, const BatchOptions *options) {
+    job->start_ns = trace_now();
+    job->state = JOB_STARTING;
+    active_jobs++;
+
+    job->session = start_dosemu_command(options->dos_path, options->config_path, job->command,
+                                        on_job_started, job);
+    if (!job->session) {
+        finish_job(job, NULL);
+        return;
+    }
+    job->session_id = dosemu_session_id(job->session);
+    dosemu_session_on_exit(job->session, on_job_exited, job);
+}
+
+/* Stop the jobs that ran out of time; returns milliseconds until the next deadline */
+static int expire_jobs(uint64_t timeout_ns) {
+    uint64_t now = trace_now();
+    uint64_t next_ns = (uint64_t)BATCH_MAX_WAIT_MS * 1000000ULL;
+
+    for (int i = 0; i < job_count; i++) {
+        BatchJob *job = &jobs[i];
+
+        if (job->state != JOB_STARTING && job->state != JOB_RUNNING) {
+            continue;
+        }
+        if (now - job->start_ns >= timeout_ns) {
+            job->timed_out = true;
+            job->state = JOB_STOPPING;
+            if (!stop_dosemu(job->session, on_job_stopped, job)) {
+                finish_job(job, job->session);
+            }
+        } else if (job->start_ns + timeout_ns - now < next_ns) {
+            next_ns = job->start_ns + timeout_ns - now;
+        }
+    }
+    return (int)(next_ns / 1000000) + 1;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of sorted values */
+static double percentile(const double *sorted, int count, double fraction) {
+    int rank = (int)ceil(fraction * count);
+
+    if (count == 0) {
+        return 0.0;
+    }
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static int report(const BatchOptions *options, int slots, double wall_s) {
+    OverlayStats drives;
+    double *durations = malloc((size_t)(job_count > 0 ? job_count : 1) * sizeof(*durations));
+    int succeeded = 0, failed = 0, timed_out = 0;
+
+    for (int i = 0; i < job_count; i++) {
+        const BatchJob *job = &jobs[i];
+        double seconds = (double)(job->end_ns - job->start_ns) / 1e9;
+        char outcome[32];
+
+        if (job->timed_out) {
+            snprintf(outcome, sizeof(outcome), "timed out");
+            timed_out++;
+        } else if (job->exit_status < 0) {
+            snprintf(outcome, sizeof(outcome), "failed to run");
+            failed++;
+        } else {
+            snprintf(outcome, sizeof(outcome), "exit %d", job->exit_status);
+            if (job->exit_status == 0) {
+                succeeded++;
+            } else {
+                failed++;
+            }
+        }
+
+        if (durations) {
+            durations[i] = seconds;
+        }
+        printf("job %d [session %d]: %s after %.2f s (%.2f s CPU, %ld MB max RSS): %s\n",
+               i + 1, job->session_id, outcome, seconds,
+               (job->usage.user_ms + job->usage.system_ms) / 1000.0,
+               job->usage.max_rss_kb / 1024, job->command);
+    }
+
+    printf("%d jobs on %d slots in %.2f s: %d succeeded, %d failed, %d timed out\n",
+           job_count, slots, wall_s, succeeded, failed, timed_out);
+    printf("Throughput: %.2f jobs/min\n", wall_s > 0 ? job_count * 60.0 / wall_s : 0.0);
+
+    if (durations && job_count > 0) {
+        qsort(durations, (size_t)job_count, sizeof(*durations), compare_doubles);
+        printf("Job latency: p50 %.2f s, p90 %.2f s, p99 %.2f s, max %.2f s\n",
+               percentile(durations, job_count, 0.50), percentile(durations, job_count, 0.90),
+               percentile(durations, job_count, 0.99), durations[job_count - 1]);
+    }
+    overlay_totals(&drives);
+    if (drives.overlays > 0) {
+        printf("Drive staging: %llu drives in %.1f ms avg, %llu MB copied, %llu MB reflinked\n",
+               (unsigned long long)drives.overlays, drives.stage_ms / (double)drives.overlays,
+               (unsigned long long)(drives.bytes_copied >> 20),
+               (unsigned long long)(drives.bytes_cloned >> 20));
+        printf("Drive harvest: %llu files (%llu KB) written back, %llu deleted, "
+               "%llu conflicts, %.1f ms total\n",
+               (unsigned long long)drives.harvested_files,
+               (unsigned long long)(drives.harvested_bytes >> 10),
+               (unsigned long long)drives.deleted_files, (unsigned long long)drives.conflicts,
+               drives.harvest_ms);
+    }
+    printf("Job output: %s\n", options->output_dir);
+    fflush(stdout);
+
+    free(durations);
+    return succeeded == job_count ? 0 : 1;
+}
+
+/* Run every job without the GUI, at most slots at a time */
+int batch_run(const BatchOptions *options) {
+    uint64_t timeout_ns = (uint64_t)options->timeout_s * 1000000000ULL;
+    int slots = options->slots > 0 ? options->slots : available_cores();
+    int next_job = 0;
+    char log_path[4096];
+    uint64_t start;
+    int status;
+
+    if (slots > MAX_SESSIONS) {
+        slots = MAX_SESSIONS;
+    }
+
+    if (!placement_configure(&options->placement) || !load_jobs(options->jobs_path)) {
+        return 1;
+    }
+    if (mkdir(options->output_dir, 0755) != 0 && errno != EEXIST) {
+        log_error("Cannot create %s: %s\n", options->output_dir, strerror(errno));
+        return 1;
+    }
+
+    app.attach_timeout_ms = BATCH_ATTACH_TIMEOUT_MS;
+    app.capture_log_dir = (char *)options->output_dir;
+    app.drive_dir = (char *)options->drive_dir;
+    snprintf(log_path, sizeof(log_path), "%s/dosemu2-gui.binlog", options->output_dir);
+    logger_open_file(log_path);
+
+    headless_enable();
+    if (!io_loop_start()) {
+        log_error("Error starting I/O thread\n");
+        return 1;
+    }
+
+    start = trace_now();
+    while (next_job < job_count || active_jobs > 0) {
+        while (active_jobs < slots && next_job < job_count) {
+            launch_job(&jobs[next_job++], options);
+        }
+
+        /* Exits arrive as callbacks; only timeouts need the clock */
+        jobs_changed = false;
+        headless_run_until(&jobs_changed, expire_jobs(timeout_ns));
+    }
+
+    /* Let the last sessions' deferred frees run */
+    jobs_changed = false;
+    headless_run_until(&jobs_changed, 1);
+
+    /* The summary follows every session's log lines */
+    logger_flush();
+    status = report(options, slots, (double)(trace_now() - start) / 1e9);
+    io_loop_stop();
+
+    for (int i = 0; i < job_count; i++) {
+        free(jobs[i].command);
+    }
+    free(jobs);
+    jobs = NULL;
+    job_count = 0;
+    return status;
+}
@@ -0,0 +1,235 @@
+#define _GNU_SOURCE
+
+#include "../include/capture.h"
+#include "../include/console.h"
+#include "../include/logger.h"
+#include "../include/io_loop.h"
+#include "../include/sessionlog.h"
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+
+enum {
+    STREAM_STDOUT,
+    STREAM_STDERR,
+    STREAM_COUNT
+};
+
+static const char *const stream_names[STREAM_COUNT] = {"stdout", "stderr"};
+
+/* One captured pipe with its partial trailing line */
+typedef struct CaptureStream {
+    int fd;
+    bool open;
+    char line[CAPTURE_LINE_SIZE];
+    size_t line_len;
+} CaptureStream;
+
+struct OutputCapture {
+    int session_id;
+    CaptureStream streams[STREAM_COUNT];
+    SessionLog *log;
+    struct timespec started;
+    unsigned long long bytes;
+    unsigned long long lines;
+};
+
+/* Reused for every read; only touched on the I/O thread */
+static char read_buffer[CAPTURE_READ_SIZE];
+
+static double seconds_since(const struct timespec *start) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) +
+           (double)(now.tv_nsec - start->tv_nsec) / 1000000000.0;
+}
+
+/* Send one complete line to the console and the session log */
+static void emit_line(OutputCapture *capture, int stream, const char *text, size_t len) {
+    double when = seconds_since(&capture->started);
+    char line[CAPTURE_LINE_SIZE + 64];
+    int line_len;
+
+    if (len > 0 && text[len - 1] == '\r') {
+        len--;
+    }
+
+    log_record(LOG_LEVEL_INFO, capture->session_id, "%s +%.3f: %.*s\n", stream_names[stream],
+               when, (int)len, text);
+    if (capture->log) {
+        line_len = snprintf(line, sizeof(line), "%.6f %s %.*s\n", when, stream_names[stream],
+                            (int)len, text);
+        sessionlog_append(capture->log, line, (size_t)line_len);
+    }
+    capture->lines++;
+}
+
+/* Split freshly read bytes into lines, keeping the unfinished tail */
+static void consume(OutputCapture *capture, int stream, const char *data, size_t len) {
+    CaptureStream *s = &capture->streams[stream];
+
+    while (len > 0) {
+        const char *newline = memchr(data, '\n', len);
+        size_t chunk = newline ? (size_t)(newline - data) : len;
+
+        if (newline && s->line_len == 0) {
+            /* Whole line in the read buffer: no copy */
+            emit_line(capture, stream, data, chunk);
+        } else {
+            bool split = false;
+
+            for (size_t done = 0; done < chunk;) {
+                size_t room = CAPTURE_LINE_SIZE - s->line_len;
+                size_t take = chunk - done < room ? chunk - done : room;
+
+                memcpy(s->line + s->line_len, data + done, take);
+                s->line_len += take;
+                done += take;
+
+                if (s->line_len == CAPTURE_LINE_SIZE) {
+                    emit_line(capture, stream, s->line, s->line_len);
+                    s->line_len = 0;
+                    split = true;
+                }
+            }
+
+            if (newline && (s->line_len > 0 || !split)) {
+                emit_line(capture, stream, s->line, s->line_len);
+                s->line_len = 0;
+            }
+        }
+
+        if (!newline) {
+            break;
+        }
+        data += chunk + 1;
+        len -= chunk + 1;
+    }
+}
+
+static void close_stream(OutputCapture *capture, int stream) {
+    CaptureStream *s = &capture->streams[stream];
+
+    if (!s->open) {
+        return;
+    }
+    s->open = false;
+    io_loop_remove_fd(s->fd);
+
+    if (s->line_len > 0) {
+        emit_line(capture, stream, s->line, s->line_len);
+        s->line_len = 0;
+    }
+}
+
+/* Read until the pipe is empty */
+static void drain(OutputCapture *capture, int stream) {
+    CaptureStream *s = &capture->streams[stream];
+
+    while (s->open) {
+        ssize_t n = read(s->fd, read_buffer, sizeof(read_buffer));
+        if (n > 0) {
+            capture->bytes += (unsigned long long)n;
+            consume(capture, stream, read_buffer, (size_t)n);
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            close_stream(capture, stream);
+        }
+    }
+
+    /* The indexer only sees what reached the file */
+    if (capture->log) {
+        sessionlog_flush(capture->log);
+    }
+}
+
+static void on_output(int fd, uint32_t events, void *data) {
+    OutputCapture *capture = data;
+
+    for (int stream = 0; stream < STREAM_COUNT; stream++) {
+        if (capture->streams[stream].open && capture->streams[stream].fd == fd) {
+            drain(capture, stream);
+        }
+    }
+}
+
+static void attach(void *data) {
+    OutputCapture *capture = data;
+
+    for (int stream = 0; stream < STREAM_COUNT; stream++) {
+        CaptureStream *s = &capture->streams[stream];
+        s->open = s->fd >= 0 && io_loop_add_fd(s->fd, EPOLLIN, on_output, capture);
+    }
+}
+
+static void detach(void *data) {
+    OutputCapture *capture = data;
+
+    for (int stream = 0; stream < STREAM_COUNT; stream++) {
+        drain(capture, stream);
+        close_stream(capture, stream);
+    }
+    if (capture->log) {
+        sessionlog_flush(capture->log);
+    }
+}
+
+static bool set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+/* Start draining a child's output */
+OutputCapture *capture_open(int session_id, int stdout_fd, int stderr_fd,
+                            const char *log_path) {
+    OutputCapture *capture = calloc(1, sizeof(*capture));
+    if (!capture) {
+        return NULL;
+    }
+
+    capture->session_id = session_id;
+    capture->streams[STREAM_STDOUT].fd = stdout_fd;
+    capture->streams[STREAM_STDERR].fd = stderr_fd;
+    clock_gettime(CLOCK_MONOTONIC, &capture->started);
+
+    for (int stream = 0; stream < STREAM_COUNT; stream++) {
+        int fd = capture->streams[stream].fd;
+        if (fd >= 0 && !set_nonblocking(fd)) {
+            capture->streams[stream].fd = -1;
+        }
+    }
+
+    /* Without a path the log lives in an unlinked temporary file */
+    capture->log = sessionlog_open(session_id, log_path);
+
+    if (!io_loop_post(attach, capture)) {
+        sessionlog_release(capture->log);
+        free(capture);
+        return NULL;
+    }
+
+    return capture;
+}
+
+/* Drain, detach and free */
+void capture_close(OutputCapture *capture) {
+    if (!capture) {
+        return;
+    }
+
+    io_loop_call(detach, capture);
+
+    if (capture->bytes > 0) {
+        log_record(LOG_LEVEL_INFO, capture->session_id,
+                   "Captured %llu bytes in %llu lines of DOSEmu output\n", capture->bytes,
+                   capture->lines);
+    }
+    sessionlog_release(capture->log);
+    free(capture);
+}
@@ -0,0 +1,186 @@
+#define _GNU_SOURCE
+
+#include "../include/console.h"
+#include "../include/logger.h"
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+
+typedef struct ConsoleEntry {
+    size_t offset;
+    size_t length;
+} ConsoleEntry;
+
+/* Ring of messages: text lives in ring_bytes, entries index it by sequence */
+static pthread_mutex_t ring_lock = PTHREAD_MUTEX_INITIALIZER;
+static char ring_bytes[CONSOLE_RING_BYTES];
+static ConsoleEntry ring_entries[CONSOLE_RING_ENTRIES];
+static uint64_t first_seq = 0;   /* oldest message still held */
+static uint64_t next_seq = 0;    /* sequence of the next message */
+static size_t write_offset = 0;
+
+/* Widget state; only touched on the UI thread */
+static uiMultilineEntry *console_widget = NULL;
+static uint64_t shown_seq = 0;   /* next message the widget has not seen */
+static uint64_t widget_first_seq = 0;
+static char *flush_buffer = NULL;
+static size_t flush_capacity = 0;
+
+static ConsoleEntry *entry_for(uint64_t seq) {
+    return &ring_entries[seq % CONSOLE_RING_ENTRIES];
+}
+
+/* Store a message, evicting the oldest ones it would overwrite */
+void console_append(const char *text, size_t length) {
+    if (length > CONSOLE_RING_BYTES) {
+        length = CONSOLE_RING_BYTES;
+    }
+
+    pthread_mutex_lock(&ring_lock);
+
+    /* Keep each message contiguous; the skipped tail holds the oldest text */
+    if (write_offset + length > CONSOLE_RING_BYTES) {
+        while (first_seq < next_seq && entry_for(first_seq)->offset >= write_offset) {
+            first_seq++;
+        }
+        write_offset = 0;
+    }
+
+    while (first_seq < next_seq) {
+        ConsoleEntry *oldest = entry_for(first_seq);
+        bool overlaps = oldest->offset < write_offset + length &&
+                        write_offset < oldest->offset + oldest->length;
+
+        if (!overlaps && next_seq - first_seq < CONSOLE_RING_ENTRIES) {
+            break;
+        }
+        first_seq++;
+    }
+
+    memcpy(ring_bytes + write_offset, text, length);
+    entry_for(next_seq)->offset = write_offset;
+    entry_for(next_seq)->length = length;
+    next_seq++;
+    write_offset += length;
+
+    pthread_mutex_unlock(&ring_lock);
+}
+
+/* Copy messages [from, to) into flush_buffer as one string; ring_lock held */
+static bool gather(uint64_t from, uint64_t to) {
+    size_t total = 1;
+    size_t used = 0;
+
+    for (uint64_t seq = from; seq < to; seq++) {
+        total += entry_for(seq)->length;
+    }
+
+    if (total > flush_capacity) {
+        char *grown = realloc(flush_buffer, total);
+        if (!grown) {
+            return false;
+        }
+        flush_buffer = grown;
+        flush_capacity = total;
+    }
+
+    for (uint64_t seq = from; seq < to; seq++) {
+        const ConsoleEntry *entry = entry_for(seq);
+        memcpy(flush_buffer + used, ring_bytes + entry->offset, entry->length);
+        used += entry->length;
+    }
+    flush_buffer[used] = '\0';
+    return true;
+}
+
+/* Push whatever arrived since the last frame into the widget */
+static int flush_console(void *data) {
+    bool rebuild;
+    uint64_t from, to;
+
+    pthread_mutex_lock(&ring_lock);
+    to = next_seq;
+    if (to == shown_seq) {
+        pthread_mutex_unlock(&ring_lock);
+        return 1;
+    }
+
+    /*
+     * Append while the widget holds fewer than twice the view size, then
+     * replace it with just the newest view. Each message is copied into the
+     * widget at most about twice, however fast messages arrive.
+     */
+    rebuild = shown_seq < first_seq ||
+              to - widget_first_seq > 2 * CONSOLE_VIEW_ENTRIES;
+    if (rebuild) {
+        from = to - first_seq > CONSOLE_VIEW_ENTRIES ? to - CONSOLE_VIEW_ENTRIES : first_seq;
+    } else {
+        from = shown_seq;
+    }
+
+    if (!gather(from, to)) {
+        pthread_mutex_unlock(&ring_lock);
+        return 1;
+    }
+    pthread_mutex_unlock(&ring_lock);
+
+    if (rebuild) {
+        uiMultilineEntrySetText(console_widget, flush_buffer);
+        widget_first_seq = from;
+    } else {
+        uiMultilineEntryAppend(console_widget, flush_buffer);
+    }
+    shown_seq = to;
+
+    return 1;
+}
+
+/* Start mirroring the ring buffer into a console widget */
+void console_attach(uiMultilineEntry *widget) {
+    console_widget = widget;
+
+    pthread_mutex_lock(&ring_lock);
+    shown_seq = widget_first_seq = first_seq;
+    pthread_mutex_unlock(&ring_lock);
+
+    uiTimer(CONSOLE_FLUSH_MS, flush_console, NULL);
+}
+
+/* Add log entry to both console and stdout */
+void log_message(const char *format, ...) {
+    va_list args;
+
+    va_start(args, format);
+    log_vrecord(LOG_LEVEL_INFO, 0, format, args);
+    va_end(args);
+}
+
+/* Add error log entry to both console and stderr */
+void log_error(const char *format, ...) {
+    va_list args;
+
+    va_start(args, format);
+    log_vrecord(LOG_LEVEL_ERROR, 0, format, args);
+    va_end(args);
+}
+
+/* Write every message still held in the ring buffer to a file */
+bool console_export(const char *path) {
+    FILE *file = fopen(path, "w");
+    bool ok;
+
+    if (!file) {
+        return false;
+    }
+
+    logger_flush();
+    pthread_mutex_lock(&ring_lock);
+    for (uint64_t seq = first_seq; seq < next_seq; seq++) {
+        const ConsoleEntry *entry = entry_for(seq);
+        fwrite(ring_bytes + entry->offset, 1, entry->length, file);
+    }
+    pthread_mutex_unlock(&ring_lock);
+
+    ok = !ferror(file);
+    return fclose(file) == 0 && ok;
+}
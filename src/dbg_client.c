@@ -0,0 +1,656 @@
+#define _GNU_SOURCE
+
+#include "../include/dbg_client.h"
+#include "../include/dosdebug_channel.h"
+#include "../include/console.h"
+#include "../include/pidfd.h"
+#include "../include/readiness.h"
+#include "../include/latency.h"
+#include "../include/headless.h"
+#include "../include/transcript.h"
+#include <ctype.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
+#include <errno.h>
+#include <time.h>
+
+typedef enum DbgRequestKind {
+    DBG_REQUEST_TEXT,
+    DBG_REQUEST_REGS,
+    DBG_REQUEST_MEM
+} DbgRequestKind;
+
+/* A command waiting for its response */
+typedef struct DbgRequest {
+    DbgRequestKind kind;
+    dbg_text_callback text_callback;
+    dbg_regs_callback regs_callback;
+    dbg_mem_callback mem_callback;
+    void *data;
+    uint16_t segment;
+    uint32_t offset;
+    size_t len;
+    char line[128];
+    struct timespec sent;
+    struct DbgRequest *next;
+} DbgRequest;
+
+struct DbgClient {
+    pid_t pid;
+    int pid_fd;
+    int in_fd;              /* dosemu.dbgin.<pid>, we write commands */
+    int out_fd;             /* dosemu.dbgout.<pid>, we read output */
+    DosdebugChannel *channel;
+    int session_id;         /* for transcripts */
+    bool replay;            /* answered from a transcript, no FIFOs */
+    uint64_t issued;
+
+    /* Issued commands, oldest first; those before unsent are in flight */
+    DbgRequest *head;
+    DbgRequest *unsent;
+    DbgRequest *tail;
+    int in_flight;
+    bool closed;
+};
+
+/* Round-trip latency per command verb, shared by every client */
+static DbgCommandStats command_stats[DBG_MAX_STATS];
+static int command_stats_count = 0;
+
+/* Keep up to DBG_PIPELINE_DEPTH commands in the debugger's FIFO */
+static void send_pending(DbgClient *client) {
+    while (client->unsent && client->in_flight < DBG_PIPELINE_DEPTH) {
+        DbgRequest *request = client->unsent;
+
+        clock_gettime(CLOCK_MONOTONIC, &request->sent);
+        if (client->channel) {
+            dosdebug_channel_send(client->channel, request->line);
+        }
+        client->unsent = request->next;
+        client->in_flight++;
+    }
+}
+
+/* Stats slot for the first word of a command line */
+static DbgCommandStats *stats_for(const char *line) {
+    size_t len = strcspn(line, " \t");
+    int i;
+
+    if (len >= sizeof(command_stats[0].verb)) {
+        len = sizeof(command_stats[0].verb) - 1;
+    }
+
+    for (i = 0; i < command_stats_count; i++) {
+        if (strlen(command_stats[i].verb) == len &&
+            strncmp(command_stats[i].verb, line, len) == 0) {
+            return &command_stats[i];
+        }
+    }
+
+    /* Everything beyond the table's capacity shares the last slot */
+    if (command_stats_count == DBG_MAX_STATS) {
+        return &command_stats[DBG_MAX_STATS - 1];
+    }
+
+    memcpy(command_stats[i].verb, line, len);
+    command_stats[i].verb[len] = '\0';
+    command_stats_count++;
+    return &command_stats[i];
+}
+
+static void record_latency(const DbgRequest *request) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    latency_record(&stats_for(request->line)->latency,
+                   (double)(now.tv_sec - request->sent.tv_sec) * 1000.0 +
+                   (double)(now.tv_nsec - request->sent.tv_nsec) / 1000000.0);
+}
+
+/* Complete a request with a response, or with a failure if text is NULL */
+static void complete(DbgRequest *request, const char *text) {
+    switch (request->kind) {
+    case DBG_REQUEST_TEXT:
+        if (request->text_callback) {
+            request->text_callback(text, request->data);
+        }
+        break;
+    case DBG_REQUEST_REGS: {
+        DbgRegs regs;
+        bool ok = text && dbg_parse_regs(text, &regs);
+        request->regs_callback(ok, ok ? &regs : NULL, request->data);
+        break;
+    }
+    case DBG_REQUEST_MEM: {
+        uint8_t bytes[DBG_MAX_READ];
+        size_t len = text ? dbg_parse_dump(text, bytes, request->len) : 0;
+        request->mem_callback(len > 0, request->segment, request->offset,
+                              bytes, len, request->data);
+        break;
+    }
+    }
+}
+
+/* Fail every outstanding request */
+static void fail_pending(DbgClient *client) {
+    while (client->head) {
+        DbgRequest *request = client->head;
+        client->head = request->next;
+        complete(request, NULL);
+        free(request);
+    }
+    client->unsent = client->tail = NULL;
+    client->in_flight = 0;
+}
+
+static void on_debugger_output(const char *response, bool overflowed, void *data) {
+    DbgClient *client = data;
+    DbgRequest *request;
+
+    if (client->closed) {
+        return;
+    }
+    /* An overflowed answer replays as an empty one, which fails the same requests */
+    transcript_output(client->session_id, overflowed ? "" : response);
+
+    if (!response && !overflowed) {
+        fail_pending(client);
+        return;
+    }
+
+    request = client->head;
+    if (overflowed && client->in_flight == 0) {
+        return;
+    }
+    if (client->in_flight == 0) {
+        /* Unsolicited output, e.g. a breakpoint being hit */
+        if (*response) {
+            log_message("DOSEmu debugger (pid %d):\n%s", (int)client->pid, response);
+        }
+        return;
+    }
+
+    /* Responses arrive in command order, so this one answers the oldest; NULL fails it */
+    client->head = request->next;
+    if (!client->head) {
+        client->tail = NULL;
+    }
+    client->in_flight--;
+    record_latency(request);
+    send_pending(client);
+
+    complete(request, response);
+    free(request);
+}
+
+static bool enqueue(DbgClient *client, DbgRequest *request) {
+    if (!client || client->closed) {
+        free(request);
+        return false;
+    }
+
+    transcript_command(client->session_id,
+                       request->kind == DBG_REQUEST_REGS ? TRANSCRIPT_COMMAND_REGS :
+                       request->kind == DBG_REQUEST_MEM ? TRANSCRIPT_COMMAND_MEM :
+                       TRANSCRIPT_COMMAND_TEXT,
+                       request->segment, request->offset, request->len, request->line);
+    client->issued++;
+
+    request->next = NULL;
+    if (client->tail) {
+        client->tail->next = request;
+    } else {
+        client->head = request;
+    }
+    client->tail = request;
+    if (!client->unsent) {
+        client->unsent = request;
+    }
+
+    send_pending(client);
+    return true;
+}
+
+/* dosemu.dbgin.<pid> -> dosemu.dbgout.<pid> */
+static bool output_path_for(const char *endpoint, char *out, size_t size, pid_t *pid) {
+    const char *name = strrchr(endpoint, '/');
+    size_t dir_len = name ? (size_t)(name - endpoint) + 1 : 0;
+    size_t prefix_len = strlen(DOSEMU_DEBUG_FIFO_PREFIX);
+    char *end;
+    long owner;
+
+    name = endpoint + dir_len;
+    if (strncmp(name, DOSEMU_DEBUG_FIFO_PREFIX, prefix_len) != 0) {
+        return false;
+    }
+
+    owner = strtol(name + prefix_len, &end, 10);
+    if (end == name + prefix_len || *end != '\0' || owner <= 0) {
+        return false;
+    }
+
+    *pid = (pid_t)owner;
+    return snprintf(out, size, "%.*s%s%ld", (int)dir_len, endpoint,
+                    DOSEMU_DEBUG_OUT_PREFIX, owner) < (int)size;
+}
+
+static void free_client(void *data) {
+    free(data);
+}
+
+/* Connect to a running DOSEmu's debugger FIFOs */
+DbgClient *dbg_open(const char *endpoint) {
+    char output_path[PATH_MAX];
+    DbgClient *client = calloc(1, sizeof(*client));
+
+    if (!client) {
+        return NULL;
+    }
+
+    if (!output_path_for(endpoint, output_path, sizeof(output_path), &client->pid)) {
+        free(client);
+        return NULL;
+    }
+
+    /*
+     * O_RDWR on both FIFOs: opening never fails for want of a peer, writes
+     * buffer until DOSEmu starts reading, and reads never see a spurious EOF
+     * while DOSEmu has no writer open. DOSEmu's exit is observed via pidfd.
+     */
+    client->in_fd = open(endpoint, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    client->out_fd = open(output_path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    client->pid_fd = pidfd_open_pid(client->pid);
+
+    if (client->in_fd >= 0 && client->out_fd >= 0) {
+        client->channel = dosdebug_channel_open_framed(client->in_fd, client->out_fd,
+                                                       DBG_RESPONSE_END,
+                                                       on_debugger_output, client);
+    }
+
+    if (!client->channel) {
+        if (client->in_fd >= 0) {
+            close(client->in_fd);
+        }
+        if (client->out_fd >= 0) {
+            close(client->out_fd);
+        }
+        if (client->pid_fd >= 0) {
+            close(client->pid_fd);
+        }
+        free(client);
+        return NULL;
+    }
+
+    return client;
+}
+
+/* A client whose output comes from dbg_replay_output() instead of DOSEmu */
+DbgClient *dbg_open_replay(pid_t pid) {
+    DbgClient *client = calloc(1, sizeof(*client));
+
+    if (!client) {
+        return NULL;
+    }
+    client->pid = pid;
+    client->in_fd = client->out_fd = client->pid_fd = -1;
+    client->replay = true;
+    return client;
+}
+
+/* Disconnect from the debugger */
+void dbg_close(DbgClient *client) {
+    if (!client) {
+        return;
+    }
+
+    client->closed = true;
+    if (client->channel) {
+        dosdebug_channel_close(client->channel);
+        close(client->in_fd);
+        close(client->out_fd);
+    }
+    if (client->pid_fd >= 0) {
+        close(client->pid_fd);
+    }
+
+    fail_pending(client);
+
+    /* Output already queued for the UI thread still refers to the client */
+    main_queue(free_client, client);
+}
+
+/* pid of the DOSEmu process that owns the endpoint */
+pid_t dbg_pid(const DbgClient *client) {
+    return client->pid;
+}
+
+void dbg_set_session(DbgClient *client, int session_id) {
+    client->session_id = session_id;
+}
+
+uint64_t dbg_commands_issued(const DbgClient *client) {
+    return client->issued;
+}
+
+/* Deliver output as if the I/O thread had framed it */
+void dbg_replay_output(DbgClient *client, const char *response) {
+    if (client->replay) {
+        on_debugger_output(response, false, client);
+    }
+}
+
+/* Send any debugger command line */
+bool dbg_command(DbgClient *client, const char *line, dbg_text_callback callback, void *data) {
+    DbgRequest *request = calloc(1, sizeof(*request));
+
+    if (!request || strlen(line) >= sizeof(request->line)) {
+        free(request);
+        return false;
+    }
+
+    request->kind = DBG_REQUEST_TEXT;
+    request->text_callback = callback;
+    request->data = data;
+    snprintf(request->line, sizeof(request->line), "%s", line);
+    return enqueue(client, request);
+}
+
+/* Read the register file */
+bool dbg_regs(DbgClient *client, dbg_regs_callback callback, void *data) {
+    DbgRequest *request = calloc(1, sizeof(*request));
+
+    if (!request) {
+        return false;
+    }
+
+    request->kind = DBG_REQUEST_REGS;
+    request->regs_callback = callback;
+    request->data = data;
+    snprintf(request->line, sizeof(request->line), "r");
+    return enqueue(client, request);
+}
+
+/* Read guest memory */
+bool dbg_read_mem(DbgClient *client, uint16_t segment, uint32_t offset, size_t len,
+                  dbg_mem_callback callback, void *data) {
+    DbgRequest *request;
+
+    if (len == 0 || len > DBG_MAX_READ) {
+        return false;
+    }
+
+    request = calloc(1, sizeof(*request));
+    if (!request) {
+        return false;
+    }
+
+    request->kind = DBG_REQUEST_MEM;
+    request->mem_callback = callback;
+    request->data = data;
+    request->segment = segment;
+    request->offset = offset;
+    request->len = len;
+    snprintf(request->line, sizeof(request->line), "d %04x:%04x %zx",
+             (unsigned)segment, (unsigned)offset, len);
+    return enqueue(client, request);
+}
+
+/* Ask DOSEmu to leave through the debugger's own "kill" command */
+bool dbg_kill(DbgClient *client) {
+    /* A replayed DOSEmu exits when its transcript says so */
+    if (client && client->replay) {
+        return true;
+    }
+    return client && dbg_command(client, "kill", NULL, NULL);
+}
+
+/* Register names accepted by the parser and where they go */
+typedef struct RegName {
+    const char *name;
+    size_t offset;
+    bool wide;
+} RegName;
+
+static const RegName reg_names[] = {
+    {"EAX", offsetof(DbgRegs, eax), true},
+    {"EBX", offsetof(DbgRegs, ebx), true},
+    {"ECX", offsetof(DbgRegs, ecx), true},
+    {"EDX", offsetof(DbgRegs, edx), true},
+    {"ESI", offsetof(DbgRegs, esi), true},
+    {"EDI", offsetof(DbgRegs, edi), true},
+    {"EBP", offsetof(DbgRegs, ebp), true},
+    {"ESP", offsetof(DbgRegs, esp), true},
+    {"SP", offsetof(DbgRegs, esp), true},
+    {"EIP", offsetof(DbgRegs, eip), true},
+    {"IP", offsetof(DbgRegs, eip), true},
+    {"EFLAGS", offsetof(DbgRegs, eflags), true},
+    {"FLAGS", offsetof(DbgRegs, eflags), true},
+    {"VFLAGS(h)", offsetof(DbgRegs, eflags), true},
+    {"CS", offsetof(DbgRegs, cs), false},
+    {"DS", offsetof(DbgRegs, ds), false},
+    {"ES", offsetof(DbgRegs, es), false},
+    {"SS", offsetof(DbgRegs, ss), false},
+    {"FS", offsetof(DbgRegs, fs), false},
+    {"GS", offsetof(DbgRegs, gs), false},
+};
+
+static const RegName *find_reg(const char *name, size_t len) {
+    for (size_t i = 0; i < sizeof(reg_names) / sizeof(reg_names[0]); i++) {
+        if (strlen(reg_names[i].name) == len && strncasecmp(reg_names[i].name, name, len) == 0) {
+            return &reg_names[i];
+        }
+    }
+    return NULL;
+}
+
+static void store_reg(DbgRegs *regs, const RegName *reg, unsigned long value) {
+    char *field = (char *)regs + reg->offset;
+
+    if (reg->wide) {
+        *(uint32_t *)(void *)field = (uint32_t)value;
+    } else {
+        *(uint16_t *)(void *)field = (uint16_t)value;
+    }
+}
+
+/*
+ * Parse "r" output. Accepts "EAX: 1234", "EAX=1234" and paired forms such
+ * as "CS:IP: F000:FFF0", in any order and layout.
+ */
+bool dbg_parse_regs(const char *text, DbgRegs *regs) {
+    bool have_cs = false, have_ip = false;
+    const char *p = text;
+
+    memset(regs, 0, sizeof(*regs));
+
+    while (*p) {
+        const RegName *names[2] = {NULL, NULL};
+        int count = 0;
+        const char *start;
+
+        while (*p && !isalpha((unsigned char)*p)) {
+            p++;
+        }
+
+        /* One or two register names, each followed by ':' (or '=') */
+        while (count < 2 && *p && isalpha((unsigned char)*p)) {
+            start = p;
+            while (isalnum((unsigned char)*p) || *p == '(' || *p == ')') {
+                p++;
+            }
+            names[count] = find_reg(start, (size_t)(p - start));
+            if (!names[count] || (*p != ':' && *p != '=')) {
+                break;
+            }
+            p++;
+            count++;
+        }
+
+        if (count == 0 || names[count - 1] == NULL) {
+            while (*p && !isspace((unsigned char)*p)) {
+                p++;
+            }
+            continue;
+        }
+
+        /* Matching number of hex values separated by ':' */
+        for (int i = 0; i < count; i++) {
+            char *end;
+            unsigned long value;
+
+            while (*p == ' ' || *p == '\t') {
+                p++;
+            }
+            value = strtoul(p, &end, 16);
+            if (end == p) {
+                break;
+            }
+            store_reg(regs, names[i], value);
+            have_cs |= names[i]->offset == offsetof(DbgRegs, cs);
+            have_ip |= names[i]->offset == offsetof(DbgRegs, eip);
+            p = end;
+            if (*p == ':') {
+                p++;
+            }
+        }
+    }
+
+    return have_cs && have_ip;
+}
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    c = (char)toupper((unsigned char)c);
+    return c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+}
+
+/*
+ * Parse "d" output: each line starts with an address containing ':' and
+ * continues with two-digit hex bytes (optionally joined by '-'); anything
+ * after the bytes, such as an ASCII column, is ignored.
+ */
+size_t dbg_parse_dump(const char *text, uint8_t *bytes, size_t capacity) {
+    size_t count = 0;
+    const char *line = text;
+
+    while (*line && count < capacity) {
+        const char *end = strchr(line, '\n');
+        const char *p = line;
+        size_t line_len = end ? (size_t)(end - line) : strlen(line);
+        const char *limit = line + line_len;
+
+        /* Address column */
+        while (p < limit && isspace((unsigned char)*p)) {
+            p++;
+        }
+        const char *address = p;
+        while (p < limit && !isspace((unsigned char)*p)) {
+            p++;
+        }
+
+        if (memchr(address, ':', (size_t)(p - address))) {
+            while (p < limit && count < capacity) {
+                int high, low;
+
+                while (p < limit && (*p == ' ' || *p == '-')) {
+                    p++;
+                }
+                if (limit - p < 2) {
+                    break;
+                }
+                high = hex_digit(p[0]);
+                low = hex_digit(p[1]);
+                if (high < 0 || low < 0 ||
+                    (p + 2 < limit && p[2] != ' ' && p[2] != '-')) {
+                    break;
+                }
+                bytes[count++] = (uint8_t)(high << 4 | low);
+                p += 2;
+            }
+        }
+
+        if (!end) {
+            break;
+        }
+        line = end + 1;
+    }
+
+    return count;
+}
+
+/*
+ * Find the disassembly of cs:ip: a line starting with that address and
+ * then the instruction bytes, run together ("B409") or in pairs ("B4 09").
+ * The mnemonic after them ends the bytes.
+ */
+size_t dbg_parse_code(const char *text, uint16_t cs, uint32_t ip, uint8_t *bytes,
+                      size_t capacity) {
+    const char *line = text;
+
+    while (*line) {
+        const char *end = strchr(line, '\n');
+        const char *limit = end ? end : line + strlen(line);
+        const char *p = line;
+        char *after;
+        unsigned long segment, offset;
+        size_t count = 0;
+
+        while (p < limit && isspace((unsigned char)*p)) {
+            p++;
+        }
+        segment = p < limit ? strtoul(p, &after, 16) : 0;
+        if (p < limit && after > p && after < limit && *after == ':' && segment == cs) {
+            p = after + 1;
+            offset = strtoul(p, &after, 16);
+            if (after > p && after < limit && offset == ip && isspace((unsigned char)*after)) {
+                p = after;
+                while (p < limit && count < capacity) {
+                    const char *token;
+
+                    while (p < limit && (*p == ' ' || *p == '\t')) {
+                        p++;
+                    }
+                    token = p;
+                    while (p < limit && isxdigit((unsigned char)*p)) {
+                        p++;
+                    }
+                    if (p == token || (p - token) % 2 != 0 ||
+                        (p < limit && !isspace((unsigned char)*p))) {
+                        break;
+                    }
+                    for (const char *q = token; q < p && count < capacity; q += 2) {
+                        bytes[count++] = (uint8_t)(hex_digit(q[0]) << 4 | hex_digit(q[1]));
+                    }
+                }
+                if (count > 0) {
+                    return count;
+                }
+            }
+        }
+
+        if (!end) {
+            break;
+        }
+        line = end + 1;
+    }
+
+    return 0;
+}
+
+/* Number of distinct commands with latency statistics */
+int dbg_stats_count(void) {
+    return command_stats_count;
+}
+
+/* Latency statistics for one command verb, or NULL */
+const DbgCommandStats *dbg_stats_at(int index) {
+    if (index < 0 || index >= command_stats_count) {
+        return NULL;
+    }
+    return &command_stats[index];
+}
@@ -0,0 +1,373 @@
+#define _GNU_SOURCE
+
+#include "../include/dosdebug_channel.h"
+#include "../include/console.h"
+#include "../include/io_loop.h"
+#include "../include/headless.h"
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+/* Buffer for reading output between terminators; grows for long responses */
+#define CHANNEL_READ_SIZE 4096
+
+/* Buffer for commands waiting for dosdebug's stdin to drain; grows up to the maximum */
+#define CHANNEL_WRITE_SIZE 4096
+#define CHANNEL_MAX_WRITE (1024 * 1024)
+
+struct DosdebugChannel {
+    int in_fd;          /* dosdebug stdin, we write commands here */
+    int out_fd;         /* dosdebug stdout, we read responses here */
+    dosdebug_response_callback on_response;
+    void *data;
+
+    /* Marks the end of each response */
+    char terminator[CHANNEL_MAX_TERMINATOR];
+    size_t terminator_len;
+
+    char *read_buffer;
+    size_t read_capacity;
+    size_t read_len;
+    bool discarding;    /* skipping the rest of an overflowed response */
+
+    char *write_buffer;
+    size_t write_capacity;
+    size_t write_len;
+    bool writing;       /* in_fd is registered for EPOLLOUT */
+    bool eof;
+};
+
+/* A framed response on its way to the UI thread */
+typedef struct ChannelResponse {
+    dosdebug_response_callback callback;
+    void *data;
+    bool eof;
+    bool overflowed;
+    char text[];
+} ChannelResponse;
+
+/* A command on its way to the I/O thread */
+typedef struct ChannelCommand {
+    DosdebugChannel *channel;
+    size_t len;
+    char bytes[];
+} ChannelCommand;
+
+static void deliver_response(void *data) {
+    ChannelResponse *response = data;
+
+    response->callback(response->eof || response->overflowed ? NULL : response->text,
+                       response->overflowed, response->data);
+    free(response);
+}
+
+/* Hand len bytes of text (or EOF, or an overflow) to the UI thread */
+static void post_response(DosdebugChannel *channel, const char *text, size_t len, bool eof,
+                          bool overflowed) {
+    ChannelResponse *response = malloc(sizeof(*response) + len + 1);
+    if (!response) {
+        return;
+    }
+
+    response->callback = channel->on_response;
+    response->data = channel->data;
+    response->eof = eof;
+    response->overflowed = overflowed;
+    memcpy(response->text, text, len);
+    response->text[len] = '\0';
+
+    main_queue(deliver_response, response);
+}
+
+/* Drop the first len bytes of the read buffer */
+static void consume(DosdebugChannel *channel, size_t len) {
+    memmove(channel->read_buffer, channel->read_buffer + len, channel->read_len - len);
+    channel->read_len -= len;
+}
+
+/* Split the read buffer on terminators and deliver each complete response */
+static void frame_responses(DosdebugChannel *channel) {
+    char *end;
+
+    while ((end = memmem(channel->read_buffer, channel->read_len,
+                            channel->terminator, channel->terminator_len)) != NULL) {
+        size_t text_len = (size_t)(end - channel->read_buffer);
+
+        /* The end of an overflowed response was already reported */
+        if (!channel->discarding) {
+            post_response(channel, channel->read_buffer, text_len, false, false);
+        }
+        channel->discarding = false;
+        consume(channel, text_len + channel->terminator_len);
+    }
+
+    /* Keep only what could be the start of a terminator while discarding */
+    if (channel->discarding) {
+        if (channel->read_len >= channel->terminator_len) {
+            consume(channel, channel->read_len - (channel->terminator_len - 1));
+        }
+        return;
+    }
+
+    /* Make room for the rest of a long response */
+    if (channel->read_len == channel->read_capacity &&
+        channel->read_capacity < DOSDEBUG_MAX_RESPONSE) {
+        char *grown = realloc(channel->read_buffer, channel->read_capacity * 2);
+        if (grown) {
+            channel->read_buffer = grown;
+            channel->read_capacity *= 2;
+            return;
+        }
+    }
+
+    /*
+     * No terminator in a full buffer: report the response as overflowed and
+     * skip the rest of it, so the next response still answers the next
+     * command. A possible partial terminator is kept.
+     */
+    if (channel->read_len == channel->read_capacity) {
+        log_error("dosdebug response longer than %d bytes; discarded\n", DOSDEBUG_MAX_RESPONSE);
+        post_response(channel, "", 0, false, true);
+        channel->discarding = true;
+        consume(channel, channel->read_len - (channel->terminator_len - 1));
+    }
+}
+
+static void channel_mark_eof(DosdebugChannel *channel) {
+    if (channel->eof) {
+        return;
+    }
+
+    channel->eof = true;
+    io_loop_remove_fd(channel->out_fd);
+    io_loop_remove_fd(channel->in_fd);
+
+    /* Whatever was printed after the last prompt */
+    if (channel->read_len > 0 && !channel->discarding) {
+        post_response(channel, channel->read_buffer, channel->read_len, false, false);
+    }
+    channel->read_len = 0;
+    post_response(channel, "", 0, true, false);
+}
+
+static void channel_read(DosdebugChannel *channel) {
+    for (;;) {
+        ssize_t n = read(channel->out_fd, channel->read_buffer + channel->read_len,
+                         channel->read_capacity - channel->read_len);
+        if (n > 0) {
+            channel->read_len += (size_t)n;
+            frame_responses(channel);
+        } else if (n == 0) {
+            channel_mark_eof(channel);
+            return;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return;
+        } else {
+            channel_mark_eof(channel);
+            return;
+        }
+    }
+}
+
+static void channel_flush(DosdebugChannel *channel) {
+    while (channel->write_len > 0) {
+        ssize_t n = write(channel->in_fd, channel->write_buffer, channel->write_len);
+        if (n > 0) {
+            memmove(channel->write_buffer, channel->write_buffer + n,
+                    channel->write_len - (size_t)n);
+            channel->write_len -= (size_t)n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            /* dosdebug went away; drop what is left */
+            channel->write_len = 0;
+            break;
+        }
+    }
+
+    /* Only ask for EPOLLOUT while there is something left to write */
+    bool want_write = channel->write_len > 0;
+    if (want_write != channel->writing && !channel->eof) {
+        io_loop_modify_fd(channel->in_fd, want_write ? EPOLLOUT : 0);
+        channel->writing = want_write;
+    }
+}
+
+static void on_channel_ready(int fd, uint32_t events, void *data) {
+    DosdebugChannel *channel = data;
+
+    if (fd == channel->out_fd) {
+        if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+            channel_read(channel);
+        }
+    } else if (fd == channel->in_fd) {
+        if (events & EPOLLERR) {
+            channel->write_len = 0;
+        }
+        channel_flush(channel);
+    }
+}
+
+static void channel_attach(void *data) {
+    DosdebugChannel *channel = data;
+
+    if (!io_loop_add_fd(channel->out_fd, EPOLLIN, on_channel_ready, channel) ||
+        !io_loop_add_fd(channel->in_fd, 0, on_channel_ready, channel)) {
+        channel_mark_eof(channel);
+    }
+}
+
+static void channel_queue(void *data) {
+    ChannelCommand *command = data;
+    DosdebugChannel *channel = command->channel;
+
+    if (!channel->eof && channel->write_len + command->len > channel->write_capacity) {
+        size_t capacity = channel->write_capacity;
+        char *grown;
+
+        while (capacity < channel->write_len + command->len) {
+            capacity *= 2;
+        }
+        grown = capacity <= CHANNEL_MAX_WRITE ? realloc(channel->write_buffer, capacity) : NULL;
+        if (grown) {
+            channel->write_buffer = grown;
+            channel->write_capacity = capacity;
+        } else {
+            /*
+             * A dropped command would make every later response answer the
+             * wrong request; close instead, which fails them all.
+             */
+            log_error("dosdebug is not reading its commands; closing the channel\n");
+            channel_mark_eof(channel);
+        }
+    }
+
+    if (!channel->eof) {
+        memcpy(channel->write_buffer + channel->write_len, command->bytes, command->len);
+        channel->write_len += command->len;
+        channel_flush(channel);
+    }
+
+    free(command);
+}
+
+static void channel_detach(void *data) {
+    DosdebugChannel *channel = data;
+
+    if (!channel->eof) {
+        io_loop_remove_fd(channel->out_fd);
+        io_loop_remove_fd(channel->in_fd);
+    }
+}
+
+static bool set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+/* Attach a channel to dosdebug's stdio */
+DosdebugChannel *dosdebug_channel_open(int in_fd, int out_fd,
+                                       dosdebug_response_callback on_response,
+                                       void *data) {
+    return dosdebug_channel_open_framed(in_fd, out_fd, DOSDEBUG_PROMPT, on_response, data);
+}
+
+/* Attach a channel that frames responses on an arbitrary terminator */
+DosdebugChannel *dosdebug_channel_open_framed(int in_fd, int out_fd, const char *terminator,
+                                              dosdebug_response_callback on_response,
+                                              void *data) {
+    DosdebugChannel *channel;
+    size_t terminator_len = strlen(terminator);
+
+    if (terminator_len == 0 || terminator_len > CHANNEL_MAX_TERMINATOR) {
+        return NULL;
+    }
+
+    if (in_fd < 0 || out_fd < 0 || !set_nonblocking(in_fd) || !set_nonblocking(out_fd)) {
+        return NULL;
+    }
+
+    channel = calloc(1, sizeof(*channel));
+    if (!channel) {
+        return NULL;
+    }
+    channel->read_buffer = malloc(CHANNEL_READ_SIZE);
+    channel->write_buffer = malloc(CHANNEL_WRITE_SIZE);
+    if (!channel->read_buffer || !channel->write_buffer) {
+        free(channel->read_buffer);
+        free(channel->write_buffer);
+        free(channel);
+        return NULL;
+    }
+    channel->read_capacity = CHANNEL_READ_SIZE;
+    channel->write_capacity = CHANNEL_WRITE_SIZE;
+    channel->in_fd = in_fd;
+    channel->out_fd = out_fd;
+    channel->on_response = on_response;
+    channel->data = data;
+    memcpy(channel->terminator, terminator, terminator_len);
+    channel->terminator_len = terminator_len;
+
+    if (!io_loop_post(channel_attach, channel)) {
+        free(channel->read_buffer);
+        free(channel->write_buffer);
+        free(channel);
+        return NULL;
+    }
+
+    return channel;
+}
+
+/* Queue raw bytes for dosdebug */
+void dosdebug_channel_send_raw(DosdebugChannel *channel, const char *bytes, size_t len) {
+    ChannelCommand *command;
+
+    if (!channel) {
+        return;
+    }
+
+    command = malloc(sizeof(*command) + len);
+    if (!command) {
+        return;
+    }
+    command->channel = channel;
+    command->len = len;
+    memcpy(command->bytes, bytes, len);
+
+    if (!io_loop_post(channel_queue, command)) {
+        free(command);
+    }
+}
+
+/* Queue a command line for dosdebug */
+void dosdebug_channel_send(DosdebugChannel *channel, const char *command) {
+    size_t len = strlen(command);
+    char *line = malloc(len + 1);
+
+    if (!line) {
+        return;
+    }
+    memcpy(line, command, len);
+    line[len] = '\n';
+
+    dosdebug_channel_send_raw(channel, line, len + 1);
+    free(line);
+}
+
+/* Detach and free the channel */
+void dosdebug_channel_close(DosdebugChannel *channel) {
+    if (!channel) {
+        return;
+    }
+
+    /* Wait so the caller can safely close the fds afterwards */
+    io_loop_call(channel_detach, channel);
+    free(channel->read_buffer);
+    free(channel->write_buffer);
+    free(channel);
+}
@@ -2,6 +2,21 @@
 #define _XOPEN_SOURCE 500
 
 #include "../include/dosemu_integration.h"
+#include "../include/console.h"
+#include "../include/logger.h"
+#include "../include/dbg_client.h"
+#include "../include/capture.h"
+#include "../include/readiness.h"
+#include "../include/exit_watch.h"
+#include "../include/shutdown.h"
+#include "../include/trace.h"
+#include "../include/headless.h"
+#include "../include/placement.h"
+#include "../include/spawn.h"
+#include "../include/pidfd.h"
+#include "../include/dosemurc.h"
+#include "../include/transcript.h"
+#include "../include/overlay.h"
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
@@ -13,376 +28,962 @@
 #include <string.h>
 #include <stdarg.h>  /* For va_list, va_start, va_end */
 #include <limits.h>  /* For PATH_MAX */
-#include <subprocess.h>
 
-/* Process handles */
-static struct subprocess_s dosemu_process;
-static struct subprocess_s dosdebug_process;
+/* How long DOSEmu gets to honour the debugger's "kill" */
+#define STOP_KILL_GRACE_MS 3000
+
+/* One DOSEmu instance; owned by the UI thread */
+struct DosemuSession {
+    int id;
+    SessionState state;
+
+    /* Process handle, and the CPUs and cgroup it was launched into */
+    SpawnedProcess dosemu_process;
+    Placement placement;
+
+    /* Flag to track if the process is running */
+    int dosemu_running;
+
+    /* Driven by a transcript instead of a process; replay_pid is the recorded pid */
+    bool replayed;
+    pid_t replay_pid;
+
+    /* Reaps DOSEmu the moment it exits */
+    ExitWatch *exit_watch;
+    bool exited;
+    ExitInfo exit_info;
+    dosemu_done_callback exit_callback;
+    void *exit_callback_data;
+
+    /* DOSEmu's own stdout/stderr, drained by the shared I/O thread */
+    OutputCapture *capture;
+
+    /* In-process client for DOSEmu's debugger FIFOs */
+    DbgClient *debugger;
+
+    /* Launch arguments, kept for a launch that waits for its drive */
+    char dos_path[PATH_MAX];
+    char config_arg[PATH_MAX];   /* passed with -f, or empty */
+    char *dos_command;
+    const char *argv[9];
+
+    /* Private copy of the DOS drive, staged before launch and harvested after exit */
+    DriveOverlay *overlay;
+    bool staging;
+    bool harvesting;
+    uint64_t harvest_ns;
+    void (*after_harvest)(DosemuSession *session);   /* teardown waiting for the harvest */
+
+    /* Config file it was launched with, and whether that file changed since */
+    char config_source[PATH_MAX];
+    bool config_generated;       /* launched from a config merged with the GUI settings */
+    bool config_stale;
+
+    /* Launch in progress: waiting for the debug endpoint or the first reply */
+    ReadinessWatch *launch_watch;
+    uint64_t launch_ns;          /* trace_now() when DOSEmu was launched */
+    uint64_t phase_ns;           /* start of the launch phase in progress */
+    double ready_ms;             /* launch to first debugger reply, or -1 */
+    dosemu_done_callback launch_callback;
+    void *launch_callback_data;
+
+    /* Shutdown in progress */
+    uint64_t stop_ns;
+    dosemu_done_callback stop_callback;
+    void *stop_callback_data;
+    bool shutdown_pending;        /* shutdown machine still running */
+    bool stop_waiting_for_exit;   /* shutdown done, exit status not reported yet */
+    bool stop_success;
+    double stop_total_ms;
+};
+
+/* Session table, in start order */
+static DosemuSession *sessions[MAX_SESSIONS];
+static int session_count = 0;
+static int next_session_id = 1;
+
+static bool config_change_registered = false;
+
+static session_listener table_listener = NULL;
+static void *table_listener_data = NULL;
+
+/* Log a message prefixed with the session it belongs to */
+static void session_message(const DosemuSession *session, const char *format, ...) {
+    va_list args;
 
-/* Flags to track if processes are running */
-static int dosemu_running = 0;
-static int dosdebug_running = 0;
+    va_start(args, format);
+    log_vrecord(LOG_LEVEL_INFO, session->id, format, args);
+    va_end(args);
+}
 
-/* Buffer for reading dosdebug output */
-#define BUFFER_SIZE 4096
-static char read_buffer[BUFFER_SIZE];
+/* Log an error prefixed with the session it belongs to */
+static void session_error(const DosemuSession *session, const char *format, ...) {
+    va_list args;
 
-/* Add log entry to both console and stdout */
-static void log_message(const char *format, ...) {
-    va_list args, args_copy;
     va_start(args, format);
+    log_vrecord(LOG_LEVEL_ERROR, session->id, format, args);
+    va_end(args);
+}
 
-    /* Copy args for reuse */
-    va_copy(args_copy, args);
+static int session_index(const DosemuSession *session) {
+    for (int i = 0; i < session_count; i++) {
+        if (sessions[i] == session) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void notify_listener(SessionEvent event, int index) {
+    if (table_listener && index >= 0) {
+        table_listener(event, index, table_listener_data);
+    }
+}
+
+static void set_state(DosemuSession *session, SessionState state) {
+    session->state = state;
+    notify_listener(SESSION_CHANGED, session_index(session));
+}
 
-    /* Print to stdout */
-    vfprintf(stdout, format, args);
-    fflush(stdout);
+static void free_session(void *data) {
+    DosemuSession *session = data;
 
-    /* Print to app console if available */
-    if (app.console) {
-        char buffer[1024];
-        vsnprintf(buffer, sizeof(buffer), format, args_copy);
-        uiMultilineEntryAppend(app.console, buffer);
+    placement_release(&session->placement);
+    overlay_close(session->overlay, false);
+    free(session->dos_command);
+    free(session);
+}
+
+/* Called on the UI thread once the drive is written back */
+static void on_drive_harvested(DriveOverlay *overlay, bool success, void *data) {
+    DosemuSession *session = data;
+    void (*next)(DosemuSession *session) = session->after_harvest;
+    OverlayStats stats;
+
+    overlay_stats(overlay, &stats);
+    session_message(session, "Drive harvested in %.1f ms: %llu files (%llu KB) written back, "
+                    "%llu deleted, %llu conflicts\n", stats.harvest_ms,
+                    (unsigned long long)stats.harvested_files,
+                    (unsigned long long)(stats.harvested_bytes / 1024),
+                    (unsigned long long)stats.deleted_files,
+                    (unsigned long long)stats.conflicts);
+    overlay_close(overlay, !success);
+    trace_span("harvest drive", session->id, session->harvest_ns, trace_now());
+
+    session->harvesting = false;
+    session->after_harvest = NULL;
+    if (next) {
+        next(session);
     }
+}
 
-    va_end(args_copy);
-    va_end(args);
+/* Write back what DOS changed on its drive, unless it never finished cleanly */
+static void finish_overlay(DosemuSession *session) {
+    DriveOverlay *overlay = session->overlay;
+
+    if (!overlay || session->staging) {
+        return;
+    }
+    session->overlay = NULL;
+    if (!session->exited || session->exit_info.signal) {
+        session_message(session, "DOSEmu did not exit by itself; staged drive discarded\n");
+        overlay_close(overlay, false);
+        return;
+    }
+
+    /* Off the UI thread; the rest of the teardown waits for it */
+    session->harvest_ns = trace_now();
+    if (!overlay_harvest(overlay, on_drive_harvested, session)) {
+        overlay_close(overlay, true);
+        return;
+    }
+    session->harvesting = true;
 }
 
-/* Add error log entry to both console and stderr */
-static void log_error(const char *format, ...) {
-    va_list args, args_copy;
-    va_start(args, format);
+/* Run the rest of a teardown now, or once the drive harvest is done */
+static void after_harvest(DosemuSession *session, void (*next)(DosemuSession *session)) {
+    if (session->harvesting) {
+        session->after_harvest = next;
+        return;
+    }
+    next(session);
+}
 
-    /* Copy args for reuse */
-    va_copy(args_copy, args);
+/* Drop a finished session from the table */
+static void release_session(DosemuSession *session) {
+    int index = session_index(session);
+
+    session->state = SESSION_STOPPED;
+    exit_watch_release(session->exit_watch);
+    session->exit_watch = NULL;
+    finish_overlay(session);
+    if (session->harvesting) {
+        session->after_harvest = release_session;
+        return;
+    }
+    if (index >= 0) {
+        memmove(&sessions[index], &sessions[index + 1],
+                (size_t)(session_count - index - 1) * sizeof(sessions[0]));
+        session_count--;
+        notify_listener(SESSION_REMOVED, index);
+    }
 
-    /* Print to stderr */
-    vfprintf(stderr, format, args);
-    fflush(stderr);
+    /* Responses queued by the I/O thread before detaching still refer to it */
+    main_queue(free_session, session);
+}
 
-    /* Print to app console if available */
-    if (app.console) {
-        char buffer[1024];
-        vsnprintf(buffer, sizeof(buffer), format, args_copy);
-        uiMultilineEntryAppend(app.console, buffer);
+/* Milliseconds since start_dosemu() launched the emulator */
+static double ms_since_launch(const DosemuSession *session) {
+    return (double)(trace_now() - session->launch_ns) / 1000000.0;
+}
+
+/* Report the outcome of start_dosemu() to its caller */
+static void finish_launch(DosemuSession *session, bool success) {
+    dosemu_done_callback callback = session->launch_callback;
+
+    session->launch_callback = NULL;
+    trace_span(success ? "launch" : "launch failed", session->id, session->launch_ns, trace_now());
+    if (success) {
+        set_state(session, SESSION_RUNNING);
+    }
+    if (callback) {
+        callback(session, success, session->launch_callback_data);
     }
+}
 
-    va_end(args_copy);
-    va_end(args);
+/* Disconnect from DOSEmu's debugger */
+static void close_debugger(DosemuSession *session) {
+    uint64_t start = trace_now();
+
+    dbg_close(session->debugger);
+    session->debugger = NULL;
+    trace_span("close debugger", session->id, start, trace_now());
 }
 
-/* Start DOSEmu with the given paths */
-bool start_dosemu(const char *dos_path, const char *config_path) {
-    int result;
-    struct timespec ts;
+/* Stop capturing DOSEmu's output and release its process handle */
+static void release_dosemu_process(DosemuSession *session) {
+    uint64_t start = trace_now();
 
-    if (is_dosemu_running()) {
-        log_error("DOSEmu is already running\n");
-        return false;
+    capture_close(session->capture);
+    session->capture = NULL;
+    trace_span("drain output", session->id, start, trace_now());
+
+    start = trace_now();
+    spawn_release(&session->dosemu_process);
+    session->dosemu_running = 0;
+    trace_span("release process", session->id, start, trace_now());
+
+    finish_overlay(session);
+}
+
+/* Report the failed launch once its drive is harvested */
+static void finish_abort(DosemuSession *session) {
+    finish_launch(session, false);
+    release_session(session);
+}
+
+/* Kill whatever a failed launch left behind and drop the session */
+static void abort_launch(DosemuSession *session) {
+    close_debugger(session);
+
+    if (session->dosemu_running) {
+        /* Kill dosemu since we can't control it without the debugger */
+        if (!session->exited && !session->replayed) {
+            pidfd_signal(session->dosemu_process.pid_fd, session->dosemu_process.pid, SIGKILL);
+        }
+        release_dosemu_process(session);
     }
+    after_harvest(session, finish_abort);
+}
 
-    /* Prepare arguments for dosemu */
-    int use_default_config = !config_path || !*config_path ||
-                             strcmp(config_path, "~/.dosemurc") == 0;
+/* Called on the UI thread with DOSEmu's answer to the verification command */
+static void on_debugger_verified(const char *response, void *data) {
+    DosemuSession *session = data;
 
-    /* Build the command array */
-    const char *dosemu_command[4];
-    dosemu_command[0] = dos_path;
+    if (session->state != SESSION_STARTING) {
+        return;
+    }
 
-    if (use_default_config) {
-        dosemu_command[1] = NULL;
-        log_message("Executing: %s (with default config)\n", dos_path);
-    } else {
-        dosemu_command[1] = "-f";
-        dosemu_command[2] = config_path;
-        dosemu_command[3] = NULL;
-        log_message("Executing: %s %s %s\n", dos_path, dosemu_command[1], dosemu_command[2]);
+    trace_span("verify command", session->id, session->phase_ns, trace_now());
+
+    if (!response) {
+        session_error(session, "DOSEmu debugger closed before answering\n");
+        abort_launch(session);
+        return;
     }
 
-    /* Verify dosemu executable exists and is executable */
-    if (access(dos_path, X_OK) != 0) {
-        log_error("Cannot execute %s: %s\n", dos_path, strerror(errno));
+    if (*response) {
+        session_message(session, "From DOSEmu debugger:\n%s", response);
+    }
+
+    /* The first reply means the debugger is attached and accepting commands */
+    trace_instant("first reply", session->id);
+    session->ready_ms = ms_since_launch(session);
+    session_message(session, "DOSEmu controllable %.1f ms after launch\n", session->ready_ms);
+    finish_launch(session, true);
+}
+
+/* Connect to DOSEmu's debugger once its endpoint exists */
+static bool attach_debugger(DosemuSession *session, const char *endpoint) {
+    uint64_t start = trace_now();
+
+    session->debugger = session->replayed ? dbg_open_replay(session->replay_pid)
+                                          : dbg_open(endpoint);
+    trace_span("debugger attach", session->id, start, trace_now());
+    if (!session->debugger) {
+        session_error(session, "Cannot connect to DOSEmu debugger at %s: %s\n",
+                      endpoint, strerror(errno));
         return false;
     }
+    dbg_set_session(session->debugger, session->id);
 
-    /* Launch dosemu process */
-    result = subprocess_create(
-        dosemu_command,          /* Command array */
-        subprocess_option_inherit_environment | subprocess_option_no_window |
-        subprocess_option_enable_async,  /* Make sure it's async */
-        &dosemu_process          /* Process handle */
-    );
-
-    if (result != 0) {
-        log_error("Failed to start DOSEmu: %s\n", strerror(errno));
+    /* Read the registers to verify the connection */
+    session_message(session, "Verifying debugger connection...\n");
+    session->phase_ns = trace_now();
+    if (!dbg_command(session->debugger, "r", on_debugger_verified, session)) {
+        session_error(session, "Cannot send to DOSEmu debugger\n");
         return false;
     }
 
-    dosemu_running = 1;
-    /* Don't join with the process as that would block */
-    log_message("Started DOSEmu\n");
+    return true;
+}
 
-    /* Wait for dosemu to initialize before starting dosdebug */
-    ts.tv_sec = 0;
-    ts.tv_nsec = 500000000; /* 500 milliseconds */
-    nanosleep(&ts, NULL);
+/* Called on the UI thread when the readiness watch finishes */
+static void on_endpoint_ready(ReadinessResult result, const char *endpoint,
+                              double elapsed_ms, void *data) {
+    DosemuSession *session = data;
 
-    log_message("Waited 500ms for DOSEmu initialization\n");
+    session->launch_watch = NULL;
+    trace_span("wait for debug endpoint", session->id, session->phase_ns, trace_now());
+    transcript_endpoint(session->id, result, endpoint ? endpoint : "", elapsed_ms);
 
-    /* Check if dosemu is still running after the initial wait */
-    if (!subprocess_alive(&dosemu_process)) {
-        log_error("DOSEmu terminated unexpectedly during initialization\n");
-        dosemu_running = 0;
-        subprocess_destroy(&dosemu_process);
-        return false;
+    if (result != READINESS_READY) {
+        session_error(session, "DOSEmu debug endpoint %s after %.1f ms\n",
+                      readiness_result_name(result), elapsed_ms);
+
+        /* The exit watch finishes the launch once it has the exit status */
+        if (result == READINESS_EXITED) {
+            return;
+        }
+        abort_launch(session);
+        return;
     }
 
-    /* Now start dosdebug using the known path */
-    const char *dosdebug_path = "/usr/bin/dosdebug";
+    session_message(session, "DOSEmu debug endpoint %s appeared after %.1f ms\n",
+                    endpoint, elapsed_ms);
 
-    /* Verify dosdebug executable exists and is executable */
-    if (access(dosdebug_path, X_OK) != 0) {
-        log_error("Cannot execute %s: %s\n", dosdebug_path, strerror(errno));
+    if (!attach_debugger(session, endpoint)) {
+        abort_launch(session);
+    }
+}
 
-        /* Kill dosemu since we can't control it without dosdebug */
-        subprocess_terminate(&dosemu_process);
-        subprocess_destroy(&dosemu_process);
-        dosemu_running = 0;
-        return false;
+static void finish_stop(DosemuSession *session);
+
+/* Report an exit nobody asked for once the drive is harvested */
+static void finish_exit(DosemuSession *session) {
+    dosemu_done_callback callback = session->exit_callback;
+
+    /* A launch that never completed reports the failure through its own callback */
+    if (session->state == SESSION_STARTING) {
+        finish_launch(session, false);
+    } else if (callback) {
+        session->exit_callback = NULL;
+        callback(session, session->exit_info.status == 0, session->exit_callback_data);
+    }
+    release_session(session);
+}
+
+/* Called on the UI thread as soon as DOSEmu has exited and been reaped */
+static void on_dosemu_exited(const ExitInfo *info, void *data) {
+    DosemuSession *session = data;
+    SessionState state = session->state;
+    uint64_t start = trace_now();
+
+    session->exit_watch = NULL;
+    session->exited = true;
+    session->exit_info = *info;
+    trace_instant("exited", session->id);
+    transcript_exited(session->id, info);
+
+    session_message(session, "DOSEmu %s %d after %.1f ms: %.1f ms user, %.1f ms system CPU, "
+                    "%ld KB max RSS\n", info->signal ? "killed by signal" : "exited with status",
+                    info->signal ? info->signal : info->status, ms_since_launch(session),
+                    info->user_ms, info->system_ms, info->max_rss_kb);
+
+    /* stop_dosemu() in progress: its shutdown finishes the teardown */
+    if (state == SESSION_STOPPING) {
+        if (session->stop_waiting_for_exit) {
+            finish_stop(session);
+        }
+        return;
     }
 
-    log_message("Using dosdebug at: %s\n", dosdebug_path);
+    if (session->launch_watch) {
+        readiness_watch_cancel(session->launch_watch);
+        session->launch_watch = NULL;
+    }
 
-    const char *dosdebug_command[] = {dosdebug_path, NULL};
+    close_debugger(session);
+    release_dosemu_process(session);
+    trace_span("exit teardown", session->id, start, trace_now());
+    after_harvest(session, finish_exit);
+}
 
-    log_message("Starting dosdebug\n");
-    result = subprocess_create(
-        dosdebug_command,        /* Command array */
-        subprocess_option_inherit_environment | subprocess_option_no_window |
-        subprocess_option_enable_async,
-        &dosdebug_process        /* Process handle */
-    );
+/* Sessions launched from a config that changed no longer match it */
+static void on_config_changed(const char *source, void *data) {
+    for (int i = 0; i < session_count; i++) {
+        DosemuSession *session = sessions[i];
+        bool affected = *source ? strcmp(session->config_source, source) == 0
+                                : session->config_generated;
 
-    if (result != 0) {
-        log_error("Failed to start dosdebug: %s (errno: %d)\n", strerror(errno), errno);
-        /* Double-check file existence */
-        if (access(dosdebug_path, F_OK) != 0) {
-            log_error("File does not exist: %s\n", dosdebug_path);
-        } else if (access(dosdebug_path, X_OK) != 0) {
-            log_error("File exists but is not executable: %s\n", dosdebug_path);
+        if (!affected || session->config_stale || session->state == SESSION_STOPPING ||
+            session->state == SESSION_STOPPED) {
+            continue;
         }
+        session->config_stale = true;
+        session_message(session, "Config changed; restart the session to use it\n");
+        notify_listener(SESSION_CHANGED, i);
+    }
+}
+
+/* Start a DOSEmu session with the given paths */
+DosemuSession *start_dosemu(const char *dos_path, const char *config_path,
+                            dosemu_done_callback on_started, void *data) {
+    return start_dosemu_command(dos_path, config_path, NULL, on_started, data);
+}
 
-        /* Kill dosemu since we can't control it without dosdebug */
-        subprocess_terminate(&dosemu_process);
-        subprocess_destroy(&dosemu_process);
-        dosemu_running = 0;
+/* Spawn DOSEmu with the session's arguments and start watching it; false if it never ran */
+static bool launch_process(DosemuSession *session) {
+    char placement_text[256];
+
+    /* Pin, schedule and confine it as configured, from its first instruction */
+    if (!placement_prepare(session->id, &session->placement)) {
+        session_error(session, "Cannot place DOSEmu as configured\n");
         return false;
     }
+    placement_describe(&session->placement, placement_text, sizeof(placement_text));
+    if (placement_text[0]) {
+        session_message(session, "Placement: %s\n", placement_text);
+    }
 
-    dosdebug_running = 1;
-    log_message("Started dosdebug\n");
-
-    /* Give dosdebug time to initialize */
-    ts.tv_sec = 0;
-    ts.tv_nsec = 100000000; /* 100 milliseconds */
-    nanosleep(&ts, NULL);
-
-    /* Read initial output from dosdebug */
-    FILE *dosdebug_stdout = subprocess_stdout(&dosdebug_process);
-    if (dosdebug_stdout) {
-        /* Try to read any initial output */
-        size_t bytes_read = 0;
-        memset(read_buffer, 0, BUFFER_SIZE);
-
-        /* Try multiple reads with short delays to get complete output */
-        for (int i = 0; i < 5; i++) {
-            if (fgets(read_buffer + bytes_read, BUFFER_SIZE - bytes_read, dosdebug_stdout)) {
-                size_t len = strlen(read_buffer + bytes_read);
-                bytes_read += len;
-
-                /* Stop if we got the prompt or buffer is nearly full */
-                if (strstr(read_buffer, "dosdebug> ") || bytes_read >= BUFFER_SIZE - 100) {
-                    break;
-                }
-            }
-
-            /* Small delay between reads */
-            ts.tv_sec = 0;
-            ts.tv_nsec = 50000000; /* 50 milliseconds */
-            nanosleep(&ts, NULL);
-        }
+    /* Launch dosemu process */
+    session->launch_ns = trace_now();
+    if (!spawn_process(session->argv, &session->placement, &session->dosemu_process)) {
+        session_error(session, "Failed to start DOSEmu: %s\n", strerror(errno));
+        placement_release(&session->placement);
+        return false;
+    }
 
-        if (bytes_read > 0) {
-            log_message("Initial dosdebug output:\n%s", read_buffer);
-        }
+    session->dosemu_running = 1;
+    trace_span("exec", session->id, session->launch_ns, trace_now());
+
+    /* Reap DOSEmu and collect its resource usage the moment it exits */
+    session->exit_watch = exit_watch_start(session->dosemu_process.pid, on_dosemu_exited,
+                                           session);
+    if (!session->exit_watch) {
+        session_error(session, "Cannot watch DOSEmu for exit\n");
+    }
+    trace_instant("child alive", session->id);
+    /* Don't join with the process as that would block */
+    session_message(session, "Started DOSEmu (pid %d)\n", (int)session->dosemu_process.pid);
+
+    /* Drain DOSEmu's output so a chatty guest never blocks on a full pipe */
+    char capture_log[PATH_MAX];
+    capture_log[0] = '\0';
+    if (app.capture_log_dir && *app.capture_log_dir) {
+        snprintf(capture_log, sizeof(capture_log), "%s/dosemu-%d-%d.log", app.capture_log_dir,
+                 session->id, (int)session->dosemu_process.pid);
+    }
+    session->phase_ns = trace_now();
+    session->capture = capture_open(session->id,
+                                    session->dosemu_process.stdout_fd,
+                                    session->dosemu_process.stderr_fd,
+                                    capture_log);
+    trace_span("capture setup", session->id, session->phase_ns, trace_now());
+    if (!session->capture) {
+        session_error(session, "Cannot capture DOSEmu output\n");
     }
 
-    /* Send '?' command to verify connection and list available commands */
-    log_message("Verifying dosdebug connection...\n");
-
-    FILE *dosdebug_stdin = subprocess_stdin(&dosdebug_process);
-    if (dosdebug_stdin) {
-        fputs("?\n", dosdebug_stdin);
-        fflush(dosdebug_stdin);
-        log_message("Sent to dosdebug: ?\n");
-
-        /* Read the help text */
-        if (dosdebug_stdout) {
-            size_t bytes_read = 0;
-            memset(read_buffer, 0, BUFFER_SIZE);
-
-            /* Try multiple reads with delays to get complete help text */
-            for (int i = 0; i < 10; i++) {
-                if (fgets(read_buffer + bytes_read, BUFFER_SIZE - bytes_read, dosdebug_stdout)) {
-                    size_t len = strlen(read_buffer + bytes_read);
-                    bytes_read += len;
-
-                    /* Stop if we got the prompt again or buffer is nearly full */
-                    if (strstr(read_buffer + bytes_read - len, "dosdebug> ") ||
-                        bytes_read >= BUFFER_SIZE - 100) {
-                        break;
-                    }
-                }
-
-                /* Small delay between reads */
-                ts.tv_sec = 0;
-                ts.tv_nsec = 100000000; /* 100 milliseconds */
-                nanosleep(&ts, NULL);
-            }
-
-            if (bytes_read > 0) {
-                log_message("From dosdebug:\n%s", read_buffer);
-            }
-        }
+    /* Attach the debugger as soon as DOSEmu has created its debug FIFO */
+    session->phase_ns = trace_now();
+    session->launch_watch = readiness_watch_start(session->dosemu_process.pid,
+                                                  app.attach_timeout_ms,
+                                                  on_endpoint_ready, session);
+    if (!session->launch_watch) {
+        session_error(session, "Cannot watch for the DOSEmu debug endpoint\n");
+        pidfd_signal(session->dosemu_process.pid_fd, session->dosemu_process.pid, SIGKILL);
+        exit_watch_release(session->exit_watch);
+        session->exit_watch = NULL;
+        release_dosemu_process(session);
+        placement_release(&session->placement);
+        return false;
     }
 
+    transcript_launch(session->id, session->dosemu_process.pid,
+                      session->dos_command ? session->dos_command : "");
     return true;
 }
 
-/* Stop the dosemu process using dosdebug */
-bool stop_dosemu(void) {
-    struct timespec ts;
+/* Called on the UI thread once the session's drive is staged */
+static void on_drive_staged(DriveOverlay *overlay, bool success, void *data) {
+    DosemuSession *session = data;
+    OverlayStats stats;
+
+    session->staging = false;
+    overlay_stats(overlay, &stats);
+    trace_span("stage drive", session->id, session->phase_ns, trace_now());
+
+    /* stop_dosemu() while staging: there is nothing to shut down */
+    if (session->state == SESSION_STOPPING) {
+        overlay_close(session->overlay, false);
+        session->overlay = NULL;
+        session->stop_success = true;
+        session->stop_total_ms = (double)(trace_now() - session->stop_ns) / 1000000.0;
+        finish_stop(session);
+        return;
+    }
 
-    if (!is_dosemu_running()) {
-        log_error("DOSEmu is not running\n");
-        return false;
+    if (!success) {
+        session_error(session, "Cannot stage DOS drive %s\n", app.drive_dir);
+    } else {
+        session_message(session, "Drive staged in %s in %.1f ms: %llu files, %llu KB copied, "
+                        "%llu KB reflinked\n", overlay_path(overlay), stats.stage_ms,
+                        (unsigned long long)stats.files,
+                        (unsigned long long)(stats.bytes_copied / 1024),
+                        (unsigned long long)(stats.bytes_cloned / 1024));
+    }
+    if (!success || !launch_process(session)) {
+        overlay_close(session->overlay, false);
+        session->overlay = NULL;
+        finish_launch(session, false);
+        release_session(session);
     }
+}
 
-    /* Send kill command to terminate dosemu */
-    log_message("Sending kill command to terminate DOSEmu\n");
+/* Start a DOSEmu session, optionally running one DOS command and exiting */
+DosemuSession *start_dosemu_command(const char *dos_path, const char *config_path,
+                                    const char *dos_command, dosemu_done_callback on_started,
+                                    void *data) {
+    DosemuSession *session;
+    const char *drive = NULL;
 
-    FILE *dosdebug_stdin = subprocess_stdin(&dosdebug_process);
-    if (dosdebug_stdin) {
-        fputs("kill\n", dosdebug_stdin);
-        fflush(dosdebug_stdin);
-        log_message("Sent to dosdebug: kill\n");
+    if (session_count == MAX_SESSIONS) {
+        log_error("Too many DOSEmu sessions (limit %d)\n", MAX_SESSIONS);
+        return NULL;
+    }
 
-        /* Read any output from the kill command */
-        FILE *dosdebug_stdout = subprocess_stdout(&dosdebug_process);
-        if (dosdebug_stdout) {
-            memset(read_buffer, 0, BUFFER_SIZE);
-            if (fgets(read_buffer, BUFFER_SIZE, dosdebug_stdout)) {
-                log_message("From dosdebug:\n%s", read_buffer);
-            }
+    session = calloc(1, sizeof(*session));
+    if (!session) {
+        log_error("Out of memory starting DOSEmu\n");
+        return NULL;
+    }
+    session->id = next_session_id++;
+    session->state = SESSION_STARTING;
+    session->ready_ms = -1.0;
+    session->dosemu_process.pid_fd = -1;
+    session->dosemu_process.stdin_fd = -1;
+    session->dosemu_process.stdout_fd = -1;
+    session->dosemu_process.stderr_fd = -1;
+    session->placement.core = -1;
+    session->placement.cgroup_procs_fd = -1;
+
+    /* Each session gets its own copy of the DOS drive on tmpfs */
+    if (app.drive_dir && *app.drive_dir) {
+        session->overlay = overlay_create(app.drive_dir, session->id);
+        if (!session->overlay) {
+            free_session(session);
+            return NULL;
         }
+        drive = overlay_path(session->overlay);
     }
 
-    /* Wait briefly to ensure dosemu has time to terminate */
-    ts.tv_sec = 0;
-    ts.tv_nsec = 500000000; /* 500 milliseconds */
-    nanosleep(&ts, NULL);
+    /* Merge the Configuration tab settings into the config DOSEmu will read */
+    if (!config_change_registered) {
+        dosemurc_add_change_callback(on_config_changed, NULL);
+        config_change_registered = true;
+    }
+    if (!dosemurc_launch_config(config_path, drive, session->config_arg,
+                                sizeof(session->config_arg),
+                                session->config_source, sizeof(session->config_source))) {
+        session_error(session, "Cannot use DOSEmu config %s\n",
+                      config_path && *config_path ? config_path : "~/.dosemurc");
+        free_session(session);
+        return NULL;
+    }
+    session->config_generated = session->config_arg[0] != '\0';
+    if (!session->config_generated && config_path && strcmp(config_path, "~/.dosemurc") != 0) {
+        snprintf(session->config_arg, sizeof(session->config_arg), "%s", config_path);
+    }
+    snprintf(session->dos_path, sizeof(session->dos_path), "%s", dos_path);
+    if (dos_command) {
+        session->dos_command = strdup(dos_command);
+        if (!session->dos_command) {
+            log_error("Out of memory starting DOSEmu\n");
+            free_session(session);
+            return NULL;
+        }
+    }
 
-    /* Send quit command to exit the debug session */
-    log_message("Sending quit command to exit debug session\n");
+    /* Build the command array */
+    const char **dosemu_command = session->argv;
+    int argc = 0;
+    dosemu_command[argc++] = session->dos_path;
 
-    if (dosdebug_stdin) {
-        fputs("quit\n", dosdebug_stdin);
-        fflush(dosdebug_stdin);
-        log_message("Sent to dosdebug: quit\n");
+    if (session->config_arg[0]) {
+        dosemu_command[argc++] = "-f";
+        dosemu_command[argc++] = session->config_arg;
+    }
 
-        /* Read any output from the quit command */
-        FILE *dosdebug_stdout = subprocess_stdout(&dosdebug_process);
-        if (dosdebug_stdout) {
-            memset(read_buffer, 0, BUFFER_SIZE);
-            if (fgets(read_buffer, BUFFER_SIZE, dosdebug_stdout)) {
-                log_message("From dosdebug:\n%s", read_buffer);
-            }
+    /* Unattended jobs use the dumb terminal so their output reaches the pipes */
+    if (dos_command) {
+        dosemu_command[argc++] = "-dumb";
+        dosemu_command[argc++] = "-E";
+        dosemu_command[argc++] = session->dos_command;
+    } else {
+        /* Interactive sessions use the video options from the Configuration tab */
+        if (app.use_console) {
+            dosemu_command[argc++] = "-c";
+        }
+        if (app.use_vga) {
+            dosemu_command[argc++] = "-V";
         }
     }
+    dosemu_command[argc] = NULL;
+
+    if (!session->config_arg[0]) {
+        session_message(session, "Executing: %s (with default config)%s%s%s%s\n", dos_path,
+                        !dos_command && app.use_console ? " -c" : "",
+                        !dos_command && app.use_vga ? " -V" : "",
+                        dos_command ? " running " : "", dos_command ? dos_command : "");
+    } else {
+        session_message(session, "Executing: %s -f %s%s%s%s%s\n", dos_path, session->config_arg,
+                        !dos_command && app.use_console ? " -c" : "",
+                        !dos_command && app.use_vga ? " -V" : "",
+                        dos_command ? " running " : "", dos_command ? dos_command : "");
+    }
 
-    /* Terminate and clean up dosdebug */
-    if (dosdebug_running) {
-        /* Send Ctrl-C to dosdebug */
-        if (dosdebug_stdin) {
-            char ctrlc = 3;  /* ASCII code for Ctrl-C */
-            fputc(ctrlc, dosdebug_stdin);
-            fflush(dosdebug_stdin);
+    /* Verify dosemu executable exists and is executable */
+    if (access(dos_path, X_OK) != 0) {
+        session_error(session, "Cannot execute %s: %s\n", dos_path, strerror(errno));
+        free_session(session);
+        return NULL;
+    }
+
+    /* DOSEmu starts once its drive is staged; the session shows as starting meanwhile */
+    if (session->overlay) {
+        session->launch_ns = session->phase_ns = trace_now();
+        if (!overlay_stage(session->overlay, on_drive_staged, session)) {
+            free_session(session);
+            return NULL;
         }
+        session->staging = true;
+    } else if (!launch_process(session)) {
+        free_session(session);
+        return NULL;
+    }
+
+    session->launch_callback = on_started;
+    session->launch_callback_data = data;
+
+    sessions[session_count++] = session;
+    notify_listener(SESSION_ADDED, session_count - 1);
+
+    return session;
+}
+
+/* Queue the debugger's "kill" behind any commands still in flight */
+static void send_dosemu_kill(void *data) {
+    DosemuSession *session = dosemu_session_find((int)(intptr_t)data);
+
+    if (session && session->debugger) {
+        dbg_kill(session->debugger);
+    }
+}
 
-        /* Wait for dosdebug to terminate, but don't wait too long */
-        int return_code;
-        subprocess_join(&dosdebug_process, &return_code);
+/* Graceful exit request, run on the I/O thread by the shutdown machine */
+static void request_dosemu_kill(void *data) {
+    main_queue(send_dosemu_kill, data);
+}
+
+/* Report the stop once the drive is harvested */
+static void report_stop(DosemuSession *session) {
+    dosemu_done_callback callback = session->stop_callback;
 
-        /* Check if the process is still running after a brief wait */
-        ts.tv_sec = 1;  /* Wait for 1 second */
-        ts.tv_nsec = 0;
-        nanosleep(&ts, NULL);
+    trace_span(session->stop_success ? "stop" : "stop incomplete", session->id,
+               session->stop_ns, trace_now());
 
-        if (subprocess_alive(&dosdebug_process)) {
-            /* Process is still running, force terminate */
-            subprocess_terminate(&dosdebug_process);
+    if (session->stop_success) {
+        session_message(session, "DOSEmu terminated in %.1f ms\n", session->stop_total_ms);
+    } else {
+        session_error(session, "DOSEmu shutdown incomplete after %.1f ms\n",
+                      session->stop_total_ms);
+    }
+
+    session->stop_callback = NULL;
+    if (callback) {
+        callback(session, session->stop_success, session->stop_callback_data);
+    }
+    release_session(session);
+}
+
+/* Release DOSEmu once it is stopped and, if it exited, reaped */
+static void finish_stop(DosemuSession *session) {
+    session->stop_waiting_for_exit = false;
+    close_debugger(session);
+
+    /* An unresponsive child is left to the exit watch */
+    if (session->dosemu_running) {
+        release_dosemu_process(session);
+    }
+    after_harvest(session, report_stop);
+}
+
+/* Called once the shutdown machine is done */
+static void on_shutdown_done(const ShutdownResult *results, int count,
+                             double total_ms, void *data) {
+    DosemuSession *session = data;
+
+    session->shutdown_pending = false;
+    session->stop_success = true;
+    session->stop_total_ms = total_ms;
+    transcript_shutdown(session->id, results, count, total_ms);
+    for (int i = 0; i < count; i++) {
+        session_message(session, "%s %s after %.1f ms\n", results[i].name,
+                        shutdown_outcome_name(results[i].outcome), results[i].elapsed_ms);
+        if (results[i].outcome == SHUTDOWN_UNRESPONSIVE) {
+            session->stop_success = false;
         }
+    }
 
-        subprocess_destroy(&dosdebug_process);
-        dosdebug_running = 0;
+    /* The exit watch may not have delivered the exit status yet */
+    if (session->stop_success && !session->exited) {
+        session->stop_waiting_for_exit = true;
+        return;
+    }
+    finish_stop(session);
+}
+
+/* Stop a session using the debugger */
+bool stop_dosemu(DosemuSession *session, dosemu_done_callback on_stopped, void *data) {
+    ShutdownTarget target;
+    uint64_t start = trace_now();
+
+    /* Nothing was launched yet; the staged drive is discarded once it is done */
+    if (session && session->staging && session->state == SESSION_STARTING) {
+        finish_launch(session, false);
+        session_message(session, "Launch abandoned while staging the drive\n");
+        session->stop_ns = start;
+        session->stop_callback = on_stopped;
+        session->stop_callback_data = data;
+        set_state(session, SESSION_STOPPING);
+        return true;
+    }
+
+    if (!session || !is_dosemu_running(session)) {
+        log_error("DOSEmu is not running\n");
+        return false;
     }
 
-    /* If dosemu is somehow still running, terminate it directly */
-    if (subprocess_alive(&dosemu_process)) {
-        log_error("DOSEmu didn't terminate via dosdebug, terminating directly\n");
-        subprocess_terminate(&dosemu_process);
+    /* Abandon a launch that is still waiting for the debug endpoint */
+    if (session->launch_watch) {
+        readiness_watch_cancel(session->launch_watch);
+        session->launch_watch = NULL;
+    }
+    if (session->state == SESSION_STARTING) {
+        finish_launch(session, false);
     }
 
-    /* Clean up dosemu process */
-    subprocess_destroy(&dosemu_process);
-    dosemu_running = 0;
+    /* kill via the debugger, then SIGTERM, then SIGKILL */
+    session_message(session, "Sending kill command to terminate DOSEmu\n");
+    target.name = "DOSEmu";
+    target.pid = session->dosemu_process.pid;
+    target.pid_fd = session->dosemu_process.pid_fd;
+    target.request = session->debugger ? request_dosemu_kill : NULL;
+    target.request_data = (void *)(intptr_t)session->id;
+    target.grace_ms = STOP_KILL_GRACE_MS;
+    target.trace_id = session->id;
+
+    /* A replayed session's shutdown result comes from its transcript */
+    if (!session->replayed && !shutdown_start(&target, 1, on_shutdown_done, session)) {
+        session_error(session, "Cannot start DOSEmu shutdown\n");
+        return false;
+    }
 
-    log_message("DOSEmu terminated\n");
+    transcript_stop(session->id);
+    session->shutdown_pending = true;
+    session->stop_ns = start;
+    session->stop_callback = on_stopped;
+    session->stop_callback_data = data;
+    set_state(session, SESSION_STOPPING);
     return true;
 }
 
-/* Check if DOSEmu is currently running */
-bool is_dosemu_running(void) {
-    if (!dosemu_running) {
+/* Check if a session's DOSEmu is currently running */
+bool is_dosemu_running(DosemuSession *session) {
+    return session && session->dosemu_running && !session->exited &&
+           session->state != SESSION_STOPPING && session->state != SESSION_STOPPED;
+}
+
+/* Sessions whose process is played back from a transcript */
+DosemuSession *dosemu_replay_launch(pid_t pid, const char *dos_command,
+                                    dosemu_done_callback on_started, void *data) {
+    DosemuSession *session;
+
+    if (session_count == MAX_SESSIONS) {
+        log_error("Too many DOSEmu sessions (limit %d)\n", MAX_SESSIONS);
+        return NULL;
+    }
+
+    session = calloc(1, sizeof(*session));
+    if (!session) {
+        log_error("Out of memory replaying DOSEmu\n");
+        return NULL;
+    }
+    session->id = next_session_id++;
+    session->state = SESSION_STARTING;
+    session->ready_ms = -1.0;
+    session->replayed = true;
+    session->replay_pid = pid;
+    session->dosemu_running = 1;
+    session->dosemu_process.pid_fd = -1;
+    session->dosemu_process.stdin_fd = -1;
+    session->dosemu_process.stdout_fd = -1;
+    session->dosemu_process.stderr_fd = -1;
+    session->placement.core = -1;
+    session->placement.cgroup_procs_fd = -1;
+    session->launch_ns = session->phase_ns = trace_now();
+    session->launch_callback = on_started;
+    session->launch_callback_data = data;
+
+    session_message(session, "Replaying DOSEmu (recorded pid %d)%s%s\n", (int)pid,
+                    *dos_command ? " running " : "", dos_command);
+
+    sessions[session_count++] = session;
+    notify_listener(SESSION_ADDED, session_count - 1);
+    transcript_launch(session->id, pid, dos_command);
+    return session;
+}
+
+bool dosemu_replay_endpoint(DosemuSession *session, ReadinessResult result,
+                            const char *endpoint, double elapsed_ms) {
+    if (!session->replayed || session->state != SESSION_STARTING || session->debugger) {
         return false;
     }
+    on_endpoint_ready(result, result == READINESS_READY ? endpoint : NULL, elapsed_ms, session);
+    return true;
+}
 
-    /* Check if the process is still alive */
-    if (!subprocess_alive(&dosemu_process)) {
-        /* Process has terminated */
-        dosemu_running = 0;
+bool dosemu_replay_shutdown(DosemuSession *session, const ShutdownResult *results, int count,
+                            double total_ms) {
+    if (!session->replayed || !session->shutdown_pending) {
+        return false;
+    }
+    on_shutdown_done(results, count, total_ms, session);
+    return true;
+}
 
-        /* If dosdebug is still running, terminate it */
-        if (dosdebug_running) {
-            log_message("DOSEmu has terminated, closing dosdebug\n");
+bool dosemu_replay_exited(DosemuSession *session, const ExitInfo *info) {
+    if (!session->replayed || session->exited) {
+        return false;
+    }
+    on_dosemu_exited(info, session);
+    return true;
+}
 
-            /* Send quit command */
-            FILE *dosdebug_stdin = subprocess_stdin(&dosdebug_process);
-            if (dosdebug_stdin) {
-                fputs("quit\n", dosdebug_stdin);
-                fflush(dosdebug_stdin);
-            }
+/* Number of sessions in the table */
+int dosemu_session_count(void) {
+    return session_count;
+}
+
+/* Session at a table index, or NULL */
+DosemuSession *dosemu_session_at(int index) {
+    if (index < 0 || index >= session_count) {
+        return NULL;
+    }
+    return sessions[index];
+}
 
-            /* Terminate and clean up */
-            subprocess_terminate(&dosdebug_process);
-            subprocess_destroy(&dosdebug_process);
-            dosdebug_running = 0;
+/* Session with the given id, or NULL once it has left the table */
+DosemuSession *dosemu_session_find(int id) {
+    for (int i = 0; i < session_count; i++) {
+        if (sessions[i]->id == id) {
+            return sessions[i];
         }
+    }
+    return NULL;
+}
 
+/* Register the single listener for session table changes */
+void dosemu_set_session_listener(session_listener listener, void *data) {
+    table_listener = listener;
+    table_listener_data = data;
+}
+
+int dosemu_session_id(const DosemuSession *session) {
+    return session->id;
+}
+
+SessionState dosemu_session_state(const DosemuSession *session) {
+    return session->state;
+}
+
+pid_t dosemu_session_pid(const DosemuSession *session) {
+    return session->dosemu_running && !session->exited ? session->dosemu_process.pid : 0;
+}
+
+bool dosemu_session_signal(const DosemuSession *session, int sig) {
+    if (!dosemu_session_pid(session) || session->replayed) {
         return false;
     }
+    return pidfd_signal(session->dosemu_process.pid_fd, session->dosemu_process.pid, sig) == 0;
+}
 
-    return true;
+DbgClient *dosemu_session_debugger(const DosemuSession *session) {
+    return session->debugger;
+}
+
+double dosemu_session_ready_ms(const DosemuSession *session) {
+    return session->ready_ms;
+}
+
+void dosemu_session_set_idle(DosemuSession *session, bool idle) {
+    SessionState state = idle ? SESSION_IDLE : SESSION_RUNNING;
+
+    if ((session->state == SESSION_RUNNING || session->state == SESSION_IDLE) &&
+        session->state != state) {
+        set_state(session, state);
+    }
+}
+
+int dosemu_session_exit_status(const DosemuSession *session) {
+    return session->exited ? session->exit_info.status : -1;
+}
+
+const ExitInfo *dosemu_session_exit_info(const DosemuSession *session) {
+    return session->exited ? &session->exit_info : NULL;
+}
+
+void dosemu_session_on_exit(DosemuSession *session, dosemu_done_callback on_exit, void *data) {
+    session->exit_callback = on_exit;
+    session->exit_callback_data = data;
+}
+
+bool dosemu_session_config_stale(const DosemuSession *session) {
+    return session->config_stale;
+}
+
+const char *dosemu_session_state_name(SessionState state) {
+    switch (state) {
+    case SESSION_STARTING:
+        return "Starting";
+    case SESSION_RUNNING:
+        return "Running";
+    case SESSION_IDLE:
+        return "Idle (pool)";
+    case SESSION_STOPPING:
+        return "Stopping";
+    case SESSION_STOPPED:
+        return "Stopped";
+    }
+    return "Unknown";
 }
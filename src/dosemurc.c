@@ -0,0 +1,676 @@
+#define _GNU_SOURCE
+
+#include "../include/dosemurc.h"
+#include "../include/console.h"
+#include "../include/headless.h"
+#include "../include/io_loop.h"
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Changes that mean a watched file has new contents */
+#define WATCH_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_MOVED_FROM)
+
+/* A config file launches were generated from, watched through its directory */
+typedef struct Source {
+    char path[PATH_MAX];
+    const char *name;        /* last component of path */
+    int wd;                  /* inotify watch of the directory, or -1 */
+    bool changed;            /* seen in the batch being delivered */
+} Source;
+
+/* One launch config that is known to be valid and on disk */
+typedef struct CacheEntry {
+    bool used;
+    int source;
+    DosemurcSettings settings;
+    char drive[PATH_MAX];    /* C: directory, or empty */
+    char path[PATH_MAX];     /* generated file, or empty for DOSEmu's own */
+} CacheEntry;
+
+/* File names the I/O thread saw change, for the UI thread to match */
+typedef struct ChangedName {
+    int wd;
+    char name[NAME_MAX + 1];
+} ChangedName;
+
+typedef struct ChangeBatch {
+    int count;
+    ChangedName names[];
+} ChangeBatch;
+
+/* UI thread state */
+static DosemurcSettings current_settings;
+static Source sources[DOSEMURC_MAX_SOURCES];
+static int source_count = 0;
+static CacheEntry cache[DOSEMURC_CACHE_ENTRIES];
+static int cache_next = 0;
+static DosemurcStats stats;
+static dosemurc_change_callback change_callbacks[DOSEMURC_MAX_CALLBACKS];
+static void *change_callback_data[DOSEMURC_MAX_CALLBACKS];
+static int change_callback_count = 0;
+static int inotify_fd = -1;
+
+/* Variables the settings replace */
+static const char *const managed_names[] = {"_dpmi", "_xms", "_ems", "_console", "_video",
+                                            "_hdimage"};
+
+static bool settings_equal(const DosemurcSettings *a, const DosemurcSettings *b) {
+    return a->memory_kb == b->memory_kb && a->xms_kb == b->xms_kb && a->ems_kb == b->ems_kb &&
+           a->console == b->console && a->vga == b->vga;
+}
+
+static bool settings_empty(const DosemurcSettings *settings) {
+    return settings->memory_kb <= 0 && settings->xms_kb <= 0 && settings->ems_kb <= 0 &&
+           !settings->console && !settings->vga;
+}
+
+/* Whether a setting or the drive replaces managed_names[index] */
+static bool overrides(const DosemurcSettings *settings, const char *drive, size_t index) {
+    switch (index) {
+    case 0:
+        return settings->memory_kb > 0;
+    case 1:
+        return settings->xms_kb > 0;
+    case 2:
+        return settings->ems_kb > 0;
+    case 3:
+        return settings->console;
+    case 4:
+        return settings->vga;
+    default:
+        return *drive != '\0';
+    }
+}
+
+static bool validate_settings(const DosemurcSettings *settings) {
+    if (settings->memory_kb < 0 || settings->memory_kb > DOSEMURC_MAX_MEMORY_KB) {
+        log_error("Memory size must be between 0 and %d KB\n", DOSEMURC_MAX_MEMORY_KB);
+        return false;
+    }
+    if (settings->xms_kb < 0 || settings->xms_kb > DOSEMURC_MAX_XMS_KB) {
+        log_error("XMS size must be between 0 and %d KB\n", DOSEMURC_MAX_XMS_KB);
+        return false;
+    }
+    if (settings->ems_kb < 0 || settings->ems_kb > DOSEMURC_MAX_EMS_KB ||
+        settings->ems_kb % DOSEMURC_EMS_PAGE_KB != 0) {
+        log_error("EMS size must be a multiple of %d KB up to %d KB\n", DOSEMURC_EMS_PAGE_KB,
+                  DOSEMURC_MAX_EMS_KB);
+        return false;
+    }
+    return true;
+}
+
+/* The absolute path config_path names; the user's own file for the default */
+static bool resolve_source(const char *config_path, char *path, size_t size, bool *required) {
+    const char *home = getenv("HOME");
+    char expanded[PATH_MAX];
+
+    *required = config_path && *config_path && strcmp(config_path, "~/.dosemurc") != 0;
+    if (!*required) {
+        config_path = "~/.dosemurc";
+    }
+
+    if (strncmp(config_path, "~/", 2) == 0) {
+        if (!home || !*home) {
+            log_error("Cannot find %s without HOME\n", config_path);
+            return false;
+        }
+        snprintf(expanded, sizeof(expanded), "%s/%s", home, config_path + 2);
+    } else {
+        snprintf(expanded, sizeof(expanded), "%s", config_path);
+    }
+
+    if (realpath(expanded, path)) {
+        return true;
+    }
+    if (*required) {
+        log_error("Cannot read DOSEmu config %s: %s\n", expanded, strerror(errno));
+        return false;
+    }
+    /* The user's file does not exist yet; watch for it anyway */
+    snprintf(path, size, "%s", expanded);
+    return true;
+}
+
+static void on_inotify(int fd, uint32_t events, void *data);
+
+static void add_inotify_fd(void *data) {
+    io_loop_add_fd(inotify_fd, EPOLLIN, on_inotify, NULL);
+}
+
+/* Watch the directory of a source so that edits, replacements and creation are seen */
+static void watch_source(Source *source) {
+    char directory[PATH_MAX];
+    char *slash;
+
+    if (inotify_fd < 0) {
+        inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotify_fd < 0 || !io_loop_post(add_inotify_fd, NULL)) {
+            log_error("Cannot watch DOSEmu configs for changes: %s\n", strerror(errno));
+            if (inotify_fd >= 0) {
+                close(inotify_fd);
+                inotify_fd = -1;
+            }
+            return;
+        }
+    }
+
+    snprintf(directory, sizeof(directory), "%s", source->path);
+    slash = strrchr(directory, '/');
+    if (slash == directory) {
+        slash[1] = '\0';
+    } else if (slash) {
+        *slash = '\0';
+    }
+    source->wd = inotify_add_watch(inotify_fd, directory, WATCH_EVENTS);
+}
+
+static int find_source(const char *path) {
+    for (int i = 0; i < source_count; i++) {
+        if (strcmp(sources[i].path, path) == 0) {
+            return i;
+        }
+    }
+    if (source_count == DOSEMURC_MAX_SOURCES) {
+        return -1;
+    }
+
+    Source *source = &sources[source_count];
+    snprintf(source->path, sizeof(source->path), "%s", path);
+    source->name = strrchr(source->path, '/') ? strrchr(source->path, '/') + 1 : source->path;
+    source->wd = -1;
+    watch_source(source);
+    return source_count++;
+}
+
+/* Read a whole config file; a missing optional file reads as empty */
+static char *read_source(const char *path, bool required, size_t *length) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    char *text;
+    ssize_t got;
+
+    *length = 0;
+    if (fd < 0) {
+        if (required || errno != ENOENT) {
+            log_error("Cannot read DOSEmu config %s: %s\n", path, strerror(errno));
+            return NULL;
+        }
+        return calloc(1, 1);
+    }
+
+    text = malloc(DOSEMURC_MAX_SOURCE_BYTES + 1);
+    while (text && *length < DOSEMURC_MAX_SOURCE_BYTES &&
+           (got = read(fd, text + *length, DOSEMURC_MAX_SOURCE_BYTES - *length)) != 0) {
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0) {
+            log_error("Cannot read DOSEmu config %s: %s\n", path, strerror(errno));
+            free(text);
+            text = NULL;
+            break;
+        }
+        *length += (size_t)got;
+    }
+    close(fd);
+
+    if (text && *length == DOSEMURC_MAX_SOURCE_BYTES) {
+        log_error("DOSEmu config %s is larger than %d bytes\n", path, DOSEMURC_MAX_SOURCE_BYTES);
+        free(text);
+        return NULL;
+    }
+    if (text) {
+        text[*length] = '\0';
+    }
+    return text;
+}
+
+/* Length of "$_name" at p if the line assigns to it, otherwise 0 */
+static size_t assignment_name(const char *p, const char *end) {
+    const char *q = p + 1;
+
+    if (p >= end || *p != '$') {
+        return 0;
+    }
+    while (q < end && (isalnum((unsigned char)*q) || *q == '_')) {
+        q++;
+    }
+    if (q == p + 1) {
+        return 0;
+    }
+    for (const char *r = q; r < end && *r != '='; r++) {
+        if (!isspace((unsigned char)*r)) {
+            return 0;
+        }
+    }
+    return memchr(q, '=', (size_t)(end - q)) ? (size_t)(q - p) : 0;
+}
+
+static bool starts_with_word(const char *p, const char *end, const char *word) {
+    size_t length = strlen(word);
+
+    return (size_t)(end - p) >= length && strncmp(p, word, length) == 0 &&
+           ((size_t)(end - p) == length || !isalnum((unsigned char)p[length]));
+}
+
+/*
+ * Check the structure DOSEmu's parser relies on: balanced quotes and
+ * parentheses on every line, assignments to $names and if/endif nesting.
+ */
+static bool validate_source(const char *path, const char *text) {
+    const char *line = text;
+    int number = 1;
+    int depth = 0;
+
+    while (*line) {
+        const char *end = strchr(line, '\n');
+        const char *limit = end ? end : line + strlen(line);
+        const char *p = line;
+        const char *problem = NULL;
+        bool quoted = false;
+        int parens = 0;
+
+        while (p < limit && isspace((unsigned char)*p)) {
+            p++;
+        }
+
+        /* Cut the comment, then look at what is left */
+        for (const char *q = p; q < limit; q++) {
+            if (*q == '"') {
+                quoted = !quoted;
+            } else if (!quoted && *q == '#') {
+                limit = q;
+                break;
+            } else if (!quoted && *q == '(') {
+                parens++;
+            } else if (!quoted && *q == ')' && --parens < 0) {
+                break;
+            }
+        }
+        if (quoted) {
+            problem = "unterminated string";
+        } else if (parens != 0) {
+            problem = "unbalanced parentheses";
+        } else if (*p == '$' && p < limit && !assignment_name(p, limit)) {
+            problem = "expected $name = value";
+        } else if (starts_with_word(p, limit, "if") || starts_with_word(p, limit, "ifdef") ||
+                   starts_with_word(p, limit, "ifndef")) {
+            depth++;
+        } else if (starts_with_word(p, limit, "endif") && --depth < 0) {
+            problem = "endif without if";
+        }
+
+        if (problem) {
+            log_error("%s:%d: %s\n", path, number, problem);
+            return false;
+        }
+        if (!end) {
+            break;
+        }
+        line = end + 1;
+        number++;
+    }
+
+    if (depth > 0) {
+        log_error("%s: if without endif\n", path);
+        return false;
+    }
+    return true;
+}
+
+static bool append(char **buffer, size_t *length, size_t *capacity, const char *text,
+                   size_t text_length) {
+    if (*length + text_length + 1 > *capacity) {
+        size_t grown = (*length + text_length + 1) * 2;
+        char *bigger = realloc(*buffer, grown);
+
+        if (!bigger) {
+            return false;
+        }
+        *buffer = bigger;
+        *capacity = grown;
+    }
+    memcpy(*buffer + *length, text, text_length);
+    *length += text_length;
+    (*buffer)[*length] = '\0';
+    return true;
+}
+
+/* The source with overridden assignments commented out and the settings after it */
+static char *merge(const char *text, const DosemurcSettings *settings, const char *drive,
+                   size_t *length) {
+    static const char commented[] = "# replaced by the GUI settings below: ";
+    size_t capacity = strlen(text) + 512;
+    char *merged = malloc(capacity);
+    const char *line = text;
+    char value[PATH_MAX + 32];
+    bool ok = merged != NULL;
+
+    *length = 0;
+    if (merged) {
+        merged[0] = '\0';
+    }
+
+    while (ok && *line) {
+        const char *end = strchr(line, '\n');
+        const char *limit = end ? end + 1 : line + strlen(line);
+        const char *p = line;
+        size_t name_length;
+
+        while (p < limit && (*p == ' ' || *p == '\t')) {
+            p++;
+        }
+        name_length = assignment_name(p, limit);
+        for (size_t i = 0; name_length && i < sizeof(managed_names) / sizeof(*managed_names); i++) {
+            if (name_length - 1 == strlen(managed_names[i]) &&
+                strncmp(p + 1, managed_names[i], name_length - 1) == 0 &&
+                overrides(settings, drive, i)) {
+                ok = append(&merged, length, &capacity, commented, sizeof(commented) - 1);
+                break;
+            }
+        }
+        ok = ok && append(&merged, length, &capacity, line, (size_t)(limit - line));
+        line = limit;
+    }
+    if (ok && *length > 0 && merged[*length - 1] != '\n') {
+        ok = append(&merged, length, &capacity, "\n", 1);
+    }
+
+    ok = ok && append(&merged, length, &capacity, "\n# Settings from the dosemu2 GUI\n", 33);
+    if (ok && settings->memory_kb > 0) {
+        snprintf(value, sizeof(value), "$_dpmi = (%d)\n", settings->memory_kb);
+        ok = append(&merged, length, &capacity, value, strlen(value));
+    }
+    if (ok && settings->xms_kb > 0) {
+        snprintf(value, sizeof(value), "$_xms = (%d)\n", settings->xms_kb);
+        ok = append(&merged, length, &capacity, value, strlen(value));
+    }
+    if (ok && settings->ems_kb > 0) {
+        snprintf(value, sizeof(value), "$_ems = (%d)\n", settings->ems_kb);
+        ok = append(&merged, length, &capacity, value, strlen(value));
+    }
+    if (ok && settings->console) {
+        ok = append(&merged, length, &capacity, "$_console = (on)\n", 17);
+    }
+    if (ok && settings->vga) {
+        ok = append(&merged, length, &capacity, "$_video = \"vga\"\n", 16);
+    }
+    if (ok && *drive) {
+        snprintf(value, sizeof(value), "$_hdimage = \"%s\"\n", drive);
+        ok = append(&merged, length, &capacity, value, strlen(value));
+    }
+
+    if (!ok) {
+        free(merged);
+        return NULL;
+    }
+    return merged;
+}
+
+/* FNV-1a, which is plenty to name files whose content is compared by hash only */
+static uint64_t hash_text(const char *text, size_t length) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (uint8_t)text[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/* <runtime dir>/dosemu2-gui/config, created on first use; tmpfs where there is one */
+static bool cache_directory(char *path, size_t size) {
+    const char *runtime = getenv("XDG_RUNTIME_DIR");
+    char parent[PATH_MAX];
+    struct stat info;
+
+    if (!runtime || !*runtime) {
+        runtime = stat("/dev/shm", &info) == 0 && S_ISDIR(info.st_mode) ? "/dev/shm" : "/tmp";
+    }
+    snprintf(parent, sizeof(parent), "%s/dosemu2-gui", runtime);
+    snprintf(path, size, "%s/" DOSEMURC_CACHE_SUBDIR, runtime);
+    if ((mkdir(parent, 0700) != 0 && errno != EEXIST) ||
+        (mkdir(path, 0700) != 0 && errno != EEXIST)) {
+        log_error("Cannot create %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+/* Whether the file at path holds exactly text; a 64-bit name alone can collide */
+static bool same_contents(const char *path, const char *text, size_t length) {
+    char buffer[4096];
+    size_t compared = 0;
+    ssize_t got;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) {
+        return false;
+    }
+    while ((got = read(fd, buffer, sizeof(buffer))) != 0) {
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0 || (size_t)got > length - compared ||
+            memcmp(buffer, text + compared, (size_t)got) != 0) {
+            break;
+        }
+        compared += (size_t)got;
+    }
+    close(fd);
+    return got == 0 && compared == length;
+}
+
+/* Store text under its hash unless an identical file is already there */
+static bool store(const char *text, size_t length, char *path, size_t size) {
+    char directory[PATH_MAX];
+    char temporary[PATH_MAX + 32];
+    struct stat info;
+    size_t done = 0;
+    int fd;
+
+    if (!cache_directory(directory, sizeof(directory))) {
+        return false;
+    }
+    snprintf(path, size, "%s/%016llx.conf", directory,
+             (unsigned long long)hash_text(text, length));
+    if (stat(path, &info) == 0 && (size_t)info.st_size == length &&
+        same_contents(path, text, length)) {
+        stats.reused++;
+        return true;
+    }
+
+    /* Written aside and renamed, so DOSEmu never reads half a file */
+    snprintf(temporary, sizeof(temporary), "%s.%d.tmp", path, (int)getpid());
+    fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    while (fd >= 0 && done < length) {
+        ssize_t written = write(fd, text + done, length - done);
+
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            break;
+        }
+        done += (size_t)written;
+    }
+    if (fd < 0 || close(fd) != 0 || done < length || rename(temporary, path) != 0) {
+        log_error("Cannot write DOSEmu config %s: %s\n", path, strerror(errno));
+        unlink(temporary);
+        return false;
+    }
+    stats.generated++;
+    return true;
+}
+
+static CacheEntry *find_entry(int source, const DosemurcSettings *settings, const char *drive) {
+    for (int i = 0; i < DOSEMURC_CACHE_ENTRIES; i++) {
+        if (cache[i].used && cache[i].source == source &&
+            settings_equal(&cache[i].settings, settings) && strcmp(cache[i].drive, drive) == 0) {
+            return &cache[i];
+        }
+    }
+    return NULL;
+}
+
+static void notify_change(const char *source) {
+    for (int i = 0; i < change_callback_count; i++) {
+        change_callbacks[i](source, change_callback_data[i]);
+    }
+}
+
+void dosemurc_configure(const DosemurcSettings *settings) {
+    if (settings_equal(settings, &current_settings)) {
+        return;
+    }
+    current_settings = *settings;
+    notify_change("");
+}
+
+bool dosemurc_launch_config(const char *config_path, const char *drive, char *path,
+                            size_t path_size, char *source_path, size_t source_size) {
+    char resolved[PATH_MAX];
+    bool required;
+    int source;
+    CacheEntry *entry;
+    struct stat info;
+    char *text, *merged;
+    size_t length;
+    bool ok;
+
+    path[0] = '\0';
+    source_path[0] = '\0';
+    if (!drive) {
+        drive = "";
+    }
+    /* $_hdimage is a list split on spaces */
+    if (strpbrk(drive, " \t\"\n") || strlen(drive) >= PATH_MAX) {
+        log_error("DOS drive path cannot be used in a DOSEmu config: %s\n", drive);
+        return false;
+    }
+    if (!resolve_source(config_path, resolved, sizeof(resolved), &required) ||
+        !validate_settings(&current_settings)) {
+        return false;
+    }
+    snprintf(source_path, source_size, "%s", resolved);
+
+    /* Nothing changed since this exact config was validated and written */
+    source = find_source(resolved);
+    entry = source >= 0 ? find_entry(source, &current_settings, drive) : NULL;
+    if (entry && (!entry->path[0] || stat(entry->path, &info) == 0)) {
+        snprintf(path, path_size, "%s", entry->path);
+        stats.hits++;
+        return true;
+    }
+
+    text = read_source(resolved, required, &length);
+    if (!text) {
+        return false;
+    }
+    ok = validate_source(resolved, text);
+    if (ok && (!settings_empty(&current_settings) || *drive)) {
+        merged = merge(text, &current_settings, drive, &length);
+        ok = merged && store(merged, length, path, path_size);
+        free(merged);
+    }
+    free(text);
+    if (!ok || source < 0) {
+        return ok;
+    }
+
+    if (!entry) {
+        entry = &cache[cache_next];
+        cache_next = (cache_next + 1) % DOSEMURC_CACHE_ENTRIES;
+    }
+    entry->used = true;
+    entry->source = source;
+    entry->settings = current_settings;
+    snprintf(entry->drive, sizeof(entry->drive), "%s", drive);
+    snprintf(entry->path, sizeof(entry->path), "%s", path);
+    return true;
+}
+
+/* Forget what was built from a changed file and tell whoever launched from it */
+static void invalidate(Source *source) {
+    int index = (int)(source - sources);
+
+    for (int i = 0; i < DOSEMURC_CACHE_ENTRIES; i++) {
+        if (cache[i].used && cache[i].source == index) {
+            cache[i].used = false;
+            stats.invalidated++;
+        }
+    }
+    log_message("DOSEmu config %s changed\n", source->path);
+    notify_change(source->path);
+}
+
+/* UI thread: match changed names against the sources */
+static void deliver_changes(void *data) {
+    ChangeBatch *batch = data;
+
+    for (int i = 0; i < batch->count; i++) {
+        for (int j = 0; j < source_count; j++) {
+            if (sources[j].wd == batch->names[i].wd &&
+                strcmp(sources[j].name, batch->names[i].name) == 0) {
+                sources[j].changed = true;
+            }
+        }
+    }
+    /* A save usually shows up as several events; report each file once */
+    for (int j = 0; j < source_count; j++) {
+        if (sources[j].changed) {
+            sources[j].changed = false;
+            invalidate(&sources[j]);
+        }
+    }
+    free(batch);
+}
+
+/* I/O thread: pass the names on; the source table belongs to the UI thread */
+static void on_inotify(int fd, uint32_t events, void *data) {
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+
+    while ((len = read(fd, buffer, sizeof(buffer))) > 0) {
+        size_t most = (size_t)len / sizeof(struct inotify_event) + 1;
+        ChangeBatch *batch = malloc(sizeof(*batch) + most * sizeof(ChangedName));
+
+        if (!batch) {
+            return;
+        }
+        batch->count = 0;
+        for (char *p = buffer; p < buffer + len;) {
+            struct inotify_event *event = (struct inotify_event *)p;
+            p += sizeof(*event) + event->len;
+
+            if (event->len > 0) {
+                batch->names[batch->count].wd = event->wd;
+                snprintf(batch->names[batch->count].name, sizeof(batch->names[0].name), "%s",
+                         event->name);
+                batch->count++;
+            }
+        }
+        main_queue(deliver_changes, batch);
+    }
+}
+
+bool dosemurc_add_change_callback(dosemurc_change_callback callback, void *data) {
+    if (change_callback_count == DOSEMURC_MAX_CALLBACKS) {
+        log_error("Too many DOSEmu config change callbacks (limit %d)\n", DOSEMURC_MAX_CALLBACKS);
+        return false;
+    }
+    change_callbacks[change_callback_count] = callback;
+    change_callback_data[change_callback_count] = data;
+    change_callback_count++;
+    return true;
+}
+
+void dosemurc_stats(DosemurcStats *out) {
+    *out = stats;
+}
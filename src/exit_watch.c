@@ -0,0 +1,148 @@
+#define _GNU_SOURCE
+
+#include "../include/exit_watch.h"
+#include "../include/io_loop.h"
+#include "../include/pidfd.h"
+#include "../include/headless.h"
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <errno.h>
+
+struct ExitWatch {
+    pid_t pid;
+    exit_callback callback;
+    void *data;
+
+    /* I/O thread state */
+    int pid_fd;
+    int poll_id;
+
+    /* UI thread state */
+    bool released;
+
+    /* Result, handed to the UI thread */
+    ExitInfo info;
+};
+
+static double timeval_ms(const struct timeval *tv) {
+    return (double)tv->tv_sec * 1000.0 + (double)tv->tv_usec / 1000.0;
+}
+
+static void deliver_exit(void *data) {
+    ExitWatch *watch = data;
+
+    if (!watch->released) {
+        watch->callback(&watch->info, watch->data);
+    }
+    free(watch);
+}
+
+static void teardown(ExitWatch *watch) {
+    if (watch->pid_fd >= 0) {
+        io_loop_remove_fd(watch->pid_fd);
+        close(watch->pid_fd);
+        watch->pid_fd = -1;
+    }
+    if (watch->poll_id >= 0) {
+        io_loop_cancel_timeout(watch->poll_id);
+        watch->poll_id = -1;
+    }
+}
+
+/* Reap the child if it has exited; true once the watch is finished */
+static bool try_reap(ExitWatch *watch) {
+    struct rusage usage;
+    int status;
+    pid_t result;
+
+    memset(&usage, 0, sizeof(usage));
+    do {
+        result = wait4(watch->pid, &status, WNOHANG, &usage);
+    } while (result < 0 && errno == EINTR);
+
+    if (result == 0) {
+        return false;
+    }
+
+    watch->info.pid = watch->pid;
+    if (result < 0) {
+        /* ECHILD: someone else reaped it, so its status is gone */
+        watch->info.status = -1;
+    } else if (WIFEXITED(status)) {
+        watch->info.status = WEXITSTATUS(status);
+    } else if (WIFSIGNALED(status)) {
+        watch->info.signal = WTERMSIG(status);
+        watch->info.status = 128 + watch->info.signal;
+    } else {
+        return false;
+    }
+    watch->info.user_ms = timeval_ms(&usage.ru_utime);
+    watch->info.system_ms = timeval_ms(&usage.ru_stime);
+    watch->info.max_rss_kb = usage.ru_maxrss;
+
+    teardown(watch);
+    main_queue(deliver_exit, watch);
+    return true;
+}
+
+static void on_pidfd(int fd, uint32_t events, void *data) {
+    try_reap(data);
+}
+
+static void on_poll(int id, uint32_t events, void *data) {
+    ExitWatch *watch = data;
+
+    watch->poll_id = -1;
+    if (!try_reap(watch)) {
+        watch->poll_id = io_loop_add_timeout(EXIT_WATCH_POLL_MS, on_poll, watch);
+    }
+}
+
+static void setup(void *data) {
+    ExitWatch *watch = data;
+
+    /* The child may be gone already */
+    if (try_reap(watch)) {
+        return;
+    }
+
+    /* pidfd becomes readable when the child exits; older kernels lack it */
+    watch->pid_fd = pidfd_open_pid(watch->pid);
+    if (watch->pid_fd >= 0 && !io_loop_add_fd(watch->pid_fd, EPOLLIN, on_pidfd, watch)) {
+        close(watch->pid_fd);
+        watch->pid_fd = -1;
+    }
+    if (watch->pid_fd < 0) {
+        watch->poll_id = io_loop_add_timeout(EXIT_WATCH_POLL_MS, on_poll, watch);
+    }
+}
+
+/* Reap pid as soon as it exits and report how it went */
+ExitWatch *exit_watch_start(pid_t pid, exit_callback callback, void *data) {
+    ExitWatch *watch = calloc(1, sizeof(*watch));
+    if (!watch) {
+        return NULL;
+    }
+
+    watch->pid = pid;
+    watch->callback = callback;
+    watch->data = data;
+    watch->pid_fd = -1;
+    watch->poll_id = -1;
+
+    if (!io_loop_post(setup, watch)) {
+        free(watch);
+        return NULL;
+    }
+
+    return watch;
+}
+
+/* Stop reporting; the pending or eventual delivery frees the watch */
+void exit_watch_release(ExitWatch *watch) {
+    if (watch) {
+        watch->released = true;
+    }
+}
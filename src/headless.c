@@ -0,0 +1,103 @@
+#define _GNU_SOURCE
+
+#include "../include/headless.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
+/* A function handed to main_queue() */
+typedef struct QueuedCall {
+    void (*fn)(void *data);
+    void *data;
+    struct QueuedCall *next;
+} QueuedCall;
+
+static bool headless = false;
+
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_ready = PTHREAD_COND_INITIALIZER;
+static QueuedCall *queue_head = NULL;
+static QueuedCall *queue_tail = NULL;
+
+static uint64_t now_ms(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+}
+
+/* Queue fn(data) for the UI thread; safe from any thread */
+void main_queue(void (*fn)(void *data), void *data) {
+    QueuedCall *call;
+
+    if (!headless) {
+        uiQueueMain(fn, data);
+        return;
+    }
+
+    call = malloc(sizeof(*call));
+    if (!call) {
+        return;
+    }
+    call->fn = fn;
+    call->data = data;
+    call->next = NULL;
+
+    pthread_mutex_lock(&queue_lock);
+    if (queue_tail) {
+        queue_tail->next = call;
+    } else {
+        queue_head = call;
+    }
+    queue_tail = call;
+    pthread_cond_signal(&queue_ready);
+    pthread_mutex_unlock(&queue_lock);
+}
+
+/* Route main_queue() to headless_run_until(); call before io_loop_start() */
+void headless_enable(void) {
+    headless = true;
+}
+
+/* Run queued work until *done is set or timeout_ms passes */
+bool headless_run_until(const bool *done, int timeout_ms) {
+    uint64_t deadline = now_ms() + (uint64_t)(timeout_ms > 0 ? timeout_ms : 0);
+
+    while (!*done) {
+        uint64_t now = now_ms();
+        QueuedCall *call;
+
+        if (now >= deadline) {
+            return false;
+        }
+
+        pthread_mutex_lock(&queue_lock);
+        if (!queue_head) {
+            struct timespec until;
+
+            /* The condition variable waits against the realtime clock */
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_sec += (time_t)((deadline - now) / 1000);
+            until.tv_nsec += (long)((deadline - now) % 1000) * 1000000;
+            if (until.tv_nsec >= 1000000000) {
+                until.tv_sec++;
+                until.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&queue_ready, &queue_lock, &until);
+        }
+        call = queue_head;
+        if (call) {
+            queue_head = call->next;
+            if (!queue_head) {
+                queue_tail = NULL;
+            }
+        }
+        pthread_mutex_unlock(&queue_lock);
+
+        if (call) {
+            call->fn(call->data);
+            free(call);
+        }
+    }
+    return true;
+}
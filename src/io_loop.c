@@ -0,0 +1,406 @@
+#define _GNU_SOURCE
+
+#include "../include/io_loop.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+
+#define MAX_EVENTS 64
+
+/* A registered descriptor; freed only after the current dispatch round */
+typedef struct IoWatch {
+    int fd;
+    io_fd_callback callback;
+    void *data;
+    struct IoWatch *next_dead;
+} IoWatch;
+
+/* A pending io_loop_add_timeout() */
+typedef struct IoTimeout {
+    io_fd_callback callback;
+    void *data;
+} IoTimeout;
+
+/* A function queued for the I/O thread */
+typedef struct IoPosted {
+    void (*fn)(void *data);
+    void *data;
+    struct IoPosted *next;
+} IoPosted;
+
+/* State for io_loop_call() */
+typedef struct IoCall {
+    void (*fn)(void *data);
+    void *data;
+    int done;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} IoCall;
+
+static int epoll_fd = -1;
+static int wake_fd = -1;
+static pthread_t loop_thread;
+static int loop_started = 0;
+static int loop_running = 0;
+
+/* Watches indexed by fd; only touched on the I/O thread */
+static IoWatch **watches = NULL;
+static int watch_capacity = 0;
+static IoWatch *dead_watches = NULL;
+
+/* Posted function queue, shared with other threads */
+static pthread_mutex_t posted_lock = PTHREAD_MUTEX_INITIALIZER;
+static IoPosted *posted_head = NULL;
+static IoPosted *posted_tail = NULL;
+
+/* Run everything that was posted before we woke up */
+static void run_posted(void) {
+    uint64_t counter;
+    IoPosted *item;
+
+    if (read(wake_fd, &counter, sizeof(counter)) < 0 && errno != EAGAIN) {
+        fprintf(stderr, "io_loop: wake read failed: %s\n", strerror(errno));
+    }
+
+    pthread_mutex_lock(&posted_lock);
+    item = posted_head;
+    posted_head = posted_tail = NULL;
+    pthread_mutex_unlock(&posted_lock);
+
+    while (item) {
+        IoPosted *next = item->next;
+        item->fn(item->data);
+        free(item);
+        item = next;
+    }
+}
+
+static void free_dead_watches(void) {
+    while (dead_watches) {
+        IoWatch *next = dead_watches->next_dead;
+        free(dead_watches);
+        dead_watches = next;
+    }
+}
+
+static void *io_loop_main(void *arg) {
+    struct epoll_event events[MAX_EVENTS];
+
+    while (loop_running) {
+        int count = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "io_loop: epoll_wait failed: %s\n", strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < count; i++) {
+            IoWatch *watch = events[i].data.ptr;
+
+            if (watch == NULL) {
+                run_posted();
+            } else if (watch->callback) {
+                /* Removed watches keep a NULL callback until freed below */
+                watch->callback(watch->fd, events[i].events, watch->data);
+            }
+        }
+
+        free_dead_watches();
+    }
+
+    return NULL;
+}
+
+static void request_stop(void *data) {
+    loop_running = 0;
+}
+
+/* Start the I/O thread */
+bool io_loop_start(void) {
+    struct epoll_event event = {0};
+
+    if (loop_started) {
+        return true;
+    }
+
+    /* Writes to a dead child must surface as EPIPE, not kill the GUI */
+    signal(SIGPIPE, SIG_IGN);
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        fprintf(stderr, "io_loop: epoll_create1 failed: %s\n", strerror(errno));
+        return false;
+    }
+
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd < 0) {
+        fprintf(stderr, "io_loop: eventfd failed: %s\n", strerror(errno));
+        close(epoll_fd);
+        epoll_fd = -1;
+        return false;
+    }
+
+    event.events = EPOLLIN;
+    event.data.ptr = NULL;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event);
+
+    loop_running = 1;
+    if (pthread_create(&loop_thread, NULL, io_loop_main, NULL) != 0) {
+        fprintf(stderr, "io_loop: cannot create I/O thread\n");
+        loop_running = 0;
+        close(wake_fd);
+        close(epoll_fd);
+        wake_fd = epoll_fd = -1;
+        return false;
+    }
+
+    loop_started = 1;
+    return true;
+}
+
+/* Stop the I/O thread */
+void io_loop_stop(void) {
+    if (!loop_started) {
+        return;
+    }
+
+    io_loop_post(request_stop, NULL);
+    pthread_join(loop_thread, NULL);
+    loop_started = 0;
+
+    /* Drop anything posted after the stop request */
+    while (posted_head) {
+        IoPosted *next = posted_head->next;
+        free(posted_head);
+        posted_head = next;
+    }
+    posted_tail = NULL;
+
+    for (int fd = 0; fd < watch_capacity; fd++) {
+        free(watches[fd]);
+    }
+    free(watches);
+    watches = NULL;
+    watch_capacity = 0;
+
+    close(wake_fd);
+    close(epoll_fd);
+    wake_fd = epoll_fd = -1;
+}
+
+/* Check whether the caller is running on the I/O thread */
+bool io_loop_is_current(void) {
+    return loop_started && pthread_equal(pthread_self(), loop_thread);
+}
+
+/* Watch fd for the given epoll events */
+bool io_loop_add_fd(int fd, uint32_t events, io_fd_callback callback, void *data) {
+    struct epoll_event event = {0};
+    IoWatch *watch;
+
+    if (fd < 0) {
+        return false;
+    }
+
+    if (fd >= watch_capacity) {
+        int new_capacity = watch_capacity ? watch_capacity : 64;
+        while (new_capacity <= fd) {
+            new_capacity *= 2;
+        }
+
+        IoWatch **grown = realloc(watches, (size_t)new_capacity * sizeof(*grown));
+        if (!grown) {
+            return false;
+        }
+        memset(grown + watch_capacity, 0,
+               (size_t)(new_capacity - watch_capacity) * sizeof(*grown));
+        watches = grown;
+        watch_capacity = new_capacity;
+    }
+
+    if (watches[fd]) {
+        return false;
+    }
+
+    watch = calloc(1, sizeof(*watch));
+    if (!watch) {
+        return false;
+    }
+    watch->fd = fd;
+    watch->callback = callback;
+    watch->data = data;
+
+    event.events = events;
+    event.data.ptr = watch;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+        free(watch);
+        return false;
+    }
+
+    watches[fd] = watch;
+    return true;
+}
+
+/* Change the epoll events of a watched fd */
+bool io_loop_modify_fd(int fd, uint32_t events) {
+    struct epoll_event event = {0};
+
+    if (fd < 0 || fd >= watch_capacity || !watches[fd]) {
+        return false;
+    }
+
+    event.events = events;
+    event.data.ptr = watches[fd];
+    return epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event) == 0;
+}
+
+/* Stop watching fd; the fd itself is not closed */
+void io_loop_remove_fd(int fd) {
+    IoWatch *watch;
+
+    if (fd < 0 || fd >= watch_capacity || !watches[fd]) {
+        return;
+    }
+
+    watch = watches[fd];
+    watches[fd] = NULL;
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+
+    /* Events for this watch may still be pending in the current round */
+    watch->callback = NULL;
+    watch->next_dead = dead_watches;
+    dead_watches = watch;
+}
+
+static void on_timeout_expired(int fd, uint32_t events, void *data) {
+    IoTimeout timeout = *(IoTimeout *)data;
+
+    /* One-shot: tear down before the callback so it may add a new one */
+    io_loop_cancel_timeout(fd);
+    timeout.callback(fd, events, timeout.data);
+}
+
+/* Arm a one-shot timeout */
+int io_loop_add_timeout(int milliseconds, io_fd_callback callback, void *data) {
+    struct itimerspec spec = {0};
+    IoTimeout *timeout;
+    int fd;
+
+    fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (milliseconds <= 0) {
+        /* A zero it_value would disarm the timer */
+        spec.it_value.tv_nsec = 1;
+    } else {
+        spec.it_value.tv_sec = milliseconds / 1000;
+        spec.it_value.tv_nsec = (long)(milliseconds % 1000) * 1000000L;
+    }
+
+    timeout = malloc(sizeof(*timeout));
+    if (!timeout || timerfd_settime(fd, 0, &spec, NULL) != 0 ||
+        !io_loop_add_fd(fd, EPOLLIN, on_timeout_expired, timeout)) {
+        free(timeout);
+        close(fd);
+        return -1;
+    }
+    timeout->callback = callback;
+    timeout->data = data;
+
+    return fd;
+}
+
+/* Cancel a timeout that has not fired yet */
+void io_loop_cancel_timeout(int id) {
+    if (id < 0 || id >= watch_capacity || !watches[id] ||
+        watches[id]->callback != on_timeout_expired) {
+        return;
+    }
+
+    free(watches[id]->data);
+    io_loop_remove_fd(id);
+    close(id);
+}
+
+/* Run fn(data) on the I/O thread */
+bool io_loop_post(void (*fn)(void *data), void *data) {
+    uint64_t one = 1;
+    IoPosted *item;
+
+    if (!loop_started) {
+        return false;
+    }
+
+    item = malloc(sizeof(*item));
+    if (!item) {
+        return false;
+    }
+    item->fn = fn;
+    item->data = data;
+    item->next = NULL;
+
+    pthread_mutex_lock(&posted_lock);
+    if (posted_tail) {
+        posted_tail->next = item;
+    } else {
+        posted_head = item;
+    }
+    posted_tail = item;
+    pthread_mutex_unlock(&posted_lock);
+
+    if (write(wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        fprintf(stderr, "io_loop: wake write failed: %s\n", strerror(errno));
+    }
+    return true;
+}
+
+static void run_call(void *data) {
+    IoCall *call = data;
+
+    call->fn(call->data);
+
+    pthread_mutex_lock(&call->lock);
+    call->done = 1;
+    pthread_cond_signal(&call->cond);
+    pthread_mutex_unlock(&call->lock);
+}
+
+/* Run fn(data) on the I/O thread and wait for it */
+bool io_loop_call(void (*fn)(void *data), void *data) {
+    IoCall call;
+
+    if (io_loop_is_current()) {
+        fn(data);
+        return true;
+    }
+
+    call.fn = fn;
+    call.data = data;
+    call.done = 0;
+    pthread_mutex_init(&call.lock, NULL);
+    pthread_cond_init(&call.cond, NULL);
+
+    if (!io_loop_post(run_call, &call)) {
+        pthread_cond_destroy(&call.cond);
+        pthread_mutex_destroy(&call.lock);
+        return false;
+    }
+
+    pthread_mutex_lock(&call.lock);
+    while (!call.done) {
+        pthread_cond_wait(&call.cond, &call.lock);
+    }
+    pthread_mutex_unlock(&call.lock);
+
+    pthread_cond_destroy(&call.cond);
+    pthread_mutex_destroy(&call.lock);
+    return true;
+}
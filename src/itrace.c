@@ -0,0 +1,712 @@
+#define _GNU_SOURCE
+
+#include "../include/itrace.h"
+#include "../include/console.h"
+#include "../include/trace.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+/* Registers in the order their change bits appear in a record */
+#define REG_COUNT 16
+
+/* Flags byte of a record */
+#define RECORD_NEW_CS 0x01     /* CS follows as two bytes */
+#define RECORD_JUMP 0x02       /* IP does not follow the previous instruction */
+
+/* Flags, CS, IP delta, opcode length and bytes, change mask and every register */
+#define MAX_RECORD_BYTES (1 + 2 + 5 + 1 + ITRACE_MAX_OPCODE + 2 + REG_COUNT * 5)
+
+/* Raw size, compressed size and record count before each block */
+#define BLOCK_HEADER_BYTES 12
+
+/* Where one record leaves off, for the one after it */
+typedef struct CodecState {
+    uint16_t cs;
+    uint32_t next_ip;
+    uint32_t regs[REG_COUNT];
+} CodecState;
+
+typedef struct ItraceBlock {
+    uint8_t *data;
+    size_t used;
+    uint32_t records;
+    CodecState state;
+} ItraceBlock;
+
+struct ItraceWriter {
+    int fd;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    ItraceBlock blocks[2];
+    int filling;             /* block records are added to */
+    int queued;              /* block handed to the thread, or -1 */
+    bool stopping;
+    atomic_bool failed;
+    uint8_t *compressed;     /* thread only */
+    uLong compressed_capacity;
+    atomic_uint_fast64_t file_bytes;
+    uint64_t encoded_bytes;
+    uint64_t stalls;
+};
+
+struct ItraceReader {
+    const uint8_t *map;
+    size_t size;
+    size_t position;         /* next block header in the file */
+    uint8_t *block;
+    size_t block_used;
+    size_t block_position;
+    uint32_t block_records;
+    uint32_t block_decoded;
+    CodecState state;
+    bool failed;
+};
+
+static void regs_to_array(const DbgRegs *regs, uint32_t *values) {
+    values[0] = regs->eax;
+    values[1] = regs->ebx;
+    values[2] = regs->ecx;
+    values[3] = regs->edx;
+    values[4] = regs->esi;
+    values[5] = regs->edi;
+    values[6] = regs->ebp;
+    values[7] = regs->esp;
+    values[8] = regs->eip;
+    values[9] = regs->eflags;
+    values[10] = regs->cs;
+    values[11] = regs->ds;
+    values[12] = regs->es;
+    values[13] = regs->ss;
+    values[14] = regs->fs;
+    values[15] = regs->gs;
+}
+
+static void array_to_regs(const uint32_t *values, DbgRegs *regs) {
+    regs->eax = values[0];
+    regs->ebx = values[1];
+    regs->ecx = values[2];
+    regs->edx = values[3];
+    regs->esi = values[4];
+    regs->edi = values[5];
+    regs->ebp = values[6];
+    regs->esp = values[7];
+    regs->eip = values[8];
+    regs->eflags = values[9];
+    regs->cs = (uint16_t)values[10];
+    regs->ds = (uint16_t)values[11];
+    regs->es = (uint16_t)values[12];
+    regs->ss = (uint16_t)values[13];
+    regs->fs = (uint16_t)values[14];
+    regs->gs = (uint16_t)values[15];
+}
+
+static size_t put_varint(uint8_t *out, uint32_t value) {
+    size_t length = 0;
+
+    while (value >= 0x80) {
+        out[length++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[length++] = (uint8_t)value;
+    return length;
+}
+
+static bool get_varint(const uint8_t *data, size_t size, size_t *position, uint32_t *value) {
+    uint32_t result = 0;
+
+    for (int shift = 0; shift < 35 && *position < size; shift += 7) {
+        uint8_t byte = data[(*position)++];
+
+        result |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void put_u32(uint8_t *out, uint32_t value) {
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+    out[2] = (uint8_t)(value >> 16);
+    out[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t get_u32(const uint8_t *in) {
+    return (uint32_t)in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 |
+           (uint32_t)in[3] << 24;
+}
+
+/*
+ * A record: flags, CS if it changed, the IP as a zigzag delta from the end
+ * of the previous instruction if it jumped, the opcode bytes, a mask of the
+ * registers that changed and each of them XORed with its old value.
+ */
+static size_t encode_record(CodecState *state, const ItraceRecord *record, uint8_t *out) {
+    uint32_t values[REG_COUNT];
+    uint16_t mask = 0;
+    size_t used = 1;
+    uint8_t flags = 0;
+
+    if (record->cs != state->cs) {
+        flags |= RECORD_NEW_CS;
+        out[used++] = (uint8_t)record->cs;
+        out[used++] = (uint8_t)(record->cs >> 8);
+    }
+    if (record->ip != state->next_ip) {
+        int32_t delta = (int32_t)(record->ip - state->next_ip);
+
+        flags |= RECORD_JUMP;
+        used += put_varint(out + used, (uint32_t)delta << 1 ^ (uint32_t)(delta >> 31));
+    }
+    out[0] = flags;
+
+    out[used++] = record->opcode_length;
+    memcpy(out + used, record->opcode, record->opcode_length);
+    used += record->opcode_length;
+
+    regs_to_array(&record->regs, values);
+    for (int i = 0; i < REG_COUNT; i++) {
+        if (values[i] != state->regs[i]) {
+            mask |= (uint16_t)(1u << i);
+        }
+    }
+    out[used++] = (uint8_t)mask;
+    out[used++] = (uint8_t)(mask >> 8);
+    for (int i = 0; i < REG_COUNT; i++) {
+        if (mask & (1u << i)) {
+            used += put_varint(out + used, values[i] ^ state->regs[i]);
+            state->regs[i] = values[i];
+        }
+    }
+
+    state->cs = record->cs;
+    state->next_ip = record->ip + record->opcode_length;
+    return used;
+}
+
+static bool decode_record(CodecState *state, const uint8_t *data, size_t size, size_t *position,
+                          ItraceRecord *record) {
+    uint8_t flags;
+    uint16_t mask;
+
+    if (*position >= size) {
+        return false;
+    }
+    flags = data[(*position)++];
+
+    record->cs = state->cs;
+    if (flags & RECORD_NEW_CS) {
+        if (size - *position < 2) {
+            return false;
+        }
+        record->cs = (uint16_t)(data[*position] | data[*position + 1] << 8);
+        *position += 2;
+    }
+    record->ip = state->next_ip;
+    if (flags & RECORD_JUMP) {
+        uint32_t zigzag;
+
+        if (!get_varint(data, size, position, &zigzag)) {
+            return false;
+        }
+        record->ip += (zigzag >> 1) ^ (uint32_t)-(int32_t)(zigzag & 1);
+    }
+
+    if (*position >= size || data[*position] > ITRACE_MAX_OPCODE ||
+        size - *position - 1 < data[*position]) {
+        return false;
+    }
+    record->opcode_length = data[(*position)++];
+    memcpy(record->opcode, data + *position, record->opcode_length);
+    memset(record->opcode + record->opcode_length, 0, ITRACE_MAX_OPCODE - record->opcode_length);
+    *position += record->opcode_length;
+
+    if (size - *position < 2) {
+        return false;
+    }
+    mask = (uint16_t)(data[*position] | data[*position + 1] << 8);
+    *position += 2;
+    for (int i = 0; i < REG_COUNT; i++) {
+        uint32_t change;
+
+        if (!(mask & (1u << i))) {
+            continue;
+        }
+        if (!get_varint(data, size, position, &change)) {
+            return false;
+        }
+        state->regs[i] ^= change;
+    }
+    array_to_regs(state->regs, &record->regs);
+
+    state->cs = record->cs;
+    state->next_ip = record->ip + record->opcode_length;
+    return true;
+}
+
+static bool write_all(int fd, const uint8_t *data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+    return true;
+}
+
+/* Deflate one block and append it; writer thread */
+static void write_block(ItraceWriter *writer, const ItraceBlock *block) {
+    uLongf compressed_length = writer->compressed_capacity - BLOCK_HEADER_BYTES;
+    uint8_t *header = writer->compressed;
+
+    if (compress2(writer->compressed + BLOCK_HEADER_BYTES, &compressed_length, block->data,
+                  (uLong)block->used, Z_BEST_SPEED) != Z_OK) {
+        atomic_store(&writer->failed, true);
+        return;
+    }
+    put_u32(header, (uint32_t)block->used);
+    put_u32(header + 4, (uint32_t)compressed_length);
+    put_u32(header + 8, block->records);
+
+    if (!write_all(writer->fd, writer->compressed, BLOCK_HEADER_BYTES + compressed_length)) {
+        atomic_store(&writer->failed, true);
+        return;
+    }
+    atomic_fetch_add(&writer->file_bytes, BLOCK_HEADER_BYTES + compressed_length);
+}
+
+static void reset_block(ItraceBlock *block) {
+    block->used = 0;
+    block->records = 0;
+    memset(&block->state, 0, sizeof(block->state));
+}
+
+static void *writer_main(void *data) {
+    ItraceWriter *writer = data;
+
+    pthread_mutex_lock(&writer->lock);
+    for (;;) {
+        ItraceBlock *block;
+
+        while (writer->queued < 0 && !writer->stopping) {
+            pthread_cond_wait(&writer->cond, &writer->lock);
+        }
+        if (writer->queued < 0) {
+            break;
+        }
+        block = &writer->blocks[writer->queued];
+        pthread_mutex_unlock(&writer->lock);
+
+        write_block(writer, block);
+        reset_block(block);
+
+        pthread_mutex_lock(&writer->lock);
+        writer->queued = -1;
+        pthread_cond_broadcast(&writer->cond);
+    }
+    pthread_mutex_unlock(&writer->lock);
+    return NULL;
+}
+
+/* Give the filled block to the thread and carry on in the other one */
+static void hand_off(ItraceWriter *writer) {
+    pthread_mutex_lock(&writer->lock);
+    if (writer->queued >= 0) {
+        writer->stalls++;
+    }
+    while (writer->queued >= 0) {
+        pthread_cond_wait(&writer->cond, &writer->lock);
+    }
+    writer->queued = writer->filling;
+    writer->filling ^= 1;
+    pthread_cond_signal(&writer->cond);
+    pthread_mutex_unlock(&writer->lock);
+}
+
+ItraceWriter *itrace_writer_open(const char *path) {
+    ItraceWriter *writer = calloc(1, sizeof(*writer));
+
+    if (!writer) {
+        return NULL;
+    }
+    writer->queued = -1;
+    writer->compressed_capacity = compressBound(ITRACE_BLOCK_BYTES) + BLOCK_HEADER_BYTES;
+    writer->compressed = malloc(writer->compressed_capacity);
+    writer->blocks[0].data = malloc(ITRACE_BLOCK_BYTES);
+    writer->blocks[1].data = malloc(ITRACE_BLOCK_BYTES);
+    writer->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if (!writer->compressed || !writer->blocks[0].data || !writer->blocks[1].data ||
+        writer->fd < 0 ||
+        !write_all(writer->fd, (const uint8_t *)ITRACE_MAGIC, strlen(ITRACE_MAGIC))) {
+        log_error("Cannot write instruction trace %s: %s\n", path, strerror(errno));
+        if (writer->fd >= 0) {
+            close(writer->fd);
+        }
+        free(writer->compressed);
+        free(writer->blocks[0].data);
+        free(writer->blocks[1].data);
+        free(writer);
+        return NULL;
+    }
+    atomic_store(&writer->file_bytes, strlen(ITRACE_MAGIC));
+
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->cond, NULL);
+    if (pthread_create(&writer->thread, NULL, writer_main, writer) != 0) {
+        log_error("Cannot start the instruction trace writer\n");
+        close(writer->fd);
+        free(writer->compressed);
+        free(writer->blocks[0].data);
+        free(writer->blocks[1].data);
+        free(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+bool itrace_writer_add(ItraceWriter *writer, const ItraceRecord *record) {
+    ItraceBlock *block = &writer->blocks[writer->filling];
+    size_t length;
+
+    if (block->used + MAX_RECORD_BYTES > ITRACE_BLOCK_BYTES) {
+        hand_off(writer);
+        block = &writer->blocks[writer->filling];
+    }
+    length = encode_record(&block->state, record, block->data + block->used);
+    block->used += length;
+    block->records++;
+    writer->encoded_bytes += length;
+    return !atomic_load(&writer->failed);
+}
+
+bool itrace_writer_close(ItraceWriter *writer) {
+    bool ok;
+
+    if (writer->blocks[writer->filling].records > 0) {
+        hand_off(writer);
+    }
+    pthread_mutex_lock(&writer->lock);
+    writer->stopping = true;
+    pthread_cond_signal(&writer->cond);
+    pthread_mutex_unlock(&writer->lock);
+    pthread_join(writer->thread, NULL);
+
+    ok = !atomic_load(&writer->failed);
+    ok = close(writer->fd) == 0 && ok;
+    pthread_mutex_destroy(&writer->lock);
+    pthread_cond_destroy(&writer->cond);
+    free(writer->compressed);
+    free(writer->blocks[0].data);
+    free(writer->blocks[1].data);
+    free(writer);
+    return ok;
+}
+
+uint64_t itrace_writer_encoded_bytes(const ItraceWriter *writer) {
+    return writer->encoded_bytes;
+}
+
+uint64_t itrace_writer_file_bytes(const ItraceWriter *writer) {
+    return atomic_load(&writer->file_bytes);
+}
+
+uint64_t itrace_writer_stalls(const ItraceWriter *writer) {
+    return writer->stalls;
+}
+
+ItraceReader *itrace_reader_open(const char *path) {
+    ItraceReader *reader;
+    struct stat info;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    void *map;
+
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < strlen(ITRACE_MAGIC)) {
+        close(fd);
+        return NULL;
+    }
+    map = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+    madvise(map, (size_t)info.st_size, MADV_SEQUENTIAL);
+
+    reader = calloc(1, sizeof(*reader));
+    if (!reader || memcmp(map, ITRACE_MAGIC, strlen(ITRACE_MAGIC)) != 0 ||
+        !(reader->block = malloc(ITRACE_BLOCK_BYTES))) {
+        free(reader);
+        munmap(map, (size_t)info.st_size);
+        return NULL;
+    }
+    reader->map = map;
+    reader->size = (size_t)info.st_size;
+    reader->position = strlen(ITRACE_MAGIC);
+    return reader;
+}
+
+/* Inflate the next block; false at the end of the file or if it is damaged */
+static bool load_block(ItraceReader *reader) {
+    const uint8_t *header = reader->map + reader->position;
+    uLongf raw_length;
+    uint32_t compressed_length;
+
+    if (reader->size - reader->position < BLOCK_HEADER_BYTES) {
+        reader->failed = reader->position != reader->size;
+        return false;
+    }
+    raw_length = get_u32(header);
+    compressed_length = get_u32(header + 4);
+    if (raw_length > ITRACE_BLOCK_BYTES ||
+        reader->size - reader->position - BLOCK_HEADER_BYTES < compressed_length ||
+        uncompress(reader->block, &raw_length, header + BLOCK_HEADER_BYTES,
+                   compressed_length) != Z_OK ||
+        raw_length != get_u32(header)) {
+        reader->failed = true;
+        return false;
+    }
+
+    reader->position += BLOCK_HEADER_BYTES + compressed_length;
+    reader->block_used = raw_length;
+    reader->block_position = 0;
+    reader->block_records = get_u32(header + 8);
+    reader->block_decoded = 0;
+    memset(&reader->state, 0, sizeof(reader->state));
+    return true;
+}
+
+bool itrace_reader_next(ItraceReader *reader, ItraceRecord *record) {
+    if (reader->failed) {
+        return false;
+    }
+    while (reader->block_decoded == reader->block_records) {
+        if (!load_block(reader)) {
+            return false;
+        }
+    }
+    if (!decode_record(&reader->state, reader->block, reader->block_used,
+                       &reader->block_position, record)) {
+        reader->failed = true;
+        return false;
+    }
+    reader->block_decoded++;
+    return true;
+}
+
+bool itrace_reader_failed(const ItraceReader *reader) {
+    return reader->failed;
+}
+
+void itrace_reader_close(ItraceReader *reader) {
+    munmap((void *)reader->map, reader->size);
+    free(reader->block);
+    free(reader);
+}
+
+/* Tracer state; UI thread only */
+static bool running = false;
+static bool stopping = false;     /* queueing no more steps, recording those in flight */
+static unsigned generation = 0;   /* answers to an older trace are ignored */
+static int session_id = 0;
+static ItraceWriter *writer = NULL;
+static int in_flight = 0;
+static bool have_previous = false;
+static DbgRegs previous_regs;
+static uint8_t previous_code[ITRACE_MAX_OPCODE];
+static size_t previous_length = 0;
+static uint64_t instructions = 0;
+static uint64_t failed = 0;
+static uint64_t started_ns = 0;
+static uint64_t stopped_ns = 0;
+static uint64_t final_encoded_bytes = 0;
+static uint64_t final_file_bytes = 0;
+static uint64_t final_stalls = 0;
+
+/* The traced session's debugger, or NULL once it has gone away */
+static DbgClient *current_debugger(void) {
+    DosemuSession *session = dosemu_session_find(session_id);
+
+    return session && dosemu_session_state(session) == SESSION_RUNNING ?
+           dosemu_session_debugger(session) : NULL;
+}
+
+/* Close the file; resume the guest unless its debugger is gone */
+static void finish_trace(bool resume) {
+    DbgClient *debugger = resume ? current_debugger() : NULL;
+
+    if (!running) {
+        return;
+    }
+    running = false;
+    stopping = false;
+    generation++;
+    stopped_ns = trace_now();
+
+    final_encoded_bytes = itrace_writer_encoded_bytes(writer);
+    final_file_bytes = itrace_writer_file_bytes(writer);
+    final_stalls = itrace_writer_stalls(writer);
+    if (!itrace_writer_close(writer)) {
+        log_error("Instruction trace of session %d is incomplete\n", session_id);
+    }
+    writer = NULL;
+
+    if (debugger) {
+        dbg_command(debugger, "g", NULL, NULL);
+    }
+    log_message("Traced %llu instructions of session %d into %.1f KB\n",
+                (unsigned long long)instructions, session_id, final_file_bytes / 1024.0);
+}
+
+static void on_step(const char *text, void *data);
+
+/* Keep the debugger's queue topped up with single steps */
+static void queue_steps(void) {
+    DbgClient *debugger = current_debugger();
+
+    if (!debugger) {
+        finish_trace(false);
+        return;
+    }
+    /* Stopping: the guest resumes once the last step has been recorded */
+    if (stopping) {
+        if (in_flight == 0) {
+            finish_trace(true);
+        }
+        return;
+    }
+    while (in_flight < ITRACE_STEPS_AHEAD) {
+        if (!dbg_command(debugger, "t", on_step, (void *)(uintptr_t)generation)) {
+            failed++;
+            break;
+        }
+        in_flight++;
+    }
+}
+
+/*
+ * Each answer shows the registers after one more instruction and the
+ * bytes of the next one, so the record for an instruction is written when
+ * the step that executed it comes back.
+ */
+static void on_step(const char *text, void *data) {
+    unsigned step_generation = (unsigned)(uintptr_t)data;
+    DbgRegs regs;
+
+    if (step_generation != generation) {
+        return;
+    }
+    in_flight--;
+
+    /* The debugger went away */
+    if (!text) {
+        finish_trace(false);
+        return;
+    }
+
+    if (!dbg_parse_regs(text, &regs)) {
+        failed++;
+        have_previous = false;
+    } else {
+        if (have_previous) {
+            ItraceRecord record;
+
+            record.cs = previous_regs.cs;
+            record.ip = previous_regs.eip;
+            record.opcode_length = (uint8_t)previous_length;
+            memcpy(record.opcode, previous_code, previous_length);
+            record.regs = regs;
+            if (!itrace_writer_add(writer, &record)) {
+                log_error("Cannot write the instruction trace of session %d\n", session_id);
+                finish_trace(true);
+                return;
+            }
+            instructions++;
+        }
+        previous_regs = regs;
+        previous_length = dbg_parse_code(text, regs.cs, regs.eip, previous_code,
+                                         ITRACE_MAX_OPCODE);
+        have_previous = true;
+    }
+
+    queue_steps();
+}
+
+/* Start single-stepping a running session into a trace file */
+bool itrace_start(DosemuSession *session, const char *path) {
+    DbgClient *debugger;
+
+    if (!session || dosemu_session_state(session) != SESSION_RUNNING) {
+        return false;
+    }
+    finish_trace(true);
+
+    writer = itrace_writer_open(path);
+    if (!writer) {
+        return false;
+    }
+
+    generation++;
+    session_id = dosemu_session_id(session);
+    running = true;
+    in_flight = 0;
+    have_previous = false;
+    instructions = failed = 0;
+    started_ns = trace_now();
+    debugger = dosemu_session_debugger(session);
+
+    /* Where the guest is now, then the first batch of steps behind it */
+    if (!dbg_command(debugger, "r", on_step, (void *)(uintptr_t)generation)) {
+        finish_trace(false);
+        return false;
+    }
+    in_flight++;
+    queue_steps();
+
+    log_message("Tracing session %d into %s\n", session_id, path);
+    return true;
+}
+
+/* Steps already queued still execute, so record them before resuming the guest */
+void itrace_stop(void) {
+    if (!running || in_flight == 0 || !current_debugger()) {
+        finish_trace(true);
+        return;
+    }
+    stopping = true;
+}
+
+bool itrace_running(void) {
+    return running;
+}
+
+void itrace_stats(ItraceStats *stats) {
+    uint64_t end_ns = running ? trace_now() : stopped_ns;
+    double seconds = (double)(end_ns - started_ns) / 1e9;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->session_id = session_id;
+    stats->instructions = instructions;
+    stats->failed = failed;
+    stats->encoded_bytes = running ? itrace_writer_encoded_bytes(writer) : final_encoded_bytes;
+    stats->file_bytes = running ? itrace_writer_file_bytes(writer) : final_file_bytes;
+    stats->writer_stalls = running ? itrace_writer_stalls(writer) : final_stalls;
+    stats->instructions_per_second = seconds > 0.0 ? (double)instructions / seconds : 0.0;
+}
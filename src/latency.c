@@ -0,0 +1,75 @@
+#define _GNU_SOURCE
+
+#include "../include/latency.h"
+#include <math.h>
+
+/* Bucket 0 holds everything under 1 us; the last one everything beyond */
+static int bucket_for(double ms) {
+    double us = ms * 1000.0;
+    int exponent;
+    double mantissa;
+    int index;
+
+    if (!(us >= 1.0)) {
+        return 0;
+    }
+
+    /* us = mantissa * 2^exponent with mantissa in [0.5, 1) */
+    mantissa = frexp(us, &exponent);
+    index = 1 + (exponent - 1) * LATENCY_SUBBUCKETS +
+            (int)((mantissa * 2.0 - 1.0) * LATENCY_SUBBUCKETS);
+
+    return index < LATENCY_BUCKETS ? index : LATENCY_BUCKETS - 1;
+}
+
+/* Upper bound of a bucket in milliseconds */
+static double bucket_limit(int index) {
+    int octave, sub;
+
+    if (index == 0) {
+        return 0.001;
+    }
+    octave = (index - 1) / LATENCY_SUBBUCKETS;
+    sub = (index - 1) % LATENCY_SUBBUCKETS;
+    return ldexp(1.0 + (double)(sub + 1) / LATENCY_SUBBUCKETS, octave) / 1000.0;
+}
+
+/* Add one duration */
+void latency_record(LatencyHistogram *histogram, double ms) {
+    histogram->counts[bucket_for(ms)]++;
+    histogram->total++;
+    histogram->sum_ms += ms;
+    if (ms > histogram->max_ms) {
+        histogram->max_ms = ms;
+    }
+}
+
+/* Duration below which the given fraction (0..1) of samples fall */
+double latency_percentile(const LatencyHistogram *histogram, double fraction) {
+    uint64_t rank, seen = 0;
+
+    if (histogram->total == 0) {
+        return 0.0;
+    }
+
+    rank = (uint64_t)ceil(fraction * (double)histogram->total);
+    if (rank == 0) {
+        rank = 1;
+    }
+
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += histogram->counts[i];
+        if (seen >= rank) {
+            /* Never report more than was actually observed; the last bucket has no bound */
+            double limit = bucket_limit(i);
+            return limit < histogram->max_ms && i < LATENCY_BUCKETS - 1 ? limit
+                                                                        : histogram->max_ms;
+        }
+    }
+    return histogram->max_ms;
+}
+
+/* Mean of all samples, or 0 if there are none */
+double latency_mean(const LatencyHistogram *histogram) {
+    return histogram->total ? histogram->sum_ms / (double)histogram->total : 0.0;
+}
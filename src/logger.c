@@ -0,0 +1,943 @@
+#define _GNU_SOURCE
+
+#include "../include/logger.h"
+#include "../include/console.h"
+#include "../include/trace.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/eventfd.h>
+
+/* Record bytes each queue slot carries after its sequence number */
+#define LOG_SLOT_PAYLOAD 56
+
+/* Open-addressing table from format address to id */
+#define LOG_FORMAT_HASH (2 * LOG_MAX_FORMATS)
+
+/* Longest line the logger thread formats */
+#define LOG_MAX_TEXT 8192
+
+/* Binary log file: this magic, then entries of a kind byte and a length-prefixed body */
+static const char file_magic[8] = "DGLOG1\n";
+
+enum {
+    ENTRY_CLOCK = 1,     /* realtime and monotonic ns when the file was opened */
+    ENTRY_FORMAT = 2,    /* format id and text, before the first record using it */
+    ENTRY_RECORD = 3,    /* an encoded record, as queued */
+    ENTRY_DROPPED = 4    /* records lost to a full queue so far */
+};
+
+/* Record header: length, timestamp, format id, session id, level */
+#define RECORD_HEADER (2 + 8 + 4 + 4 + 1)
+
+/* How a conversion's argument is stored; integers and doubles take 8 bytes */
+typedef enum ArgKind {
+    ARG_INT,
+    ARG_LONG,
+    ARG_LLONG,
+    ARG_SIZE,
+    ARG_INTMAX,
+    ARG_PTRDIFF,
+    ARG_DOUBLE,
+    ARG_POINTER,
+    ARG_STRING          /* 16-bit length, then the bytes */
+} ArgKind;
+
+typedef struct Conversion {
+    ArgKind kind;
+    bool star_width;
+    bool star_precision;
+    int precision;      /* literal precision of a string, or -1 */
+    char spec[16];      /* for snprintf; a string's always takes ".*" */
+} Conversion;
+
+typedef struct LogFormat {
+    const char *text;
+    int count;
+    Conversion conversions[LOG_MAX_ARGS];
+} LogFormat;
+
+typedef struct Slot {
+    _Atomic uint64_t seq;
+    uint8_t payload[LOG_SLOT_PAYLOAD];
+} Slot;
+
+/* Bounded MPSC queue; a record takes consecutive slots */
+static Slot queue[LOG_QUEUE_SLOTS];
+static _Atomic uint64_t queue_tail = 0;
+static uint64_t queue_head = 0;             /* logger thread only */
+static _Atomic uint64_t dropped = 0;
+
+/* Formats by id, found by address through the hash */
+static LogFormat formats[LOG_MAX_FORMATS];
+static int format_count = 0;
+static const char *_Atomic format_keys[LOG_FORMAT_HASH];
+static int format_ids[LOG_FORMAT_HASH];
+static pthread_mutex_t format_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Stands in for formats that cannot be deferred; the text is formatted up front */
+static const char eager_format[] = "%s";
+static int eager_id = -1;
+
+/* Logger thread */
+static pthread_once_t logger_once = PTHREAD_ONCE_INIT;
+static pthread_t logger_thread;
+static bool logger_running = false;
+static atomic_bool logger_stopping = false;
+static atomic_bool logger_sleeping = false;
+static int wake_fd = -1;
+static pthread_mutex_t inline_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Progress, for logger_flush() */
+static pthread_mutex_t done_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static uint64_t done_pos = 0;
+
+/* Binary log file; written by the logger thread */
+static pthread_mutex_t file_lock = PTHREAD_MUTEX_INITIALIZER;
+static FILE *log_file = NULL;
+static bool file_known[LOG_MAX_FORMATS];
+static uint64_t file_dropped = 0;
+
+/* Bounds-checked reading of encoded records, which may come from a file */
+typedef struct Reader {
+    const uint8_t *p;
+    const uint8_t *end;
+    bool ok;
+} Reader;
+
+static uint64_t read_u64(Reader *reader) {
+    uint64_t value = 0;
+
+    if (reader->end - reader->p < 8) {
+        reader->ok = false;
+        reader->p = reader->end;
+        return 0;
+    }
+    memcpy(&value, reader->p, 8);
+    reader->p += 8;
+    return value;
+}
+
+static uint32_t read_u32(Reader *reader) {
+    uint32_t value = 0;
+
+    if (reader->end - reader->p < 4) {
+        reader->ok = false;
+        reader->p = reader->end;
+        return 0;
+    }
+    memcpy(&value, reader->p, 4);
+    reader->p += 4;
+    return value;
+}
+
+static uint16_t read_u16(Reader *reader) {
+    uint16_t value = 0;
+
+    if (reader->end - reader->p < 2) {
+        reader->ok = false;
+        reader->p = reader->end;
+        return 0;
+    }
+    memcpy(&value, reader->p, 2);
+    reader->p += 2;
+    return value;
+}
+
+/* Work out what each conversion takes; false for ones that cannot be deferred */
+static bool parse_format(const char *text, LogFormat *format) {
+    format->text = text;
+    format->count = 0;
+
+    for (const char *p = text; *p; p++) {
+        Conversion *conversion;
+        char length[3] = "";
+        size_t used = 0;
+        bool is_string;
+
+        if (*p != '%') {
+            continue;
+        }
+        if (p[1] == '%') {
+            p++;
+            continue;
+        }
+        if (format->count == LOG_MAX_ARGS) {
+            return false;
+        }
+        conversion = &format->conversions[format->count++];
+        memset(conversion, 0, sizeof(*conversion));
+        conversion->precision = -1;
+        conversion->spec[used++] = *p++;
+
+        while (*p && strchr("-+ #0", *p) && used < 8) {
+            conversion->spec[used++] = *p++;
+        }
+        if (*p == '*') {
+            conversion->star_width = true;
+            conversion->spec[used++] = *p++;
+        }
+        while (*p >= '0' && *p <= '9' && used < 10) {
+            conversion->spec[used++] = *p++;
+        }
+
+        /* The precision is copied below, once the conversion is known */
+        const char *precision = NULL;
+        size_t precision_length = 0;
+        if (*p == '.') {
+            precision = p++;
+            if (*p == '*') {
+                conversion->star_precision = true;
+                p++;
+            } else {
+                conversion->precision = 0;
+                while (*p >= '0' && *p <= '9') {
+                    conversion->precision = conversion->precision * 10 + (*p++ - '0');
+                }
+            }
+            precision_length = (size_t)(p - precision);
+        }
+
+        for (size_t i = 0; i < 2 && *p && strchr("hlzjtL", *p); i++) {
+            length[i] = *p++;
+        }
+        if (!*p) {
+            return false;
+        }
+
+        is_string = *p == 's';
+        if (is_string) {
+            if (length[0] || used + 4 > sizeof(conversion->spec)) {
+                return false;
+            }
+            conversion->kind = ARG_STRING;
+            memcpy(conversion->spec + used, ".*s", 4);
+            continue;
+        }
+        if (used + precision_length + 4 > sizeof(conversion->spec)) {
+            return false;
+        }
+        if (precision) {
+            memcpy(conversion->spec + used, precision, precision_length);
+            used += precision_length;
+        }
+
+        if (strchr("diouxXc", *p)) {
+            if (*p == 'c' && length[0]) {
+                return false;
+            }
+            if (strcmp(length, "l") == 0) {
+                conversion->kind = ARG_LONG;
+            } else if (strcmp(length, "ll") == 0) {
+                conversion->kind = ARG_LLONG;
+            } else if (strcmp(length, "z") == 0) {
+                conversion->kind = ARG_SIZE;
+            } else if (strcmp(length, "j") == 0) {
+                conversion->kind = ARG_INTMAX;
+            } else if (strcmp(length, "t") == 0) {
+                conversion->kind = ARG_PTRDIFF;
+            } else if (!length[0] || strcmp(length, "h") == 0 || strcmp(length, "hh") == 0) {
+                conversion->kind = ARG_INT;
+            } else {
+                return false;
+            }
+            memcpy(conversion->spec + used, length, strlen(length));
+            used += strlen(length);
+        } else if (strchr("fFeEgGaA", *p) && (!length[0] || strcmp(length, "l") == 0)) {
+            conversion->kind = ARG_DOUBLE;
+        } else if (*p == 'p' && !length[0]) {
+            conversion->kind = ARG_POINTER;
+        } else {
+            return false;
+        }
+        conversion->spec[used++] = *p;
+        conversion->spec[used] = '\0';
+    }
+    return true;
+}
+
+static size_t format_hash(const char *format) {
+    return (size_t)(((uintptr_t)format >> 2) * 0x9E3779B97F4A7C15ULL % LOG_FORMAT_HASH);
+}
+
+/* Id of a format already seen, -2 if unknown, -1 if it cannot be deferred */
+static int lookup_format(const char *format, size_t *free_slot) {
+    size_t slot = format_hash(format);
+
+    for (int i = 0; i < LOG_FORMAT_HASH; i++) {
+        const char *key = atomic_load_explicit(&format_keys[slot], memory_order_acquire);
+
+        if (key == format) {
+            return format_ids[slot];
+        }
+        if (!key) {
+            if (free_slot) {
+                *free_slot = slot;
+            }
+            return -2;
+        }
+        slot = (slot + 1) % LOG_FORMAT_HASH;
+    }
+    return -1;
+}
+
+static int format_id(const char *format) {
+    size_t slot = LOG_FORMAT_HASH;
+    int id = lookup_format(format, NULL);
+
+    if (id != -2) {
+        return id;
+    }
+
+    pthread_mutex_lock(&format_lock);
+    id = lookup_format(format, &slot);
+    if (id == -2 && slot < LOG_FORMAT_HASH) {
+        id = -1;
+        if (format_count < LOG_MAX_FORMATS && parse_format(format, &formats[format_count])) {
+            id = format_count++;
+        }
+        format_ids[slot] = id;
+        atomic_store_explicit(&format_keys[slot], format, memory_order_release);
+    }
+    pthread_mutex_unlock(&format_lock);
+    return id < 0 ? -1 : id;
+}
+
+static size_t put_u64(uint8_t *out, size_t used, uint64_t value) {
+    memcpy(out + used, &value, 8);
+    return used + 8;
+}
+
+static size_t encode_header(uint8_t *out, LogLevel level, int session_id, int id) {
+    uint64_t now = trace_now();
+    uint32_t format = (uint32_t)id;
+    int32_t session = session_id;
+
+    memcpy(out + 2, &now, 8);
+    memcpy(out + 10, &format, 4);
+    memcpy(out + 14, &session, 4);
+    out[18] = (uint8_t)level;
+    return RECORD_HEADER;
+}
+
+static size_t encode_string(uint8_t *out, size_t used, const char *text, size_t limit,
+                            size_t reserve) {
+    size_t room = LOG_MAX_RECORD - used - 2 > reserve ? LOG_MAX_RECORD - used - 2 - reserve : 0;
+    uint16_t length;
+
+    if (!text) {
+        text = "(null)";
+    }
+    length = (uint16_t)strnlen(text, limit < room ? limit : room);
+    memcpy(out + used, &length, 2);
+    memcpy(out + used + 2, text, length);
+    return used + 2 + length;
+}
+
+/* Encode a record with the raw arguments; returns its length */
+static size_t encode(uint8_t *out, LogLevel level, int session_id, int id, va_list args) {
+    const LogFormat *format = &formats[id];
+    size_t used = encode_header(out, level, session_id, id);
+
+    for (int i = 0; i < format->count; i++) {
+        const Conversion *conversion = &format->conversions[i];
+        size_t reserve = (size_t)(format->count - i - 1) * 24;
+        size_t limit = SIZE_MAX;
+
+        if (conversion->star_width) {
+            used = put_u64(out, used, (uint64_t)(int64_t)va_arg(args, int));
+        }
+        if (conversion->star_precision) {
+            int precision = va_arg(args, int);
+            if (conversion->kind == ARG_STRING) {
+                limit = precision >= 0 ? (size_t)precision : SIZE_MAX;
+            } else {
+                used = put_u64(out, used, (uint64_t)(int64_t)precision);
+            }
+        } else if (conversion->precision >= 0) {
+            limit = (size_t)conversion->precision;
+        }
+
+        switch (conversion->kind) {
+        case ARG_INT:
+            used = put_u64(out, used, (uint64_t)(int64_t)va_arg(args, int));
+            break;
+        case ARG_LONG:
+            used = put_u64(out, used, (uint64_t)va_arg(args, long));
+            break;
+        case ARG_LLONG:
+            used = put_u64(out, used, (uint64_t)va_arg(args, long long));
+            break;
+        case ARG_SIZE:
+            used = put_u64(out, used, (uint64_t)va_arg(args, size_t));
+            break;
+        case ARG_INTMAX:
+            used = put_u64(out, used, (uint64_t)va_arg(args, intmax_t));
+            break;
+        case ARG_PTRDIFF:
+            used = put_u64(out, used, (uint64_t)va_arg(args, ptrdiff_t));
+            break;
+        case ARG_DOUBLE: {
+            double value = va_arg(args, double);
+            uint64_t bits;
+            memcpy(&bits, &value, 8);
+            used = put_u64(out, used, bits);
+            break;
+        }
+        case ARG_POINTER:
+            used = put_u64(out, used, (uint64_t)(uintptr_t)va_arg(args, void *));
+            break;
+        case ARG_STRING:
+            used = encode_string(out, used, va_arg(args, const char *), limit, reserve);
+            break;
+        }
+    }
+
+    uint16_t length = (uint16_t)used;
+    memcpy(out, &length, 2);
+    return used;
+}
+
+/* A format that cannot be deferred is formatted now and queued as one string */
+static size_t encode_eager(uint8_t *out, LogLevel level, int session_id, const char *format,
+                           va_list args) {
+    char text[LOG_MAX_RECORD];
+    size_t used = encode_header(out, level, session_id, eager_id);
+    uint16_t length;
+
+    vsnprintf(text, sizeof(text), format, args);
+    used = encode_string(out, used, text, SIZE_MAX, 0);
+    length = (uint16_t)used;
+    memcpy(out, &length, 2);
+    return used;
+}
+
+#define FORMAT_WITH(value)                                                              \
+    (star_count == 0 ? snprintf(out, size, conversion->spec, value)                     \
+     : star_count == 1 ? snprintf(out, size, conversion->spec, stars[0], value)         \
+     : snprintf(out, size, conversion->spec, stars[0], stars[1], value))
+
+/* Format one conversion from its stored arguments */
+static int format_conversion(const Conversion *conversion, Reader *reader, char *out,
+                             size_t size) {
+    int stars[2];
+    int star_count = 0;
+    uint64_t value;
+
+    if (conversion->star_width) {
+        stars[star_count++] = (int)(int64_t)read_u64(reader);
+    }
+    if (conversion->star_precision && conversion->kind != ARG_STRING) {
+        stars[star_count++] = (int)(int64_t)read_u64(reader);
+    }
+
+    if (conversion->kind == ARG_STRING) {
+        uint16_t length = read_u16(reader);
+        const char *text = (const char *)reader->p;
+
+        if (reader->end - reader->p < length) {
+            reader->ok = false;
+            return 0;
+        }
+        reader->p += length;
+        stars[star_count++] = length;
+        return FORMAT_WITH(text);
+    }
+
+    value = read_u64(reader);
+    switch (conversion->kind) {
+    case ARG_INT:
+        return FORMAT_WITH((int)(int64_t)value);
+    case ARG_LONG:
+        return FORMAT_WITH((long)value);
+    case ARG_LLONG:
+        return FORMAT_WITH((long long)value);
+    case ARG_SIZE:
+        return FORMAT_WITH((size_t)value);
+    case ARG_INTMAX:
+        return FORMAT_WITH((intmax_t)value);
+    case ARG_PTRDIFF:
+        return FORMAT_WITH((ptrdiff_t)value);
+    case ARG_POINTER:
+        return FORMAT_WITH((void *)(uintptr_t)value);
+    case ARG_DOUBLE: {
+        double number;
+        memcpy(&number, &value, 8);
+        return FORMAT_WITH(number);
+    }
+    default:
+        return 0;
+    }
+}
+
+/* Expand a record's format with its arguments; returns the text length */
+static size_t format_record(const LogFormat *format, Reader *reader, char *out, size_t size) {
+    size_t used = 0;
+    int index = 0;
+
+    for (const char *p = format->text; *p && used + 1 < size; p++) {
+        if (*p != '%') {
+            out[used++] = *p;
+            continue;
+        }
+        if (p[1] == '%') {
+            out[used++] = '%';
+            p++;
+            continue;
+        }
+
+        int written = index < format->count
+                          ? format_conversion(&format->conversions[index++], reader, out + used,
+                                              size - used)
+                          : 0;
+        if (written > 0) {
+            used += (size_t)written < size - used ? (size_t)written : size - used - 1;
+        }
+
+        /* Skip the rest of the conversion spec */
+        p++;
+        while (*p && !strchr("diouxXcsfFeEgGaAp", *p)) {
+            p++;
+        }
+        if (!*p) {
+            break;
+        }
+    }
+    out[used] = '\0';
+    return used;
+}
+
+/* Console text for a record: "[session] message" */
+static size_t record_text(const uint8_t *record, size_t length, const LogFormat *table,
+                          int table_size, char *out, size_t size, LogLevel *level,
+                          uint64_t *timestamp) {
+    Reader reader = {record + 2, record + length, true};
+    uint32_t id;
+    int32_t session;
+    size_t used = 0;
+
+    *timestamp = read_u64(&reader);
+    id = read_u32(&reader);
+    session = (int32_t)read_u32(&reader);
+    *level = reader.p < reader.end ? (LogLevel)*reader.p++ : LOG_LEVEL_INFO;
+
+    if (!reader.ok || id >= (uint32_t)table_size || !table[id].text) {
+        return (size_t)snprintf(out, size, "(undecodable log record)\n");
+    }
+    if (session != 0) {
+        used = (size_t)snprintf(out, size, "[%d] ", (int)session);
+    }
+    return used + format_record(&table[id], &reader, out + used, size - used);
+}
+
+static void write_entry(FILE *file, uint8_t kind, const void *body, size_t length) {
+    uint16_t total = (uint16_t)(length + 2);
+
+    fputc(kind, file);
+    fwrite(&total, 2, 1, file);
+    fwrite(body, 1, length, file);
+}
+
+/* Append a record to the binary log, defining its format first; file_lock held */
+static void write_record(const uint8_t *record, size_t length) {
+    uint32_t id;
+
+    memcpy(&id, record + 10, 4);
+    if (id < LOG_MAX_FORMATS && !file_known[id]) {
+        uint8_t body[LOG_MAX_RECORD];
+        size_t text_length = strlen(formats[id].text);
+
+        if (text_length > sizeof(body) - 8) {
+            text_length = sizeof(body) - 8;
+        }
+        memcpy(body, &id, 4);
+        memcpy(body + 4, formats[id].text, text_length);
+        write_entry(log_file, ENTRY_FORMAT, body, 4 + text_length);
+        file_known[id] = true;
+    }
+    write_entry(log_file, ENTRY_RECORD, record + 2, length - 2);
+}
+
+/* Format for the console and append to the file */
+static void handle_record(const uint8_t *record, size_t length) {
+    char text[LOG_MAX_TEXT];
+    LogLevel level;
+    uint64_t timestamp;
+    size_t text_length = record_text(record, length, formats, format_count, text, sizeof(text),
+                                     &level, &timestamp);
+
+    fwrite(text, 1, text_length, level == LOG_LEVEL_ERROR ? stderr : stdout);
+    console_append(text, text_length);
+
+    pthread_mutex_lock(&file_lock);
+    if (log_file) {
+        write_record(record, length);
+    }
+    pthread_mutex_unlock(&file_lock);
+}
+
+/* Claim slots for a record and copy it in; false if the queue is full */
+static bool enqueue(const uint8_t *record, size_t length) {
+    uint64_t count = (length + LOG_SLOT_PAYLOAD - 1) / LOG_SLOT_PAYLOAD;
+    uint64_t pos = atomic_load_explicit(&queue_tail, memory_order_relaxed);
+
+    for (;;) {
+        /* Slots are freed in order, so the last one being free means all are */
+        uint64_t last = pos + count - 1;
+        uint64_t seq = atomic_load_explicit(&queue[last % LOG_QUEUE_SLOTS].seq,
+                                            memory_order_acquire);
+
+        if (seq == last) {
+            if (atomic_compare_exchange_weak_explicit(&queue_tail, &pos, pos + count,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if ((int64_t)(seq - last) < 0) {
+            return false;
+        } else {
+            pos = atomic_load_explicit(&queue_tail, memory_order_relaxed);
+        }
+    }
+
+    for (uint64_t i = 0; i < count; i++) {
+        size_t offset = (size_t)i * LOG_SLOT_PAYLOAD;
+        size_t chunk = length - offset < LOG_SLOT_PAYLOAD ? length - offset : LOG_SLOT_PAYLOAD;
+        memcpy(queue[(pos + i) % LOG_QUEUE_SLOTS].payload, record + offset, chunk);
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        atomic_store_explicit(&queue[(pos + i) % LOG_QUEUE_SLOTS].seq, pos + i + 1,
+                              memory_order_release);
+    }
+    return true;
+}
+
+/* Take the record at the head of the queue, if it has been published */
+static size_t dequeue(uint8_t *record) {
+    Slot *first = &queue[queue_head % LOG_QUEUE_SLOTS];
+    uint16_t length;
+    uint64_t count;
+
+    if (atomic_load_explicit(&first->seq, memory_order_acquire) != queue_head + 1) {
+        return 0;
+    }
+    memcpy(&length, first->payload, 2);
+    count = (length + LOG_SLOT_PAYLOAD - 1) / LOG_SLOT_PAYLOAD;
+
+    for (uint64_t i = 0; i < count; i++) {
+        Slot *slot = &queue[(queue_head + i) % LOG_QUEUE_SLOTS];
+        size_t offset = (size_t)i * LOG_SLOT_PAYLOAD;
+        size_t chunk = length - offset < LOG_SLOT_PAYLOAD ? length - offset : LOG_SLOT_PAYLOAD;
+
+        /* The producer is still copying the rest of the record */
+        while (atomic_load_explicit(&slot->seq, memory_order_acquire) != queue_head + i + 1) {
+            sched_yield();
+        }
+        memcpy(record + offset, slot->payload, chunk);
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        atomic_store_explicit(&queue[(queue_head + i) % LOG_QUEUE_SLOTS].seq,
+                              queue_head + i + LOG_QUEUE_SLOTS, memory_order_release);
+    }
+    queue_head += count;
+    return length;
+}
+
+static bool record_ready(void) {
+    return atomic_load_explicit(&queue[queue_head % LOG_QUEUE_SLOTS].seq,
+                                memory_order_acquire) == queue_head + 1;
+}
+
+/* Say how many records were lost since the last report */
+static void report_dropped(void) {
+    uint64_t total = atomic_load(&dropped);
+    char text[96];
+    size_t length;
+
+    if (total == file_dropped) {
+        return;
+    }
+    length = (size_t)snprintf(text, sizeof(text), "%llu log records dropped: queue full\n",
+                              (unsigned long long)(total - file_dropped));
+    fwrite(text, 1, length, stderr);
+    console_append(text, length);
+
+    pthread_mutex_lock(&file_lock);
+    if (log_file) {
+        write_entry(log_file, ENTRY_DROPPED, &total, sizeof(total));
+    }
+    pthread_mutex_unlock(&file_lock);
+    file_dropped = total;
+}
+
+static void *logger_main(void *data) {
+    uint8_t record[LOG_MAX_RECORD];
+    struct pollfd wake = {wake_fd, POLLIN, 0};
+
+    for (;;) {
+        size_t length;
+        bool handled = false;
+
+        while ((length = dequeue(record)) > 0) {
+            handle_record(record, length);
+            handled = true;
+        }
+
+        if (handled) {
+            report_dropped();
+            fflush(stdout);
+            pthread_mutex_lock(&file_lock);
+            if (log_file) {
+                fflush(log_file);
+            }
+            pthread_mutex_unlock(&file_lock);
+
+            pthread_mutex_lock(&done_lock);
+            done_pos = queue_head;
+            pthread_cond_broadcast(&done_cond);
+            pthread_mutex_unlock(&done_lock);
+            continue;
+        }
+
+        if (atomic_load(&logger_stopping)) {
+            break;
+        }
+
+        /* Producers only pay for a wakeup when this thread is about to sleep */
+        atomic_store(&logger_sleeping, true);
+        if (!record_ready()) {
+            uint64_t count;
+            poll(&wake, 1, LOG_IDLE_WAIT_MS);
+            while (read(wake_fd, &count, sizeof(count)) > 0) {
+            }
+        }
+        atomic_store(&logger_sleeping, false);
+    }
+    return NULL;
+}
+
+static void wake_logger(void) {
+    uint64_t one = 1;
+
+    if (write(wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        /* The idle timeout picks the record up instead */
+    }
+}
+
+/* Drain and stop the logger thread; registered with atexit() */
+static void stop_logger(void) {
+    if (!logger_running) {
+        return;
+    }
+    atomic_store(&logger_stopping, true);
+    wake_logger();
+    pthread_join(logger_thread, NULL);
+    logger_running = false;
+
+    pthread_mutex_lock(&file_lock);
+    if (log_file) {
+        fclose(log_file);
+        log_file = NULL;
+    }
+    pthread_mutex_unlock(&file_lock);
+}
+
+static void start_logger(void) {
+    for (uint64_t i = 0; i < LOG_QUEUE_SLOTS; i++) {
+        atomic_init(&queue[i].seq, i);
+    }
+    eager_id = format_id(eager_format);
+
+    wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wake_fd >= 0 && pthread_create(&logger_thread, NULL, logger_main, NULL) == 0) {
+        logger_running = true;
+        atexit(stop_logger);
+    }
+}
+
+void log_vrecord(LogLevel level, int session_id, const char *format, va_list args) {
+    uint8_t record[LOG_MAX_RECORD];
+    size_t length;
+    int id;
+
+    pthread_once(&logger_once, start_logger);
+
+    id = format_id(format);
+    length = id >= 0 ? encode(record, level, session_id, id, args)
+                     : encode_eager(record, level, session_id, format, args);
+
+    /* Without the logger thread, format in place as before */
+    if (!logger_running) {
+        pthread_mutex_lock(&inline_lock);
+        handle_record(record, length);
+        pthread_mutex_unlock(&inline_lock);
+        return;
+    }
+
+    if (!enqueue(record, length)) {
+        atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&logger_sleeping, memory_order_relaxed) &&
+        atomic_exchange(&logger_sleeping, false)) {
+        wake_logger();
+    }
+}
+
+void log_record(LogLevel level, int session_id, const char *format, ...) {
+    va_list args;
+
+    va_start(args, format);
+    log_vrecord(level, session_id, format, args);
+    va_end(args);
+}
+
+bool logger_open_file(const char *path) {
+    FILE *file = NULL;
+    uint64_t clocks[2];
+    struct timespec now;
+
+    pthread_once(&logger_once, start_logger);
+
+    if (path && *path) {
+        file = fopen(path, "ab");
+        if (!file) {
+            log_error("Cannot open log file %s: %s\n", path, strerror(errno));
+            return false;
+        }
+        if (ftell(file) == 0) {
+            fwrite(file_magic, 1, sizeof(file_magic), file);
+        }
+
+        /* Lets the decoder turn record timestamps into wall-clock time */
+        clock_gettime(CLOCK_REALTIME, &now);
+        clocks[0] = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+        clocks[1] = trace_now();
+        write_entry(file, ENTRY_CLOCK, clocks, sizeof(clocks));
+    }
+
+    pthread_mutex_lock(&file_lock);
+    if (log_file) {
+        fclose(log_file);
+    }
+    log_file = file;
+    memset(file_known, 0, sizeof(file_known));
+    pthread_mutex_unlock(&file_lock);
+    return true;
+}
+
+void logger_flush(void) {
+    uint64_t target;
+
+    pthread_once(&logger_once, start_logger);
+    if (!logger_running) {
+        return;
+    }
+
+    target = atomic_load(&queue_tail);
+    wake_logger();
+    pthread_mutex_lock(&done_lock);
+    while (done_pos < target) {
+        pthread_cond_wait(&done_cond, &done_lock);
+    }
+    pthread_mutex_unlock(&done_lock);
+}
+
+uint64_t logger_dropped(void) {
+    return atomic_load(&dropped);
+}
+
+static const char *level_name(LogLevel level) {
+    return level == LOG_LEVEL_ERROR ? "ERROR" : "INFO";
+}
+
+bool logger_decode(FILE *in, FILE *out) {
+    char magic[sizeof(file_magic)];
+    LogFormat *table = calloc(LOG_MAX_FORMATS, sizeof(*table));
+    char *texts[LOG_MAX_FORMATS] = {NULL};
+    uint8_t body[LOG_MAX_RECORD + 2];
+    char text[LOG_MAX_TEXT];
+    int64_t clock_offset = 0;
+    bool ok = true;
+    int kind;
+
+    if (!table) {
+        return false;
+    }
+    if (fread(magic, 1, sizeof(magic), in) != sizeof(magic) ||
+        memcmp(magic, file_magic, sizeof(magic)) != 0) {
+        free(table);
+        return false;
+    }
+
+    while ((kind = fgetc(in)) != EOF) {
+        uint16_t total;
+        size_t length;
+
+        if (fread(&total, 2, 1, in) != 1 || total < 2) {
+            ok = false;
+            break;
+        }
+        length = total - 2u;
+        if (fread(body + 2, 1, length, in) != length) {
+            ok = false;
+            break;
+        }
+
+        if (kind == ENTRY_CLOCK && length == 16) {
+            uint64_t clocks[2];
+            memcpy(clocks, body + 2, 16);
+            clock_offset = (int64_t)(clocks[0] - clocks[1]);
+        } else if (kind == ENTRY_FORMAT && length >= 4) {
+            uint32_t id;
+            memcpy(&id, body + 2, 4);
+            if (id < LOG_MAX_FORMATS) {
+                free(texts[id]);
+                texts[id] = strndup((const char *)body + 6, length - 4);
+                if (!texts[id] || !parse_format(texts[id], &table[id])) {
+                    table[id].text = NULL;
+                }
+            }
+        } else if (kind == ENTRY_RECORD) {
+            LogLevel level;
+            uint64_t timestamp;
+            size_t text_length;
+            time_t seconds;
+            struct tm when;
+            char stamp[32];
+
+            total = (uint16_t)(length + 2);
+            memcpy(body, &total, 2);
+            text_length = record_text(body, length + 2, table, LOG_MAX_FORMATS, text,
+                                      sizeof(text), &level, &timestamp);
+
+            timestamp += (uint64_t)clock_offset;
+            seconds = (time_t)(timestamp / 1000000000ULL);
+            localtime_r(&seconds, &when);
+            strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &when);
+            fprintf(out, "%s.%06llu %-5s %.*s%s", stamp,
+                    (unsigned long long)(timestamp % 1000000000ULL / 1000), level_name(level),
+                    (int)text_length, text,
+                    text_length > 0 && text[text_length - 1] == '\n' ? "" : "\n");
+        } else if (kind == ENTRY_DROPPED && length == 8) {
+            uint64_t total_dropped;
+            memcpy(&total_dropped, body + 2, 8);
+            fprintf(out, "-- %llu records dropped so far --\n",
+                    (unsigned long long)total_dropped);
+        }
+    }
+
+    for (int i = 0; i < LOG_MAX_FORMATS; i++) {
+        free(texts[i]);
+    }
+    free(table);
+    return ok;
+}
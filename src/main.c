@@ -1,5 +1,10 @@
 #include "../include/common.h"
 #include "../include/ui_main.h"
+#include "../include/io_loop.h"
+#include "../include/batch.h"
+#include "../include/pool.h"
+#include "../include/resmon.h"
+#include "../include/transcript.h"
 
 /* Global application state */
 AppState app = {0};
@@ -22,6 +27,18 @@ int main(int argc, char **argv) {
     /* Initialize application state */
     memset(&app, 0, sizeof(AppState));
 
+    /* Unattended jobs run without libui */
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--batch") == 0) {
+            BatchOptions batch;
+
+            if (!batch_parse_args(argc, argv, &batch)) {
+                return 2;
+            }
+            return batch_run(&batch);
+        }
+    }
+
     /* Initialize libui */
     memset(&options, 0, sizeof(uiInitOptions));
     err = uiInit(&options);
@@ -31,6 +48,13 @@ int main(int argc, char **argv) {
         return 1;
     }
 
+    /* Start the I/O thread that services child process pipes */
+    if (!io_loop_start()) {
+        fprintf(stderr, "Error starting I/O thread\n");
+        uiUninit();
+        return 1;
+    }
+
     /* Set up UI quit handler */
     uiOnShouldQuit(on_should_quit, NULL);
 
@@ -47,6 +71,10 @@ int main(int argc, char **argv) {
     uiMain();
 
     /* Clean up */
+    transcript_record_stop();
+    pool_shutdown();
+    resmon_close();
+    io_loop_stop();
     uiUninit();
 
     return 0;
@@ -0,0 +1,246 @@
+#define _GNU_SOURCE
+
+#include "../include/memview.h"
+#include "../include/dbg_client.h"
+#include "../include/dosemu_integration.h"
+
+/* Fetches in flight at once, so fast scrolling cannot flood the debugger */
+#define MEMVIEW_MAX_FETCHES 32
+
+/* Bytes compared per block when diffing a page */
+#define MEMVIEW_BLOCK_SIZE 64
+
+typedef struct CacheSlot {
+    MemoryPage page;
+    bool valid;              /* page holds data */
+    bool fetching;           /* a dump of this page is outstanding */
+    uint64_t last_used;
+} CacheSlot;
+
+/* A dump on its way back from the debugger */
+typedef struct PageFetch {
+    uint32_t address;
+    unsigned generation;
+} PageFetch;
+
+static CacheSlot *slots = NULL;
+static uint64_t use_clock = 0;
+static int fetches = 0;
+static unsigned generation = 0;   /* bumped when the cache is dropped */
+static int attached_session = 0;
+static memview_listener page_listener = NULL;
+static void *page_listener_data = NULL;
+
+static CacheSlot *find_slot(uint32_t address) {
+    for (int i = 0; i < MEMVIEW_CACHE_PAGES; i++) {
+        if ((slots[i].valid || slots[i].fetching) && slots[i].page.address == address) {
+            return &slots[i];
+        }
+    }
+    return NULL;
+}
+
+/* An empty slot, else the least recently used one without a fetch pending */
+static CacheSlot *evict_slot(void) {
+    CacheSlot *victim = NULL;
+
+    for (int i = 0; i < MEMVIEW_CACHE_PAGES; i++) {
+        if (!slots[i].valid && !slots[i].fetching) {
+            return &slots[i];
+        }
+        if (!slots[i].fetching && (!victim || slots[i].last_used < victim->last_used)) {
+            victim = &slots[i];
+        }
+    }
+
+    if (victim) {
+        victim->valid = false;
+    }
+    return victim;
+}
+
+/*
+ * Mark the bytes that differ between the cached copy and a fresh dump, then
+ * take the fresh one. Whole 64-byte blocks are compared with word-sized XORs
+ * first, a loop the compiler turns into vector code; only blocks that differ
+ * are walked byte by byte.
+ */
+static void diff_page(MemoryPage *page, const uint8_t *fresh, size_t length) {
+    size_t blocks = length / MEMVIEW_BLOCK_SIZE;
+
+    page->changed_blocks = 0;
+    memset(page->changed, 0, sizeof(page->changed));
+
+    for (size_t block = 0; block < blocks; block++) {
+        const uint8_t *old_bytes = page->bytes + block * MEMVIEW_BLOCK_SIZE;
+        const uint8_t *new_bytes = fresh + block * MEMVIEW_BLOCK_SIZE;
+        uint64_t difference = 0;
+
+        for (size_t i = 0; i < MEMVIEW_BLOCK_SIZE; i += sizeof(uint64_t)) {
+            uint64_t a, b;
+            memcpy(&a, old_bytes + i, sizeof(a));
+            memcpy(&b, new_bytes + i, sizeof(b));
+            difference |= a ^ b;
+        }
+        if (difference == 0) {
+            continue;
+        }
+
+        page->changed_blocks |= 1ULL << block;
+        for (size_t i = 0; i < MEMVIEW_BLOCK_SIZE; i++) {
+            size_t index = block * MEMVIEW_BLOCK_SIZE + i;
+            if (old_bytes[i] != new_bytes[i]) {
+                page->changed[index / 8] |= (uint8_t)(1u << (index % 8));
+            }
+        }
+    }
+
+    /* A trailing partial block, if the dump came back short */
+    for (size_t index = blocks * MEMVIEW_BLOCK_SIZE; index < length; index++) {
+        if (page->bytes[index] != fresh[index]) {
+            page->changed_blocks |= 1ULL << (index / MEMVIEW_BLOCK_SIZE);
+            page->changed[index / 8] |= (uint8_t)(1u << (index % 8));
+        }
+    }
+
+    memcpy(page->bytes, fresh, length);
+}
+
+static void on_page_dumped(bool ok, uint16_t segment, uint32_t offset,
+                           const uint8_t *bytes, size_t len, void *data) {
+    PageFetch *fetch = data;
+    CacheSlot *slot;
+
+    fetches--;
+    if (fetch->generation != generation) {
+        free(fetch);
+        return;
+    }
+
+    slot = find_slot(fetch->address);
+    if (slot) {
+        slot->fetching = false;
+        if (ok) {
+            if (slot->valid && len == slot->page.length) {
+                diff_page(&slot->page, bytes, len);
+            } else {
+                /* First sight of this page: nothing to compare against */
+                memcpy(slot->page.bytes, bytes, len);
+                slot->page.changed_blocks = 0;
+                memset(slot->page.changed, 0, sizeof(slot->page.changed));
+            }
+            slot->page.length = len;
+            slot->valid = true;
+        }
+    }
+
+    if (ok && slot && page_listener) {
+        page_listener(fetch->address, page_listener_data);
+    }
+    free(fetch);
+}
+
+/*
+ * Dump one page. Below 1 MiB the page is addressed as segment:0000;
+ * above it, as a 32-bit offset from segment 0.
+ */
+static bool fetch_page(CacheSlot *slot) {
+    DosemuSession *session = dosemu_session_find(attached_session);
+    DbgClient *debugger = session ? dosemu_session_debugger(session) : NULL;
+    uint32_t address = slot->page.address;
+    PageFetch *fetch;
+    bool started;
+
+    if (!debugger || fetches >= MEMVIEW_MAX_FETCHES) {
+        return false;
+    }
+
+    fetch = malloc(sizeof(*fetch));
+    if (!fetch) {
+        return false;
+    }
+    fetch->address = address;
+    fetch->generation = generation;
+
+    if (address < 0x100000) {
+        started = dbg_read_mem(debugger, (uint16_t)(address >> 4), 0, MEMVIEW_PAGE_SIZE,
+                               on_page_dumped, fetch);
+    } else {
+        started = dbg_read_mem(debugger, 0, address, MEMVIEW_PAGE_SIZE,
+                               on_page_dumped, fetch);
+    }
+
+    if (!started) {
+        free(fetch);
+        return false;
+    }
+
+    slot->fetching = true;
+    fetches++;
+    return true;
+}
+
+/* Browse the memory of a session */
+void memview_attach(int session_id, memview_listener listener, void *data) {
+    if (!slots) {
+        slots = calloc(MEMVIEW_CACHE_PAGES, sizeof(*slots));
+    }
+
+    if (slots && session_id != attached_session) {
+        memset(slots, 0, MEMVIEW_CACHE_PAGES * sizeof(*slots));
+        generation++;
+    }
+
+    attached_session = session_id;
+    page_listener = listener;
+    page_listener_data = data;
+}
+
+/* The cached page containing address, fetching it on a miss */
+const MemoryPage *memview_page(uint32_t address) {
+    uint32_t page_address = address & ~(uint32_t)(MEMVIEW_PAGE_SIZE - 1);
+    CacheSlot *slot;
+
+    if (!slots) {
+        return NULL;
+    }
+
+    slot = find_slot(page_address);
+    if (slot) {
+        slot->last_used = ++use_clock;
+        return slot->valid ? &slot->page : NULL;
+    }
+
+    slot = evict_slot();
+    if (slot) {
+        slot->page.address = page_address;
+        slot->last_used = ++use_clock;
+        fetch_page(slot);
+    }
+    return NULL;
+}
+
+/* Whether a byte changed between the last two fetches of its page */
+bool memview_byte_changed(const MemoryPage *page, size_t index) {
+    return (page->changed_blocks >> (index / MEMVIEW_BLOCK_SIZE) & 1) &&
+           (page->changed[index / 8] >> (index % 8) & 1);
+}
+
+/* Re-fetch the cached pages overlapping [first, last] */
+void memview_refresh(uint32_t first, uint32_t last) {
+    if (!slots) {
+        return;
+    }
+
+    first &= ~(uint32_t)(MEMVIEW_PAGE_SIZE - 1);
+    for (uint64_t address = first; address <= last; address += MEMVIEW_PAGE_SIZE) {
+        CacheSlot *slot = find_slot((uint32_t)address);
+
+        if (!slot) {
+            /* Misses that could not be fetched while scrolling */
+            memview_page((uint32_t)address);
+        } else if (!slot->fetching) {
+            fetch_page(slot);
+        }
+    }
+}
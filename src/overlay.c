@@ -0,0 +1,692 @@
+#define _GNU_SOURCE
+
+#include "../include/overlay.h"
+#include "../include/console.h"
+#include "../include/headless.h"
+#include "../include/trace.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <limits.h>
+#include <linux/fs.h>
+#include <linux/magic.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+
+/* A staged file or directory as it was copied, to find what DOS changed */
+typedef struct ManifestEntry {
+    size_t name;             /* offset of the relative path in the name arena */
+    off_t size;
+    struct timespec mtime;
+    bool directory;
+    bool seen;               /* still in the overlay when harvesting */
+} ManifestEntry;
+
+struct DriveOverlay {
+    int slot;
+    int session_id;
+    char base[PATH_MAX];
+    char path[PATH_MAX];
+
+    /* Written by the staging or harvest thread, read on the UI thread once it is done */
+    ManifestEntry *entries;
+    size_t count;
+    size_t capacity;
+    char *names;
+    size_t names_used;
+    size_t names_capacity;
+    OverlayStats stats;
+    bool failed;             /* staging failed, or harvest left something behind */
+    bool incomplete;         /* harvest could not walk all of the overlay */
+
+    overlay_staged_callback callback;
+    void *callback_data;
+};
+
+/* UI thread state */
+static char process_dir[PATH_MAX];      /* this process's slots, locked while it runs */
+static int process_lock = -1;
+static bool slot_used[OVERLAY_MAX_SLOTS];
+static OverlayStats totals;
+static bool warned_not_tmpfs = false;
+
+/* Where staged drives go; tmpfs where there is one */
+static bool overlay_root(char *path, size_t size) {
+    const char *runtime = getenv("XDG_RUNTIME_DIR");
+    char parent[PATH_MAX];
+    struct stat info;
+
+    if (!runtime || !*runtime) {
+        runtime = stat("/dev/shm", &info) == 0 && S_ISDIR(info.st_mode) ? "/dev/shm" : "/tmp";
+    }
+    snprintf(parent, sizeof(parent), "%s/dosemu2-gui", runtime);
+    snprintf(path, size, "%s/" OVERLAY_SUBDIR, runtime);
+    if ((mkdir(parent, 0700) != 0 && errno != EEXIST) ||
+        (mkdir(path, 0700) != 0 && errno != EEXIST)) {
+        log_error("Cannot create %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+static int remove_entry(const char *path, const struct stat *info, int type, struct FTW *ftw) {
+    remove(path);
+    return 0;
+}
+
+static void remove_tree(const char *path) {
+    nftw(path, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+/* Remove the directories of GUIs and batch runs that are gone, skipping any still locked */
+static void sweep_stale(const char *root) {
+    DIR *dir = opendir(root);
+    struct dirent *entry;
+    char path[PATH_MAX * 2];
+
+    while (dir && (entry = readdir(dir)) != NULL) {
+        pid_t pid = (pid_t)atoi(entry->d_name);
+        int fd;
+
+        /* Kept overlays are named kept-..., and live owners are left alone */
+        if (pid <= 0 || pid == getpid() || kill(pid, 0) == 0 || errno == EPERM) {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/%s", root, entry->d_name);
+        fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd >= 0 && flock(fd, LOCK_EX | LOCK_NB) == 0) {
+            remove_tree(path);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    if (dir) {
+        closedir(dir);
+    }
+}
+
+/* <root>/<pid>-XXXXXX, made once and held under flock so no other process reuses it */
+static bool process_directory(char *root, size_t size) {
+    if (!overlay_root(root, size)) {
+        return false;
+    }
+    if (process_lock >= 0) {
+        return true;
+    }
+
+    if (snprintf(process_dir, sizeof(process_dir), "%s/%d-XXXXXX", root, (int)getpid()) >=
+            (int)sizeof(process_dir) || !mkdtemp(process_dir)) {
+        log_error("Cannot create a staging directory in %s: %s\n", root, strerror(errno));
+        process_dir[0] = '\0';
+        return false;
+    }
+    process_lock = open(process_dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (process_lock < 0 || flock(process_lock, LOCK_EX) != 0) {
+        log_error("Cannot lock %s: %s\n", process_dir, strerror(errno));
+        if (process_lock >= 0) {
+            close(process_lock);
+            process_lock = -1;
+        }
+        rmdir(process_dir);
+        process_dir[0] = '\0';
+        return false;
+    }
+    sweep_stale(root);
+    return true;
+}
+
+static double ms_since(uint64_t start_ns) {
+    return (double)(trace_now() - start_ns) / 1000000.0;
+}
+
+static bool same_time(const struct timespec *a, const struct timespec *b) {
+    return a->tv_sec == b->tv_sec && a->tv_nsec == b->tv_nsec;
+}
+
+/* Share the blocks if the filesystem can, otherwise copy in the kernel */
+static bool copy_contents(int in, int out, off_t size, bool *cloned) {
+    bool use_range = true;
+    off_t done = 0;
+
+    *cloned = ioctl(out, FICLONE, in) == 0;
+    if (*cloned) {
+        return true;
+    }
+
+    while (done < size) {
+        ssize_t copied = use_range
+            ? copy_file_range(in, NULL, out, NULL, (size_t)(size - done), 0)
+            : sendfile(out, in, NULL, (size_t)(size - done));
+
+        if (copied < 0 && use_range &&
+            (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP)) {
+            use_range = false;
+            continue;
+        }
+        if (copied < 0 && errno == EINTR) {
+            continue;
+        }
+        if (copied < 0) {
+            return false;
+        }
+        if (copied == 0) {
+            break;           /* the file shrank while we copied it */
+        }
+        done += copied;
+    }
+    return true;
+}
+
+/* Copy one file with its mode and times; target is created or replaced */
+static bool copy_file(const char *source, const char *target, const struct stat *info,
+                      bool *cloned) {
+    int in = open(source, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+    int out = in >= 0 ? open(target, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                             (info->st_mode & 0777) | 0600) : -1;
+    struct timespec times[2] = {info->st_atim, info->st_mtim};
+    bool ok = out >= 0 && copy_contents(in, out, info->st_size, cloned) &&
+              futimens(out, times) == 0;
+
+    if (out >= 0 && close(out) != 0) {
+        ok = false;
+    }
+    if (in >= 0) {
+        close(in);
+    }
+    return ok;
+}
+
+static bool add_entry(DriveOverlay *overlay, const char *name, const struct stat *info) {
+    size_t length = strlen(name) + 1;
+
+    if (overlay->count == overlay->capacity) {
+        size_t capacity = overlay->capacity ? overlay->capacity * 2 : 256;
+        ManifestEntry *entries = realloc(overlay->entries, capacity * sizeof(*entries));
+
+        if (!entries) {
+            return false;
+        }
+        overlay->entries = entries;
+        overlay->capacity = capacity;
+    }
+    if (overlay->names_used + length > overlay->names_capacity) {
+        size_t capacity = (overlay->names_used + length) * 2;
+        char *names = realloc(overlay->names, capacity);
+
+        if (!names) {
+            return false;
+        }
+        overlay->names = names;
+        overlay->names_capacity = capacity;
+    }
+
+    memcpy(overlay->names + overlay->names_used, name, length);
+    overlay->entries[overlay->count].name = overlay->names_used;
+    overlay->entries[overlay->count].size = info->st_size;
+    overlay->entries[overlay->count].mtime = info->st_mtim;
+    overlay->entries[overlay->count].directory = S_ISDIR(info->st_mode);
+    overlay->entries[overlay->count].seen = false;
+    overlay->count++;
+    overlay->names_used += length;
+    return true;
+}
+
+/* Point a staged link at the overlay's copy of its target; links leaving the drive are dropped */
+static void stage_link(DriveOverlay *overlay, const char *source, const char *target) {
+    char resolved[PATH_MAX], link[PATH_MAX * 2];
+    size_t base_length = strlen(overlay->base);
+
+    if (!realpath(source, resolved) || strncmp(resolved, overlay->base, base_length) != 0 ||
+        (resolved[base_length] != '/' && resolved[base_length] != '\0')) {
+        log_message("Session %d: not staging %s, which points outside %s\n",
+                    overlay->session_id, source, overlay->base);
+        return;
+    }
+    snprintf(link, sizeof(link), "%s%s", overlay->path, resolved + base_length);
+    symlink(link, target);
+}
+
+/* Staging thread: mirror base/relative into the overlay */
+static void stage_directory(DriveOverlay *overlay, char *relative, size_t length) {
+    char source[PATH_MAX * 2], target[PATH_MAX * 2];
+    DIR *dir;
+    struct dirent *entry;
+
+    snprintf(source, sizeof(source), "%s%s", overlay->base, relative);
+    dir = opendir(source);
+    if (!dir) {
+        log_error("Cannot stage %s: %s\n", source, strerror(errno));
+        overlay->failed = true;
+        return;
+    }
+
+    while (!overlay->failed && (entry = readdir(dir)) != NULL) {
+        size_t name_length = strlen(entry->d_name);
+        struct stat info;
+        bool cloned;
+
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        if (length + 1 + name_length >= PATH_MAX) {
+            log_error("Cannot stage %s/%s: path too long\n", source, entry->d_name);
+            overlay->failed = true;
+            break;
+        }
+        relative[length] = '/';
+        memcpy(relative + length + 1, entry->d_name, name_length + 1);
+        snprintf(source, sizeof(source), "%s%s", overlay->base, relative);
+        snprintf(target, sizeof(target), "%s%s", overlay->path, relative);
+
+        if (lstat(source, &info) != 0) {
+            continue;        /* removed while we looked */
+        }
+        if (S_ISDIR(info.st_mode)) {
+            struct timespec times[2] = {info.st_atim, info.st_mtim};
+
+            if (mkdir(target, (info.st_mode & 0777) | 0700) != 0 ||
+                !add_entry(overlay, relative, &info)) {
+                log_error("Cannot stage %s: %s\n", target, strerror(errno));
+                overlay->failed = true;
+                break;
+            }
+            overlay->stats.directories++;
+            stage_directory(overlay, relative, length + 1 + name_length);
+            utimensat(AT_FDCWD, target, times, AT_SYMLINK_NOFOLLOW);
+        } else if (S_ISREG(info.st_mode)) {
+            if (!copy_file(source, target, &info, &cloned) ||
+                !add_entry(overlay, relative, &info)) {
+                log_error("Cannot stage %s: %s\n", source, strerror(errno));
+                overlay->failed = true;
+                break;
+            }
+            overlay->stats.files++;
+            if (cloned) {
+                overlay->stats.bytes_cloned += (uint64_t)info.st_size;
+            } else {
+                overlay->stats.bytes_copied += (uint64_t)info.st_size;
+            }
+        } else if (S_ISLNK(info.st_mode)) {
+            stage_link(overlay, source, target);
+        }
+        /* Devices, FIFOs and sockets mean nothing to DOS */
+    }
+    relative[length] = '\0';
+    closedir(dir);
+}
+
+static int compare_entries(const void *a, const void *b, void *data) {
+    const char *names = data;
+
+    return strcmp(names + ((const ManifestEntry *)a)->name,
+                  names + ((const ManifestEntry *)b)->name);
+}
+
+static void deliver_staged(void *data) {
+    DriveOverlay *overlay = data;
+
+    if (!overlay->failed) {
+        totals.overlays++;
+        totals.files += overlay->stats.files;
+        totals.directories += overlay->stats.directories;
+        totals.bytes_copied += overlay->stats.bytes_copied;
+        totals.bytes_cloned += overlay->stats.bytes_cloned;
+        totals.stage_ms += overlay->stats.stage_ms;
+    }
+    overlay->callback(overlay, !overlay->failed, overlay->callback_data);
+}
+
+static void *stage_thread(void *data) {
+    DriveOverlay *overlay = data;
+    char relative[PATH_MAX] = "";
+    uint64_t start = trace_now();
+
+    stage_directory(overlay, relative, 0);
+
+    /* Sorted, so harvesting can look files up */
+    qsort_r(overlay->entries, overlay->count, sizeof(*overlay->entries), compare_entries,
+            overlay->names);
+    overlay->stats.stage_ms = ms_since(start);
+
+    main_queue(deliver_staged, overlay);
+    return NULL;
+}
+
+DriveOverlay *overlay_create(const char *base, int session_id) {
+    DriveOverlay *overlay;
+    char root[PATH_MAX];
+    struct stat info;
+    struct statfs fs;
+    int slot = 0;
+
+    while (slot < OVERLAY_MAX_SLOTS && slot_used[slot]) {
+        slot++;
+    }
+    if (slot == OVERLAY_MAX_SLOTS) {
+        log_error("Too many staged drives (limit %d)\n", OVERLAY_MAX_SLOTS);
+        return NULL;
+    }
+
+    overlay = calloc(1, sizeof(*overlay));
+    if (!overlay) {
+        return NULL;
+    }
+    if (!realpath(base, overlay->base) || stat(overlay->base, &info) != 0) {
+        log_error("Cannot stage drive %s: %s\n", base, strerror(errno));
+        free(overlay);
+        return NULL;
+    }
+    if (!S_ISDIR(info.st_mode)) {
+        log_error("Cannot stage drive %s: not a directory\n", base);
+        free(overlay);
+        return NULL;
+    }
+    if (!process_directory(root, sizeof(root))) {
+        free(overlay);
+        return NULL;
+    }
+
+    /* Slots are private to this process; a kept overlay that failed to move may linger */
+    if (snprintf(overlay->path, sizeof(overlay->path), "%s/%d", process_dir, slot) >=
+        (int)sizeof(overlay->path)) {
+        log_error("Staging directory path too long: %s\n", process_dir);
+        free(overlay);
+        return NULL;
+    }
+    remove_tree(overlay->path);
+    if (mkdir(overlay->path, 0700) != 0) {
+        log_error("Cannot create %s: %s\n", overlay->path, strerror(errno));
+        free(overlay);
+        return NULL;
+    }
+    if (!warned_not_tmpfs && statfs(overlay->path, &fs) == 0 && fs.f_type != TMPFS_MAGIC) {
+        log_message("Staged drives are in %s, which is not tmpfs\n", root);
+        warned_not_tmpfs = true;
+    }
+
+    overlay->slot = slot;
+    overlay->session_id = session_id;
+    slot_used[slot] = true;
+    return overlay;
+}
+
+const char *overlay_path(const DriveOverlay *overlay) {
+    return overlay->path;
+}
+
+bool overlay_stage(DriveOverlay *overlay, overlay_staged_callback callback, void *data) {
+    pthread_t thread;
+
+    overlay->callback = callback;
+    overlay->callback_data = data;
+    if (pthread_create(&thread, NULL, stage_thread, overlay) != 0) {
+        log_error("Cannot start staging %s\n", overlay->base);
+        return false;
+    }
+    pthread_detach(thread);
+    return true;
+}
+
+static ManifestEntry *find_entry(DriveOverlay *overlay, const char *name) {
+    size_t low = 0, high = overlay->count;
+
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        int order = strcmp(name, overlay->names + overlay->entries[middle].name);
+
+        if (order == 0) {
+            return &overlay->entries[middle];
+        }
+        if (order < 0) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+    return NULL;
+}
+
+/* Whether the base drive still has what was staged, or nothing for a new file */
+static bool base_unchanged(const char *path, const ManifestEntry *entry) {
+    struct stat info;
+
+    if (lstat(path, &info) != 0) {
+        return errno == ENOENT && !entry;
+    }
+    return entry && S_ISREG(info.st_mode) && info.st_size == entry->size &&
+           same_time(&info.st_mtim, &entry->mtime);
+}
+
+static void conflict(DriveOverlay *overlay, const char *relative) {
+    log_error("Session %d: %s changed in %s too; kept the base drive's copy\n",
+              overlay->session_id, relative + 1, overlay->base);
+    overlay->stats.conflicts++;
+}
+
+/* Replace a file in the base drive without anyone seeing half of it */
+static bool write_back(DriveOverlay *overlay, const char *source, const char *target,
+                       const struct stat *info) {
+    char temporary[PATH_MAX * 2 + 32];
+    const char *name = strrchr(target, '/') + 1;
+    bool cloned;
+
+    snprintf(temporary, sizeof(temporary), "%.*s.%s.dosemu2-gui", (int)(name - target), target,
+             name);
+    if (!copy_file(source, temporary, info, &cloned) || rename(temporary, target) != 0) {
+        log_error("Cannot write back %s: %s\n", target, strerror(errno));
+        unlink(temporary);
+        return false;
+    }
+    overlay->stats.harvested_files++;
+    overlay->stats.harvested_bytes += (uint64_t)info->st_size;
+    return true;
+}
+
+/* Walk overlay/relative for new and changed files */
+static bool harvest_directory(DriveOverlay *overlay, char *relative, size_t length) {
+    char source[PATH_MAX * 2], target[PATH_MAX * 2];
+    DIR *dir;
+    struct dirent *entry;
+    bool ok = true;
+
+    snprintf(source, sizeof(source), "%s%s", overlay->path, relative);
+    dir = opendir(source);
+    if (!dir) {
+        log_error("Cannot harvest %s: %s\n", source, strerror(errno));
+        overlay->incomplete = true;
+        return false;
+    }
+
+    while ((entry = readdir(dir)) != NULL) {
+        size_t name_length = strlen(entry->d_name);
+        ManifestEntry *staged;
+        struct stat info;
+
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0 ||
+            length + 1 + name_length >= PATH_MAX) {
+            continue;
+        }
+        relative[length] = '/';
+        memcpy(relative + length + 1, entry->d_name, name_length + 1);
+        snprintf(source, sizeof(source), "%s%s", overlay->path, relative);
+        snprintf(target, sizeof(target), "%s%s", overlay->base, relative);
+        if (lstat(source, &info) != 0) {
+            overlay->incomplete = true;
+            continue;
+        }
+
+        if (S_ISDIR(info.st_mode)) {
+            staged = find_entry(overlay, relative);
+            if (staged) {
+                staged->seen = true;
+            }
+            if (mkdir(target, info.st_mode & 0777) != 0 && errno != EEXIST) {
+                log_error("Cannot write back %s: %s\n", target, strerror(errno));
+                ok = false;
+                continue;
+            }
+            ok = harvest_directory(overlay, relative, length + 1 + name_length) && ok;
+            continue;
+        }
+        if (!S_ISREG(info.st_mode)) {
+            continue;
+        }
+
+        /* Untouched since staging: same size and the base drive's own time */
+        staged = find_entry(overlay, relative);
+        if (staged && staged->directory) {
+            staged = NULL;   /* DOS replaced a directory with a file */
+        }
+        if (staged) {
+            staged->seen = true;
+            if (info.st_size == staged->size && same_time(&info.st_mtim, &staged->mtime)) {
+                continue;
+            }
+        }
+        if (!base_unchanged(target, staged)) {
+            conflict(overlay, relative);
+            ok = false;
+            continue;
+        }
+        ok = write_back(overlay, source, target, &info) && ok;
+    }
+    relative[length] = '\0';
+    closedir(dir);
+    return ok;
+}
+
+/* Staged directories DOS deleted, deepest first: the manifest is sorted, so children follow their parent */
+static bool remove_directories(DriveOverlay *overlay) {
+    char target[PATH_MAX * 2];
+    bool ok = true;
+
+    for (size_t i = overlay->count; i-- > 0;) {
+        const char *name = overlay->names + overlay->entries[i].name;
+        struct stat info;
+
+        if (!overlay->entries[i].directory || overlay->entries[i].seen) {
+            continue;
+        }
+        snprintf(target, sizeof(target), "%s%s", overlay->base, name);
+        if (lstat(target, &info) != 0 || !S_ISDIR(info.st_mode)) {
+            continue;        /* already gone from the base drive too */
+        }
+        /* Not empty: the host added to it, or a conflict kept a file there */
+        if (rmdir(target) != 0) {
+            if (errno != ENOTEMPTY && errno != EEXIST) {
+                log_error("Cannot delete %s: %s\n", target, strerror(errno));
+                ok = false;
+            }
+            continue;
+        }
+        overlay->stats.deleted_files++;
+    }
+    return ok;
+}
+
+static void deliver_harvested(void *data) {
+    DriveOverlay *overlay = data;
+
+    totals.harvested_files += overlay->stats.harvested_files;
+    totals.harvested_bytes += overlay->stats.harvested_bytes;
+    totals.deleted_files += overlay->stats.deleted_files;
+    totals.conflicts += overlay->stats.conflicts;
+    totals.harvest_ms += overlay->stats.harvest_ms;
+    overlay->callback(overlay, !overlay->failed, overlay->callback_data);
+}
+
+static void *harvest_thread(void *data) {
+    DriveOverlay *overlay = data;
+    char relative[PATH_MAX] = "";
+    char target[PATH_MAX * 2];
+    uint64_t start = trace_now();
+    bool ok = harvest_directory(overlay, relative, 0);
+
+    /* Staged files DOS deleted; unseen only means deleted if every directory was read */
+    if (overlay->incomplete) {
+        log_error("Session %d: could not read all of %s; deleted nothing from %s\n",
+                  overlay->session_id, overlay->path, overlay->base);
+    }
+    for (size_t i = 0; i < overlay->count && !overlay->incomplete; i++) {
+        const char *name = overlay->names + overlay->entries[i].name;
+
+        if (overlay->entries[i].seen || overlay->entries[i].directory) {
+            continue;
+        }
+        snprintf(target, sizeof(target), "%s%s", overlay->base, name);
+        if (!base_unchanged(target, &overlay->entries[i])) {
+            if (access(target, F_OK) == 0) {
+                conflict(overlay, name);
+                ok = false;
+            }
+            continue;
+        }
+        if (unlink(target) != 0) {
+            log_error("Cannot delete %s: %s\n", target, strerror(errno));
+            ok = false;
+            continue;
+        }
+        overlay->stats.deleted_files++;
+    }
+    if (!overlay->incomplete) {
+        ok = remove_directories(overlay) && ok;
+    }
+
+    overlay->failed = !ok;
+    overlay->stats.harvest_ms = ms_since(start);
+    main_queue(deliver_harvested, overlay);
+    return NULL;
+}
+
+bool overlay_harvest(DriveOverlay *overlay, overlay_harvested_callback callback, void *data) {
+    pthread_t thread;
+
+    overlay->callback = callback;
+    overlay->callback_data = data;
+    if (pthread_create(&thread, NULL, harvest_thread, overlay) != 0) {
+        log_error("Cannot start harvesting %s\n", overlay->path);
+        return false;
+    }
+    pthread_detach(thread);
+    return true;
+}
+
+void overlay_close(DriveOverlay *overlay, bool keep) {
+    char kept[PATH_MAX + 64];
+    char *slash = strrchr(process_dir, '/');
+
+    if (!overlay) {
+        return;
+    }
+    if (keep && slash) {
+        /* Beside the process directories, so it outlives this process and the sweep */
+        snprintf(kept, sizeof(kept), "%.*s/kept-%d-session-%d", (int)(slash - process_dir),
+                 process_dir, (int)getpid(), overlay->session_id);
+        remove_tree(kept);
+        if (rename(overlay->path, kept) == 0) {
+            log_message("Session %d: staged drive kept in %s\n", overlay->session_id, kept);
+        }
+    }
+    remove_tree(overlay->path);
+
+    slot_used[overlay->slot] = false;
+    free(overlay->entries);
+    free(overlay->names);
+    free(overlay);
+}
+
+void overlay_stats(const DriveOverlay *overlay, OverlayStats *stats) {
+    *stats = overlay->stats;
+}
+
+void overlay_totals(OverlayStats *stats) {
+    *stats = totals;
+}
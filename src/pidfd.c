@@ -0,0 +1,31 @@
+#define _GNU_SOURCE
+
+#include "../include/pidfd.h"
+#include <sys/syscall.h>
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+#ifndef SYS_pidfd_send_signal
+#define SYS_pidfd_send_signal 424
+#endif
+
+/* Open a pidfd for pid */
+int pidfd_open_pid(pid_t pid) {
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+}
+
+/* Signal a process, immune to pid reuse when a pidfd is available */
+int pidfd_signal(int pidfd, pid_t pid, int sig) {
+    if (pidfd >= 0) {
+        int result = (int)syscall(SYS_pidfd_send_signal, pidfd, sig, NULL, 0);
+        if (result == 0 || errno != ENOSYS) {
+            return result;
+        }
+    }
+    return kill(pid, sig);
+}
@@ -0,0 +1,365 @@
+#define _GNU_SOURCE
+
+#include "../include/placement.h"
+#include "../include/console.h"
+#include "../include/dosemu_integration.h"
+#include <sched.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+/* cgroup v2 cpu.max period, in microseconds */
+#define PLACEMENT_CPU_PERIOD_US 100000
+
+/* Configuration; strings are owned copies */
+static char *config_cpus = NULL;
+static bool config_auto_spread = false;
+static SchedClass config_sched_class = SCHED_CLASS_NORMAL;
+static int config_nice = 0;
+static char *config_cgroup_parent = NULL;
+static int config_cpu_max_percent = 0;
+static size_t config_memory_max_mb = 0;
+static int config_generation = 0;
+
+/* Auto-spread: the first allowed CPU of each physical core, and instances on it */
+static int cores[PLACEMENT_MAX_CPUS];
+static int core_load[PLACEMENT_MAX_CPUS];
+static int core_count = -1;
+
+/* cgroups whose instance was still exiting when released; removed later */
+static char *stale_cgroups[MAX_SESSIONS];
+static int stale_count = 0;
+
+static void set_cpu(uint64_t *cpus, int cpu) {
+    cpus[cpu / 64] |= 1ULL << (cpu % 64);
+}
+
+static bool has_cpu(const uint64_t *cpus, int cpu) {
+    return (cpus[cpu / 64] >> (cpu % 64)) & 1;
+}
+
+/* Parse a kernel-style CPU list such as "0-3,8,10-11" */
+static bool parse_cpu_list(const char *text, uint64_t *cpus) {
+    const char *p = text;
+
+    memset(cpus, 0, PLACEMENT_MAX_CPUS / 8);
+    while (*p) {
+        char *end;
+        long first = strtol(p, &end, 10);
+        long last = first;
+
+        if (end == p || first < 0 || first >= PLACEMENT_MAX_CPUS) {
+            return false;
+        }
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            if (end == p + 1 || last < first || last >= PLACEMENT_MAX_CPUS) {
+                return false;
+            }
+            p = end;
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            set_cpu(cpus, (int)cpu);
+        }
+        while (*p == ',' || *p == ' ' || *p == '\n') {
+            p++;
+        }
+    }
+    return true;
+}
+
+static char *copy_string(const char *text) {
+    return text && *text ? strdup(text) : NULL;
+}
+
+static bool same_string(const char *a, const char *b) {
+    return strcmp(a ? a : "", b ? b : "") == 0;
+}
+
+bool placement_configure(const PlacementConfig *config) {
+    uint64_t cpus[PLACEMENT_MAX_CPUS / 64];
+
+    if (config->cpus && *config->cpus && !parse_cpu_list(config->cpus, cpus)) {
+        log_error("Invalid CPU list \"%s\"\n", config->cpus);
+        return false;
+    }
+
+    if (!same_string(config->cpus, config_cpus) || config->auto_spread != config_auto_spread ||
+        config->sched_class != config_sched_class || config->nice != config_nice ||
+        !same_string(config->cgroup_parent, config_cgroup_parent) ||
+        (config->cpu_max_percent > 0 ? config->cpu_max_percent : 0) != config_cpu_max_percent ||
+        config->memory_max_mb != config_memory_max_mb) {
+        config_generation++;
+    }
+
+    free(config_cpus);
+    free(config_cgroup_parent);
+    config_cpus = copy_string(config->cpus);
+    config_auto_spread = config->auto_spread;
+    config_sched_class = config->sched_class;
+    config_nice = config->nice;
+    config_cgroup_parent = copy_string(config->cgroup_parent);
+    config_cpu_max_percent = config->cpu_max_percent > 0 ? config->cpu_max_percent : 0;
+    config_memory_max_mb = config->memory_max_mb;
+    return true;
+}
+
+int placement_generation(void) {
+    return config_generation;
+}
+
+/* One CPU per physical core among those we may run on, so SMT siblings stay free */
+static void discover_cores(void) {
+    cpu_set_t allowed;
+
+    core_count = 0;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return;
+    }
+
+    for (int cpu = 0; cpu < PLACEMENT_MAX_CPUS && cpu < CPU_SETSIZE; cpu++) {
+        uint64_t siblings[PLACEMENT_MAX_CPUS / 64];
+        char path[96], list[256];
+        bool first_of_core = true;
+        FILE *file;
+
+        if (!CPU_ISSET(cpu, &allowed)) {
+            continue;
+        }
+
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list",
+                 cpu);
+        file = fopen(path, "r");
+        if (file) {
+            if (fgets(list, sizeof(list), file) && parse_cpu_list(list, siblings)) {
+                for (int sibling = 0; sibling < cpu; sibling++) {
+                    if (has_cpu(siblings, sibling) && CPU_ISSET(sibling, &allowed)) {
+                        first_of_core = false;
+                        break;
+                    }
+                }
+            }
+            fclose(file);
+        }
+
+        if (first_of_core) {
+            core_load[core_count] = 0;
+            cores[core_count++] = cpu;
+        }
+    }
+}
+
+/* The least loaded core; ties go to the highest, away from CPU 0 and its interrupts */
+static int pick_core(void) {
+    int best = -1;
+
+    if (core_count < 0) {
+        discover_cores();
+    }
+    for (int i = 0; i < core_count; i++) {
+        if (best < 0 || core_load[i] <= core_load[best]) {
+            best = i;
+        }
+    }
+    if (best >= 0) {
+        core_load[best]++;
+    }
+    return best;
+}
+
+static bool write_file(const char *directory, const char *name, const char *text,
+                       bool report) {
+    char path[PATH_MAX];
+    size_t length = strlen(text);
+    int fd;
+    bool ok;
+
+    snprintf(path, sizeof(path), "%s/%s", directory, name);
+    fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (report) {
+            log_error("Cannot open %s: %s\n", path, strerror(errno));
+        }
+        return false;
+    }
+    ok = write(fd, text, length) == (ssize_t)length;
+    if (!ok && report) {
+        log_error("Cannot write \"%s\" to %s: %s\n", text, path, strerror(errno));
+    }
+    close(fd);
+    return ok;
+}
+
+/* Remove cgroups left behind by instances that had not finished exiting */
+static void remove_stale_cgroups(void) {
+    int kept = 0;
+
+    for (int i = 0; i < stale_count; i++) {
+        if (rmdir(stale_cgroups[i]) == 0 || errno == ENOENT) {
+            free(stale_cgroups[i]);
+        } else {
+            stale_cgroups[kept++] = stale_cgroups[i];
+        }
+    }
+    stale_count = kept;
+}
+
+/* A cgroup of its own under the configured parent, with the configured limits */
+static bool prepare_cgroup(int session_id, Placement *placement) {
+    char path[PATH_MAX], limit[64];
+
+    remove_stale_cgroups();
+
+    /* Children only get the controllers their parent delegates; fine if already enabled */
+    write_file(config_cgroup_parent, "cgroup.subtree_control", "+cpu +memory", false);
+
+    snprintf(path, sizeof(path), "%s/dosemu-%d-%d", config_cgroup_parent, (int)getpid(),
+             session_id);
+    if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+        log_error("Cannot create cgroup %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    placement->cgroup_path = strdup(path);
+    if (!placement->cgroup_path) {
+        rmdir(path);
+        return false;
+    }
+
+    if (config_cpu_max_percent > 0) {
+        snprintf(limit, sizeof(limit), "%ld %d",
+                 (long)config_cpu_max_percent * PLACEMENT_CPU_PERIOD_US / 100,
+                 PLACEMENT_CPU_PERIOD_US);
+        if (!write_file(placement->cgroup_path, "cpu.max", limit, true)) {
+            return false;
+        }
+    }
+    if (config_memory_max_mb > 0) {
+        snprintf(limit, sizeof(limit), "%zu", config_memory_max_mb * 1024 * 1024);
+        if (!write_file(placement->cgroup_path, "memory.max", limit, true)) {
+            return false;
+        }
+    }
+
+    /* Opened now so the child only has to write to it */
+    char procs[PATH_MAX];
+    snprintf(procs, sizeof(procs), "%s/cgroup.procs", placement->cgroup_path);
+    placement->cgroup_procs_fd = open(procs, O_WRONLY | O_CLOEXEC);
+    if (placement->cgroup_procs_fd < 0) {
+        log_error("Cannot open %s: %s\n", procs, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool placement_prepare(int session_id, Placement *placement) {
+    memset(placement, 0, sizeof(*placement));
+    placement->core = -1;
+    placement->cgroup_procs_fd = -1;
+    placement->sched_class = config_sched_class;
+    placement->nice = config_nice;
+
+    if (config_auto_spread) {
+        placement->core = pick_core();
+        if (placement->core >= 0) {
+            placement->pin = true;
+            set_cpu(placement->cpus, cores[placement->core]);
+        }
+    } else if (config_cpus) {
+        placement->pin = parse_cpu_list(config_cpus, placement->cpus);
+    }
+
+    if (config_cgroup_parent && !prepare_cgroup(session_id, placement)) {
+        placement_release(placement);
+        return false;
+    }
+    return true;
+}
+
+int placement_apply(const Placement *placement) {
+    if (placement->cgroup_procs_fd >= 0 && write(placement->cgroup_procs_fd, "0", 1) != 1) {
+        return errno;
+    }
+
+    if (placement->pin) {
+        cpu_set_t cpus;
+
+        CPU_ZERO(&cpus);
+        for (int cpu = 0; cpu < PLACEMENT_MAX_CPUS && cpu < CPU_SETSIZE; cpu++) {
+            if (has_cpu(placement->cpus, cpu)) {
+                CPU_SET(cpu, &cpus);
+            }
+        }
+        if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+            return errno;
+        }
+    }
+
+    if (placement->sched_class != SCHED_CLASS_NORMAL) {
+        struct sched_param param = {0};
+        int policy = placement->sched_class == SCHED_CLASS_IDLE ? SCHED_IDLE : SCHED_BATCH;
+
+        if (sched_setscheduler(0, policy, &param) != 0) {
+            return errno;
+        }
+    }
+
+    if (placement->nice != 0) {
+        errno = 0;
+        if (setpriority(PRIO_PROCESS, 0, getpriority(PRIO_PROCESS, 0) + placement->nice) != 0) {
+            return errno;
+        }
+    }
+    return 0;
+}
+
+void placement_release(Placement *placement) {
+    if (placement->core >= 0) {
+        core_load[placement->core]--;
+        placement->core = -1;
+    }
+    if (placement->cgroup_procs_fd >= 0) {
+        close(placement->cgroup_procs_fd);
+        placement->cgroup_procs_fd = -1;
+    }
+
+    /* A killed instance may not have been reaped yet; try again later */
+    if (placement->cgroup_path) {
+        if (rmdir(placement->cgroup_path) != 0 && errno == EBUSY && stale_count < MAX_SESSIONS) {
+            stale_cgroups[stale_count++] = placement->cgroup_path;
+        } else {
+            free(placement->cgroup_path);
+        }
+        placement->cgroup_path = NULL;
+    }
+}
+
+void placement_describe(const Placement *placement, char *buffer, size_t size) {
+    static const char *class_names[] = {"", "SCHED_BATCH", "SCHED_IDLE"};
+    size_t used = 0;
+
+    buffer[0] = '\0';
+    if (placement->pin) {
+        used += (size_t)snprintf(buffer + used, size - used, "CPUs");
+        for (int cpu = 0; cpu < PLACEMENT_MAX_CPUS && used < size; cpu++) {
+            if (has_cpu(placement->cpus, cpu)) {
+                used += (size_t)snprintf(buffer + used, size - used, " %d", cpu);
+            }
+        }
+    }
+    if (placement->sched_class != SCHED_CLASS_NORMAL && used < size) {
+        used += (size_t)snprintf(buffer + used, size - used, "%s%s", used ? ", " : "",
+                                 class_names[placement->sched_class]);
+    }
+    if (placement->nice != 0 && used < size) {
+        used += (size_t)snprintf(buffer + used, size - used, "%snice %+d", used ? ", " : "",
+                                 placement->nice);
+    }
+    if (placement->cgroup_path && used < size) {
+        snprintf(buffer + used, size - used, "%scgroup %s", used ? ", " : "",
+                 placement->cgroup_path);
+    }
+}
@@ -0,0 +1,340 @@
+#define _GNU_SOURCE
+
+#include "../include/pool.h"
+#include "../include/console.h"
+#include "../include/dosemurc.h"
+#include "../include/logger.h"
+#include "../include/headless.h"
+#include "../include/placement.h"
+#include "../include/trace.h"
+#include <stdint.h>
+#include <signal.h>
+#include <unistd.h>
+
+/* A pool_start() caller waiting for its session */
+typedef struct PoolRequest {
+    dosemu_done_callback on_started;
+    void *data;
+    uint64_t start_ns;
+    int session_id;
+} PoolRequest;
+
+/* Configuration; paths are owned copies */
+static char *pool_dos_path = NULL;
+static char *pool_config_path = NULL;
+static char *pool_drive_dir = NULL;    /* app.drive_dir the instances were staged from */
+static int pool_placement = 0;         /* placement_generation() they were placed with */
+static int pool_size = 0;
+static int pool_refill = 1;
+static size_t pool_budget_kb = 0;
+
+/* Idle instances by session id, oldest first; ids survive a session being stopped elsewhere */
+static int ready_ids[MAX_SESSIONS];
+static int ready_count = 0;
+static int warming = 0;
+static int failures = 0;
+
+/* Resident size of the last instance booted, to predict the next one's */
+static size_t instance_kb = 0;
+
+/* Bumped on reconfiguration so instances booted for old paths are discarded */
+static int generation = 0;
+
+static bool change_registered = false;
+
+static uint64_t hits = 0;
+static uint64_t misses = 0;
+static LatencyHistogram boot_latency;
+static LatencyHistogram start_latency;
+
+static void refill(void);
+
+static bool same_path(const char *a, const char *b) {
+    return strcmp(a ? a : "", b ? b : "") == 0;
+}
+
+static char *copy_path(const char *path) {
+    return path && *path ? strdup(path) : NULL;
+}
+
+/* Resident set size of a process in KiB, or 0 if it cannot be read */
+static size_t resident_kb(pid_t pid) {
+    char path[64];
+    unsigned long size_pages, resident_pages;
+    FILE *file;
+
+    snprintf(path, sizeof(path), "/proc/%d/statm", (int)pid);
+    file = fopen(path, "r");
+    if (!file) {
+        return 0;
+    }
+    if (fscanf(file, "%lu %lu", &size_pages, &resident_pages) != 2) {
+        resident_pages = 0;
+    }
+    fclose(file);
+    return (size_t)resident_pages * (size_t)sysconf(_SC_PAGESIZE) / 1024;
+}
+
+/* A stale idle instance is gone; boot one with the current config */
+static void on_stale_stopped(DosemuSession *session, bool success, void *data) {
+    refill();
+}
+
+static void prune_ready(void) {
+    bool drive_changed = !same_path(app.drive_dir, pool_drive_dir);
+    bool placement_changed = placement_generation() != pool_placement;
+    int kept = 0;
+
+    /* Instances staged from another drive, or from none, no longer match a start */
+    if (drive_changed) {
+        free(pool_drive_dir);
+        pool_drive_dir = copy_path(app.drive_dir);
+        generation++;
+    }
+    /* Nor do ones pinned, scheduled or limited differently from what is now configured */
+    if (placement_changed) {
+        pool_placement = placement_generation();
+        generation++;
+    }
+
+    for (int i = 0; i < ready_count; i++) {
+        DosemuSession *session = dosemu_session_find(ready_ids[i]);
+
+        if (!session || dosemu_session_state(session) != SESSION_IDLE ||
+            !is_dosemu_running(session)) {
+            continue;
+        }
+        /* Booted with a config, drive or placement changed since; nobody should get it */
+        if (drive_changed || placement_changed || dosemu_session_config_stale(session)) {
+            stop_dosemu(session, on_stale_stopped, NULL);
+            continue;
+        }
+        ready_ids[kept++] = ready_ids[i];
+    }
+    ready_count = kept;
+}
+
+static size_t idle_resident_kb(void) {
+    size_t total = 0;
+
+    for (int i = 0; i < ready_count; i++) {
+        DosemuSession *session = dosemu_session_find(ready_ids[i]);
+
+        if (session) {
+            total += resident_kb(dosemu_session_pid(session));
+        }
+    }
+    return total;
+}
+
+/* Stop the most recently readied idle instance */
+static void drop_newest(void) {
+    DosemuSession *session = dosemu_session_find(ready_ids[--ready_count]);
+
+    if (session) {
+        stop_dosemu(session, NULL, NULL);
+    }
+}
+
+/* An idle instance died; replace it */
+static void on_idle_exited(DosemuSession *session, bool success, void *data) {
+    prune_ready();
+    refill();
+}
+
+static void on_instance_booted(DosemuSession *session, bool success, void *data) {
+    int booted_generation = (int)(intptr_t)data;
+
+    warming--;
+
+    if (!success) {
+        failures++;
+        if (failures == POOL_MAX_FAILURES) {
+            log_error("Pre-warm pool stopped refilling after %d failed launches\n", failures);
+        }
+    } else if (booted_generation != generation || ready_count + 1 > pool_size ||
+               dosemu_session_config_stale(session)) {
+        /* Booted for a configuration that no longer applies */
+        stop_dosemu(session, NULL, NULL);
+    } else {
+        failures = 0;
+        instance_kb = resident_kb(dosemu_session_pid(session));
+        latency_record(&boot_latency, dosemu_session_ready_ms(session));
+        dosemu_session_set_idle(session, true);
+        dosemu_session_on_exit(session, on_idle_exited, NULL);
+        ready_ids[ready_count++] = dosemu_session_id(session);
+    }
+
+    refill();
+}
+
+/* Boot instances until the pool is full, within the concurrency and memory limits */
+static void refill(void) {
+    size_t idle_kb;
+
+    prune_ready();
+
+    idle_kb = pool_budget_kb ? idle_resident_kb() : 0;
+    while (pool_budget_kb && ready_count > 0 && idle_kb > pool_budget_kb) {
+        drop_newest();
+        idle_kb = idle_resident_kb();
+    }
+
+    while (ready_count + warming < pool_size && warming < pool_refill &&
+           failures < POOL_MAX_FAILURES && dosemu_session_count() < MAX_SESSIONS) {
+        /* Assume each instance still booting will need as much as the last one */
+        if (pool_budget_kb && idle_kb + (size_t)(warming + 1) * instance_kb > pool_budget_kb) {
+            break;
+        }
+
+        if (!start_dosemu(pool_dos_path, pool_config_path, on_instance_booted,
+                          (void *)(intptr_t)generation)) {
+            failures++;
+            break;
+        }
+        warming++;
+    }
+}
+
+static void deferred_refill(void *data) {
+    refill();
+}
+
+/* Replace instances made stale by a config change, once they are all marked */
+static void on_config_changed(const char *source, void *data) {
+    main_queue(deferred_refill, NULL);
+}
+
+/* Keep instances booted with their debugger attached */
+void pool_configure(const PoolConfig *config) {
+    bool paths_changed = !same_path(config->dos_path, pool_dos_path) ||
+                         !same_path(config->config_path, pool_config_path);
+
+    if (paths_changed) {
+        free(pool_dos_path);
+        free(pool_config_path);
+        pool_dos_path = copy_path(config->dos_path);
+        pool_config_path = copy_path(config->config_path);
+        generation++;
+
+        prune_ready();
+        while (ready_count > 0) {
+            drop_newest();
+        }
+    }
+
+    pool_size = config->size > 0 ? config->size : 0;
+    pool_refill = config->refill_concurrency > 0 ? config->refill_concurrency : 1;
+    pool_budget_kb = config->memory_budget_kb;
+    failures = 0;
+    if (!change_registered) {
+        change_registered = dosemurc_add_change_callback(on_config_changed, NULL);
+    }
+
+    prune_ready();
+    while (ready_count > pool_size) {
+        drop_newest();
+    }
+    refill();
+}
+
+static void finish_request(PoolRequest *request, DosemuSession *session, bool success) {
+    if (success) {
+        latency_record(&start_latency, (double)(trace_now() - request->start_ns) / 1000000.0);
+    }
+    if (request->on_started) {
+        request->on_started(session, success, request->data);
+    }
+    free(request);
+}
+
+static void on_cold_started(DosemuSession *session, bool success, void *data) {
+    finish_request(data, session, success);
+}
+
+/* Deliver a pooled instance the way start_dosemu() would, after pool_start() returns */
+static void deliver_hit(void *data) {
+    PoolRequest *request = data;
+    DosemuSession *session = dosemu_session_find(request->session_id);
+
+    if (!session) {
+        log_error("Pooled DOSEmu session %d went away before it was handed over\n",
+                  request->session_id);
+        free(request);
+        return;
+    }
+    finish_request(request, session, dosemu_session_state(session) == SESSION_RUNNING);
+}
+
+/* Start a session, from the pool when an idle instance matches */
+DosemuSession *pool_start(const char *dos_path, const char *config_path,
+                          dosemu_done_callback on_started, void *data) {
+    PoolRequest *request = calloc(1, sizeof(*request));
+    DosemuSession *session = NULL;
+
+    if (!request) {
+        log_error("Out of memory starting DOSEmu\n");
+        return NULL;
+    }
+    request->on_started = on_started;
+    request->data = data;
+    request->start_ns = trace_now();
+
+    prune_ready();
+    if (ready_count > 0 && same_path(dos_path, pool_dos_path) &&
+        same_path(config_path, pool_config_path)) {
+        session = dosemu_session_find(ready_ids[0]);
+        ready_count--;
+        memmove(&ready_ids[0], &ready_ids[1], (size_t)ready_count * sizeof(ready_ids[0]));
+    }
+
+    if (session) {
+        hits++;
+        dosemu_session_set_idle(session, false);
+        dosemu_session_on_exit(session, NULL, NULL);
+        log_record(LOG_LEVEL_INFO, dosemu_session_id(session), "Taken from the pre-warm pool\n");
+        request->session_id = dosemu_session_id(session);
+        main_queue(deliver_hit, request);
+    } else {
+        misses++;
+        session = start_dosemu(dos_path, config_path, on_cold_started, request);
+        if (!session) {
+            free(request);
+        }
+    }
+
+    refill();
+    return session;
+}
+
+/* Read-only: instances that died or went stale are pruned by the pool's own events */
+void pool_stats(PoolStats *stats) {
+    stats->ready = 0;
+    for (int i = 0; i < ready_count; i++) {
+        DosemuSession *session = dosemu_session_find(ready_ids[i]);
+
+        if (session && dosemu_session_state(session) == SESSION_IDLE &&
+            !dosemu_session_config_stale(session)) {
+            stats->ready++;
+        }
+    }
+    stats->warming = warming;
+    stats->hits = hits;
+    stats->misses = misses;
+    stats->idle_rss_kb = idle_resident_kb();
+    stats->boot = boot_latency;
+    stats->time_to_ready = start_latency;
+}
+
+/* Terminate idle instances without waiting; for application exit */
+void pool_shutdown(void) {
+    pool_size = 0;
+    for (int i = 0; i < ready_count; i++) {
+        DosemuSession *session = dosemu_session_find(ready_ids[i]);
+
+        if (session) {
+            dosemu_session_signal(session, SIGTERM);
+        }
+    }
+    ready_count = 0;
+}
@@ -0,0 +1,446 @@
+#define _GNU_SOURCE
+
+#include "../include/profiler.h"
+#include "../include/latency.h"
+#include <time.h>
+
+/* One register read taken from the guest */
+typedef struct ProfileSample {
+    double time_ms;          /* since profiler_start() */
+    bool has_regs;
+    DbgRegs regs;
+} ProfileSample;
+
+/* Open-addressing table of address -> sample count */
+typedef struct AddressSlot {
+    uint64_t key;            /* segment << 32 | offset, plus one; 0 is empty */
+    uint64_t samples;
+} AddressSlot;
+
+/*
+ * Bounded ring between the register read callback, which pushes, and the
+ * aggregator in profiler_collect(). Both run on the UI thread.
+ */
+static ProfileSample ring[PROFILE_RING_SIZE];
+static uint64_t ring_head = 0;   /* next slot to read */
+static uint64_t ring_tail = 0;   /* next slot to write */
+static uint64_t ring_dropped = 0;
+
+/* Aggregated profile; touched by the consumer only */
+static AddressSlot *addresses = NULL;
+static size_t address_capacity = 0;
+static size_t address_count = 0;
+static uint64_t segment_samples[65536];
+static uint64_t total_samples = 0;
+static ProfileSample *history = NULL;
+static uint64_t history_count = 0;
+
+/* Sampler state; UI thread only */
+static bool running = false;
+static unsigned generation = 0;   /* stale timers stop when this changes */
+static int session_id = 0;
+static int rate_hz = 0;
+static bool record_regs = false;
+static bool read_outstanding = false;
+static struct timespec started;
+static struct timespec stopped;
+static struct timespec read_issued;
+static uint64_t skipped = 0;
+static uint64_t failed = 0;
+static LatencyHistogram round_trips;
+static double round_trip_total_ms = 0.0;
+static double sampler_total_ms = 0.0;
+static uint64_t sampler_calls = 0;
+
+static double elapsed_ms(const struct timespec *from, const struct timespec *to) {
+    return (double)(to->tv_sec - from->tv_sec) * 1000.0 +
+           (double)(to->tv_nsec - from->tv_nsec) / 1000000.0;
+}
+
+static double ms_since(const struct timespec *from) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return elapsed_ms(from, &now);
+}
+
+static bool ring_push(const ProfileSample *sample) {
+    if (ring_tail - ring_head == PROFILE_RING_SIZE) {
+        ring_dropped++;
+        return false;
+    }
+
+    ring[ring_tail++ & (PROFILE_RING_SIZE - 1)] = *sample;
+    return true;
+}
+
+static bool ring_pop(ProfileSample *sample) {
+    if (ring_head == ring_tail) {
+        return false;
+    }
+
+    *sample = ring[ring_head++ & (PROFILE_RING_SIZE - 1)];
+    return true;
+}
+
+static size_t slot_for(const AddressSlot *table, size_t capacity, uint64_t key) {
+    size_t mask = capacity - 1;
+    size_t index = (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+
+    while (table[index].key != 0 && table[index].key != key) {
+        index = (index + 1) & mask;
+    }
+    return index;
+}
+
+/* Double the table once it is 70% full */
+static bool grow_addresses(void) {
+    size_t capacity = address_capacity ? address_capacity * 2 : 4096;
+    AddressSlot *table = calloc(capacity, sizeof(*table));
+
+    if (!table) {
+        return false;
+    }
+
+    for (size_t i = 0; i < address_capacity; i++) {
+        if (addresses[i].key != 0) {
+            table[slot_for(table, capacity, addresses[i].key)] = addresses[i];
+        }
+    }
+
+    free(addresses);
+    addresses = table;
+    address_capacity = capacity;
+    return true;
+}
+
+static void count_address(uint16_t segment, uint32_t offset) {
+    uint64_t key = ((uint64_t)segment << 32 | offset) + 1;
+    size_t index;
+
+    if ((address_count + 1) * 10 > address_capacity * 7 && !grow_addresses()) {
+        return;
+    }
+
+    index = slot_for(addresses, address_capacity, key);
+    if (addresses[index].key == 0) {
+        addresses[index].key = key;
+        address_count++;
+    }
+    addresses[index].samples++;
+}
+
+/* Move buffered samples into the histogram */
+void profiler_collect(void) {
+    ProfileSample sample;
+
+    while (ring_pop(&sample)) {
+        count_address(sample.regs.cs, sample.regs.eip);
+        segment_samples[sample.regs.cs]++;
+        total_samples++;
+
+        if (sample.has_regs) {
+            if (!history) {
+                history = malloc(PROFILE_HISTORY_SIZE * sizeof(*history));
+            }
+            if (history) {
+                history[history_count++ % PROFILE_HISTORY_SIZE] = sample;
+            }
+        }
+    }
+}
+
+static void reset_profile(void) {
+    ProfileSample sample;
+
+    while (ring_pop(&sample)) {
+    }
+    ring_dropped = 0;
+
+    free(addresses);
+    addresses = NULL;
+    address_capacity = address_count = 0;
+    memset(segment_samples, 0, sizeof(segment_samples));
+    total_samples = 0;
+    history_count = 0;
+
+    skipped = failed = 0;
+    memset(&round_trips, 0, sizeof(round_trips));
+    round_trip_total_ms = sampler_total_ms = 0.0;
+    sampler_calls = 0;
+}
+
+/* The profiled session's debugger, or NULL once it has gone away */
+static DbgClient *current_debugger(void) {
+    DosemuSession *session = dosemu_session_find(session_id);
+
+    return session && dosemu_session_state(session) == SESSION_RUNNING ?
+           dosemu_session_debugger(session) : NULL;
+}
+
+static void on_sample(bool ok, const DbgRegs *regs, void *data) {
+    unsigned sample_generation = (unsigned)(uintptr_t)data;
+    struct timespec begin;
+    ProfileSample sample;
+    double round_trip;
+
+    if (sample_generation != generation) {
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    read_outstanding = false;
+    round_trip = elapsed_ms(&read_issued, &begin);
+
+    if (!ok) {
+        failed++;
+        return;
+    }
+
+    latency_record(&round_trips, round_trip);
+    round_trip_total_ms += round_trip;
+
+    sample.time_ms = elapsed_ms(&started, &begin);
+    sample.has_regs = record_regs;
+    sample.regs = *regs;
+    ring_push(&sample);
+
+    sampler_total_ms += ms_since(&begin);
+    sampler_calls++;
+}
+
+static int on_sample_tick(void *data) {
+    unsigned tick_generation = (unsigned)(uintptr_t)data;
+    struct timespec begin;
+    DbgClient *debugger;
+
+    if (!running || tick_generation != generation) {
+        return 0;
+    }
+
+    debugger = current_debugger();
+    if (!debugger) {
+        profiler_stop();
+        return 0;
+    }
+
+    /* Never queue reads faster than the guest answers them */
+    if (read_outstanding) {
+        skipped++;
+        return 1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    read_issued = begin;
+    if (dbg_regs(debugger, on_sample, (void *)(uintptr_t)generation)) {
+        read_outstanding = true;
+    } else {
+        failed++;
+    }
+    sampler_total_ms += ms_since(&begin);
+
+    return 1;
+}
+
+/* Start sampling a running session */
+bool profiler_start(DosemuSession *session, int requested_hz, bool full_regs) {
+    if (!session || dosemu_session_state(session) != SESSION_RUNNING ||
+        requested_hz <= 0 || requested_hz > PROFILE_MAX_RATE_HZ) {
+        return false;
+    }
+
+    profiler_stop();
+    reset_profile();
+
+    generation++;
+    session_id = dosemu_session_id(session);
+    rate_hz = requested_hz;
+    record_regs = full_regs;
+    read_outstanding = false;
+    running = true;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+
+    uiTimer(1000 / rate_hz > 0 ? 1000 / rate_hz : 1, on_sample_tick,
+            (void *)(uintptr_t)generation);
+    return true;
+}
+
+/* Stop sampling; the profile is kept for viewing and export */
+void profiler_stop(void) {
+    if (!running) {
+        return;
+    }
+
+    running = false;
+    generation++;
+    clock_gettime(CLOCK_MONOTONIC, &stopped);
+    profiler_collect();
+}
+
+bool profiler_running(void) {
+    return running;
+}
+
+static int compare_entries(const void *a, const void *b) {
+    const ProfileEntry *left = a, *right = b;
+
+    if (left->samples != right->samples) {
+        return left->samples < right->samples ? 1 : -1;
+    }
+    if (left->segment != right->segment) {
+        return left->segment < right->segment ? -1 : 1;
+    }
+    return left->offset < right->offset ? -1 : left->offset > right->offset;
+}
+
+/* Every sampled address, hottest first; the caller frees the result */
+static ProfileEntry *sorted_entries(size_t *count) {
+    ProfileEntry *entries = malloc((address_count ? address_count : 1) * sizeof(*entries));
+    size_t used = 0;
+
+    if (!entries) {
+        *count = 0;
+        return NULL;
+    }
+
+    for (size_t i = 0; i < address_capacity; i++) {
+        if (addresses[i].key != 0) {
+            uint64_t key = addresses[i].key - 1;
+            entries[used].segment = (uint16_t)(key >> 32);
+            entries[used].offset = (uint32_t)key;
+            entries[used].samples = addresses[i].samples;
+            used++;
+        }
+    }
+
+    qsort(entries, used, sizeof(*entries), compare_entries);
+    *count = used;
+    return entries;
+}
+
+/* Most sampled addresses, hottest first */
+size_t profiler_top(ProfileEntry *out, size_t max) {
+    size_t count;
+    ProfileEntry *entries = sorted_entries(&count);
+
+    if (count > max) {
+        count = max;
+    }
+    if (entries) {
+        memcpy(out, entries, count * sizeof(*out));
+    }
+    free(entries);
+    return count;
+}
+
+uint64_t profiler_total_samples(void) {
+    return total_samples;
+}
+
+uint64_t profiler_segment_samples(uint16_t segment) {
+    return segment_samples[segment];
+}
+
+void profiler_stats(ProfileStats *stats) {
+    double wall_ms = running ? ms_since(&started) : elapsed_ms(&started, &stopped);
+    uint64_t answered = round_trips.total;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->requested_hz = rate_hz;
+    stats->achieved_hz = wall_ms > 0.0 ? (double)answered * 1000.0 / wall_ms : 0.0;
+    stats->samples = total_samples;
+    stats->skipped = skipped;
+    stats->dropped = ring_dropped;
+    stats->failed = failed;
+    stats->round_trip_p50_ms = latency_percentile(&round_trips, 0.50);
+    stats->round_trip_p99_ms = latency_percentile(&round_trips, 0.99);
+    stats->debugger_busy_percent = wall_ms > 0.0 ? round_trip_total_ms * 100.0 / wall_ms : 0.0;
+    stats->sampler_us = answered ? sampler_total_ms * 1000.0 / (double)answered : 0.0;
+}
+
+/* Brendan Gregg's folded format: segment;address count */
+bool profiler_export_folded(const char *path) {
+    size_t count;
+    ProfileEntry *entries;
+    FILE *file = fopen(path, "w");
+    bool ok;
+
+    if (!file) {
+        return false;
+    }
+
+    profiler_collect();
+    entries = sorted_entries(&count);
+    for (size_t i = 0; i < count; i++) {
+        fprintf(file, "dosemu;%04X;%04X:%04X %llu\n", entries[i].segment, entries[i].segment,
+                (unsigned)entries[i].offset, (unsigned long long)entries[i].samples);
+    }
+    free(entries);
+
+    ok = !ferror(file);
+    return fclose(file) == 0 && ok;
+}
+
+/* Text in the layout of "pprof -top", with segment totals as cum */
+bool profiler_export_pprof(const char *path) {
+    size_t count;
+    ProfileEntry *entries;
+    FILE *file = fopen(path, "w");
+    double total, sum = 0.0;
+    bool ok;
+
+    if (!file) {
+        return false;
+    }
+
+    profiler_collect();
+    entries = sorted_entries(&count);
+    total = total_samples ? (double)total_samples : 1.0;
+
+    fprintf(file, "Type: samples\n");
+    fprintf(file, "Showing nodes accounting for %llu samples, 100%% of %llu total\n",
+            (unsigned long long)total_samples, (unsigned long long)total_samples);
+    fprintf(file, "%10s %7s %7s %10s %7s\n", "flat", "flat%", "sum%", "cum", "cum%");
+    for (size_t i = 0; i < count; i++) {
+        uint64_t cum = segment_samples[entries[i].segment];
+
+        sum += (double)entries[i].samples;
+        fprintf(file, "%10llu %6.2f%% %6.2f%% %10llu %6.2f%%  %04X:%04X\n",
+                (unsigned long long)entries[i].samples,
+                (double)entries[i].samples * 100.0 / total, sum * 100.0 / total,
+                (unsigned long long)cum, (double)cum * 100.0 / total,
+                entries[i].segment, (unsigned)entries[i].offset);
+    }
+    free(entries);
+
+    ok = !ferror(file);
+    return fclose(file) == 0 && ok;
+}
+
+/* Recorded register files as CSV, oldest first */
+bool profiler_export_samples(const char *path) {
+    FILE *file = fopen(path, "w");
+    uint64_t first;
+    bool ok;
+
+    if (!file) {
+        return false;
+    }
+
+    profiler_collect();
+    first = history_count > PROFILE_HISTORY_SIZE ? history_count - PROFILE_HISTORY_SIZE : 0;
+
+    fprintf(file, "time_ms,cs,eip,ss,esp,ds,es,fs,gs,eax,ebx,ecx,edx,esi,edi,ebp,eflags\n");
+    for (uint64_t i = first; i < history_count; i++) {
+        const ProfileSample *sample = &history[i % PROFILE_HISTORY_SIZE];
+        const DbgRegs *r = &sample->regs;
+
+        fprintf(file, "%.3f,%04X,%08X,%04X,%08X,%04X,%04X,%04X,%04X,"
+                "%08X,%08X,%08X,%08X,%08X,%08X,%08X,%08X\n",
+                sample->time_ms, r->cs, r->eip, r->ss, r->esp, r->ds, r->es, r->fs, r->gs,
+                r->eax, r->ebx, r->ecx, r->edx, r->esi, r->edi, r->ebp, r->eflags);
+    }
+
+    ok = !ferror(file);
+    return fclose(file) == 0 && ok;
+}
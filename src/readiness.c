@@ -0,0 +1,358 @@
+#define _GNU_SOURCE
+
+#include "../include/readiness.h"
+#include "../include/io_loop.h"
+#include "../include/pidfd.h"
+#include "../include/headless.h"
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+#include <time.h>
+
+/* How far up the process tree a FIFO owner may be from our child */
+#define MAX_ANCESTRY_DEPTH 16
+
+/* Directories DOSEmu may use for its runtime files */
+#define MAX_RUNTIME_DIRS 2
+
+struct ReadinessWatch {
+    pid_t pid;
+    int timeout_ms;
+    readiness_callback callback;
+    void *data;
+    struct timespec started;
+
+    /* I/O thread state */
+    int inotify_fd;
+    int pid_fd;
+    int timeout_id;
+    char dirs[MAX_RUNTIME_DIRS][PATH_MAX];
+    int wd[MAX_RUNTIME_DIRS];
+    int dir_count;
+
+    /* Result, handed to the UI thread */
+    bool finished;
+    bool cancelled;
+    ReadinessResult result;
+    char endpoint[PATH_MAX];
+    double elapsed_ms;
+};
+
+static double elapsed_ms_since(const struct timespec *start) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) * 1000.0 +
+           (double)(now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+/* Parent of pid from /proc, or -1 */
+static pid_t parent_of(pid_t pid) {
+    char path[64];
+    char stat[512];
+    ssize_t len;
+    int fd, ppid;
+    char *end;
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    len = read(fd, stat, sizeof(stat) - 1);
+    close(fd);
+    if (len <= 0) {
+        return -1;
+    }
+    stat[len] = '\0';
+
+    /* The command name may itself contain ") " */
+    end = strrchr(stat, ')');
+    if (!end || sscanf(end + 1, " %*c %d", &ppid) != 1) {
+        return -1;
+    }
+    return (pid_t)ppid;
+}
+
+/* The dosemu launcher script may fork the real emulator binary */
+static bool is_same_or_descendant(pid_t pid, pid_t ancestor) {
+    for (int depth = 0; depth < MAX_ANCESTRY_DEPTH && pid > 1; depth++) {
+        if (pid == ancestor) {
+            return true;
+        }
+        pid = parent_of(pid);
+    }
+    return false;
+}
+
+/* Does a runtime directory entry name the debug FIFO of our DOSEmu? */
+static bool matches_endpoint(const ReadinessWatch *watch, const char *name) {
+    size_t prefix_len = strlen(DOSEMU_DEBUG_FIFO_PREFIX);
+    char *end;
+    long owner;
+
+    if (strncmp(name, DOSEMU_DEBUG_FIFO_PREFIX, prefix_len) != 0) {
+        return false;
+    }
+
+    owner = strtol(name + prefix_len, &end, 10);
+    if (end == name + prefix_len || *end != '\0' || owner <= 0) {
+        return false;
+    }
+
+    return is_same_or_descendant((pid_t)owner, watch->pid);
+}
+
+static void deliver_result(void *data) {
+    ReadinessWatch *watch = data;
+
+    if (!watch->cancelled) {
+        watch->callback(watch->result, watch->result == READINESS_READY ? watch->endpoint : NULL,
+                        watch->elapsed_ms, watch->data);
+    }
+    free(watch);
+}
+
+/* Release the I/O thread resources of a watch */
+static void teardown(ReadinessWatch *watch) {
+    if (watch->inotify_fd >= 0) {
+        io_loop_remove_fd(watch->inotify_fd);
+        close(watch->inotify_fd);
+        watch->inotify_fd = -1;
+    }
+    if (watch->pid_fd >= 0) {
+        io_loop_remove_fd(watch->pid_fd);
+        close(watch->pid_fd);
+        watch->pid_fd = -1;
+    }
+    if (watch->timeout_id >= 0) {
+        io_loop_cancel_timeout(watch->timeout_id);
+        watch->timeout_id = -1;
+    }
+}
+
+static void finish(ReadinessWatch *watch, ReadinessResult result, const char *endpoint) {
+    if (watch->finished) {
+        return;
+    }
+
+    watch->finished = true;
+    watch->result = result;
+    watch->elapsed_ms = elapsed_ms_since(&watch->started);
+    if (endpoint) {
+        snprintf(watch->endpoint, sizeof(watch->endpoint), "%s", endpoint);
+    }
+
+    teardown(watch);
+    main_queue(deliver_result, watch);
+}
+
+/* Look for an endpoint that was created before the inotify watch existed */
+static bool scan_existing(ReadinessWatch *watch) {
+    for (int i = 0; i < watch->dir_count; i++) {
+        DIR *dir = opendir(watch->dirs[i]);
+        struct dirent *entry;
+
+        if (!dir) {
+            continue;
+        }
+
+        while ((entry = readdir(dir)) != NULL) {
+            if (matches_endpoint(watch, entry->d_name)) {
+                char path[PATH_MAX * 2];
+                snprintf(path, sizeof(path), "%s/%s", watch->dirs[i], entry->d_name);
+                closedir(dir);
+                finish(watch, READINESS_READY, path);
+                return true;
+            }
+        }
+        closedir(dir);
+    }
+    return false;
+}
+
+static void on_inotify(int fd, uint32_t events, void *data) {
+    ReadinessWatch *watch = data;
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+
+    while ((len = read(fd, buffer, sizeof(buffer))) > 0) {
+        for (char *p = buffer; p < buffer + len;) {
+            struct inotify_event *event = (struct inotify_event *)p;
+            p += sizeof(*event) + event->len;
+
+            if (event->len == 0 || !matches_endpoint(watch, event->name)) {
+                continue;
+            }
+
+            for (int i = 0; i < watch->dir_count; i++) {
+                if (watch->wd[i] == event->wd) {
+                    char path[PATH_MAX * 2];
+                    snprintf(path, sizeof(path), "%s/%s", watch->dirs[i], event->name);
+                    finish(watch, READINESS_READY, path);
+                    return;
+                }
+            }
+        }
+    }
+}
+
+static void on_pidfd(int fd, uint32_t events, void *data) {
+    ReadinessWatch *watch = data;
+
+    /* The FIFO may have been created just before the exit */
+    if (!scan_existing(watch)) {
+        finish(watch, READINESS_EXITED, NULL);
+    }
+}
+
+static void on_timeout(int id, uint32_t events, void *data) {
+    ReadinessWatch *watch = data;
+
+    watch->timeout_id = -1;
+    if (!scan_existing(watch)) {
+        finish(watch, READINESS_TIMEOUT, NULL);
+    }
+}
+
+static bool is_directory(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+/* Collect the runtime directories DOSEmu may create its FIFO in */
+static void find_runtime_dirs(ReadinessWatch *watch) {
+    const char *xdg = getenv("XDG_RUNTIME_DIR");
+    const char *home = getenv("HOME");
+    char path[PATH_MAX];
+
+    watch->dir_count = 0;
+
+    if (xdg && *xdg) {
+        snprintf(path, sizeof(path), "%s/dosemu2", xdg);
+        if (is_directory(path)) {
+            snprintf(watch->dirs[watch->dir_count++], PATH_MAX, "%s", path);
+        }
+    }
+
+    if (home && *home) {
+        snprintf(path, sizeof(path), "%s/.dosemu/run", home);
+        if (!is_directory(path) && watch->dir_count == 0) {
+            /* First run: create the directory DOSEmu would create */
+            char parent[PATH_MAX];
+            snprintf(parent, sizeof(parent), "%s/.dosemu", home);
+            mkdir(parent, 0755);
+            mkdir(path, 0755);
+        }
+        if (is_directory(path)) {
+            snprintf(watch->dirs[watch->dir_count++], PATH_MAX, "%s", path);
+        }
+    }
+}
+
+static void setup(void *data) {
+    ReadinessWatch *watch = data;
+
+    find_runtime_dirs(watch);
+    if (watch->dir_count == 0) {
+        finish(watch, READINESS_ERROR, NULL);
+        return;
+    }
+
+    watch->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch->inotify_fd < 0) {
+        finish(watch, READINESS_ERROR, NULL);
+        return;
+    }
+
+    for (int i = 0; i < watch->dir_count; i++) {
+        watch->wd[i] = inotify_add_watch(watch->inotify_fd, watch->dirs[i],
+                                         IN_CREATE | IN_MOVED_TO);
+    }
+
+    if (!io_loop_add_fd(watch->inotify_fd, EPOLLIN, on_inotify, watch)) {
+        finish(watch, READINESS_ERROR, NULL);
+        return;
+    }
+
+    /* pidfd becomes readable when the child exits; older kernels lack it */
+    watch->pid_fd = pidfd_open_pid(watch->pid);
+    if (watch->pid_fd >= 0 && !io_loop_add_fd(watch->pid_fd, EPOLLIN, on_pidfd, watch)) {
+        close(watch->pid_fd);
+        watch->pid_fd = -1;
+    }
+
+    watch->timeout_id = io_loop_add_timeout(watch->timeout_ms, on_timeout, watch);
+
+    /* The FIFO may already exist if DOSEmu was quick */
+    scan_existing(watch);
+}
+
+static void cancel(void *data) {
+    ReadinessWatch *watch = data;
+
+    if (!watch->finished) {
+        teardown(watch);
+    }
+}
+
+/* Wait for DOSEmu to create its debug FIFO */
+ReadinessWatch *readiness_watch_start(pid_t pid, int timeout_ms,
+                                      readiness_callback callback, void *data) {
+    ReadinessWatch *watch = calloc(1, sizeof(*watch));
+    if (!watch) {
+        return NULL;
+    }
+
+    watch->pid = pid;
+    watch->timeout_ms = timeout_ms > 0 ? timeout_ms : DEFAULT_ATTACH_TIMEOUT_MS;
+    watch->callback = callback;
+    watch->data = data;
+    watch->inotify_fd = -1;
+    watch->pid_fd = -1;
+    watch->timeout_id = -1;
+    clock_gettime(CLOCK_MONOTONIC, &watch->started);
+
+    if (!io_loop_post(setup, watch)) {
+        free(watch);
+        return NULL;
+    }
+
+    return watch;
+}
+
+/* Stop waiting */
+void readiness_watch_cancel(ReadinessWatch *watch) {
+    if (!watch) {
+        return;
+    }
+
+    io_loop_call(cancel, watch);
+
+    /* A finished watch is freed by its pending delivery */
+    if (watch->finished) {
+        watch->cancelled = true;
+    } else {
+        free(watch);
+    }
+}
+
+/* Human-readable name of a result */
+const char *readiness_result_name(ReadinessResult result) {
+    switch (result) {
+    case READINESS_READY:
+        return "ready";
+    case READINESS_EXITED:
+        return "exited";
+    case READINESS_TIMEOUT:
+        return "timed out";
+    case READINESS_ERROR:
+        return "watch failed";
+    }
+    return "unknown";
+}
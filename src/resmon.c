@@ -0,0 +1,317 @@
+#define _GNU_SOURCE
+
+#include "../include/resmon.h"
+#include "../include/dosemu_integration.h"
+#include "../include/trace.h"
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Large enough for /proc/<pid>/stat and /proc/<pid>/io */
+#define RESMON_READ_SIZE 1024
+
+/* Window over which the sampler's own CPU time is reported */
+#define RESMON_OVERHEAD_WINDOW_NS 5000000000ULL
+
+/* A monitored process and the /proc files kept open for it */
+typedef struct Instance {
+    ResourceHistory history;
+    bool used;
+    bool seen;
+    int stat_fd;
+    int statm_fd;
+    int io_fd;           /* -1 if the kernel will not show our I/O counters */
+    uint64_t last_ns;
+    uint64_t due_ns;
+    unsigned long long last_cpu_ticks;
+    unsigned long long last_io_bytes;
+    int quiet_samples;
+} Instance;
+
+/* Slots stay put; order lists the used ones in session table order */
+static Instance instances[MAX_SESSIONS];
+static int order[MAX_SESSIONS];
+static int order_count = 0;
+
+/* Every read lands here; resmon is UI thread only */
+static char read_buffer[RESMON_READ_SIZE];
+
+static long clock_ticks = 0;
+static long page_size = 0;
+
+static uint64_t window_start_ns = 0;
+static uint64_t window_cpu_ns = 0;
+static double overhead_percent = 0.0;
+
+static uint64_t thread_cpu_now(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+static int open_proc(pid_t pid, const char *name) {
+    char path[64];
+
+    snprintf(path, sizeof(path), "/proc/%d/%s", (int)pid, name);
+    return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+/* Read a whole /proc file into read_buffer; false once the process is gone */
+static bool read_proc(int fd) {
+    ssize_t length = pread(fd, read_buffer, sizeof(read_buffer) - 1, 0);
+
+    if (length <= 0) {
+        return false;
+    }
+    read_buffer[length] = '\0';
+    return true;
+}
+
+static void close_instance(Instance *instance) {
+    close(instance->stat_fd);
+    close(instance->statm_fd);
+    if (instance->io_fd >= 0) {
+        close(instance->io_fd);
+    }
+    instance->used = false;
+}
+
+static Instance *open_instance(int session_id, pid_t pid) {
+    Instance *instance = NULL;
+
+    for (int i = 0; i < MAX_SESSIONS && !instance; i++) {
+        if (!instances[i].used) {
+            instance = &instances[i];
+        }
+    }
+    if (!instance) {
+        return NULL;
+    }
+
+    instance->stat_fd = open_proc(pid, "stat");
+    instance->statm_fd = open_proc(pid, "statm");
+    if (instance->stat_fd < 0 || instance->statm_fd < 0) {
+        if (instance->stat_fd >= 0) {
+            close(instance->stat_fd);
+        }
+        if (instance->statm_fd >= 0) {
+            close(instance->statm_fd);
+        }
+        return NULL;
+    }
+    instance->io_fd = open_proc(pid, "io");
+
+    memset(&instance->history, 0, sizeof(instance->history));
+    instance->history.session_id = session_id;
+    instance->history.pid = pid;
+    instance->history.interval_ms = RESMON_FAST_MS;
+    instance->used = true;
+    instance->last_ns = 0;
+    instance->due_ns = 0;
+    instance->quiet_samples = 0;
+    return instance;
+}
+
+static Instance *find_instance(int session_id, pid_t pid, int hint) {
+    if (hint < order_count) {
+        Instance *instance = &instances[order[hint]];
+        if (instance->used && instance->history.session_id == session_id &&
+            instance->history.pid == pid) {
+            return instance;
+        }
+    }
+    for (int i = 0; i < MAX_SESSIONS; i++) {
+        if (instances[i].used && instances[i].history.session_id == session_id &&
+            instances[i].history.pid == pid) {
+            return &instances[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Follow the session table: open files for new processes, close them for
+ * ended ones. True if the set of instances changed.
+ */
+static bool sync_sessions(void) {
+    int count = 0;
+    bool changed = false;
+
+    for (int i = 0; i < MAX_SESSIONS; i++) {
+        instances[i].seen = false;
+    }
+
+    for (int i = 0; i < dosemu_session_count(); i++) {
+        DosemuSession *session = dosemu_session_at(i);
+        pid_t pid = dosemu_session_pid(session);
+        Instance *instance;
+
+        if (pid <= 0) {
+            continue;
+        }
+        instance = find_instance(dosemu_session_id(session), pid, count);
+        if (!instance) {
+            instance = open_instance(dosemu_session_id(session), pid);
+            changed = changed || instance != NULL;
+        }
+        if (instance) {
+            instance->seen = true;
+            order[count++] = (int)(instance - instances);
+        }
+    }
+    order_count = count;
+
+    for (int i = 0; i < MAX_SESSIONS; i++) {
+        if (instances[i].used && !instances[i].seen) {
+            close_instance(&instances[i]);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+/* utime + stime from /proc/<pid>/stat, skipping the command name, which may hold spaces */
+static bool parse_cpu_ticks(unsigned long long *ticks) {
+    char *p = strrchr(read_buffer, ')');
+    unsigned long long utime, stime;
+
+    if (!p) {
+        return false;
+    }
+    /* Fields after the name start at 3 (state); utime is 14, stime 15 */
+    for (int field = 3; field < 14; field++) {
+        p = strchr(p + 1, ' ');
+        if (!p) {
+            return false;
+        }
+    }
+    utime = strtoull(p + 1, &p, 10);
+    stime = strtoull(p, NULL, 10);
+    *ticks = utime + stime;
+    return true;
+}
+
+/* rchar + wchar from /proc/<pid>/io */
+static unsigned long long parse_io_bytes(void) {
+    const char *rchar = strstr(read_buffer, "rchar:");
+    const char *wchar = strstr(read_buffer, "wchar:");
+
+    return (rchar ? strtoull(rchar + 6, NULL, 10) : 0) +
+           (wchar ? strtoull(wchar + 6, NULL, 10) : 0);
+}
+
+static void sample_instance(Instance *instance, uint64_t now) {
+    ResourceHistory *history = &instance->history;
+    unsigned long long cpu_ticks, io_bytes = 0, size_pages, resident_pages = 0;
+    double elapsed_s = (double)(now - instance->last_ns) / 1e9;
+    uint32_t slot = history->samples % RESMON_HISTORY;
+    float cpu, io;
+
+    if (!read_proc(instance->stat_fd) || !parse_cpu_ticks(&cpu_ticks)) {
+        /* Exited; sync_sessions() closes it once the session notices */
+        instance->due_ns = UINT64_MAX;
+        return;
+    }
+    if (read_proc(instance->statm_fd) &&
+        sscanf(read_buffer, "%llu %llu", &size_pages, &resident_pages) != 2) {
+        resident_pages = 0;
+    }
+    if (instance->io_fd >= 0 && read_proc(instance->io_fd)) {
+        io_bytes = parse_io_bytes();
+    }
+
+    /* The first read only sets the baseline for the rates */
+    if (instance->last_ns != 0 && elapsed_s > 0) {
+        cpu = (float)((double)(cpu_ticks - instance->last_cpu_ticks) / (double)clock_ticks /
+                      elapsed_s * 100.0);
+        io = (float)((double)(io_bytes - instance->last_io_bytes) / 1024.0 / elapsed_s);
+
+        history->values[RESOURCE_CPU][slot] = cpu;
+        history->values[RESOURCE_RSS][slot] =
+            (float)((double)resident_pages * (double)page_size / (1024.0 * 1024.0));
+        history->values[RESOURCE_IO][slot] = io;
+        history->samples++;
+
+        if (cpu >= RESMON_BUSY_CPU_PERCENT || io >= RESMON_BUSY_IO_KB_S) {
+            instance->quiet_samples = 0;
+            history->interval_ms = RESMON_FAST_MS;
+        } else if (++instance->quiet_samples >= RESMON_QUIET_SAMPLES) {
+            history->interval_ms = RESMON_SLOW_MS;
+        }
+    }
+
+    instance->last_cpu_ticks = cpu_ticks;
+    instance->last_io_bytes = io_bytes;
+    instance->last_ns = now;
+    instance->due_ns = now + (uint64_t)history->interval_ms * 1000000ULL;
+}
+
+bool resmon_sample(void) {
+    uint64_t cpu_start = thread_cpu_now();
+    uint64_t now = trace_now();
+    int previous_count = order_count;
+    bool changed = false;
+
+    if (clock_ticks == 0) {
+        clock_ticks = sysconf(_SC_CLK_TCK);
+        page_size = sysconf(_SC_PAGESIZE);
+        window_start_ns = now;
+    }
+
+    if (sync_sessions() || order_count != previous_count) {
+        changed = true;
+    }
+
+    /* Sampling slightly early keeps a due instance from slipping a whole tick */
+    for (int i = 0; i < order_count; i++) {
+        Instance *instance = &instances[order[i]];
+
+        if (instance->due_ns <= now + RESMON_FAST_MS * 1000000ULL / 4) {
+            sample_instance(instance, now);
+            changed = true;
+        }
+    }
+
+    window_cpu_ns += thread_cpu_now() - cpu_start;
+    if (now - window_start_ns >= RESMON_OVERHEAD_WINDOW_NS) {
+        overhead_percent = (double)window_cpu_ns / (double)(now - window_start_ns) * 100.0;
+        window_cpu_ns = 0;
+        window_start_ns = now;
+    }
+    return changed;
+}
+
+int resmon_count(void) {
+    return order_count;
+}
+
+const ResourceHistory *resmon_at(int index) {
+    if (index < 0 || index >= order_count) {
+        return NULL;
+    }
+    return &instances[order[index]].history;
+}
+
+int resmon_filled(const ResourceHistory *history) {
+    return history->samples < RESMON_HISTORY ? (int)history->samples : RESMON_HISTORY;
+}
+
+float resmon_value(const ResourceHistory *history, ResourceSeries series, int i) {
+    uint32_t oldest = history->samples - (uint32_t)resmon_filled(history);
+
+    return history->values[series][(oldest + (uint32_t)i) % RESMON_HISTORY];
+}
+
+double resmon_overhead_percent(void) {
+    return overhead_percent;
+}
+
+void resmon_close(void) {
+    for (int i = 0; i < MAX_SESSIONS; i++) {
+        if (instances[i].used) {
+            close_instance(&instances[i]);
+        }
+    }
+    order_count = 0;
+}
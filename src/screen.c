@@ -0,0 +1,341 @@
+#define _GNU_SOURCE
+
+#include "../include/screen.h"
+#include "../include/dbg_client.h"
+#include "../include/dosemu_integration.h"
+#include "../include/trace.h"
+
+/* BIOS data area from 0040:0049 (video mode) to 0040:0084 (rows - 1) */
+#define BDA_SEGMENT 0x40
+#define BDA_OFFSET 0x49
+#define BDA_LENGTH (0x84 - BDA_OFFSET + 1)
+#define BDA_MODE 0
+#define BDA_COLUMNS 1      /* word */
+#define BDA_PAGE_START 5   /* word, byte offset of the active page */
+#define BDA_LAST_ROW (0x84 - BDA_OFFSET)
+
+typedef struct Mirror {
+    ScreenMirror screen;
+    uint64_t dirty_rows;
+    bool seen;
+
+    /* The frame being fetched */
+    bool fetching;
+    bool failed;
+    bool fetch_text;       /* the text buffer was requested too */
+    int pending;           /* replies still due */
+    unsigned frame_id;
+    uint64_t due_ns;
+    uint16_t page_start;
+    uint8_t bda[BDA_LENGTH];
+    uint8_t frame[SCREEN_MAX_ROWS * SCREEN_MAX_COLUMNS * 2];
+} Mirror;
+
+/* One reply of a frame; the mirror may be gone by the time it lands */
+typedef struct FramePart {
+    int session_id;
+    unsigned frame_id;
+    bool bda;
+    size_t offset;         /* into the frame, for the text buffer */
+} FramePart;
+
+static Mirror *mirrors[SCREEN_MAX_MIRRORS];
+static int mirror_count = 0;
+
+/* Code page 437, for the characters outside printable ASCII */
+static const uint16_t cp437_low[32] = {
+    0x0020, 0x263A, 0x263B, 0x2665, 0x2666, 0x2663, 0x2660, 0x2022,
+    0x25D8, 0x25CB, 0x25D9, 0x2642, 0x2640, 0x266A, 0x266B, 0x263C,
+    0x25BA, 0x25C4, 0x2195, 0x203C, 0x00B6, 0x00A7, 0x25AC, 0x21A8,
+    0x2191, 0x2193, 0x2192, 0x2190, 0x221F, 0x2194, 0x25B2, 0x25BC
+};
+
+static const uint16_t cp437_high[128] = {
+    0x00C7, 0x00FC, 0x00E9, 0x00E2, 0x00E4, 0x00E0, 0x00E5, 0x00E7,
+    0x00EA, 0x00EB, 0x00E8, 0x00EF, 0x00EE, 0x00EC, 0x00C4, 0x00C5,
+    0x00C9, 0x00E6, 0x00C6, 0x00F4, 0x00F6, 0x00F2, 0x00FB, 0x00F9,
+    0x00FF, 0x00D6, 0x00DC, 0x00A2, 0x00A3, 0x00A5, 0x20A7, 0x0192,
+    0x00E1, 0x00ED, 0x00F3, 0x00FA, 0x00F1, 0x00D1, 0x00AA, 0x00BA,
+    0x00BF, 0x2310, 0x00AC, 0x00BD, 0x00BC, 0x00A1, 0x00AB, 0x00BB,
+    0x2591, 0x2592, 0x2593, 0x2502, 0x2524, 0x2561, 0x2562, 0x2556,
+    0x2555, 0x2563, 0x2551, 0x2557, 0x255D, 0x255C, 0x255B, 0x2510,
+    0x2514, 0x2534, 0x252C, 0x251C, 0x2500, 0x253C, 0x255E, 0x255F,
+    0x255A, 0x2554, 0x2569, 0x2566, 0x2560, 0x2550, 0x256C, 0x2567,
+    0x2568, 0x2564, 0x2565, 0x2559, 0x2558, 0x2552, 0x2553, 0x256B,
+    0x256A, 0x2518, 0x250C, 0x2588, 0x2584, 0x258C, 0x2590, 0x2580,
+    0x03B1, 0x00DF, 0x0393, 0x03C0, 0x03A3, 0x03C3, 0x00B5, 0x03C4,
+    0x03A6, 0x0398, 0x03A9, 0x03B4, 0x221E, 0x03C6, 0x03B5, 0x2229,
+    0x2261, 0x00B1, 0x2265, 0x2264, 0x2320, 0x2321, 0x00F7, 0x2248,
+    0x00B0, 0x2219, 0x00B7, 0x221A, 0x207F, 0x00B2, 0x25A0, 0x00A0
+};
+
+size_t screen_char_utf8(uint8_t character, char *out) {
+    uint16_t code;
+
+    if (character >= 0x20 && character < 0x7f) {
+        out[0] = (char)character;
+        return 1;
+    }
+    code = character < 0x20 ? cp437_low[character]
+           : character == 0x7f ? 0x2302
+           : cp437_high[character - 0x80];
+
+    if (code < 0x80) {
+        out[0] = (char)code;
+        return 1;
+    }
+    if (code < 0x800) {
+        out[0] = (char)(0xC0 | (code >> 6));
+        out[1] = (char)(0x80 | (code & 0x3F));
+        return 2;
+    }
+    out[0] = (char)(0xE0 | (code >> 12));
+    out[1] = (char)(0x80 | ((code >> 6) & 0x3F));
+    out[2] = (char)(0x80 | (code & 0x3F));
+    return 3;
+}
+
+static Mirror *find_mirror(int session_id) {
+    for (int i = 0; i < mirror_count; i++) {
+        if (mirrors[i]->screen.session_id == session_id) {
+            return mirrors[i];
+        }
+    }
+    return NULL;
+}
+
+static uint64_t all_rows(int rows) {
+    return rows >= 64 ? ~0ULL : (1ULL << rows) - 1;
+}
+
+/* Compare a complete frame with the last one and keep the rows that differ */
+static void finish_frame(Mirror *mirror) {
+    ScreenMirror *screen = &mirror->screen;
+    uint8_t mode = mirror->bda[BDA_MODE];
+    int columns = mirror->bda[BDA_COLUMNS] | mirror->bda[BDA_COLUMNS + 1] << 8;
+    int rows = mirror->bda[BDA_LAST_ROW] + 1;
+    uint16_t page_start = (uint16_t)(mirror->bda[BDA_PAGE_START] |
+                                     mirror->bda[BDA_PAGE_START + 1] << 8);
+    bool text_mode = mode <= 3 || mode == 7;
+    bool changed = false;
+
+    mirror->fetching = false;
+    if (mirror->failed) {
+        return;
+    }
+
+    /* Some BIOSes leave the row count at 0 */
+    if (rows < 25 || rows > SCREEN_MAX_ROWS) {
+        rows = 25;
+    }
+    if (columns < 40 || columns > SCREEN_MAX_COLUMNS) {
+        columns = 80;
+    }
+    screen->frames++;
+
+    /* The text read with the old geometry does not fit the new one: read again now */
+    if (text_mode != screen->text_mode || mode != screen->video_mode ||
+        columns != screen->columns || rows != screen->rows ||
+        page_start != mirror->page_start || !mirror->fetch_text) {
+        screen->text_mode = text_mode;
+        screen->video_mode = mode;
+        screen->columns = columns;
+        screen->rows = rows;
+        mirror->page_start = page_start;
+        memset(screen->cells, 0, sizeof(screen->cells));
+        mirror->dirty_rows = all_rows(SCREEN_MAX_ROWS);
+        screen->valid = !text_mode;
+        screen->changed_frames++;
+        if (text_mode) {
+            mirror->due_ns = 0;
+        }
+        return;
+    }
+
+    for (int row = 0; row < rows; row++) {
+        uint16_t *cells = screen->cells + row * columns;
+        const uint8_t *bytes = mirror->frame + (size_t)row * (size_t)columns * 2;
+        uint16_t difference = 0;
+
+        for (int column = 0; column < columns; column++) {
+            uint16_t cell = (uint16_t)(bytes[column * 2] | bytes[column * 2 + 1] << 8);
+            difference |= cell ^ cells[column];
+            cells[column] = cell;
+        }
+        if (difference || !screen->valid) {
+            mirror->dirty_rows |= 1ULL << row;
+            changed = true;
+        }
+    }
+    screen->valid = true;
+    if (changed) {
+        screen->changed_frames++;
+    }
+}
+
+static void on_part_read(bool ok, uint16_t segment, uint32_t offset, const uint8_t *bytes,
+                         size_t len, void *data) {
+    FramePart *part = data;
+    Mirror *mirror = find_mirror(part->session_id);
+
+    if (mirror && mirror->fetching && mirror->frame_id == part->frame_id) {
+        if (!ok) {
+            mirror->failed = true;
+        } else if (part->bda) {
+            memcpy(mirror->bda, bytes, len < BDA_LENGTH ? len : BDA_LENGTH);
+            mirror->failed |= len < BDA_LENGTH;
+        } else if (part->offset + len <= sizeof(mirror->frame)) {
+            memcpy(mirror->frame + part->offset, bytes, len);
+        }
+        if (--mirror->pending == 0) {
+            finish_frame(mirror);
+        }
+    }
+    free(part);
+}
+
+static bool request_part(DbgClient *debugger, Mirror *mirror, uint16_t segment, uint32_t offset,
+                         size_t len, bool bda, size_t frame_offset) {
+    FramePart *part = malloc(sizeof(*part));
+
+    if (!part) {
+        return false;
+    }
+    part->session_id = mirror->screen.session_id;
+    part->frame_id = mirror->frame_id;
+    part->bda = bda;
+    part->offset = frame_offset;
+
+    if (!dbg_read_mem(debugger, segment, offset, len, on_part_read, part)) {
+        free(part);
+        return false;
+    }
+    mirror->pending++;
+    return true;
+}
+
+/* Ask for the BIOS data area and, in a text mode, the active page; all pipelined */
+static void start_frame(Mirror *mirror, DbgClient *debugger) {
+    const ScreenMirror *screen = &mirror->screen;
+    bool ok;
+
+    mirror->frame_id++;
+    mirror->pending = 0;
+    mirror->failed = false;
+    mirror->fetching = true;
+    mirror->fetch_text = screen->text_mode;
+
+    ok = request_part(debugger, mirror, BDA_SEGMENT, BDA_OFFSET, BDA_LENGTH, true, 0);
+    if (ok && mirror->fetch_text) {
+        uint16_t segment = screen->video_mode == 7 ? 0xB000 : 0xB800;
+        size_t total = (size_t)screen->columns * (size_t)screen->rows * 2;
+
+        for (size_t done = 0; ok && done < total; done += DBG_MAX_READ) {
+            size_t len = total - done < DBG_MAX_READ ? total - done : DBG_MAX_READ;
+            ok = request_part(debugger, mirror, segment, mirror->page_start + done, len, false,
+                              done);
+        }
+    }
+
+    /* Replies already asked for still arrive, and then finish the frame as failed */
+    if (!ok) {
+        mirror->failed = true;
+        if (mirror->pending == 0) {
+            mirror->fetching = false;
+        }
+    }
+}
+
+static Mirror *open_mirror(int session_id) {
+    Mirror *mirror = calloc(1, sizeof(*mirror));
+
+    if (!mirror) {
+        return NULL;
+    }
+
+    /* Until the BIOS data area says otherwise */
+    mirror->screen.session_id = session_id;
+    mirror->screen.text_mode = true;
+    mirror->screen.video_mode = 3;
+    mirror->screen.columns = 80;
+    mirror->screen.rows = 25;
+    return mirror;
+}
+
+/* Mirror the running sessions that have a debugger, in session table order */
+static bool sync_sessions(void) {
+    Mirror *kept[SCREEN_MAX_MIRRORS];
+    int count = 0;
+    bool changed = false;
+
+    for (int i = 0; i < mirror_count; i++) {
+        mirrors[i]->seen = false;
+    }
+
+    for (int i = 0; i < dosemu_session_count() && count < SCREEN_MAX_MIRRORS; i++) {
+        DosemuSession *session = dosemu_session_at(i);
+        Mirror *mirror;
+
+        if (dosemu_session_state(session) != SESSION_RUNNING ||
+            !dosemu_session_debugger(session)) {
+            continue;
+        }
+        mirror = find_mirror(dosemu_session_id(session));
+        if (!mirror) {
+            mirror = open_mirror(dosemu_session_id(session));
+            changed = changed || mirror != NULL;
+        }
+        if (mirror) {
+            mirror->seen = true;
+            kept[count++] = mirror;
+        }
+    }
+
+    for (int i = 0; i < mirror_count; i++) {
+        if (!mirrors[i]->seen) {
+            free(mirrors[i]);
+            changed = true;
+        }
+    }
+    changed = changed || count != mirror_count;
+    memcpy(mirrors, kept, (size_t)count * sizeof(*kept));
+    mirror_count = count;
+    return changed;
+}
+
+bool screen_poll(int fps) {
+    bool changed = sync_sessions();
+    uint64_t now = trace_now();
+    uint64_t interval = 1000000000ULL / (uint64_t)(fps > 0 ? fps : SCREEN_DEFAULT_FPS);
+
+    for (int i = 0; i < mirror_count; i++) {
+        Mirror *mirror = mirrors[i];
+        DosemuSession *session = dosemu_session_find(mirror->screen.session_id);
+
+        if (mirror->fetching || now < mirror->due_ns || !session) {
+            continue;
+        }
+        mirror->due_ns = now + interval;
+        start_frame(mirror, dosemu_session_debugger(session));
+    }
+    return changed;
+}
+
+int screen_count(void) {
+    return mirror_count;
+}
+
+const ScreenMirror *screen_at(int index) {
+    return index >= 0 && index < mirror_count ? &mirrors[index]->screen : NULL;
+}
+
+uint64_t screen_take_dirty(int index) {
+    uint64_t dirty;
+
+    if (index < 0 || index >= mirror_count) {
+        return 0;
+    }
+    dirty = mirrors[index]->dirty_rows;
+    mirrors[index]->dirty_rows = 0;
+    return dirty;
+}
@@ -0,0 +1,738 @@
+#define _GNU_SOURCE
+
+#include "../include/sessionlog.h"
+#include "../include/console.h"
+#include <stdatomic.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* A trigram is three bytes with ASCII letters folded to lower case */
+#define TRIGRAM_SPACE (1U << 24)
+
+/* Blocks holding one trigram, as deltas of block numbers in LEB128 */
+typedef struct PostingList {
+    uint8_t *data;
+    uint32_t length;
+    uint32_t capacity;
+    uint32_t count;
+    uint32_t last_block;
+} PostingList;
+
+struct SessionLog {
+    int session_id;
+    int references;
+    int fd;
+    SessionLog *next;
+
+    /* Writer side */
+    char buffer[SESSIONLOG_WRITE_BUFFER];
+    size_t buffered;
+    bool write_failed;
+    _Atomic uint64_t written;
+
+    /* Reader side, all on the UI thread */
+    const char *map;
+    size_t map_length;
+    uint64_t indexed;              /* bytes of complete lines indexed */
+    uint64_t lines;
+    uint64_t *line_offsets;        /* start of every SESSIONLOG_LINE_STRIDE-th line */
+    size_t line_offsets_capacity;
+
+    /* Open-addressed table from trigram to posting list; only complete blocks are listed */
+    uint32_t *trigram_keys;        /* trigram + 1, or 0 for a free slot */
+    uint32_t *trigram_lists;
+    size_t trigram_capacity;
+    PostingList *lists;
+    size_t list_count;
+    size_t list_capacity;
+
+    /* Distinct trigrams of the block being filled */
+    uint32_t *block_keys;
+    size_t block_key_count;
+    size_t block_key_capacity;
+};
+
+/* Where a search stands in one trigram's posting list */
+typedef struct TrigramCursor {
+    uint32_t trigram;
+    int list;              /* -1 until the trigram first shows up */
+    uint32_t position;     /* bytes of the list decoded */
+    uint32_t block;        /* the block last decoded */
+    bool started;
+} TrigramCursor;
+
+struct SessionLogSearch {
+    SessionLog *log;
+    char *query;           /* folded */
+    size_t query_length;
+    TrigramCursor cursors[SESSIONLOG_QUERY_TRIGRAMS];
+    int cursor_count;
+    uint64_t scan_line;    /* first line not searched yet */
+    uint64_t scan_offset;
+    uint64_t *matches;     /* offsets of matching lines */
+    uint64_t match_count;
+    size_t match_capacity;
+    uint64_t scanned;
+};
+
+static SessionLog *open_logs = NULL;
+
+/*
+ * Which trigrams the block being indexed has seen, one bit each. Shared by
+ * every log; the owner's block_keys say which bits are set.
+ */
+static uint64_t seen_bits[TRIGRAM_SPACE / 64];
+static SessionLog *seen_owner = NULL;
+
+static unsigned char fold(unsigned char c) {
+    return c >= 'A' && c <= 'Z' ? (unsigned char)(c + ('a' - 'A')) : c;
+}
+
+static bool grow(void **array, size_t *capacity, size_t needed, size_t element) {
+    size_t new_capacity = *capacity ? *capacity : 64;
+    void *grown;
+
+    if (needed <= *capacity) {
+        return true;
+    }
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    grown = realloc(*array, new_capacity * element);
+    if (!grown) {
+        return false;
+    }
+    *array = grown;
+    *capacity = new_capacity;
+    return true;
+}
+
+static size_t trigram_slot(uint32_t trigram, size_t capacity) {
+    return (size_t)((trigram * 2654435761U) & (capacity - 1));
+}
+
+/* The posting list of a trigram, or -1 */
+static int find_list(const SessionLog *log, uint32_t trigram) {
+    if (!log->trigram_capacity) {
+        return -1;
+    }
+    for (size_t slot = trigram_slot(trigram, log->trigram_capacity);;
+         slot = (slot + 1) & (log->trigram_capacity - 1)) {
+        if (log->trigram_keys[slot] == 0) {
+            return -1;
+        }
+        if (log->trigram_keys[slot] == trigram + 1) {
+            return (int)log->trigram_lists[slot];
+        }
+    }
+}
+
+/* Double the table once it is 70% full */
+static bool grow_table(SessionLog *log) {
+    size_t capacity = log->trigram_capacity ? log->trigram_capacity * 2 : 4096;
+    uint32_t *keys = calloc(capacity, sizeof(*keys));
+    uint32_t *lists = malloc(capacity * sizeof(*lists));
+
+    if (!keys || !lists) {
+        free(keys);
+        free(lists);
+        return false;
+    }
+    for (size_t i = 0; i < log->trigram_capacity; i++) {
+        if (log->trigram_keys[i]) {
+            size_t slot = trigram_slot(log->trigram_keys[i] - 1, capacity);
+            while (keys[slot]) {
+                slot = (slot + 1) & (capacity - 1);
+            }
+            keys[slot] = log->trigram_keys[i];
+            lists[slot] = log->trigram_lists[i];
+        }
+    }
+    free(log->trigram_keys);
+    free(log->trigram_lists);
+    log->trigram_keys = keys;
+    log->trigram_lists = lists;
+    log->trigram_capacity = capacity;
+    return true;
+}
+
+static PostingList *list_for(SessionLog *log, uint32_t trigram) {
+    int index = find_list(log, trigram);
+    size_t slot;
+
+    if (index >= 0) {
+        return &log->lists[index];
+    }
+    if ((log->list_count + 1) * 10 > log->trigram_capacity * 7 && !grow_table(log)) {
+        return NULL;
+    }
+    if (!grow((void **)&log->lists, &log->list_capacity, log->list_count + 1,
+              sizeof(*log->lists))) {
+        return NULL;
+    }
+
+    slot = trigram_slot(trigram, log->trigram_capacity);
+    while (log->trigram_keys[slot]) {
+        slot = (slot + 1) & (log->trigram_capacity - 1);
+    }
+    log->trigram_keys[slot] = trigram + 1;
+    log->trigram_lists[slot] = (uint32_t)log->list_count;
+    memset(&log->lists[log->list_count], 0, sizeof(*log->lists));
+    return &log->lists[log->list_count++];
+}
+
+static void add_posting(SessionLog *log, uint32_t trigram, uint32_t block) {
+    PostingList *list = list_for(log, trigram);
+    uint32_t delta;
+    size_t capacity;
+
+    if (!list) {
+        return;
+    }
+    capacity = list->capacity;
+    if (!grow((void **)&list->data, &capacity, (size_t)list->length + 5, 1)) {
+        return;
+    }
+    list->capacity = (uint32_t)capacity;
+
+    delta = list->count ? block - list->last_block : block;
+    do {
+        uint8_t byte = delta & 0x7f;
+        delta >>= 7;
+        list->data[list->length++] = delta ? (uint8_t)(byte | 0x80) : byte;
+    } while (delta);
+    list->count++;
+    list->last_block = block;
+}
+
+/* Point the shared seen bits at this log's block */
+static void claim_seen_bits(SessionLog *log) {
+    if (seen_owner == log) {
+        return;
+    }
+    if (seen_owner) {
+        for (size_t i = 0; i < seen_owner->block_key_count; i++) {
+            uint32_t trigram = seen_owner->block_keys[i];
+            seen_bits[trigram / 64] &= ~(1ULL << (trigram % 64));
+        }
+    }
+    for (size_t i = 0; i < log->block_key_count; i++) {
+        uint32_t trigram = log->block_keys[i];
+        seen_bits[trigram / 64] |= 1ULL << (trigram % 64);
+    }
+    seen_owner = log;
+}
+
+/* Note the trigrams of a line that are new to the current block */
+static void index_trigrams(SessionLog *log, const unsigned char *text, size_t length) {
+    uint32_t trigram = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        trigram = ((trigram << 8) | fold(text[i])) & (TRIGRAM_SPACE - 1);
+        if (i < 2 || (seen_bits[trigram / 64] & (1ULL << (trigram % 64)))) {
+            continue;
+        }
+        if (!grow((void **)&log->block_keys, &log->block_key_capacity, log->block_key_count + 1,
+                  sizeof(*log->block_keys))) {
+            return;
+        }
+        seen_bits[trigram / 64] |= 1ULL << (trigram % 64);
+        log->block_keys[log->block_key_count++] = trigram;
+    }
+}
+
+/* A block is full: list it under each of its trigrams */
+static void complete_block(SessionLog *log, uint32_t block) {
+    for (size_t i = 0; i < log->block_key_count; i++) {
+        uint32_t trigram = log->block_keys[i];
+        add_posting(log, trigram, block);
+        seen_bits[trigram / 64] &= ~(1ULL << (trigram % 64));
+    }
+    log->block_key_count = 0;
+}
+
+/* Map at least the first length bytes of the file */
+static bool ensure_mapped(SessionLog *log, uint64_t length) {
+    size_t new_length;
+    void *map;
+
+    if (length <= log->map_length) {
+        return true;
+    }
+    new_length = (size_t)((length + SESSIONLOG_MAP_STEP - 1) / SESSIONLOG_MAP_STEP *
+                          SESSIONLOG_MAP_STEP);
+
+    /* Only bytes already written are ever read, never the pages past the end */
+    if (log->map) {
+        map = mremap((void *)log->map, log->map_length, new_length, MREMAP_MAYMOVE);
+    } else {
+        map = mmap(NULL, new_length, PROT_READ, MAP_SHARED, log->fd, 0);
+    }
+    if (map == MAP_FAILED) {
+        log_error("Cannot map the log of session %d: %s\n", log->session_id, strerror(errno));
+        return false;
+    }
+    log->map = map;
+    log->map_length = new_length;
+    return true;
+}
+
+/* Index complete lines written since the last call; returns the bytes used */
+static uint64_t update_log(SessionLog *log, uint64_t budget) {
+    uint64_t written = atomic_load_explicit(&log->written, memory_order_acquire);
+    uint64_t start = log->indexed;
+    uint64_t position = start;
+
+    if (written <= position || !ensure_mapped(log, written)) {
+        return 0;
+    }
+    claim_seen_bits(log);
+
+    while (position < written && position - start < budget) {
+        const char *line = log->map + position;
+        const char *newline = memchr(line, '\n', (size_t)(written - position));
+
+        if (!newline) {
+            break;
+        }
+        if (log->lines % SESSIONLOG_LINE_STRIDE == 0) {
+            size_t slot = (size_t)(log->lines / SESSIONLOG_LINE_STRIDE);
+            if (!grow((void **)&log->line_offsets, &log->line_offsets_capacity, slot + 1,
+                      sizeof(*log->line_offsets))) {
+                break;
+            }
+            log->line_offsets[slot] = position;
+        }
+
+        index_trigrams(log, (const unsigned char *)line, (size_t)(newline - line));
+        log->lines++;
+        if (log->lines % SESSIONLOG_BLOCK_LINES == 0) {
+            complete_block(log, (uint32_t)(log->lines / SESSIONLOG_BLOCK_LINES - 1));
+        }
+        position += (uint64_t)(newline - line) + 1;
+    }
+
+    log->indexed = position;
+    return position - start;
+}
+
+SessionLog *sessionlog_open(int session_id, const char *path) {
+    SessionLog *log = calloc(1, sizeof(*log));
+    struct stat info;
+
+    if (!log) {
+        return NULL;
+    }
+
+    if (path && *path) {
+        log->fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    } else {
+        const char *dir = getenv("TMPDIR");
+        log->fd = open(dir && *dir ? dir : "/tmp", O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    }
+    if (log->fd < 0) {
+        log_error("Cannot open the log of session %d: %s\n", session_id, strerror(errno));
+        free(log);
+        return NULL;
+    }
+
+    /* Text already in the file is indexed like new output */
+    if (fstat(log->fd, &info) == 0) {
+        atomic_init(&log->written, (uint64_t)info.st_size);
+    }
+
+    log->session_id = session_id;
+    log->references = 1;
+    log->next = open_logs;
+    open_logs = log;
+    return log;
+}
+
+static void write_out(SessionLog *log, const char *text, size_t length) {
+    size_t done = 0;
+
+    while (done < length) {
+        ssize_t n = write(log->fd, text + done, length - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            if (!log->write_failed) {
+                log_error("Cannot write the log of session %d: %s\n", log->session_id,
+                          strerror(errno));
+                log->write_failed = true;
+            }
+            return;
+        }
+        done += (size_t)n;
+        atomic_fetch_add_explicit(&log->written, (uint64_t)n, memory_order_release);
+    }
+}
+
+void sessionlog_append(SessionLog *log, const char *text, size_t length) {
+    if (log->buffered + length > sizeof(log->buffer)) {
+        sessionlog_flush(log);
+    }
+    if (length > sizeof(log->buffer)) {
+        write_out(log, text, length);
+        return;
+    }
+    memcpy(log->buffer + log->buffered, text, length);
+    log->buffered += length;
+}
+
+void sessionlog_flush(SessionLog *log) {
+    if (log->buffered > 0) {
+        write_out(log, log->buffer, log->buffered);
+        log->buffered = 0;
+    }
+}
+
+SessionLog *sessionlog_find(int session_id) {
+    for (SessionLog *log = open_logs; log; log = log->next) {
+        if (log->session_id == session_id) {
+            log->references++;
+            return log;
+        }
+    }
+    return NULL;
+}
+
+void sessionlog_release(SessionLog *log) {
+    if (!log || --log->references > 0) {
+        return;
+    }
+
+    for (SessionLog **link = &open_logs; *link; link = &(*link)->next) {
+        if (*link == log) {
+            *link = log->next;
+            break;
+        }
+    }
+    if (seen_owner == log) {
+        for (size_t i = 0; i < log->block_key_count; i++) {
+            seen_bits[log->block_keys[i] / 64] &= ~(1ULL << (log->block_keys[i] % 64));
+        }
+        seen_owner = NULL;
+    }
+
+    sessionlog_flush(log);
+    if (log->map) {
+        munmap((void *)log->map, log->map_length);
+    }
+    close(log->fd);
+    for (size_t i = 0; i < log->list_count; i++) {
+        free(log->lists[i].data);
+    }
+    free(log->lists);
+    free(log->trigram_keys);
+    free(log->trigram_lists);
+    free(log->line_offsets);
+    free(log->block_keys);
+    free(log);
+}
+
+bool sessionlog_update_all(void) {
+    uint64_t remaining = SESSIONLOG_INDEX_BUDGET;
+    int count = 0;
+    bool changed = false;
+
+    for (SessionLog *log = open_logs; log; log = log->next) {
+        count++;
+    }
+
+    /* Split the budget so one chatty session cannot starve the others */
+    for (SessionLog *log = open_logs; log && remaining > 0; log = log->next) {
+        uint64_t share = remaining / (uint64_t)count--;
+        uint64_t used = update_log(log, share);
+
+        changed |= used > 0;
+        remaining = used < remaining ? remaining - used : 0;
+    }
+    return changed;
+}
+
+int sessionlog_session_id(const SessionLog *log) {
+    return log->session_id;
+}
+
+uint64_t sessionlog_lines(const SessionLog *log) {
+    return log->lines;
+}
+
+uint64_t sessionlog_bytes(const SessionLog *log) {
+    return log->indexed;
+}
+
+size_t sessionlog_index_bytes(const SessionLog *log) {
+    size_t total = log->line_offsets_capacity * sizeof(*log->line_offsets) +
+                   log->trigram_capacity * (sizeof(*log->trigram_keys) +
+                                            sizeof(*log->trigram_lists)) +
+                   log->list_capacity * sizeof(*log->lists) +
+                   log->block_key_capacity * sizeof(*log->block_keys);
+
+    for (size_t i = 0; i < log->list_count; i++) {
+        total += log->lists[i].capacity;
+    }
+    return total;
+}
+
+/* The line starting at offset, without its newline */
+static const char *line_at(const SessionLog *log, uint64_t offset, size_t *length) {
+    const char *text = log->map + offset;
+    const char *newline = memchr(text, '\n', (size_t)(log->indexed - offset));
+
+    *length = newline ? (size_t)(newline - text) : (size_t)(log->indexed - offset);
+    return text;
+}
+
+const char *sessionlog_line(const SessionLog *log, uint64_t line, size_t *length) {
+    const char *text;
+    const char *end = log->map + log->indexed;
+
+    if (line >= log->lines) {
+        *length = 0;
+        return "";
+    }
+
+    /* At most SESSIONLOG_LINE_STRIDE - 1 lines to skip */
+    text = log->map + log->line_offsets[line / SESSIONLOG_LINE_STRIDE];
+    for (uint64_t i = 0; i < line % SESSIONLOG_LINE_STRIDE; i++) {
+        text = (const char *)memchr(text, '\n', (size_t)(end - text)) + 1;
+    }
+    return line_at(log, (uint64_t)(text - log->map), length);
+}
+
+/* Offset of a line that starts a stride; the end of the indexed text past the last line */
+static uint64_t stride_offset(const SessionLog *log, uint64_t line) {
+    return line < log->lines ? log->line_offsets[line / SESSIONLOG_LINE_STRIDE] : log->indexed;
+}
+
+SessionLogSearch *sessionlog_search_start(SessionLog *log, const char *query) {
+    SessionLogSearch *search = calloc(1, sizeof(*search));
+    size_t length = strcspn(query, "\r\n");
+    uint32_t trigram = 0;
+
+    if (!search) {
+        return NULL;
+    }
+    search->query = malloc(length + 1);
+    if (!search->query) {
+        free(search);
+        return NULL;
+    }
+    for (size_t i = 0; i < length; i++) {
+        search->query[i] = (char)fold((unsigned char)query[i]);
+    }
+    search->query[length] = '\0';
+    search->query_length = length;
+
+    /* Candidate blocks must hold every trigram of the query; shorter queries scan everything */
+    for (size_t i = 0; i < length && search->cursor_count < SESSIONLOG_QUERY_TRIGRAMS; i++) {
+        bool duplicate = false;
+
+        trigram = ((trigram << 8) | (unsigned char)search->query[i]) & (TRIGRAM_SPACE - 1);
+        if (i < 2) {
+            continue;
+        }
+        for (int j = 0; j < search->cursor_count; j++) {
+            duplicate |= search->cursors[j].trigram == trigram;
+        }
+        if (!duplicate) {
+            search->cursors[search->cursor_count].trigram = trigram;
+            search->cursors[search->cursor_count].list = -1;
+            search->cursor_count++;
+        }
+    }
+
+    log->references++;
+    search->log = log;
+    return search;
+}
+
+/* Decode the next block of a cursor's list; false at its current end */
+static bool advance_cursor(const SessionLog *log, TrigramCursor *cursor) {
+    const PostingList *list = &log->lists[cursor->list];
+    uint32_t delta = 0;
+    int shift = 0;
+
+    if (cursor->position >= list->length) {
+        return false;
+    }
+    for (;;) {
+        uint8_t byte = list->data[cursor->position++];
+        delta |= (uint32_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            break;
+        }
+        shift += 7;
+    }
+    cursor->block = cursor->started ? cursor->block + delta : delta;
+    cursor->started = true;
+    return true;
+}
+
+/* The first complete block from block on that holds every query trigram, or complete */
+static uint64_t next_candidate(SessionLogSearch *search, uint64_t block, uint64_t complete) {
+    const SessionLog *log = search->log;
+    uint64_t target = block;
+
+    while (target < complete) {
+        bool agreed = true;
+
+        for (int i = 0; i < search->cursor_count && agreed; i++) {
+            TrigramCursor *cursor = &search->cursors[i];
+
+            if (cursor->list < 0) {
+                cursor->list = find_list(log, cursor->trigram);
+                if (cursor->list < 0) {
+                    return complete;
+                }
+            }
+            while (!cursor->started || cursor->block < target) {
+                if (!advance_cursor(log, cursor)) {
+                    return complete;
+                }
+            }
+            if (cursor->block > target) {
+                target = cursor->block;
+                agreed = false;
+            }
+        }
+        if (agreed) {
+            return target;
+        }
+    }
+    return complete;
+}
+
+/* Case-insensitive search for the folded query */
+static const char *find_folded(const char *text, size_t length, const char *query,
+                               size_t query_length) {
+    unsigned char first = (unsigned char)query[0];
+    unsigned char upper = first >= 'a' && first <= 'z' ? (unsigned char)(first - ('a' - 'A'))
+                                                         : first;
+    const char *end;
+
+    if (length < query_length) {
+        return NULL;
+    }
+    end = text + length - query_length + 1;
+
+    while (text < end) {
+        const char *lower_hit = memchr(text, first, (size_t)(end - text));
+        const char *upper_hit = upper != first
+                                    ? memchr(text, upper, (size_t)((lower_hit ? lower_hit : end) - text))
+                                    : NULL;
+        const char *hit = upper_hit ? upper_hit : lower_hit;
+        size_t i = 1;
+
+        if (!hit) {
+            return NULL;
+        }
+        while (i < query_length && fold((unsigned char)hit[i]) == (unsigned char)query[i]) {
+            i++;
+        }
+        if (i == query_length) {
+            return hit;
+        }
+        text = hit + 1;
+    }
+    return NULL;
+}
+
+/* Add every line in [from, to) that contains the query; both are line starts */
+static void scan_range(SessionLogSearch *search, uint64_t from, uint64_t to) {
+    const char *base = search->log->map;
+    uint64_t position = from;
+
+    while (position < to) {
+        const char *hit = search->query_length
+                              ? find_folded(base + position, (size_t)(to - position),
+                                            search->query, search->query_length)
+                              : base + position;
+        const char *start, *newline;
+
+        if (!hit) {
+            break;
+        }
+        start = memrchr(base + position, '\n', (size_t)(hit - (base + position)));
+        start = start ? start + 1 : base + position;
+        newline = memchr(hit, '\n', (size_t)(base + to - hit));
+
+        if (!grow((void **)&search->matches, &search->match_capacity, search->match_count + 1,
+                  sizeof(*search->matches))) {
+            break;
+        }
+        search->matches[search->match_count++] = (uint64_t)(start - base);
+        position = newline ? (uint64_t)(newline - base) + 1 : to;
+    }
+}
+
+bool sessionlog_search_step(SessionLogSearch *search, size_t budget) {
+    const SessionLog *log = search->log;
+    uint64_t before = search->match_count;
+    uint64_t spent = 0;
+
+    while (spent < budget && search->scan_line < log->lines) {
+        uint64_t block = search->scan_line / SESSIONLOG_BLOCK_LINES;
+        uint64_t complete = log->lines / SESSIONLOG_BLOCK_LINES;
+        uint64_t end_line, end_offset;
+
+        /* Skip whole blocks the trigram index rules out */
+        if (search->cursor_count > 0 && block < complete &&
+            search->scan_line % SESSIONLOG_BLOCK_LINES == 0) {
+            uint64_t candidate = next_candidate(search, block, complete);
+            if (candidate != block) {
+                search->scan_line = candidate * SESSIONLOG_BLOCK_LINES;
+                search->scan_offset = stride_offset(log, search->scan_line);
+                continue;
+            }
+        }
+
+        /* The rest of this block, or of the lines indexed so far */
+        end_line = block < complete ? (block + 1) * SESSIONLOG_BLOCK_LINES : log->lines;
+        end_offset = block < complete ? stride_offset(log, end_line) : log->indexed;
+
+        scan_range(search, search->scan_offset, end_offset);
+        spent += end_offset - search->scan_offset;
+        search->scanned += end_offset - search->scan_offset;
+        search->scan_line = end_line;
+        search->scan_offset = end_offset;
+    }
+    return search->match_count > before;
+}
+
+bool sessionlog_search_caught_up(const SessionLogSearch *search) {
+    return search->scan_line >= search->log->lines;
+}
+
+uint64_t sessionlog_search_count(const SessionLogSearch *search) {
+    return search->match_count;
+}
+
+const char *sessionlog_search_match(const SessionLogSearch *search, uint64_t index,
+                                    size_t *length) {
+    if (index >= search->match_count) {
+        *length = 0;
+        return "";
+    }
+    return line_at(search->log, search->matches[index], length);
+}
+
+uint64_t sessionlog_search_scanned(const SessionLogSearch *search) {
+    return search->scanned;
+}
+
+void sessionlog_search_free(SessionLogSearch *search) {
+    if (!search) {
+        return;
+    }
+    sessionlog_release(search->log);
+    free(search->query);
+    free(search->matches);
+    free(search);
+}
@@ -0,0 +1,297 @@
+#define _GNU_SOURCE
+
+#include "../include/shutdown.h"
+#include "../include/io_loop.h"
+#include "../include/pidfd.h"
+#include "../include/trace.h"
+#include "../include/headless.h"
+#include <sys/epoll.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+/* Exit polling interval when the kernel has no pidfd support */
+#define EXIT_POLL_MS 10
+
+typedef enum ShutdownPhase {
+    PHASE_GRACEFUL,
+    PHASE_TERM,
+    PHASE_KILL
+} ShutdownPhase;
+
+typedef struct Shutdown {
+    ShutdownTarget targets[SHUTDOWN_MAX_TARGETS];
+    ShutdownResult results[SHUTDOWN_MAX_TARGETS];
+    int count;
+    int current;
+    shutdown_callback callback;
+    void *data;
+
+    /* State of the current target */
+    ShutdownPhase phase;
+    uint64_t phase_ns;
+    int pid_fd;
+    int deadline_id;
+    int poll_id;
+    struct timespec started;
+    struct timespec target_started;
+    double total_ms;
+} Shutdown;
+
+static void begin_target(Shutdown *shutdown);
+
+static const char *phase_name(ShutdownPhase phase) {
+    switch (phase) {
+    case PHASE_GRACEFUL:
+        return "graceful request";
+    case PHASE_TERM:
+        return "SIGTERM";
+    case PHASE_KILL:
+        return "SIGKILL";
+    }
+    return "unknown";
+}
+
+/* Close the current phase's span and open the next one */
+static void enter_phase(Shutdown *shutdown, ShutdownPhase phase) {
+    uint64_t now = trace_now();
+
+    trace_span(phase_name(shutdown->phase), shutdown->targets[shutdown->current].trace_id,
+               shutdown->phase_ns, now);
+    shutdown->phase = phase;
+    shutdown->phase_ns = now;
+}
+
+static double elapsed_ms_since(const struct timespec *start) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) * 1000.0 +
+           (double)(now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+/* Has the process exited? Leaves the zombie for its owner to reap */
+static bool has_exited(pid_t pid, int pid_fd) {
+    struct pollfd exit_poll = {.fd = pid_fd, .events = POLLIN};
+    siginfo_t info;
+
+    /* A pidfd turns readable on exit and still names the process once it is reaped */
+    if (pid_fd >= 0) {
+        return poll(&exit_poll, 1, 0) > 0;
+    }
+
+    memset(&info, 0, sizeof(info));
+    if (waitid(P_PID, (id_t)pid, &info, WEXITED | WNOHANG | WNOWAIT) != 0) {
+        /* ECHILD: already reaped elsewhere */
+        return errno == ECHILD;
+    }
+    return info.si_pid == pid;
+}
+
+static void deliver_results(void *data) {
+    Shutdown *shutdown = data;
+
+    if (shutdown->callback) {
+        shutdown->callback(shutdown->results, shutdown->count, shutdown->total_ms,
+                           shutdown->data);
+    }
+    free(shutdown);
+}
+
+/* Close the pidfds of targets not begun */
+static void close_target_fds(Shutdown *shutdown) {
+    for (int i = 0; i < shutdown->count; i++) {
+        if (shutdown->targets[i].pid_fd >= 0) {
+            close(shutdown->targets[i].pid_fd);
+            shutdown->targets[i].pid_fd = -1;
+        }
+    }
+}
+
+/* Drop the pidfd and timers of the current target */
+static void release_target(Shutdown *shutdown) {
+    if (shutdown->pid_fd >= 0) {
+        io_loop_remove_fd(shutdown->pid_fd);
+        close(shutdown->pid_fd);
+        shutdown->pid_fd = -1;
+    }
+    io_loop_cancel_timeout(shutdown->deadline_id);
+    shutdown->deadline_id = -1;
+    io_loop_cancel_timeout(shutdown->poll_id);
+    shutdown->poll_id = -1;
+}
+
+/* Record how the current target ended and move on to the next */
+static void end_target(Shutdown *shutdown, ShutdownOutcome outcome) {
+    ShutdownResult *result = &shutdown->results[shutdown->current];
+
+    if (outcome != SHUTDOWN_ALREADY_EXITED) {
+        trace_span(phase_name(shutdown->phase), shutdown->targets[shutdown->current].trace_id,
+                   shutdown->phase_ns, trace_now());
+    }
+    release_target(shutdown);
+    result->outcome = outcome;
+    result->elapsed_ms = elapsed_ms_since(&shutdown->target_started);
+
+    shutdown->current++;
+    begin_target(shutdown);
+}
+
+static void on_target_exited(Shutdown *shutdown) {
+    switch (shutdown->phase) {
+    case PHASE_GRACEFUL:
+        end_target(shutdown, SHUTDOWN_GRACEFUL);
+        break;
+    case PHASE_TERM:
+        end_target(shutdown, SHUTDOWN_TERMINATED);
+        break;
+    case PHASE_KILL:
+        end_target(shutdown, SHUTDOWN_KILLED);
+        break;
+    }
+}
+
+static void on_pidfd(int fd, uint32_t events, void *data) {
+    on_target_exited(data);
+}
+
+static void on_exit_poll(int id, uint32_t events, void *data) {
+    Shutdown *shutdown = data;
+
+    shutdown->poll_id = -1;
+    if (has_exited(shutdown->targets[shutdown->current].pid, shutdown->pid_fd)) {
+        on_target_exited(shutdown);
+    } else {
+        shutdown->poll_id = io_loop_add_timeout(EXIT_POLL_MS, on_exit_poll, shutdown);
+    }
+}
+
+/* The current phase ran out of time: escalate */
+static void on_deadline(int id, uint32_t events, void *data) {
+    Shutdown *shutdown = data;
+    const ShutdownTarget *target = &shutdown->targets[shutdown->current];
+
+    shutdown->deadline_id = -1;
+
+    switch (shutdown->phase) {
+    case PHASE_GRACEFUL:
+        enter_phase(shutdown, PHASE_TERM);
+        pidfd_signal(shutdown->pid_fd, target->pid, SIGTERM);
+        shutdown->deadline_id = io_loop_add_timeout(SHUTDOWN_TERM_DEADLINE_MS, on_deadline, shutdown);
+        break;
+    case PHASE_TERM:
+        enter_phase(shutdown, PHASE_KILL);
+        pidfd_signal(shutdown->pid_fd, target->pid, SIGKILL);
+        shutdown->deadline_id = io_loop_add_timeout(SHUTDOWN_KILL_DEADLINE_MS, on_deadline, shutdown);
+        break;
+    case PHASE_KILL:
+        /* Stuck in the kernel; nothing more we can do without blocking */
+        end_target(shutdown, SHUTDOWN_UNRESPONSIVE);
+        break;
+    }
+}
+
+static void begin_target(Shutdown *shutdown) {
+    ShutdownTarget *target;
+
+    if (shutdown->current == shutdown->count) {
+        shutdown->total_ms = elapsed_ms_since(&shutdown->started);
+        main_queue(deliver_results, shutdown);
+        return;
+    }
+
+    target = &shutdown->targets[shutdown->current];
+    shutdown->results[shutdown->current].name = target->name;
+    clock_gettime(CLOCK_MONOTONIC, &shutdown->target_started);
+
+    /* The pidfd is ours from here on; release_target() closes it */
+    shutdown->pid_fd = target->pid_fd;
+    target->pid_fd = -1;
+
+    if (target->pid <= 0 || has_exited(target->pid, shutdown->pid_fd)) {
+        end_target(shutdown, SHUTDOWN_ALREADY_EXITED);
+        return;
+    }
+
+    /* Watch for the exit before asking, so a fast exit is not missed */
+    if (shutdown->pid_fd < 0 ||
+        !io_loop_add_fd(shutdown->pid_fd, EPOLLIN, on_pidfd, shutdown)) {
+        shutdown->poll_id = io_loop_add_timeout(EXIT_POLL_MS, on_exit_poll, shutdown);
+    }
+
+    shutdown->phase = PHASE_GRACEFUL;
+    shutdown->phase_ns = trace_now();
+    if (target->request) {
+        target->request(target->request_data);
+        shutdown->deadline_id = io_loop_add_timeout(target->grace_ms, on_deadline, shutdown);
+    } else {
+        /* No graceful path: go straight to SIGTERM */
+        on_deadline(-1, 0, shutdown);
+    }
+}
+
+static void run_shutdown(void *data) {
+    Shutdown *shutdown = data;
+
+    clock_gettime(CLOCK_MONOTONIC, &shutdown->started);
+    begin_target(shutdown);
+}
+
+/* Stop each target in turn */
+bool shutdown_start(const ShutdownTarget *targets, int count,
+                    shutdown_callback callback, void *data) {
+    Shutdown *shutdown;
+
+    if (count < 0 || count > SHUTDOWN_MAX_TARGETS) {
+        return false;
+    }
+
+    shutdown = calloc(1, sizeof(*shutdown));
+    if (!shutdown) {
+        return false;
+    }
+
+    memcpy(shutdown->targets, targets, (size_t)count * sizeof(*targets));
+    shutdown->count = count;
+
+    /* Our own copies, so the caller may release its process meanwhile */
+    for (int i = 0; i < count; i++) {
+        if (targets[i].pid_fd >= 0) {
+            shutdown->targets[i].pid_fd = fcntl(targets[i].pid_fd, F_DUPFD_CLOEXEC, 0);
+        }
+    }
+    shutdown->callback = callback;
+    shutdown->data = data;
+    shutdown->pid_fd = -1;
+    shutdown->deadline_id = -1;
+    shutdown->poll_id = -1;
+
+    if (!io_loop_post(run_shutdown, shutdown)) {
+        close_target_fds(shutdown);
+        free(shutdown);
+        return false;
+    }
+
+    return true;
+}
+
+/* Human-readable description of an outcome */
+const char *shutdown_outcome_name(ShutdownOutcome outcome) {
+    switch (outcome) {
+    case SHUTDOWN_ALREADY_EXITED:
+        return "already exited";
+    case SHUTDOWN_GRACEFUL:
+        return "exited on request";
+    case SHUTDOWN_TERMINATED:
+        return "exited on SIGTERM";
+    case SHUTDOWN_KILLED:
+        return "exited on SIGKILL";
+    case SHUTDOWN_UNRESPONSIVE:
+        return "did not exit";
+    }
+    return "unknown";
+}
@@ -0,0 +1,239 @@
+#define _GNU_SOURCE
+
+#include "../include/spawn.h"
+#include "../include/pidfd.h"
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+/* Stack for the CLONE_VM child; it only runs the setup below and exec */
+#define SPAWN_STACK_SIZE (64 * 1024)
+
+#ifndef CLONE_PIDFD
+#define CLONE_PIDFD 0x00001000
+#endif
+
+#ifndef CLOSE_RANGE_CLOEXEC
+#define CLOSE_RANGE_CLOEXEC (1U << 2)
+#endif
+
+/* What the child needs; under CLONE_VM it is shared with the waiting parent */
+typedef struct ChildSetup {
+    const char *const *argv;
+    const Placement *placement;
+    int in;
+    int out;
+    int err;
+    int report_fd;   /* fork backend: errors are written here */
+    int error;       /* vfork backend: errors are stored here */
+} ChildSetup;
+
+static void close_pair(int pair[2]) {
+    if (pair[0] >= 0) {
+        close(pair[0]);
+    }
+    if (pair[1] >= 0) {
+        close(pair[1]);
+    }
+}
+
+/*
+ * In the child: only system calls from here to exec. Returns the errno
+ * value of whatever failed; it does not return if exec succeeds.
+ */
+static int setup_and_exec(const ChildSetup *setup) {
+    sigset_t none;
+    int error;
+
+    /* Our handlers must not run in the child, least of all on shared memory */
+    for (int sig = 1; sig < NSIG; sig++) {
+        struct sigaction action;
+
+        if (sigaction(sig, NULL, &action) == 0 && action.sa_handler != SIG_DFL &&
+            action.sa_handler != SIG_IGN) {
+            action.sa_handler = SIG_DFL;
+            action.sa_flags = 0;
+            sigaction(sig, &action, NULL);
+        }
+    }
+
+    /* Whatever the spawning thread had blocked must not carry over to DOSEmu */
+    sigemptyset(&none);
+    sigprocmask(SIG_SETMASK, &none, NULL);
+
+    if (dup2(setup->in, STDIN_FILENO) < 0 || dup2(setup->out, STDOUT_FILENO) < 0 ||
+        dup2(setup->err, STDERR_FILENO) < 0) {
+        return errno;
+    }
+    if (setup->placement) {
+        error = placement_apply(setup->placement);
+        if (error) {
+            return error;
+        }
+    }
+
+    /* Descriptors the toolkit or a library opened without O_CLOEXEC stay behind */
+#ifdef SYS_close_range
+    syscall(SYS_close_range, 3U, ~0U, CLOSE_RANGE_CLOEXEC);
+#endif
+
+    execv(setup->argv[0], (char *const *)setup->argv);
+    return errno;
+}
+
+static int vfork_child(void *data) {
+    ChildSetup *setup = data;
+
+    setup->error = setup_and_exec(setup);
+    _exit(127);
+}
+
+/*
+ * Share our memory with the child until it execs, so nothing is copied.
+ * The pidfd comes with the child where the kernel has CLONE_PIDFD.
+ */
+static pid_t start_vfork(ChildSetup *setup, int *pid_fd) {
+    sigset_t all, saved;
+    char *stack;
+    pid_t pid;
+
+    stack = mmap(NULL, SPAWN_STACK_SIZE, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (stack == MAP_FAILED) {
+        return -1;
+    }
+
+    /* No handler may run in the child before it has reset them */
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &saved);
+    setup->error = 0;
+    pid = clone(vfork_child, stack + SPAWN_STACK_SIZE,
+                CLONE_VM | CLONE_VFORK | CLONE_PIDFD | SIGCHLD, setup, pid_fd);
+    if (pid < 0 && errno == EINVAL) {
+        *pid_fd = -1;
+        pid = clone(vfork_child, stack + SPAWN_STACK_SIZE, CLONE_VM | CLONE_VFORK | SIGCHLD, setup);
+    }
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+
+    munmap(stack, SPAWN_STACK_SIZE);
+    return pid;
+}
+
+static pid_t start_fork(ChildSetup *setup) {
+    pid_t pid = fork();
+    int error;
+
+    if (pid == 0) {
+        error = setup_and_exec(setup);
+        while (write(setup->report_fd, &error, sizeof(error)) < 0 && errno == EINTR) {
+        }
+        _exit(127);
+    }
+    return pid;
+}
+
+/* Close every pipe end still open and fail with error */
+static bool fail_spawn(int pipes[][2], int count, int error) {
+    for (int i = 0; i < count; i++) {
+        close_pair(pipes[i]);
+    }
+    errno = error;
+    return false;
+}
+
+bool spawn_process(const char *const argv[], const Placement *placement,
+                   SpawnedProcess *process) {
+    return spawn_process_with(SPAWN_VFORK, argv, placement, process);
+}
+
+bool spawn_process_with(SpawnBackend backend, const char *const argv[],
+                        const Placement *placement, SpawnedProcess *process) {
+    enum { IN, OUT, ERR, REPORT, PIPE_COUNT };
+    int pipes[PIPE_COUNT][2];
+    int pipe_count = backend == SPAWN_FORK ? PIPE_COUNT : REPORT;
+    ChildSetup setup;
+    int error = 0;
+    ssize_t length;
+    int pid_fd = -1;
+    pid_t pid;
+
+    /* Everything is close-on-exec; dup2() clears it on the child's copies */
+    for (int i = 0; i < PIPE_COUNT; i++) {
+        pipes[i][0] = pipes[i][1] = -1;
+    }
+    for (int i = 0; i < pipe_count; i++) {
+        if (pipe2(pipes[i], O_CLOEXEC) != 0) {
+            return fail_spawn(pipes, PIPE_COUNT, errno);
+        }
+    }
+
+    setup.argv = argv;
+    setup.placement = placement;
+    setup.in = pipes[IN][0];
+    setup.out = pipes[OUT][1];
+    setup.err = pipes[ERR][1];
+    setup.report_fd = pipes[REPORT][1];
+
+    pid = backend == SPAWN_FORK ? start_fork(&setup) : start_vfork(&setup, &pid_fd);
+    if (pid < 0) {
+        return fail_spawn(pipes, PIPE_COUNT, errno);
+    }
+
+    /* Not reaped by anyone yet, so the pid still names our child */
+    if (pid_fd < 0) {
+        pid_fd = pidfd_open_pid(pid);
+    }
+
+    if (backend == SPAWN_FORK) {
+        /* The report pipe closes without a word once exec succeeds */
+        close(pipes[REPORT][1]);
+        pipes[REPORT][1] = -1;
+        do {
+            length = read(pipes[REPORT][0], &error, sizeof(error));
+        } while (length < 0 && errno == EINTR);
+        if (length != (ssize_t)sizeof(error)) {
+            error = 0;
+        }
+    } else {
+        /* CLONE_VFORK resumes us once the child has exec'd or exited */
+        error = setup.error;
+    }
+
+    if (error) {
+        while (waitpid(pid, NULL, 0) < 0 && errno == EINTR) {
+        }
+        if (pid_fd >= 0) {
+            close(pid_fd);
+        }
+        return fail_spawn(pipes, PIPE_COUNT, error);
+    }
+
+    close_pair(pipes[REPORT]);
+    close(pipes[IN][0]);
+    close(pipes[OUT][1]);
+    close(pipes[ERR][1]);
+    process->pid = pid;
+    process->pid_fd = pid_fd;
+    process->stdin_fd = pipes[IN][1];
+    process->stdout_fd = pipes[OUT][0];
+    process->stderr_fd = pipes[ERR][0];
+    return true;
+}
+
+void spawn_release(SpawnedProcess *process) {
+    int *fds[] = {&process->stdin_fd, &process->stdout_fd, &process->stderr_fd,
+                  &process->pid_fd};
+
+    for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); i++) {
+        if (*fds[i] >= 0) {
+            close(*fds[i]);
+            *fds[i] = -1;
+        }
+    }
+}
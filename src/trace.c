@@ -0,0 +1,183 @@
+#define _GNU_SOURCE
+
+#include "../include/trace.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <time.h>
+
+typedef struct TraceEvent {
+    const char *name;
+    int session;
+    bool instant;
+    uint64_t start_ns;
+    uint64_t duration_ns;
+} TraceEvent;
+
+/* Written by its own thread only; count is published for the exporter */
+typedef struct TraceBuffer {
+    pid_t tid;
+    _Atomic uint64_t count;
+    TraceEvent events[TRACE_BUFFER_EVENTS];
+} TraceBuffer;
+
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static TraceBuffer *buffers[TRACE_MAX_THREADS];
+static int buffer_count = 0;
+
+static _Thread_local TraceBuffer *thread_buffer = NULL;
+static _Thread_local bool thread_unregistered = false;
+
+/* Monotonic clock in nanoseconds */
+uint64_t trace_now(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/* This thread's buffer, allocated and registered on first use */
+static TraceBuffer *get_buffer(void) {
+    TraceBuffer *buffer;
+
+    if (thread_buffer || thread_unregistered) {
+        return thread_buffer;
+    }
+
+    buffer = calloc(1, sizeof(*buffer));
+    if (!buffer) {
+        thread_unregistered = true;
+        return NULL;
+    }
+    buffer->tid = gettid();
+
+    pthread_mutex_lock(&registry_lock);
+    if (buffer_count < TRACE_MAX_THREADS) {
+        buffers[buffer_count++] = buffer;
+        thread_buffer = buffer;
+    }
+    pthread_mutex_unlock(&registry_lock);
+
+    if (!thread_buffer) {
+        free(buffer);
+        thread_unregistered = true;
+    }
+    return thread_buffer;
+}
+
+static void record(const char *name, int session, bool instant, uint64_t start_ns,
+                   uint64_t duration_ns) {
+    TraceBuffer *buffer = get_buffer();
+    uint64_t count;
+    TraceEvent *event;
+
+    if (!buffer) {
+        return;
+    }
+
+    count = atomic_load_explicit(&buffer->count, memory_order_relaxed);
+    event = &buffer->events[count % TRACE_BUFFER_EVENTS];
+    event->name = name;
+    event->session = session;
+    event->instant = instant;
+    event->start_ns = start_ns;
+    event->duration_ns = duration_ns;
+    atomic_store_explicit(&buffer->count, count + 1, memory_order_release);
+}
+
+/* Record a span */
+void trace_span(const char *name, int session, uint64_t start_ns, uint64_t end_ns) {
+    record(name, session, false, start_ns, end_ns > start_ns ? end_ns - start_ns : 0);
+}
+
+/* Record a point in time */
+void trace_instant(const char *name, int session) {
+    record(name, session, true, trace_now(), 0);
+}
+
+static void write_string(FILE *file, const char *text) {
+    fputc('"', file);
+    for (; *text; text++) {
+        if (*text == '"' || *text == '\\') {
+            fputc('\\', file);
+        }
+        if ((unsigned char)*text >= 0x20) {
+            fputc(*text, file);
+        }
+    }
+    fputc('"', file);
+}
+
+/*
+ * Copy a buffer's held events. Its thread may keep recording meanwhile, so
+ * anything it could have overwritten during the copy is discarded, including
+ * the slot it fills next: that one is written before count is published.
+ */
+static size_t snapshot(TraceBuffer *buffer, TraceEvent *out) {
+    uint64_t end = atomic_load_explicit(&buffer->count, memory_order_acquire);
+    uint64_t begin = end > TRACE_BUFFER_EVENTS ? end - TRACE_BUFFER_EVENTS : 0;
+    uint64_t after;
+    size_t used = 0;
+
+    for (uint64_t i = begin; i < end; i++) {
+        out[i - begin] = buffer->events[i % TRACE_BUFFER_EVENTS];
+    }
+
+    after = atomic_load_explicit(&buffer->count, memory_order_acquire);
+    for (uint64_t i = begin; i < end; i++) {
+        if (after < TRACE_BUFFER_EVENTS || i > after - TRACE_BUFFER_EVENTS) {
+            out[used++] = out[i - begin];
+        }
+    }
+    return used;
+}
+
+/* Write every held event as Chrome trace-event JSON */
+bool trace_export_chrome(const char *path) {
+    TraceEvent *events = malloc(TRACE_BUFFER_EVENTS * sizeof(*events));
+    FILE *file;
+    bool first = true;
+    bool ok;
+    int count;
+
+    if (!events) {
+        return false;
+    }
+
+    file = fopen(path, "w");
+    if (!file) {
+        free(events);
+        return false;
+    }
+
+    pthread_mutex_lock(&registry_lock);
+    count = buffer_count;
+    pthread_mutex_unlock(&registry_lock);
+
+    /* Sessions become processes and the recording threads their threads */
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (int b = 0; b < count; b++) {
+        TraceBuffer *buffer = buffers[b];
+        size_t held = snapshot(buffer, events);
+
+        for (size_t i = 0; i < held; i++) {
+            const TraceEvent *event = &events[i];
+
+            fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+            write_string(file, event->name);
+            fprintf(file, ",\"cat\":\"dosemu\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f",
+                    event->session, (int)buffer->tid, (double)event->start_ns / 1000.0);
+            if (event->instant) {
+                fprintf(file, ",\"ph\":\"i\",\"s\":\"t\"}");
+            } else {
+                fprintf(file, ",\"ph\":\"X\",\"dur\":%.3f}", (double)event->duration_ns / 1000.0);
+            }
+            first = false;
+        }
+    }
+    fprintf(file, "\n]}\n");
+    free(events);
+
+    ok = !ferror(file);
+    return fclose(file) == 0 && ok;
+}
@@ -0,0 +1,764 @@
+#define _GNU_SOURCE
+
+#include "../include/transcript.h"
+#include "../include/console.h"
+#include "../include/dbg_client.h"
+#include "../include/dosemu_integration.h"
+#include "../include/headless.h"
+#include "../include/io_loop.h"
+#include "../include/trace.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Type, time delta, session and payload length before every payload */
+#define MAX_HEADER_BYTES (1 + 10 + 5 + 5)
+
+/* Fixed fields of a payload, before its text */
+#define MAX_FIELD_BYTES 256
+
+/* Longest shutdown target name kept */
+#define MAX_TARGET_NAME 32
+
+/* UI thread only */
+typedef struct Recorder {
+    int fd;
+    uint8_t *buffer;
+    size_t used;
+    uint64_t last_ns;
+    uint64_t events;
+    bool failed;
+} Recorder;
+
+struct TranscriptReader {
+    const uint8_t *map;
+    size_t size;
+    size_t position;
+    uint64_t time_ns;
+    bool failed;
+};
+
+/* A recorded session and the live one replaying it */
+typedef struct ReplaySession {
+    int recorded;            /* 0 when the slot is free */
+    int live;
+    uint64_t commands;       /* COMMAND events delivered to its debugger */
+} ReplaySession;
+
+typedef struct Replay {
+    TranscriptReader *reader;
+    bool realtime;
+    int generation;          /* tells steps and timers of an earlier replay apart */
+    uint64_t start_ns;
+    TranscriptEvent next;
+    bool have_next;
+    ReplaySession sessions[MAX_SESSIONS];
+    int last;                /* slot of the previous lookup */
+    transcript_done_callback done;
+    void *done_data;
+    TranscriptReplayStats stats;
+} Replay;
+
+/* When to run the next replay step, handed to the I/O thread */
+typedef struct ReplayWake {
+    int milliseconds;
+    int generation;
+} ReplayWake;
+
+static Recorder recorder = {.fd = -1};
+static Replay replay;
+
+static size_t put_varint(uint8_t *out, uint64_t value) {
+    size_t length = 0;
+
+    while (value >= 0x80) {
+        out[length++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[length++] = (uint8_t)value;
+    return length;
+}
+
+static bool get_varint(const uint8_t **p, const uint8_t *end, uint64_t *value) {
+    *value = 0;
+    for (int shift = 0; shift < 64 && *p < end; shift += 7) {
+        uint8_t byte = *(*p)++;
+
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint64_t zigzag(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+/* Durations are kept in whole microseconds */
+static uint64_t to_us(double ms) {
+    return ms > 0 ? (uint64_t)llround(ms * 1000.0) : 0;
+}
+
+static bool write_all(int fd, const void *data, size_t length) {
+    const uint8_t *p = data;
+
+    while (length > 0) {
+        ssize_t written = write(fd, p, length);
+
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        p += written;
+        length -= (size_t)written;
+    }
+    return true;
+}
+
+static void flush_recorder(void) {
+    if (recorder.used > 0 && !recorder.failed &&
+        !write_all(recorder.fd, recorder.buffer, recorder.used)) {
+        log_error("Cannot write the session transcript: %s\n", strerror(errno));
+        recorder.failed = true;
+    }
+    recorder.used = 0;
+}
+
+/* Append one event: its fixed fields, then text with its terminator if there is one */
+static void record(TranscriptEventType type, int session, const uint8_t *fields,
+                   size_t field_length, const char *text) {
+    size_t text_length = text ? strlen(text) + 1 : 0;
+    uint64_t now = trace_now();
+    uint8_t *out;
+
+    if (recorder.used + MAX_HEADER_BYTES + field_length + text_length > TRANSCRIPT_BUFFER_BYTES) {
+        flush_recorder();
+    }
+
+    out = recorder.buffer + recorder.used;
+    *out++ = (uint8_t)type;
+    out += put_varint(out, now - recorder.last_ns);
+    out += put_varint(out, (uint64_t)session);
+    out += put_varint(out, field_length + text_length);
+    if (field_length > 0) {
+        memcpy(out, fields, field_length);
+        out += field_length;
+    }
+    recorder.used = (size_t)(out - recorder.buffer);
+    recorder.last_ns = now;
+    recorder.events++;
+
+    /* Output too big for the buffer goes straight to the file */
+    if (recorder.used + text_length > TRANSCRIPT_BUFFER_BYTES) {
+        flush_recorder();
+        if (!recorder.failed && !write_all(recorder.fd, text, text_length)) {
+            log_error("Cannot write the session transcript: %s\n", strerror(errno));
+            recorder.failed = true;
+        }
+        return;
+    }
+    if (text) {
+        memcpy(recorder.buffer + recorder.used, text, text_length);
+        recorder.used += text_length;
+    }
+}
+
+bool transcript_record_start(const char *path) {
+    if (recorder.fd >= 0) {
+        transcript_record_stop();
+    }
+
+    recorder.buffer = malloc(TRANSCRIPT_BUFFER_BYTES);
+    recorder.fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (!recorder.buffer || recorder.fd < 0) {
+        log_error("Cannot record a session transcript to %s: %s\n", path, strerror(errno));
+        if (recorder.fd >= 0) {
+            close(recorder.fd);
+            recorder.fd = -1;
+        }
+        free(recorder.buffer);
+        recorder.buffer = NULL;
+        return false;
+    }
+
+    memcpy(recorder.buffer, TRANSCRIPT_MAGIC, strlen(TRANSCRIPT_MAGIC));
+    recorder.used = strlen(TRANSCRIPT_MAGIC);
+    recorder.last_ns = trace_now();
+    recorder.events = 0;
+    recorder.failed = false;
+    log_message("Recording session transcript to %s\n", path);
+    return true;
+}
+
+void transcript_record_stop(void) {
+    if (recorder.fd < 0) {
+        return;
+    }
+    flush_recorder();
+    if (close(recorder.fd) != 0 && !recorder.failed) {
+        log_error("Cannot write the session transcript: %s\n", strerror(errno));
+    }
+    recorder.fd = -1;
+    free(recorder.buffer);
+    recorder.buffer = NULL;
+    log_message("Session transcript stopped after %llu events\n",
+                (unsigned long long)recorder.events);
+}
+
+bool transcript_recording(void) {
+    return recorder.fd >= 0;
+}
+
+uint64_t transcript_recorded_events(void) {
+    return recorder.events;
+}
+
+void transcript_launch(int session, pid_t pid, const char *dos_command) {
+    uint8_t fields[MAX_FIELD_BYTES];
+
+    if (recorder.fd < 0) {
+        return;
+    }
+    record(TRANSCRIPT_LAUNCH, session, fields, put_varint(fields, (uint64_t)pid), dos_command);
+}
+
+void transcript_endpoint(int session, int readiness, const char *endpoint, double elapsed_ms) {
+    uint8_t fields[MAX_FIELD_BYTES];
+    size_t length;
+
+    if (recorder.fd < 0) {
+        return;
+    }
+    fields[0] = (uint8_t)readiness;
+    length = 1 + put_varint(fields + 1, to_us(elapsed_ms));
+    record(TRANSCRIPT_ENDPOINT, session, fields, length, endpoint);
+}
+
+void transcript_command(int session, TranscriptCommandKind kind, uint16_t segment,
+                        uint32_t offset, size_t len, const char *line) {
+    uint8_t fields[MAX_FIELD_BYTES];
+    size_t length = 1;
+
+    if (recorder.fd < 0) {
+        return;
+    }
+    fields[0] = (uint8_t)kind;
+    if (kind == TRANSCRIPT_COMMAND_MEM) {
+        length += put_varint(fields + length, segment);
+        length += put_varint(fields + length, offset);
+        length += put_varint(fields + length, len);
+    }
+    record(TRANSCRIPT_COMMAND, session, fields, length, line);
+}
+
+void transcript_output(int session, const char *text) {
+    uint8_t closed = text == NULL;
+
+    if (recorder.fd < 0) {
+        return;
+    }
+    record(TRANSCRIPT_OUTPUT, session, &closed, 1, text);
+}
+
+void transcript_stop(int session) {
+    if (recorder.fd < 0) {
+        return;
+    }
+    record(TRANSCRIPT_STOP, session, NULL, 0, NULL);
+}
+
+void transcript_shutdown(int session, const ShutdownResult *results, int count,
+                         double total_ms) {
+    uint8_t fields[MAX_FIELD_BYTES];
+    size_t length;
+
+    if (recorder.fd < 0) {
+        return;
+    }
+    if (count > SHUTDOWN_MAX_TARGETS) {
+        count = SHUTDOWN_MAX_TARGETS;
+    }
+    length = put_varint(fields, to_us(total_ms));
+    fields[length++] = (uint8_t)count;
+    for (int i = 0; i < count; i++) {
+        size_t name_length = strnlen(results[i].name, MAX_TARGET_NAME - 1);
+
+        fields[length++] = (uint8_t)results[i].outcome;
+        length += put_varint(fields + length, to_us(results[i].elapsed_ms));
+        memcpy(fields + length, results[i].name, name_length);
+        length += name_length;
+        fields[length++] = '\0';
+    }
+    record(TRANSCRIPT_SHUTDOWN, session, fields, length, NULL);
+}
+
+void transcript_exited(int session, const ExitInfo *info) {
+    uint8_t fields[MAX_FIELD_BYTES];
+    size_t length = 0;
+
+    if (recorder.fd < 0) {
+        return;
+    }
+    length += put_varint(fields + length, (uint64_t)info->pid);
+    length += put_varint(fields + length, zigzag(info->status));
+    length += put_varint(fields + length, (uint64_t)info->signal);
+    length += put_varint(fields + length, to_us(info->user_ms));
+    length += put_varint(fields + length, to_us(info->system_ms));
+    length += put_varint(fields + length, info->max_rss_kb > 0 ? (uint64_t)info->max_rss_kb : 0);
+    record(TRANSCRIPT_EXITED, session, fields, length, NULL);
+}
+
+TranscriptReader *transcript_reader_open(const char *path) {
+    TranscriptReader *reader;
+    struct stat info;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    void *map;
+
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < strlen(TRANSCRIPT_MAGIC)) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+    map = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+    madvise(map, (size_t)info.st_size, MADV_SEQUENTIAL);
+
+    reader = calloc(1, sizeof(*reader));
+    if (!reader || memcmp(map, TRANSCRIPT_MAGIC, strlen(TRANSCRIPT_MAGIC)) != 0) {
+        free(reader);
+        munmap(map, (size_t)info.st_size);
+        errno = EINVAL;
+        return NULL;
+    }
+    reader->map = map;
+    reader->size = (size_t)info.st_size;
+    reader->position = strlen(TRANSCRIPT_MAGIC);
+    return reader;
+}
+
+/* A terminated string at *p within end */
+static bool get_string(const uint8_t **p, const uint8_t *end, const char **text) {
+    const uint8_t *nul = memchr(*p, '\0', (size_t)(end - *p));
+
+    if (!nul) {
+        return false;
+    }
+    *text = (const char *)*p;
+    *p = nul + 1;
+    return true;
+}
+
+/* The fields of a payload, by event type; false if they do not fit it */
+static bool decode_payload(TranscriptEvent *event, const uint8_t *p, const uint8_t *end) {
+    uint64_t a, b, c, d, e, f;
+
+    switch (event->type) {
+    case TRANSCRIPT_LAUNCH:
+        if (!get_varint(&p, end, &a) || !get_string(&p, end, &event->text)) {
+            return false;
+        }
+        event->pid = (pid_t)a;
+        return true;
+    case TRANSCRIPT_ENDPOINT:
+        if (p == end) {
+            return false;
+        }
+        event->readiness = *p++;
+        if (!get_varint(&p, end, &a) || !get_string(&p, end, &event->text)) {
+            return false;
+        }
+        event->elapsed_ms = (double)a / 1000.0;
+        return true;
+    case TRANSCRIPT_COMMAND:
+        if (p == end || *p > TRANSCRIPT_COMMAND_MEM) {
+            return false;
+        }
+        event->kind = (TranscriptCommandKind)*p++;
+        if (event->kind == TRANSCRIPT_COMMAND_MEM) {
+            if (!get_varint(&p, end, &a) || !get_varint(&p, end, &b) ||
+                !get_varint(&p, end, &c)) {
+                return false;
+            }
+            event->segment = (uint16_t)a;
+            event->offset = (uint32_t)b;
+            event->len = (uint32_t)c;
+        }
+        return get_string(&p, end, &event->text);
+    case TRANSCRIPT_OUTPUT:
+        if (p == end) {
+            return false;
+        }
+        if (*p++) {
+            event->text = NULL;
+            return true;
+        }
+        return get_string(&p, end, &event->text);
+    case TRANSCRIPT_STOP:
+        return true;
+    case TRANSCRIPT_SHUTDOWN:
+        if (!get_varint(&p, end, &a) || p == end || *p > SHUTDOWN_MAX_TARGETS) {
+            return false;
+        }
+        event->total_ms = (double)a / 1000.0;
+        event->result_count = *p++;
+        for (int i = 0; i < event->result_count; i++) {
+            if (p == end) {
+                return false;
+            }
+            event->results[i].outcome = (ShutdownOutcome)*p++;
+            if (!get_varint(&p, end, &a) || !get_string(&p, end, &event->results[i].name)) {
+                return false;
+            }
+            event->results[i].elapsed_ms = (double)a / 1000.0;
+        }
+        return true;
+    case TRANSCRIPT_EXITED:
+        if (!get_varint(&p, end, &a) || !get_varint(&p, end, &b) || !get_varint(&p, end, &c) ||
+            !get_varint(&p, end, &d) || !get_varint(&p, end, &e) || !get_varint(&p, end, &f)) {
+            return false;
+        }
+        event->exit.pid = (pid_t)a;
+        event->exit.status = (int)unzigzag(b);
+        event->exit.signal = (int)c;
+        event->exit.user_ms = (double)d / 1000.0;
+        event->exit.system_ms = (double)e / 1000.0;
+        event->exit.max_rss_kb = (long)f;
+        event->pid = event->exit.pid;
+        return true;
+    }
+    return false;
+}
+
+bool transcript_reader_next(TranscriptReader *reader, TranscriptEvent *event) {
+    const uint8_t *end = reader->map + reader->size;
+
+    while (!reader->failed && reader->position < reader->size) {
+        const uint8_t *p = reader->map + reader->position;
+        uint64_t delta, session, length;
+        uint8_t type = *p++;
+
+        if (!get_varint(&p, end, &delta) || !get_varint(&p, end, &session) ||
+            !get_varint(&p, end, &length) || length > (uint64_t)(end - p)) {
+            reader->failed = true;
+            return false;
+        }
+        reader->position = (size_t)(p - reader->map) + length;
+        reader->time_ns += delta;
+
+        /* Event types added after this reader are skipped over */
+        if (type < TRANSCRIPT_LAUNCH || type > TRANSCRIPT_EXITED) {
+            continue;
+        }
+
+        memset(event, 0, sizeof(*event));
+        event->type = (TranscriptEventType)type;
+        event->time_ns = reader->time_ns;
+        event->session = (int)session;
+        if (!decode_payload(event, p, p + length)) {
+            reader->failed = true;
+            return false;
+        }
+        return true;
+    }
+    return false;
+}
+
+bool transcript_reader_failed(const TranscriptReader *reader) {
+    return reader->failed;
+}
+
+void transcript_reader_close(TranscriptReader *reader) {
+    if (reader) {
+        munmap((void *)reader->map, reader->size);
+        free(reader);
+    }
+}
+
+const char *transcript_event_name(TranscriptEventType type) {
+    switch (type) {
+    case TRANSCRIPT_LAUNCH:
+        return "launch";
+    case TRANSCRIPT_ENDPOINT:
+        return "endpoint";
+    case TRANSCRIPT_COMMAND:
+        return "command";
+    case TRANSCRIPT_OUTPUT:
+        return "output";
+    case TRANSCRIPT_STOP:
+        return "stop";
+    case TRANSCRIPT_SHUTDOWN:
+        return "shutdown";
+    case TRANSCRIPT_EXITED:
+        return "exited";
+    }
+    return "unknown";
+}
+
+static void on_replay_started(DosemuSession *session, bool success, void *data) {
+    if (success) {
+        replay.stats.launched++;
+    } else {
+        replay.stats.failed++;
+    }
+}
+
+/* Answers to replayed commands only need to be parsed, as they were when recorded */
+static void on_replay_regs(bool ok, const DbgRegs *regs, void *data) {
+}
+
+static void on_replay_mem(bool ok, uint16_t segment, uint32_t offset, const uint8_t *bytes,
+                          size_t len, void *data) {
+}
+
+static ReplaySession *find_replayed(int recorded) {
+    if (recorded == 0) {
+        return NULL;
+    }
+    if (replay.sessions[replay.last].recorded == recorded) {
+        return &replay.sessions[replay.last];
+    }
+    for (int i = 0; i < MAX_SESSIONS; i++) {
+        if (replay.sessions[i].recorded == recorded) {
+            replay.last = i;
+            return &replay.sessions[i];
+        }
+    }
+    return NULL;
+}
+
+/* A slot for a new session, reusing those whose session has left the table */
+static ReplaySession *new_replayed(int recorded, int live) {
+    ReplaySession *slot = NULL;
+
+    for (int i = 0; i < MAX_SESSIONS && !slot; i++) {
+        if (replay.sessions[i].recorded == 0 || !dosemu_session_find(replay.sessions[i].live)) {
+            slot = &replay.sessions[i];
+        }
+    }
+    if (slot) {
+        slot->recorded = recorded;
+        slot->live = live;
+        slot->commands = 0;
+    }
+    return slot;
+}
+
+static bool replay_command(ReplaySession *slot, DbgClient *client, const TranscriptEvent *event) {
+    /* Commands the integration layer issues itself are already queued */
+    if (dbg_commands_issued(client) >= ++slot->commands) {
+        return true;
+    }
+    switch (event->kind) {
+    case TRANSCRIPT_COMMAND_REGS:
+        return dbg_regs(client, on_replay_regs, NULL);
+    case TRANSCRIPT_COMMAND_MEM:
+        return dbg_read_mem(client, event->segment, event->offset, event->len, on_replay_mem,
+                            NULL);
+    default:
+        return dbg_command(client, event->text, NULL, NULL);
+    }
+}
+
+/* Hand one event to the session replaying its recorded session */
+static bool apply(const TranscriptEvent *event) {
+    ReplaySession *slot;
+    DosemuSession *session;
+    DbgClient *client;
+
+    if (event->type == TRANSCRIPT_LAUNCH) {
+        session = dosemu_replay_launch(event->pid, event->text, on_replay_started, NULL);
+        if (session && !new_replayed(event->session, dosemu_session_id(session))) {
+            dosemu_replay_exited(session, &(ExitInfo){.status = -1});
+            return false;
+        }
+        return session != NULL;
+    }
+
+    slot = find_replayed(event->session);
+    session = slot ? dosemu_session_find(slot->live) : NULL;
+    if (!session) {
+        return false;
+    }
+    client = dosemu_session_debugger(session);
+
+    switch (event->type) {
+    case TRANSCRIPT_ENDPOINT:
+        return dosemu_replay_endpoint(session, (ReadinessResult)event->readiness, event->text,
+                                      event->elapsed_ms);
+    case TRANSCRIPT_COMMAND:
+        return client && replay_command(slot, client, event);
+    case TRANSCRIPT_OUTPUT:
+        if (client) {
+            dbg_replay_output(client, event->text);
+        }
+        return client != NULL;
+    case TRANSCRIPT_STOP:
+        return stop_dosemu(session, NULL, NULL);
+    case TRANSCRIPT_SHUTDOWN:
+        return dosemu_replay_shutdown(session, event->results, event->result_count,
+                                      event->total_ms);
+    case TRANSCRIPT_EXITED:
+        return dosemu_replay_exited(session, &event->exit);
+    default:
+        return false;
+    }
+}
+
+/* Make every session the transcript left open exit, then report */
+static void finish_replay(void) {
+    transcript_done_callback done = replay.done;
+    ExitInfo info = {.status = -1};
+
+    for (int i = 0; i < MAX_SESSIONS; i++) {
+        DosemuSession *session = replay.sessions[i].recorded
+                                     ? dosemu_session_find(replay.sessions[i].live) : NULL;
+
+        if (session) {
+            dosemu_replay_shutdown(session, NULL, 0, 0.0);
+            dosemu_replay_exited(session, &info);
+        }
+    }
+
+    replay.stats.corrupt = transcript_reader_failed(replay.reader);
+    replay.stats.elapsed_ms = (double)(trace_now() - replay.start_ns) / 1000000.0;
+    transcript_reader_close(replay.reader);
+    replay.reader = NULL;
+    replay.done = NULL;
+    replay.generation++;
+
+    log_message("Replayed %llu transcript events (%llu skipped%s) in %.1f ms: "
+                "%d sessions up, %d failed\n", (unsigned long long)replay.stats.events,
+                (unsigned long long)replay.stats.skipped,
+                replay.stats.corrupt ? ", transcript damaged" : "", replay.stats.elapsed_ms,
+                replay.stats.launched, replay.stats.failed);
+    if (done) {
+        done(&replay.stats, replay.done_data);
+    }
+}
+
+static void replay_step(void *data);
+
+/* I/O thread: wake the replay when its next event is due */
+static void on_replay_timer(int id, uint32_t events, void *data) {
+    main_queue(replay_step, data);
+}
+
+static void arm_replay_timer(void *data) {
+    ReplayWake *wake = data;
+
+    io_loop_add_timeout(wake->milliseconds, on_replay_timer,
+                        (void *)(intptr_t)wake->generation);
+    free(wake);
+}
+
+/* Replay a batch of events, then yield to the rest of the UI thread's work */
+static void replay_step(void *data) {
+    int generation = (int)(intptr_t)data;
+
+    if (!replay.reader || generation != replay.generation) {
+        return;
+    }
+
+    for (int n = 0; n < TRANSCRIPT_REPLAY_BATCH; n++) {
+        if (!replay.have_next) {
+            replay.have_next = transcript_reader_next(replay.reader, &replay.next);
+            if (!replay.have_next) {
+                finish_replay();
+                return;
+            }
+        }
+
+        if (replay.realtime) {
+            uint64_t elapsed = trace_now() - replay.start_ns;
+
+            if (replay.next.time_ns > elapsed) {
+                ReplayWake *wake = malloc(sizeof(*wake));
+
+                if (!wake) {
+                    break;
+                }
+                wake->milliseconds = (int)((replay.next.time_ns - elapsed + 999999) / 1000000);
+                wake->generation = generation;
+                if (!io_loop_post(arm_replay_timer, wake)) {
+                    free(wake);
+                    break;
+                }
+                return;
+            }
+            if ((double)(elapsed - replay.next.time_ns) / 1000000.0 > replay.stats.max_lag_ms) {
+                replay.stats.max_lag_ms = (double)(elapsed - replay.next.time_ns) / 1000000.0;
+            }
+        }
+
+        replay.have_next = false;
+        replay.stats.events++;
+        if (!apply(&replay.next)) {
+            replay.stats.skipped++;
+        }
+    }
+    main_queue(replay_step, data);
+}
+
+bool transcript_replay_start(const char *path, bool realtime, transcript_done_callback done,
+                             void *data) {
+    TranscriptReader *reader;
+
+    if (replay.reader) {
+        log_error("A transcript is already being replayed\n");
+        return false;
+    }
+    reader = transcript_reader_open(path);
+    if (!reader) {
+        log_error("Cannot replay transcript %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    memset(replay.sessions, 0, sizeof(replay.sessions));
+    memset(&replay.stats, 0, sizeof(replay.stats));
+    replay.reader = reader;
+    replay.realtime = realtime;
+    replay.have_next = false;
+    replay.last = 0;
+    replay.done = done;
+    replay.done_data = data;
+    replay.start_ns = trace_now();
+    replay.generation++;
+
+    log_message("Replaying transcript %s%s\n", path, realtime ? " at recorded speed" : "");
+    main_queue(replay_step, (void *)(intptr_t)replay.generation);
+    return true;
+}
+
+void transcript_replay_stop(void) {
+    if (replay.reader) {
+        finish_replay();
+    }
+}
+
+bool transcript_replay_running(void) {
+    return replay.reader != NULL;
+}
+
+void transcript_replay_stats(TranscriptReplayStats *stats) {
+    *stats = replay.stats;
+    if (replay.reader) {
+        stats->elapsed_ms = (double)(trace_now() - replay.start_ns) / 1000000.0;
+    }
+}
@@ -1,5 +1,23 @@
 #include "../include/ui_main.h"
 #include "../include/dosemu_integration.h"
+#include "../include/console.h"
+#include "../include/dbg_client.h"
+#include "../include/dosemurc.h"
+#include "../include/itrace.h"
+#include "../include/logger.h"
+#include "../include/profiler.h"
+#include "../include/memview.h"
+#include "../include/overlay.h"
+#include "../include/placement.h"
+#include "../include/pool.h"
+#include "../include/resmon.h"
+#include "../include/screen.h"
+#include "../include/sessionlog.h"
+#include "../include/trace.h"
+#include "../include/transcript.h"
+#include <ctype.h>
+#include <limits.h>
+#include <math.h>
 
 /* Create a labeled control with horizontal layout */
 static uiBox *create_labeled_control(const char *label_text, uiControl *control) {
@@ -51,6 +69,13 @@ static uiControl *create_config_tab(void) {
     uiBoxAppend(config_path_box, uiControl(create_labeled_control("Config Path:", uiControl(app.config_path_entry))), 1);
     uiBoxAppend(config_path_box, uiControl(browse_config_button), 0);
 
+    /* DOS drive directory; each session gets a copy-on-write copy of it */
+    uiBox *drive_dir_box = uiNewHorizontalBox();
+    uiBoxSetPadded(drive_dir_box, 1);
+
+    app.drive_dir_entry = uiNewEntry();
+    uiBoxAppend(drive_dir_box, uiControl(create_labeled_control("DOS Drive (C:, staged in tmpfs):", uiControl(app.drive_dir_entry))), 1);
+
     /* Memory configurations */
     uiForm *memory_form = uiNewForm();
     uiFormSetPadded(memory_form, 1);
@@ -67,6 +92,62 @@ static uiControl *create_config_tab(void) {
     uiEntrySetText(app.ems_size_entry, "8192");
     uiFormAppend(memory_form, "EMS Size (KB):", uiControl(app.ems_size_entry), 0);
 
+    app.attach_timeout_entry = uiNewEntry();
+    uiEntrySetText(app.attach_timeout_entry, "10000");
+    uiFormAppend(memory_form, "Debugger Attach Timeout (ms):", uiControl(app.attach_timeout_entry), 0);
+
+    app.capture_log_entry = uiNewEntry();
+    uiFormAppend(memory_form, "Output Log Directory:", uiControl(app.capture_log_entry), 0);
+
+    /* Pre-warm pool; Apply boots instances with the paths above */
+    app.pool_size_entry = uiNewEntry();
+    uiEntrySetText(app.pool_size_entry, "0");
+    uiFormAppend(memory_form, "Pre-warmed Instances:", uiControl(app.pool_size_entry), 0);
+
+    app.pool_refill_entry = uiNewEntry();
+    uiEntrySetText(app.pool_refill_entry, "1");
+    uiFormAppend(memory_form, "Concurrent Warm-ups:", uiControl(app.pool_refill_entry), 0);
+
+    app.pool_budget_entry = uiNewEntry();
+    uiEntrySetText(app.pool_budget_entry, "0");
+    uiFormAppend(memory_form, "Idle Memory Budget (MB, 0 = none):", uiControl(app.pool_budget_entry), 0);
+
+    uiButton *pool_apply_button = uiNewButton("Apply Pool Settings");
+    uiButtonOnClicked(pool_apply_button, on_pool_apply_clicked, NULL);
+
+    /* Where instances run; applied to each launch, pre-warmed ones included */
+    uiForm *placement_form = uiNewForm();
+    uiFormSetPadded(placement_form, 1);
+
+    app.cpu_affinity_entry = uiNewEntry();
+    uiFormAppend(placement_form, "CPU Affinity (e.g. 2-3,6; empty = any):",
+                 uiControl(app.cpu_affinity_entry), 0);
+
+    app.auto_spread_checkbox = uiNewCheckbox("One instance per physical core, skipping SMT siblings");
+    uiFormAppend(placement_form, "Auto-spread:", uiControl(app.auto_spread_checkbox), 0);
+
+    app.sched_class_combobox = uiNewCombobox();
+    uiComboboxAppend(app.sched_class_combobox, "Normal");
+    uiComboboxAppend(app.sched_class_combobox, "Batch (SCHED_BATCH)");
+    uiComboboxAppend(app.sched_class_combobox, "Idle (SCHED_IDLE)");
+    uiComboboxSetSelected(app.sched_class_combobox, SCHED_CLASS_NORMAL);
+    uiFormAppend(placement_form, "Scheduling Class:", uiControl(app.sched_class_combobox), 0);
+
+    app.nice_entry = uiNewEntry();
+    uiEntrySetText(app.nice_entry, "0");
+    uiFormAppend(placement_form, "Nice Increment:", uiControl(app.nice_entry), 0);
+
+    app.cgroup_entry = uiNewEntry();
+    uiFormAppend(placement_form, "cgroup v2 Parent (empty = none):", uiControl(app.cgroup_entry), 0);
+
+    app.cpu_max_entry = uiNewEntry();
+    uiEntrySetText(app.cpu_max_entry, "0");
+    uiFormAppend(placement_form, "CPU Limit (% of a core, 0 = none):", uiControl(app.cpu_max_entry), 0);
+
+    app.memory_max_entry = uiNewEntry();
+    uiEntrySetText(app.memory_max_entry, "0");
+    uiFormAppend(placement_form, "Memory Limit (MB, 0 = none):", uiControl(app.memory_max_entry), 0);
+
     /* Video options */
     uiBox *video_box = uiNewHorizontalBox();
     uiBoxSetPadded(video_box, 1);
@@ -86,13 +167,413 @@ static uiControl *create_config_tab(void) {
     /* Add components to the configuration tab */
     uiBoxAppend(vbox, uiControl(dos_path_box), 0);
     uiBoxAppend(vbox, uiControl(config_path_box), 0);
+    uiBoxAppend(vbox, uiControl(drive_dir_box), 0);
     uiBoxAppend(vbox, uiControl(memory_form), 0);
+    uiBoxAppend(vbox, uiControl(pool_apply_button), 0);
+    uiBoxAppend(vbox, uiControl(placement_form), 0);
     uiBoxAppend(vbox, uiControl(video_box), 0);
     uiBoxAppend(vbox, uiControl(app.auto_start_checkbox), 0);
 
     return uiControl(vbox);
 }
 
+/* Session list columns */
+enum {
+    SESSION_COLUMN_ID,
+    SESSION_COLUMN_PID,
+    SESSION_COLUMN_STATE,
+    SESSION_COLUMN_COUNT
+};
+
+static uiTableModelHandler session_model_handler;
+
+static int session_model_num_columns(uiTableModelHandler *mh, uiTableModel *m) {
+    return SESSION_COLUMN_COUNT;
+}
+
+static uiTableValueType session_model_column_type(uiTableModelHandler *mh, uiTableModel *m, int column) {
+    return uiTableValueTypeString;
+}
+
+static int session_model_num_rows(uiTableModelHandler *mh, uiTableModel *m) {
+    return dosemu_session_count();
+}
+
+static uiTableValue *session_model_cell_value(uiTableModelHandler *mh, uiTableModel *m, int row, int column) {
+    DosemuSession *session = dosemu_session_at(row);
+    char text[64];
+
+    if (!session) {
+        return uiNewTableValueString("");
+    }
+
+    switch (column) {
+    case SESSION_COLUMN_ID:
+        snprintf(text, sizeof(text), "%d", dosemu_session_id(session));
+        break;
+    case SESSION_COLUMN_PID:
+        snprintf(text, sizeof(text), "%d", (int)dosemu_session_pid(session));
+        break;
+    default:
+        /* Flag sessions whose config file changed after they were launched */
+        snprintf(text, sizeof(text), "%s%s", dosemu_session_state_name(dosemu_session_state(session)),
+                 dosemu_session_config_stale(session) ? " (config changed)" : "");
+        break;
+    }
+    return uiNewTableValueString(text);
+}
+
+static void session_model_set_cell_value(uiTableModelHandler *mh, uiTableModel *m, int row, int column, const uiTableValue *value) {
+    /* Read-only */
+}
+
+/* The session selected in the list, or NULL */
+static DosemuSession *selected_session(void) {
+    DosemuSession *session = NULL;
+    uiTableSelection *selection = uiTableGetSelection(app.session_table);
+
+    if (selection->NumRows > 0) {
+        session = dosemu_session_at(selection->Rows[0]);
+    }
+    uiFreeTableSelection(selection);
+    return session;
+}
+
+/* Enable Stop only for a selected session that can be stopped */
+static void update_session_controls(void) {
+    DosemuSession *session = selected_session();
+    SessionState state = session ? dosemu_session_state(session) : SESSION_STOPPED;
+    int running = 0;
+    int idle = 0;
+    char status[64];
+
+    if (state == SESSION_STARTING || state == SESSION_RUNNING || state == SESSION_IDLE) {
+        uiControlEnable(uiControl(app.stop_button));
+    } else {
+        uiControlDisable(uiControl(app.stop_button));
+    }
+
+    if (dosemu_session_count() < MAX_SESSIONS) {
+        uiControlEnable(uiControl(app.start_button));
+    } else {
+        uiControlDisable(uiControl(app.start_button));
+    }
+
+    for (int i = 0; i < dosemu_session_count(); i++) {
+        state = dosemu_session_state(dosemu_session_at(i));
+        if (state == SESSION_RUNNING) {
+            running++;
+        } else if (state == SESSION_IDLE) {
+            idle++;
+        }
+    }
+
+    if (dosemu_session_count() == idle) {
+        snprintf(status, sizeof(status), "Stopped");
+    } else {
+        snprintf(status, sizeof(status), "%d of %d sessions running",
+                 running, dosemu_session_count() - idle);
+    }
+    uiLabelSetText(app.status_label, status);
+}
+
+/* Session output view: one log line per row */
+#define LOG_VIEW_ROW_HEIGHT 16
+#define LOG_VIEW_WIDTH 1600
+#define LOG_VIEW_MAX_COLUMNS 256
+#define LOG_VIEW_REFRESH_MS 100
+
+/* Bytes of candidate lines a search scans per refresh */
+#define LOG_VIEW_SEARCH_BUDGET (64 * 1024 * 1024)
+
+static uiAreaHandler log_area_handler;
+static SessionLog *log_view = NULL;            /* log shown, with a reference */
+static SessionLogSearch *log_search = NULL;   /* filter, or NULL for every line */
+static uint64_t log_view_rows = 0;            /* rows the area is sized for */
+static uint64_t log_visible_last = 0;
+
+/* Text of a row: a line of the log, or of the matches when filtering */
+static const char *log_row_text(uint64_t row, size_t *length) {
+    if (log_search) {
+        return sessionlog_search_match(log_search, row, length);
+    }
+    return sessionlog_line(log_view, row, length);
+}
+
+/* Where the query occurs in text, ignoring ASCII case, or -1 */
+static long find_query(const char *text, size_t length, const char *query, size_t from) {
+    size_t query_length = strlen(query);
+
+    for (size_t i = from; query_length && i + query_length <= length; i++) {
+        size_t j = 0;
+        while (j < query_length && tolower((unsigned char)text[i + j]) ==
+                                       tolower((unsigned char)query[j])) {
+            j++;
+        }
+        if (j == query_length) {
+            return (long)i;
+        }
+    }
+    return -1;
+}
+
+static void draw_log_row(uiAreaDrawParams *params, uiFontDescriptor *font, uint64_t row,
+                         const char *query) {
+    char line[LOG_VIEW_MAX_COLUMNS + 1];
+    size_t length;
+    const char *text = log_row_text(row, &length);
+
+    /* DOS output is not UTF-8; show anything unprintable as a dot */
+    if (length > LOG_VIEW_MAX_COLUMNS) {
+        length = LOG_VIEW_MAX_COLUMNS;
+    }
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)text[i];
+        line[i] = c >= 0x20 && c < 0x7f ? (char)c : '.';
+    }
+    line[length] = '\0';
+
+    uiAttributedString *string = uiNewAttributedString(line);
+    for (long hit = query ? find_query(line, length, query, 0) : -1; hit >= 0;
+         hit = find_query(line, length, query, (size_t)hit + 1)) {
+        uiAttributedStringSetAttribute(string, uiNewBackgroundAttribute(1.0, 0.85, 0.3, 1.0),
+                                       (size_t)hit, (size_t)hit + strlen(query));
+    }
+
+    uiDrawTextLayoutParams layout_params;
+    layout_params.String = string;
+    layout_params.DefaultFont = font;
+    layout_params.Width = -1;
+    layout_params.Align = uiDrawTextAlignLeft;
+
+    uiDrawTextLayout *layout = uiDrawNewTextLayout(&layout_params);
+    uiDrawText(params->Context, layout, 0, (double)row * LOG_VIEW_ROW_HEIGHT);
+    uiDrawFreeTextLayout(layout);
+    uiFreeAttributedString(string);
+}
+
+/* Only the rows inside the clip rectangle are read from the mapped log */
+static void log_area_draw(uiAreaHandler *handler, uiArea *area, uiAreaDrawParams *params) {
+    uiFontDescriptor font = {"Monospace", 10, uiTextWeightNormal, uiTextItalicNormal,
+                             uiTextStretchNormal};
+    char *query = log_search ? uiEntryText(app.log_search_entry) : NULL;
+    uint64_t first_row, last_row;
+
+    if (!log_view) {
+        return;
+    }
+
+    first_row = params->ClipY > 0 ? (uint64_t)(params->ClipY / LOG_VIEW_ROW_HEIGHT) : 0;
+    last_row = (uint64_t)((params->ClipY + params->ClipHeight) / LOG_VIEW_ROW_HEIGHT) + 1;
+    if (last_row > log_view_rows) {
+        last_row = log_view_rows;
+    }
+
+    for (uint64_t row = first_row; row < last_row; row++) {
+        draw_log_row(params, &font, row, query);
+    }
+    if (last_row > 0) {
+        log_visible_last = last_row - 1;
+    }
+    if (query) {
+        uiFreeText(query);
+    }
+}
+
+static void log_area_mouse_event(uiAreaHandler *handler, uiArea *area, uiAreaMouseEvent *event) {
+}
+
+static void log_area_mouse_crossed(uiAreaHandler *handler, uiArea *area, int left) {
+}
+
+static void log_area_drag_broken(uiAreaHandler *handler, uiArea *area) {
+}
+
+static int log_area_key_event(uiAreaHandler *handler, uiArea *area, uiAreaKeyEvent *event) {
+    return 0;
+}
+
+static void update_log_status(void) {
+    char status[256];
+    size_t used;
+
+    if (!log_view) {
+        uiLabelSetText(app.log_status_label, "Select a session to see its output");
+        return;
+    }
+
+    used = (size_t)snprintf(status, sizeof(status),
+                            "Session %d: %llu lines, %.1f MB (index %.1f MB)",
+                            sessionlog_session_id(log_view),
+                            (unsigned long long)sessionlog_lines(log_view),
+                            sessionlog_bytes(log_view) / 1048576.0,
+                            sessionlog_index_bytes(log_view) / 1048576.0);
+    if (log_search) {
+        snprintf(status + used, sizeof(status) - used, " | %llu matches, %.1f MB read%s",
+                 (unsigned long long)sessionlog_search_count(log_search),
+                 sessionlog_search_scanned(log_search) / 1048576.0,
+                 sessionlog_search_caught_up(log_search) ? "" : ", searching...");
+    }
+    uiLabelSetText(app.log_status_label, status);
+}
+
+/* Size the area for the rows there are now, following the end if it was in view */
+static void resize_log_area(void) {
+    uint64_t rows = 0;
+    bool following = log_visible_last + 1 >= log_view_rows;
+
+    if (log_view) {
+        rows = log_search ? sessionlog_search_count(log_search) : sessionlog_lines(log_view);
+    }
+
+    /* The area's height is an int */
+    if (rows > INT_MAX / LOG_VIEW_ROW_HEIGHT) {
+        rows = INT_MAX / LOG_VIEW_ROW_HEIGHT;
+    }
+    if (rows == log_view_rows) {
+        return;
+    }
+
+    log_view_rows = rows;
+    uiAreaSetSize(app.log_area, LOG_VIEW_WIDTH, (int)(rows * LOG_VIEW_ROW_HEIGHT));
+    if (following && rows > 0) {
+        uiAreaScrollTo(app.log_area, 0, (double)(rows - 1) * LOG_VIEW_ROW_HEIGHT,
+                       LOG_VIEW_WIDTH, LOG_VIEW_ROW_HEIGHT);
+    }
+    uiAreaQueueRedrawAll(app.log_area);
+}
+
+/* Filter the shown log by the search box, or show all of it */
+static void restart_log_search(void) {
+    char *query = uiEntryText(app.log_search_entry);
+
+    sessionlog_search_free(log_search);
+    log_search = NULL;
+    if (log_view && *query) {
+        log_search = sessionlog_search_start(log_view, query);
+        if (log_search) {
+            sessionlog_search_step(log_search, LOG_VIEW_SEARCH_BUDGET);
+        }
+    }
+    uiFreeText(query);
+
+    log_view_rows = 0;
+    log_visible_last = 0;
+    resize_log_area();
+    uiAreaScrollTo(app.log_area, 0, 0, LOG_VIEW_WIDTH, LOG_VIEW_ROW_HEIGHT);
+    uiAreaQueueRedrawAll(app.log_area);
+    update_log_status();
+}
+
+static void show_session_log(int session_id) {
+    if (log_view && sessionlog_session_id(log_view) == session_id) {
+        return;
+    }
+
+    /* The log stays readable after its session has gone */
+    SessionLog *log = sessionlog_find(session_id);
+    if (!log) {
+        return;
+    }
+    sessionlog_search_free(log_search);
+    log_search = NULL;
+    sessionlog_release(log_view);
+    log_view = log;
+    restart_log_search();
+}
+
+static void on_log_search_changed(uiEntry *entry, void *data) {
+    restart_log_search();
+}
+
+/* Index new output of every session and carry the search on over it */
+static int refresh_log_view(void *data) {
+    bool changed = sessionlog_update_all();
+
+    if (log_search && !sessionlog_search_caught_up(log_search)) {
+        sessionlog_search_step(log_search, LOG_VIEW_SEARCH_BUDGET);
+        changed = true;
+    }
+    if (changed && log_view) {
+        resize_log_area();
+        update_log_status();
+    }
+    return 1;
+}
+
+/* Keep the list view in step with the session table */
+static void on_session_table_changed(SessionEvent event, int index, void *data) {
+    switch (event) {
+    case SESSION_ADDED:
+        uiTableModelRowInserted(app.session_model, index);
+        break;
+    case SESSION_CHANGED:
+        uiTableModelRowChanged(app.session_model, index);
+        break;
+    case SESSION_REMOVED:
+        uiTableModelRowDeleted(app.session_model, index);
+        break;
+    }
+    update_session_controls();
+}
+
+static void on_session_selection_changed(uiTable *table, void *data) {
+    DosemuSession *session = selected_session();
+
+    update_session_controls();
+    if (session) {
+        show_session_log(dosemu_session_id(session));
+    }
+}
+
+/* How often the pool status line is refreshed */
+#define POOL_REFRESH_MS 500
+
+static int refresh_pool_status(void *data) {
+    PoolStats stats;
+    char text[256];
+
+    pool_stats(&stats);
+    if (stats.ready == 0 && stats.warming == 0 && stats.hits == 0 && stats.misses == 0) {
+        uiLabelSetText(app.pool_status_label, "Disabled");
+        return 1;
+    }
+
+    snprintf(text, sizeof(text),
+             "%d ready, %d warming, %zu MB idle | %llu hits, %llu misses | "
+             "ready in p50 %.0f ms, p99 %.0f ms | boot p50 %.0f ms",
+             stats.ready, stats.warming, stats.idle_rss_kb / 1024,
+             (unsigned long long)stats.hits, (unsigned long long)stats.misses,
+             latency_percentile(&stats.time_to_ready, 0.50),
+             latency_percentile(&stats.time_to_ready, 0.99),
+             latency_percentile(&stats.boot, 0.50));
+    uiLabelSetText(app.pool_status_label, text);
+    return 1;
+}
+
+static int refresh_drive_status(void *data) {
+    OverlayStats stats;
+    char text[256];
+
+    overlay_totals(&stats);
+    if (stats.overlays == 0) {
+        uiLabelSetText(app.drive_status_label, app.drive_dir ? "None yet" : "Disabled");
+        return 1;
+    }
+
+    snprintf(text, sizeof(text),
+             "%llu staged in %.0f ms avg, %llu MB copied, %llu MB reflinked | "
+             "%llu files (%llu KB) harvested, %llu deleted, %llu conflicts",
+             (unsigned long long)stats.overlays, stats.stage_ms / (double)stats.overlays,
+             (unsigned long long)(stats.bytes_copied >> 20),
+             (unsigned long long)(stats.bytes_cloned >> 20),
+             (unsigned long long)stats.harvested_files,
+             (unsigned long long)(stats.harvested_bytes >> 10),
+             (unsigned long long)stats.deleted_files, (unsigned long long)stats.conflicts);
+    uiLabelSetText(app.drive_status_label, text);
+    return 1;
+}
+
 /* Create the control tab */
 static uiControl *create_control_tab(void) {
     uiBox *vbox = uiNewVerticalBox();
@@ -102,8 +583,16 @@ static uiControl *create_control_tab(void) {
     uiForm *status_form = uiNewForm();
     uiFormSetPadded(status_form, 1);
 
-    uiLabel *status_label = uiNewLabel("Stopped");
-    uiFormAppend(status_form, "Status:", uiControl(status_label), 0);
+    app.status_label = uiNewLabel("Stopped");
+    uiFormAppend(status_form, "Status:", uiControl(app.status_label), 0);
+
+    app.pool_status_label = uiNewLabel("Disabled");
+    uiFormAppend(status_form, "Pre-warm Pool:", uiControl(app.pool_status_label), 0);
+    uiTimer(POOL_REFRESH_MS, refresh_pool_status, NULL);
+
+    app.drive_status_label = uiNewLabel("Disabled");
+    uiFormAppend(status_form, "Staged Drives:", uiControl(app.drive_status_label), 0);
+    uiTimer(POOL_REFRESH_MS, refresh_drive_status, NULL);
 
     /* Control buttons */
     uiBox *button_box = uiNewHorizontalBox();
@@ -119,9 +608,33 @@ static uiControl *create_control_tab(void) {
     uiBoxAppend(button_box, uiControl(app.start_button), 1);
     uiBoxAppend(button_box, uiControl(app.stop_button), 1);
 
+    /* Session list */
+    uiTableParams table_params;
+
+    session_model_handler.NumColumns = session_model_num_columns;
+    session_model_handler.ColumnType = session_model_column_type;
+    session_model_handler.NumRows = session_model_num_rows;
+    session_model_handler.CellValue = session_model_cell_value;
+    session_model_handler.SetCellValue = session_model_set_cell_value;
+    app.session_model = uiNewTableModel(&session_model_handler);
+
+    table_params.Model = app.session_model;
+    table_params.RowBackgroundColorModelColumn = -1;
+    app.session_table = uiNewTable(&table_params);
+    uiTableAppendTextColumn(app.session_table, "Session", SESSION_COLUMN_ID,
+                            uiTableModelColumnNeverEditable, NULL);
+    uiTableAppendTextColumn(app.session_table, "PID", SESSION_COLUMN_PID,
+                            uiTableModelColumnNeverEditable, NULL);
+    uiTableAppendTextColumn(app.session_table, "State", SESSION_COLUMN_STATE,
+                            uiTableModelColumnNeverEditable, NULL);
+    uiTableSetSelectionMode(app.session_table, uiTableSelectionModeZeroOrOne);
+    uiTableOnSelectionChanged(app.session_table, on_session_selection_changed, NULL);
+    dosemu_set_session_listener(on_session_table_changed, NULL);
+
     /* Add components to the control tab */
     uiBoxAppend(vbox, uiControl(status_form), 0);
     uiBoxAppend(vbox, uiControl(button_box), 0);
+    uiBoxAppend(vbox, uiControl(app.session_table), 1);
 
     /* Add a spacer */
     uiBoxAppend(vbox, uiControl(uiNewVerticalSeparator()), 0);
@@ -130,62 +643,1531 @@ static uiControl *create_control_tab(void) {
     uiBox *console_box = uiNewVerticalBox();
     uiBoxSetPadded(console_box, 1);
 
+    uiBox *console_header = uiNewHorizontalBox();
+    uiBoxSetPadded(console_header, 1);
+
     uiLabel *console_label = uiNewLabel("Console Output:");
-    uiBoxAppend(console_box, uiControl(console_label), 0);
+    uiBoxAppend(console_header, uiControl(console_label), 1);
+
+    uiButton *save_log_button = uiNewButton("Save Log...");
+    uiButtonOnClicked(save_log_button, on_save_log_clicked, NULL);
+    uiBoxAppend(console_header, uiControl(save_log_button), 0);
+
+    uiButton *save_trace_button = uiNewButton("Save Trace...");
+    uiButtonOnClicked(save_trace_button, on_save_trace_clicked, NULL);
+    uiBoxAppend(console_header, uiControl(save_trace_button), 0);
+
+    /* Transcripts of every session, and replays of them without DOSEmu */
+    app.transcript_record_button = uiNewButton("Record Transcript...");
+    uiButtonOnClicked(app.transcript_record_button, on_transcript_record_clicked, NULL);
+    uiBoxAppend(console_header, uiControl(app.transcript_record_button), 0);
+
+    app.transcript_replay_button = uiNewButton("Replay Transcript...");
+    uiButtonOnClicked(app.transcript_replay_button, on_transcript_replay_clicked, NULL);
+    uiBoxAppend(console_header, uiControl(app.transcript_replay_button), 0);
+
+    app.transcript_realtime_checkbox = uiNewCheckbox("At recorded speed");
+    uiBoxAppend(console_header, uiControl(app.transcript_realtime_checkbox), 0);
+
+    uiBoxAppend(console_box, uiControl(console_header), 0);
 
     app.console = uiNewMultilineEntry();
     uiMultilineEntrySetReadOnly(app.console, 1);
     uiBoxAppend(console_box, uiControl(app.console), 1);
 
+    /* Log lines are batched into the widget once per frame */
+    console_attach(app.console);
+
     uiBoxAppend(vbox, uiControl(console_box), 1);
 
+    /* Output of the selected session, read back from its log */
+    uiBox *log_box = uiNewVerticalBox();
+    uiBoxSetPadded(log_box, 1);
+
+    uiBox *log_header = uiNewHorizontalBox();
+    uiBoxSetPadded(log_header, 1);
+
+    uiLabel *log_label = uiNewLabel("Session Output:");
+    uiBoxAppend(log_header, uiControl(log_label), 0);
+
+    app.log_search_entry = uiNewSearchEntry();
+    uiEntryOnChanged(app.log_search_entry, on_log_search_changed, NULL);
+    uiBoxAppend(log_header, uiControl(create_labeled_control("Search:",
+                                                             uiControl(app.log_search_entry))), 1);
+
+    app.log_status_label = uiNewLabel("");
+    update_log_status();
+
+    log_area_handler.Draw = log_area_draw;
+    log_area_handler.MouseEvent = log_area_mouse_event;
+    log_area_handler.MouseCrossed = log_area_mouse_crossed;
+    log_area_handler.DragBroken = log_area_drag_broken;
+    log_area_handler.KeyEvent = log_area_key_event;
+    app.log_area = uiNewScrollingArea(&log_area_handler, LOG_VIEW_WIDTH, LOG_VIEW_ROW_HEIGHT);
+
+    uiBoxAppend(log_box, uiControl(log_header), 0);
+    uiBoxAppend(log_box, uiControl(app.log_status_label), 0);
+    uiBoxAppend(log_box, uiControl(app.log_area), 1);
+    uiBoxAppend(vbox, uiControl(log_box), 1);
+
+    uiTimer(LOG_VIEW_REFRESH_MS, refresh_log_view, NULL);
+
     return uiControl(vbox);
 }
 
-/* Create the main UI */
-void create_ui(void) {
-    /* Create main window */
-    app.main_window = uiNewWindow("DOSEmu2 GUI", 600, 400, 1);
+/* Debugger latency columns */
+enum {
+    LATENCY_COLUMN_COMMAND,
+    LATENCY_COLUMN_COUNT,
+    LATENCY_COLUMN_P50,
+    LATENCY_COLUMN_P99,
+    LATENCY_COLUMN_MAX,
+    LATENCY_COLUMN_TOTAL
+};
 
-    /* Create main vertical box */
-    app.main_vbox = uiNewVerticalBox();
-    uiBoxSetPadded(app.main_vbox, 1);
+/* How often the latency table is refreshed */
+#define LATENCY_REFRESH_MS 500
 
-    /* Create tab container */
-    app.main_tab = uiNewTab();
+static uiTableModelHandler latency_model_handler;
+static int latency_rows_shown = 0;
 
-    /* Add tabs */
-    uiTabAppend(app.main_tab, "Control", create_control_tab());
-    uiTabAppend(app.main_tab, "Configuration", create_config_tab());
+static int latency_model_num_columns(uiTableModelHandler *mh, uiTableModel *m) {
+    return LATENCY_COLUMN_TOTAL;
+}
 
-    /* Add tab container to main box */
-    uiBoxAppend(app.main_vbox, uiControl(app.main_tab), 1);
+static uiTableValueType latency_model_column_type(uiTableModelHandler *mh, uiTableModel *m, int column) {
+    return uiTableValueTypeString;
+}
 
-    /* Set main box as window content */
-    uiWindowSetChild(app.main_window, uiControl(app.main_vbox));
-    uiWindowSetMargined(app.main_window, 1);
+static int latency_model_num_rows(uiTableModelHandler *mh, uiTableModel *m) {
+    return latency_rows_shown;
 }
 
-/* UI callback implementations */
-void on_start_button_clicked(uiButton *button, void *data) {
-    const char *dos_path = uiEntryText(app.dos_path_entry);
-    const char *config_path = uiEntryText(app.config_path_entry);
+static uiTableValue *latency_model_cell_value(uiTableModelHandler *mh, uiTableModel *m, int row, int column) {
+    const DbgCommandStats *stats = dbg_stats_at(row);
+    char text[32];
 
-    if (start_dosemu(dos_path, config_path)) {
-        uiControlDisable(uiControl(app.start_button));
-        uiControlEnable(uiControl(app.stop_button));
-    } else {
-        uiMsgBoxError(app.main_window, "Error", "Failed to start DOSEmu");
+    if (!stats) {
+        return uiNewTableValueString("");
     }
+
+    switch (column) {
+    case LATENCY_COLUMN_COMMAND:
+        return uiNewTableValueString(stats->verb);
+    case LATENCY_COLUMN_COUNT:
+        snprintf(text, sizeof(text), "%llu", (unsigned long long)stats->latency.total);
+        break;
+    case LATENCY_COLUMN_P50:
+        snprintf(text, sizeof(text), "%.3f", latency_percentile(&stats->latency, 0.50));
+        break;
+    case LATENCY_COLUMN_P99:
+        snprintf(text, sizeof(text), "%.3f", latency_percentile(&stats->latency, 0.99));
+        break;
+    default:
+        snprintf(text, sizeof(text), "%.3f", stats->latency.max_ms);
+        break;
+    }
+    return uiNewTableValueString(text);
 }
 
-void on_stop_button_clicked(uiButton *button, void *data) {
-    if (stop_dosemu()) {
-        uiControlEnable(uiControl(app.start_button));
-        uiControlDisable(uiControl(app.stop_button));
+static void latency_model_set_cell_value(uiTableModelHandler *mh, uiTableModel *m, int row, int column, const uiTableValue *value) {
+    /* Read-only */
+}
+
+/* Show commands seen since the last refresh and update the others */
+static int refresh_latency_table(void *data) {
+    int count = dbg_stats_count();
+
+    for (int i = 0; i < latency_rows_shown; i++) {
+        uiTableModelRowChanged(app.latency_model, i);
+    }
+    while (latency_rows_shown < count) {
+        uiTableModelRowInserted(app.latency_model, latency_rows_shown++);
+    }
+    return 1;
+}
+
+/* Create the debugger tab */
+static uiControl *create_debugger_tab(void) {
+    uiBox *vbox = uiNewVerticalBox();
+    uiBoxSetPadded(vbox, 1);
+
+    uiLabel *label = uiNewLabel("Debugger command round trips (ms), all sessions:");
+    uiBoxAppend(vbox, uiControl(label), 0);
+
+    uiTableParams table_params;
+
+    latency_model_handler.NumColumns = latency_model_num_columns;
+    latency_model_handler.ColumnType = latency_model_column_type;
+    latency_model_handler.NumRows = latency_model_num_rows;
+    latency_model_handler.CellValue = latency_model_cell_value;
+    latency_model_handler.SetCellValue = latency_model_set_cell_value;
+    app.latency_model = uiNewTableModel(&latency_model_handler);
+
+    table_params.Model = app.latency_model;
+    table_params.RowBackgroundColorModelColumn = -1;
+    uiTable *table = uiNewTable(&table_params);
+    uiTableAppendTextColumn(table, "Command", LATENCY_COLUMN_COMMAND,
+                            uiTableModelColumnNeverEditable, NULL);
+    uiTableAppendTextColumn(table, "Count", LATENCY_COLUMN_COUNT,
+                            uiTableModelColumnNeverEditable, NULL);
+    uiTableAppendTextColumn(table, "p50", LATENCY_COLUMN_P50,
+                            uiTableModelColumnNeverEditable, NULL);
+    uiTableAppendTextColumn(table, "p99", LATENCY_COLUMN_P99,
+                            uiTableModelColumnNeverEditable, NULL);
+    uiTableAppendTextColumn(table, "Max", LATENCY_COLUMN_MAX,
+                            uiTableModelColumnNeverEditable, NULL);
+    uiBoxAppend(vbox, uiControl(table), 1);
+
+    uiTimer(LATENCY_REFRESH_MS, refresh_latency_table, NULL);
+
+    return uiControl(vbox);
+}
+
+/* Profile columns */
+enum {
+    PROFILE_COLUMN_ADDRESS,
+    PROFILE_COLUMN_SAMPLES,
+    PROFILE_COLUMN_PERCENT,
+    PROFILE_COLUMN_SEGMENT,
+    PROFILE_COLUMN_COUNT
+};
+
+/* Addresses listed in the profile table and how often it is refreshed */
+#define PROFILE_TOP_ENTRIES 100
+#define PROFILE_REFRESH_MS 250
+
+/* Which file format each export button writes */
+enum {
+    PROFILE_EXPORT_FOLDED,
+    PROFILE_EXPORT_PPROF,
+    PROFILE_EXPORT_SAMPLES
+};
+
+static uiTableModelHandler profile_model_handler;
+static ProfileEntry profile_rows[PROFILE_TOP_ENTRIES];
+static int profile_rows_shown = 0;
+
+static int profile_model_num_columns(uiTableModelHandler *mh, uiTableModel *m) {
+    return PROFILE_COLUMN_COUNT;
+}
+
+static uiTableValueType profile_model_column_type(uiTableModelHandler *mh, uiTableModel *m, int column) {
+    return uiTableValueTypeString;
+}
+
+static int profile_model_num_rows(uiTableModelHandler *mh, uiTableModel *m) {
+    return profile_rows_shown;
+}
+
+static uiTableValue *profile_model_cell_value(uiTableModelHandler *mh, uiTableModel *m, int row, int column) {
+    double total = (double)profiler_total_samples();
+    const ProfileEntry *entry;
+    char text[32];
+
+    if (row < 0 || row >= profile_rows_shown || total == 0.0) {
+        return uiNewTableValueString("");
+    }
+    entry = &profile_rows[row];
+
+    switch (column) {
+    case PROFILE_COLUMN_ADDRESS:
+        snprintf(text, sizeof(text), "%04X:%04X", entry->segment, (unsigned)entry->offset);
+        break;
+    case PROFILE_COLUMN_SAMPLES:
+        snprintf(text, sizeof(text), "%llu", (unsigned long long)entry->samples);
+        break;
+    case PROFILE_COLUMN_PERCENT:
+        snprintf(text, sizeof(text), "%.2f", (double)entry->samples * 100.0 / total);
+        break;
+    default:
+        snprintf(text, sizeof(text), "%.2f",
+                 (double)profiler_segment_samples(entry->segment) * 100.0 / total);
+        break;
+    }
+    return uiNewTableValueString(text);
+}
+
+static void profile_model_set_cell_value(uiTableModelHandler *mh, uiTableModel *m, int row, int column, const uiTableValue *value) {
+    /* Read-only */
+}
+
+static void update_profile_controls(void) {
+    if (profiler_running()) {
+        uiControlDisable(uiControl(app.profile_start_button));
+        uiControlEnable(uiControl(app.profile_stop_button));
     } else {
-        uiMsgBoxError(app.main_window, "Error", "Failed to stop DOSEmu");
+        uiControlEnable(uiControl(app.profile_start_button));
+        uiControlDisable(uiControl(app.profile_stop_button));
+    }
+    if (itrace_running()) {
+        uiControlDisable(uiControl(app.itrace_start_button));
+        uiControlEnable(uiControl(app.itrace_stop_button));
+    } else {
+        uiControlEnable(uiControl(app.itrace_start_button));
+        uiControlDisable(uiControl(app.itrace_stop_button));
+    }
+}
+
+static void update_itrace_status(void) {
+    ItraceStats stats;
+    char text[256];
+
+    itrace_stats(&stats);
+    if (stats.session_id == 0) {
+        return;
+    }
+    snprintf(text, sizeof(text),
+             "Trace of session %d%s: %llu instructions at %.0f/s (%llu failed); "
+             "%.1f KB encoded, %.1f KB on disk (%.2f bytes each); writer stalled %llu times",
+             stats.session_id, itrace_running() ? "" : " (stopped)",
+             (unsigned long long)stats.instructions, stats.instructions_per_second,
+             (unsigned long long)stats.failed, stats.encoded_bytes / 1024.0,
+             stats.file_bytes / 1024.0,
+             stats.instructions ? (double)stats.file_bytes / (double)stats.instructions : 0.0,
+             (unsigned long long)stats.writer_stalls);
+    uiLabelSetText(app.itrace_stats_label, text);
+}
+
+/* Pull in new samples, then redraw the hottest addresses and the overhead */
+static int refresh_profile(void *data) {
+    ProfileStats stats;
+    char text[256];
+    int rows;
+
+    profiler_collect();
+    rows = (int)profiler_top(profile_rows, PROFILE_TOP_ENTRIES);
+
+    for (int i = 0; i < rows && i < profile_rows_shown; i++) {
+        uiTableModelRowChanged(app.profile_model, i);
+    }
+    while (profile_rows_shown < rows) {
+        uiTableModelRowInserted(app.profile_model, profile_rows_shown++);
     }
+    while (profile_rows_shown > rows) {
+        uiTableModelRowDeleted(app.profile_model, --profile_rows_shown);
+    }
+
+    profiler_stats(&stats);
+    snprintf(text, sizeof(text),
+             "%llu samples at %.1f of %d Hz (%llu skipped, %llu dropped, %llu failed); "
+             "round trip p50 %.3f ms, p99 %.3f ms; debugger busy %.2f%%; sampler %.1f us/sample",
+             (unsigned long long)stats.samples, stats.achieved_hz, stats.requested_hz,
+             (unsigned long long)stats.skipped, (unsigned long long)stats.dropped,
+             (unsigned long long)stats.failed, stats.round_trip_p50_ms, stats.round_trip_p99_ms,
+             stats.debugger_busy_percent, stats.sampler_us);
+    uiLabelSetText(app.profile_stats_label, text);
+
+    update_itrace_status();
+    update_profile_controls();
+    return 1;
+}
+
+/* Create the profile tab */
+static uiControl *create_profile_tab(void) {
+    uiBox *vbox = uiNewVerticalBox();
+    uiBoxSetPadded(vbox, 1);
+
+    /* Sampling options */
+    uiForm *options_form = uiNewForm();
+    uiFormSetPadded(options_form, 1);
+
+    app.profile_rate_entry = uiNewEntry();
+    uiEntrySetText(app.profile_rate_entry, "100");
+    uiFormAppend(options_form, "Sample Rate (Hz):", uiControl(app.profile_rate_entry), 0);
+
+    app.profile_regs_checkbox = uiNewCheckbox("Record full register file");
+    uiFormAppend(options_form, "", uiControl(app.profile_regs_checkbox), 0);
+
+    /* Profile buttons */
+    uiBox *button_box = uiNewHorizontalBox();
+    uiBoxSetPadded(button_box, 1);
+
+    app.profile_start_button = uiNewButton("Profile Selected Session");
+    uiButtonOnClicked(app.profile_start_button, on_profile_start_clicked, NULL);
+
+    app.profile_stop_button = uiNewButton("Stop Profiling");
+    uiButtonOnClicked(app.profile_stop_button, on_profile_stop_clicked, NULL);
+    uiControlDisable(uiControl(app.profile_stop_button));
+
+    uiButton *folded_button = uiNewButton("Export Folded...");
+    uiButtonOnClicked(folded_button, on_profile_export_clicked, (void *)PROFILE_EXPORT_FOLDED);
+
+    uiButton *pprof_button = uiNewButton("Export pprof...");
+    uiButtonOnClicked(pprof_button, on_profile_export_clicked, (void *)PROFILE_EXPORT_PPROF);
+
+    uiButton *samples_button = uiNewButton("Export Samples...");
+    uiButtonOnClicked(samples_button, on_profile_export_clicked, (void *)PROFILE_EXPORT_SAMPLES);
+
+    uiBoxAppend(button_box, uiControl(app.profile_start_button), 1);
+    uiBoxAppend(button_box, uiControl(app.profile_stop_button), 1);
+    uiBoxAppend(button_box, uiControl(folded_button), 0);
+    uiBoxAppend(button_box, uiControl(pprof_button), 0);
+    uiBoxAppend(button_box, uiControl(samples_button), 0);
+
+    /* Instruction trace: every instruction, single-stepped into a file */
+    uiBox *itrace_box = uiNewHorizontalBox();
+    uiBoxSetPadded(itrace_box, 1);
+
+    app.itrace_start_button = uiNewButton("Trace Instructions...");
+    uiButtonOnClicked(app.itrace_start_button, on_itrace_start_clicked, NULL);
+
+    app.itrace_stop_button = uiNewButton("Stop Trace");
+    uiButtonOnClicked(app.itrace_stop_button, on_itrace_stop_clicked, NULL);
+    uiControlDisable(uiControl(app.itrace_stop_button));
+
+    app.itrace_stats_label = uiNewLabel("Not tracing");
+
+    uiBoxAppend(itrace_box, uiControl(app.itrace_start_button), 0);
+    uiBoxAppend(itrace_box, uiControl(app.itrace_stop_button), 0);
+    uiBoxAppend(itrace_box, uiControl(app.itrace_stats_label), 1);
+
+    /* Sampling overhead */
+    app.profile_stats_label = uiNewLabel("Not profiling");
+
+    /* Hottest addresses */
+    uiTableParams table_params;
+
+    profile_model_handler.NumColumns = profile_model_num_columns;
+    profile_model_handler.ColumnType = profile_model_column_type;
+    profile_model_handler.NumRows = profile_model_num_rows;
+    profile_model_handler.CellValue = profile_model_cell_value;
+    profile_model_handler.SetCellValue = profile_model_set_cell_value;
+    app.profile_model = uiNewTableModel(&profile_model_handler);
+
+    table_params.Model = app.profile_model;
+    table_params.RowBackgroundColorModelColumn = -1;
+    uiTable *table = uiNewTable(&table_params);
+    uiTableAppendTextColumn(table, "Address", PROFILE_COLUMN_ADDRESS,
+                            uiTableModelColumnNeverEditable, NULL);
+    uiTableAppendTextColumn(table, "Samples", PROFILE_COLUMN_SAMPLES,
+                            uiTableModelColumnNeverEditable, NULL);
+    uiTableAppendTextColumn(table, "%", PROFILE_COLUMN_PERCENT,
+                            uiTableModelColumnNeverEditable, NULL);
+    uiTableAppendTextColumn(table, "Segment %", PROFILE_COLUMN_SEGMENT,
+                            uiTableModelColumnNeverEditable, NULL);
+
+    uiBoxAppend(vbox, uiControl(options_form), 0);
+    uiBoxAppend(vbox, uiControl(button_box), 0);
+    uiBoxAppend(vbox, uiControl(itrace_box), 0);
+    uiBoxAppend(vbox, uiControl(app.profile_stats_label), 0);
+    uiBoxAppend(vbox, uiControl(table), 1);
+
+    uiTimer(PROFILE_REFRESH_MS, refresh_profile, NULL);
+
+    return uiControl(vbox);
+}
+
+/* Memory view layout: one row of 16 bytes per line */
+#define MEMORY_ROW_BYTES 16
+#define MEMORY_ROW_HEIGHT 16
+#define MEMORY_VIEW_WIDTH 640
+#define MEMORY_REFRESH_MS 500
+
+/* Columns of a row: "AAAAAAAA  " then "XX " per byte, then the ASCII column */
+#define MEMORY_HEX_COLUMN 10
+#define MEMORY_ASCII_COLUMN (MEMORY_HEX_COLUMN + MEMORY_ROW_BYTES * 3 + 1)
+
+static uiAreaHandler memory_area_handler;
+static int memory_session = 0;
+static uint32_t memory_range = 0;           /* bytes of guest memory browsed */
+static uint32_t memory_visible_first = 0;
+static uint32_t memory_visible_last = 0;
+
+/* Redraw when a page that is on screen arrives */
+static void on_memory_page_loaded(uint32_t address, void *data) {
+    if (address <= memory_visible_last && address + MEMVIEW_PAGE_SIZE > memory_visible_first) {
+        uiAreaQueueRedrawAll(app.memory_area);
+    }
+}
+
+static void draw_memory_row(uiAreaDrawParams *params, uiFontDescriptor *font, uint32_t address) {
+    const MemoryPage *page = memview_page(address);
+    size_t base = address % MEMVIEW_PAGE_SIZE;
+    char line[MEMORY_ASCII_COLUMN + MEMORY_ROW_BYTES + 1];
+    size_t used;
+
+    used = (size_t)snprintf(line, sizeof(line), "%08X  ", (unsigned)address);
+    for (int i = 0; i < MEMORY_ROW_BYTES; i++) {
+        if (page && base + (size_t)i < page->length) {
+            used += (size_t)snprintf(line + used, sizeof(line) - used, "%02X ",
+                                     page->bytes[base + (size_t)i]);
+        } else {
+            used += (size_t)snprintf(line + used, sizeof(line) - used, "?? ");
+        }
+    }
+    line[used++] = ' ';
+    for (int i = 0; i < MEMORY_ROW_BYTES; i++) {
+        uint8_t byte = page && base + (size_t)i < page->length ? page->bytes[base + (size_t)i] : '?';
+        line[used++] = byte >= 0x20 && byte < 0x7f ? (char)byte : '.';
+    }
+    line[used] = '\0';
+
+    uiAttributedString *text = uiNewAttributedString(line);
+
+    /* Highlight bytes that changed since the previous refresh */
+    for (int i = 0; page && i < MEMORY_ROW_BYTES; i++) {
+        if (base + (size_t)i < page->length && memview_byte_changed(page, base + (size_t)i)) {
+            size_t hex = MEMORY_HEX_COLUMN + (size_t)i * 3;
+            size_t ascii = MEMORY_ASCII_COLUMN + (size_t)i;
+            uiAttributedStringSetAttribute(text, uiNewBackgroundAttribute(1.0, 0.85, 0.3, 1.0),
+                                           hex, hex + 2);
+            uiAttributedStringSetAttribute(text, uiNewBackgroundAttribute(1.0, 0.85, 0.3, 1.0),
+                                           ascii, ascii + 1);
+        }
+    }
+
+    uiDrawTextLayoutParams layout_params;
+    layout_params.String = text;
+    layout_params.DefaultFont = font;
+    layout_params.Width = -1;
+    layout_params.Align = uiDrawTextAlignLeft;
+
+    uiDrawTextLayout *layout = uiDrawNewTextLayout(&layout_params);
+    uiDrawText(params->Context, layout, 0,
+               (double)(address / MEMORY_ROW_BYTES) * MEMORY_ROW_HEIGHT);
+    uiDrawFreeTextLayout(layout);
+    uiFreeAttributedString(text);
+}
+
+/* Only the rows inside the clip rectangle are drawn, and only their pages fetched */
+static void memory_area_draw(uiAreaHandler *handler, uiArea *area, uiAreaDrawParams *params) {
+    uiFontDescriptor font = {"Monospace", 10, uiTextWeightNormal, uiTextItalicNormal,
+                             uiTextStretchNormal};
+    uint64_t first_row, last_row;
+
+    if (memory_session == 0 || memory_range == 0) {
+        return;
+    }
+
+    first_row = params->ClipY > 0 ? (uint64_t)(params->ClipY / MEMORY_ROW_HEIGHT) : 0;
+    last_row = (uint64_t)((params->ClipY + params->ClipHeight) / MEMORY_ROW_HEIGHT) + 1;
+    if (last_row > memory_range / MEMORY_ROW_BYTES) {
+        last_row = memory_range / MEMORY_ROW_BYTES;
+    }
+    if (first_row >= last_row) {
+        return;
+    }
+
+    memory_visible_first = (uint32_t)(first_row * MEMORY_ROW_BYTES);
+    memory_visible_last = (uint32_t)(last_row * MEMORY_ROW_BYTES - 1);
+
+    for (uint64_t row = first_row; row < last_row; row++) {
+        draw_memory_row(params, &font, (uint32_t)(row * MEMORY_ROW_BYTES));
+    }
+}
+
+static void memory_area_mouse_event(uiAreaHandler *handler, uiArea *area, uiAreaMouseEvent *event) {
+}
+
+static void memory_area_mouse_crossed(uiAreaHandler *handler, uiArea *area, int left) {
+}
+
+static void memory_area_drag_broken(uiAreaHandler *handler, uiArea *area) {
+}
+
+static int memory_area_key_event(uiAreaHandler *handler, uiArea *area, uiAreaKeyEvent *event) {
+    return 0;
+}
+
+/* Re-read what is on screen so changes show up while the guest runs */
+static int refresh_memory_view(void *data) {
+    if (memory_session != 0 && memory_range != 0) {
+        if (!dosemu_session_find(memory_session)) {
+            memory_session = 0;
+            uiLabelSetText(app.memory_status_label, "Session ended");
+        } else {
+            memview_refresh(memory_visible_first, memory_visible_last);
+        }
+    }
+    return 1;
+}
+
+/* Create the memory tab */
+static uiControl *create_memory_tab(void) {
+    uiBox *vbox = uiNewVerticalBox();
+    uiBoxSetPadded(vbox, 1);
+
+    uiBox *control_box = uiNewHorizontalBox();
+    uiBoxSetPadded(control_box, 1);
+
+    uiButton *browse_button = uiNewButton("Browse Selected Session");
+    uiButtonOnClicked(browse_button, on_memory_browse_clicked, NULL);
+
+    app.memory_goto_entry = uiNewEntry();
+
+    uiButton *goto_button = uiNewButton("Go");
+    uiButtonOnClicked(goto_button, on_memory_goto_clicked, NULL);
+
+    uiBoxAppend(control_box, uiControl(browse_button), 0);
+    uiBoxAppend(control_box, uiControl(create_labeled_control("Address (hex):",
+                                                              uiControl(app.memory_goto_entry))), 1);
+    uiBoxAppend(control_box, uiControl(goto_button), 0);
+
+    app.memory_status_label = uiNewLabel("No session");
+
+    memory_area_handler.Draw = memory_area_draw;
+    memory_area_handler.MouseEvent = memory_area_mouse_event;
+    memory_area_handler.MouseCrossed = memory_area_mouse_crossed;
+    memory_area_handler.DragBroken = memory_area_drag_broken;
+    memory_area_handler.KeyEvent = memory_area_key_event;
+    app.memory_area = uiNewScrollingArea(&memory_area_handler, MEMORY_VIEW_WIDTH, MEMORY_ROW_HEIGHT);
+
+    uiBoxAppend(vbox, uiControl(control_box), 0);
+    uiBoxAppend(vbox, uiControl(app.memory_status_label), 0);
+    uiBoxAppend(vbox, uiControl(app.memory_area), 1);
+
+    uiTimer(MEMORY_REFRESH_MS, refresh_memory_view, NULL);
+
+    return uiControl(vbox);
+}
+
+/* Resources view layout: a caption and three sparklines per instance */
+#define RESOURCES_ROW_HEIGHT 64
+#define RESOURCES_CAPTION_HEIGHT 18
+#define RESOURCES_SPARK_WIDTH 200
+#define RESOURCES_SPARK_HEIGHT 36
+#define RESOURCES_SPARK_GAP 16
+#define RESOURCES_VIEW_WIDTH (RESOURCES_SPARK_WIDTH * RESOURCE_SERIES_COUNT + \
+                              RESOURCES_SPARK_GAP * (RESOURCE_SERIES_COUNT - 1))
+
+static uiAreaHandler resources_area_handler;
+static int resources_rows = 0;
+
+/* Largest value held in a series, so each sparkline fills its box */
+static double series_peak(const ResourceHistory *history, ResourceSeries series) {
+    double peak = 0.0;
+
+    for (int i = 0; i < resmon_filled(history); i++) {
+        if (resmon_value(history, series, i) > peak) {
+            peak = resmon_value(history, series, i);
+        }
+    }
+    return peak;
+}
+
+static void draw_sparkline(uiAreaDrawParams *params, const ResourceHistory *history,
+                           ResourceSeries series, double x, double y, double scale) {
+    uiDrawBrush background, line;
+    uiDrawStrokeParams stroke;
+    double step = (double)RESOURCES_SPARK_WIDTH / (RESMON_HISTORY - 1);
+    int filled = resmon_filled(history);
+    uiDrawPath *path;
+
+    memset(&background, 0, sizeof(background));
+    background.Type = uiDrawBrushTypeSolid;
+    background.R = background.G = background.B = 0.93;
+    background.A = 1.0;
+    line = background;
+    line.R = 0.1;
+    line.G = 0.4;
+    line.B = 0.8;
+
+    memset(&stroke, 0, sizeof(stroke));
+    stroke.Cap = uiDrawLineCapFlat;
+    stroke.Join = uiDrawLineJoinMiter;
+    stroke.Thickness = 1.0;
+    stroke.MiterLimit = uiDrawDefaultMiterLimit;
+
+    path = uiDrawNewPath(uiDrawFillModeWinding);
+    uiDrawPathAddRectangle(path, x, y, RESOURCES_SPARK_WIDTH, RESOURCES_SPARK_HEIGHT);
+    uiDrawPathEnd(path);
+    uiDrawFill(params->Context, path, &background);
+    uiDrawFreePath(path);
+
+    if (filled < 2) {
+        return;
+    }
+
+    /* Newest sample at the right edge */
+    path = uiDrawNewPath(uiDrawFillModeWinding);
+    for (int i = 0; i < filled; i++) {
+        double px = x + (double)(RESMON_HISTORY - filled + i) * step;
+        double py = y + RESOURCES_SPARK_HEIGHT -
+                    resmon_value(history, series, i) / scale * (RESOURCES_SPARK_HEIGHT - 2) - 1;
+        if (i == 0) {
+            uiDrawPathNewFigure(path, px, py);
+        } else {
+            uiDrawPathLineTo(path, px, py);
+        }
+    }
+    uiDrawPathEnd(path);
+    uiDrawStroke(params->Context, path, &line, &stroke);
+    uiDrawFreePath(path);
+}
+
+static void draw_resources_row(uiAreaDrawParams *params, uiFontDescriptor *font, int row) {
+    const ResourceHistory *history = resmon_at(row);
+    double y = (double)row * RESOURCES_ROW_HEIGHT;
+    double scales[RESOURCE_SERIES_COUNT];
+    float current[RESOURCE_SERIES_COUNT] = {0};
+    char caption[160];
+
+    if (!history) {
+        return;
+    }
+    for (int series = 0; series < RESOURCE_SERIES_COUNT; series++) {
+        if (resmon_filled(history) > 0) {
+            current[series] = resmon_value(history, series, resmon_filled(history) - 1);
+        }
+        scales[series] = series_peak(history, series) * 1.1;
+    }
+    /* CPU is drawn against a full core unless it uses more */
+    if (scales[RESOURCE_CPU] < 100.0) {
+        scales[RESOURCE_CPU] = 100.0;
+    }
+    for (int series = 0; series < RESOURCE_SERIES_COUNT; series++) {
+        if (scales[series] <= 0.0) {
+            scales[series] = 1.0;
+        }
+    }
+
+    snprintf(caption, sizeof(caption),
+             "[%d] pid %d   CPU %.1f%%   RSS %.1f MB   I/O %.1f KB/s   (every %d ms)",
+             history->session_id, (int)history->pid, current[RESOURCE_CPU],
+             current[RESOURCE_RSS], current[RESOURCE_IO], history->interval_ms);
+
+    uiAttributedString *text = uiNewAttributedString(caption);
+    uiDrawTextLayoutParams layout_params;
+    layout_params.String = text;
+    layout_params.DefaultFont = font;
+    layout_params.Width = -1;
+    layout_params.Align = uiDrawTextAlignLeft;
+
+    uiDrawTextLayout *layout = uiDrawNewTextLayout(&layout_params);
+    uiDrawText(params->Context, layout, 0, y);
+    uiDrawFreeTextLayout(layout);
+    uiFreeAttributedString(text);
+
+    for (int series = 0; series < RESOURCE_SERIES_COUNT; series++) {
+        draw_sparkline(params, history, series,
+                       (double)series * (RESOURCES_SPARK_WIDTH + RESOURCES_SPARK_GAP),
+                       y + RESOURCES_CAPTION_HEIGHT, scales[series]);
+    }
+}
+
+/* Only the rows inside the clip rectangle are drawn */
+static void resources_area_draw(uiAreaHandler *handler, uiArea *area, uiAreaDrawParams *params) {
+    uiFontDescriptor font = {"Monospace", 10, uiTextWeightNormal, uiTextItalicNormal,
+                             uiTextStretchNormal};
+    int first_row = params->ClipY > 0 ? (int)(params->ClipY / RESOURCES_ROW_HEIGHT) : 0;
+    int last_row = (int)((params->ClipY + params->ClipHeight) / RESOURCES_ROW_HEIGHT) + 1;
+
+    if (last_row > resmon_count()) {
+        last_row = resmon_count();
+    }
+    for (int row = first_row; row < last_row; row++) {
+        draw_resources_row(params, &font, row);
+    }
+}
+
+static void resources_area_mouse_event(uiAreaHandler *handler, uiArea *area,
+                                       uiAreaMouseEvent *event) {
+}
+
+static void resources_area_mouse_crossed(uiAreaHandler *handler, uiArea *area, int left) {
+}
+
+static void resources_area_drag_broken(uiAreaHandler *handler, uiArea *area) {
+}
+
+static int resources_area_key_event(uiAreaHandler *handler, uiArea *area, uiAreaKeyEvent *event) {
+    return 0;
+}
+
+/* Sample whatever is due; redraw only when something was */
+static int refresh_resources(void *data) {
+    char status[128];
+
+    if (!resmon_sample()) {
+        return 1;
+    }
+
+    if (resources_rows != resmon_count()) {
+        resources_rows = resmon_count();
+        uiAreaSetSize(app.resources_area, RESOURCES_VIEW_WIDTH,
+                      resources_rows > 0 ? resources_rows * RESOURCES_ROW_HEIGHT : 1);
+    }
+    uiAreaQueueRedrawAll(app.resources_area);
+
+    snprintf(status, sizeof(status),
+             "%d instance(s); CPU, RSS and I/O over the last %d samples; sampler %.3f%% of a core",
+             resources_rows, RESMON_HISTORY, resmon_overhead_percent());
+    uiLabelSetText(app.resources_status_label, status);
+    return 1;
+}
+
+/* Create the resources tab */
+static uiControl *create_resources_tab(void) {
+    uiBox *vbox = uiNewVerticalBox();
+    uiBoxSetPadded(vbox, 1);
+
+    app.resources_status_label = uiNewLabel("No instances");
+
+    resources_area_handler.Draw = resources_area_draw;
+    resources_area_handler.MouseEvent = resources_area_mouse_event;
+    resources_area_handler.MouseCrossed = resources_area_mouse_crossed;
+    resources_area_handler.DragBroken = resources_area_drag_broken;
+    resources_area_handler.KeyEvent = resources_area_key_event;
+    app.resources_area = uiNewScrollingArea(&resources_area_handler, RESOURCES_VIEW_WIDTH, 1);
+
+    uiBoxAppend(vbox, uiControl(app.resources_status_label), 0);
+    uiBoxAppend(vbox, uiControl(app.resources_area), 1);
+
+    uiTimer(RESMON_FAST_MS, refresh_resources, NULL);
+
+    return uiControl(vbox);
+}
+
+/* Screen view layout: one tile per mirrored session, in a grid */
+#define SCREEN_REFRESH_MS 16
+#define SCREEN_CAPTION_HEIGHT 18
+#define SCREEN_TILE_GAP 12
+#define SCREEN_STATUS_MS 500
+
+/* The 16 text mode colours */
+static const double screen_palette[16][3] = {
+    {0.0, 0.0, 0.0},       {0.0, 0.0, 0.667},     {0.0, 0.667, 0.0},     {0.0, 0.667, 0.667},
+    {0.667, 0.0, 0.0},     {0.667, 0.0, 0.667},   {0.667, 0.333, 0.0},   {0.667, 0.667, 0.667},
+    {0.333, 0.333, 0.333}, {0.333, 0.333, 1.0},   {0.333, 1.0, 0.333},   {0.333, 1.0, 1.0},
+    {1.0, 0.333, 0.333},   {1.0, 0.333, 1.0},     {1.0, 1.0, 0.333},     {1.0, 1.0, 1.0}
+};
+
+/* Laid out rows of one tile; a row is laid out again only when it changed */
+typedef struct ScreenTile {
+    int session_id;
+    int columns;
+    uiAttributedString *strings[SCREEN_MAX_ROWS];
+    uiDrawTextLayout *layouts[SCREEN_MAX_ROWS];
+} ScreenTile;
+
+static uiAreaHandler screen_area_handler;
+static uiFontDescriptor screen_font = {"Monospace", 10, uiTextWeightNormal, uiTextItalicNormal,
+                                       uiTextStretchNormal};
+static ScreenTile screen_tiles[SCREEN_MAX_MIRRORS];
+static int screen_tile_count = 0;
+static int screen_tab_index = -1;
+static int screen_grid_columns = 1;
+static double screen_cell_width = 0.0;
+static double screen_cell_height = 0.0;
+static double screen_tile_width = 0.0;
+static double screen_tile_height = 0.0;
+static uint64_t screen_rows_laid_out = 0;
+static uint64_t screen_status_ns = 0;
+
+static void free_screen_row(ScreenTile *tile, int row) {
+    if (tile->layouts[row]) {
+        uiDrawFreeTextLayout(tile->layouts[row]);
+        uiFreeAttributedString(tile->strings[row]);
+        tile->layouts[row] = NULL;
+        tile->strings[row] = NULL;
+    }
+}
+
+static void clear_screen_tile(ScreenTile *tile) {
+    for (int row = 0; row < SCREEN_MAX_ROWS; row++) {
+        free_screen_row(tile, row);
+    }
+    tile->session_id = -1;
+    tile->columns = 0;
+}
+
+/* The row as UTF-8 with one colour attribute per run of equal foregrounds */
+static void lay_out_screen_row(ScreenTile *tile, const ScreenMirror *screen, int row) {
+    const uint16_t *cells = screen->cells + row * screen->columns;
+    char text[SCREEN_MAX_COLUMNS * 3 + 1];
+    size_t starts[SCREEN_MAX_COLUMNS + 1];
+    size_t used = 0;
+    uiDrawTextLayoutParams params;
+
+    for (int column = 0; column < screen->columns; column++) {
+        starts[column] = used;
+        used += screen_char_utf8((uint8_t)(cells[column] & 0xFF), text + used);
+    }
+    starts[screen->columns] = used;
+    text[used] = '\0';
+
+    tile->strings[row] = uiNewAttributedString(text);
+    for (int start = 0; start < screen->columns;) {
+        int foreground = (cells[start] >> 8) & 0x0F;
+        int end = start + 1;
+
+        while (end < screen->columns && ((cells[end] >> 8) & 0x0F) == foreground) {
+            end++;
+        }
+        uiAttributedStringSetAttribute(tile->strings[row],
+                                       uiNewColorAttribute(screen_palette[foreground][0],
+                                                           screen_palette[foreground][1],
+                                                           screen_palette[foreground][2], 1.0),
+                                       starts[start], starts[end]);
+        start = end;
+    }
+
+    params.String = tile->strings[row];
+    params.DefaultFont = &screen_font;
+    params.Width = -1;
+    params.Align = uiDrawTextAlignLeft;
+    tile->layouts[row] = uiDrawNewTextLayout(&params);
+    screen_rows_laid_out++;
+}
+
+/* Cell size of the monospace font, from a run of wide characters */
+static void measure_screen_cell(void) {
+    uiAttributedString *text = uiNewAttributedString("MMMMMMMMMMMMMMMM");
+    uiDrawTextLayoutParams params;
+    uiDrawTextLayout *layout;
+    double width, height;
+
+    params.String = text;
+    params.DefaultFont = &screen_font;
+    params.Width = -1;
+    params.Align = uiDrawTextAlignLeft;
+    layout = uiDrawNewTextLayout(&params);
+    uiDrawTextLayoutExtents(layout, &width, &height);
+    uiDrawFreeTextLayout(layout);
+    uiFreeAttributedString(text);
+
+    screen_cell_width = width / 16.0;
+    screen_cell_height = height;
+}
+
+static void fill_screen_rect(uiAreaDrawParams *params, double x, double y, double width,
+                             double height, const double *colour) {
+    uiDrawBrush brush;
+    uiDrawPath *path;
+
+    memset(&brush, 0, sizeof(brush));
+    brush.Type = uiDrawBrushTypeSolid;
+    brush.R = colour[0];
+    brush.G = colour[1];
+    brush.B = colour[2];
+    brush.A = 1.0;
+
+    path = uiDrawNewPath(uiDrawFillModeWinding);
+    uiDrawPathAddRectangle(path, x, y, width, height);
+    uiDrawPathEnd(path);
+    uiDrawFill(params->Context, path, &brush);
+    uiDrawFreePath(path);
+}
+
+static void draw_screen_tile(uiAreaDrawParams *params, int index, double x, double y) {
+    const ScreenMirror *screen = screen_at(index);
+    const ScreenTile *tile = &screen_tiles[index];
+    char caption[128];
+    uiAttributedString *text;
+    uiDrawTextLayoutParams layout_params;
+    uiDrawTextLayout *layout;
+
+    if (!screen) {
+        return;
+    }
+
+    if (!screen->valid) {
+        snprintf(caption, sizeof(caption), "[%d] waiting for the first frame", screen->session_id);
+    } else if (!screen->text_mode) {
+        snprintf(caption, sizeof(caption), "[%d] graphics mode %02Xh, not mirrored",
+                 screen->session_id, screen->video_mode);
+    } else {
+        snprintf(caption, sizeof(caption), "[%d] mode %02Xh, %dx%d", screen->session_id,
+                 screen->video_mode, screen->columns, screen->rows);
+    }
+    text = uiNewAttributedString(caption);
+    layout_params.String = text;
+    layout_params.DefaultFont = &screen_font;
+    layout_params.Width = -1;
+    layout_params.Align = uiDrawTextAlignLeft;
+    layout = uiDrawNewTextLayout(&layout_params);
+    uiDrawText(params->Context, layout, x, y);
+    uiDrawFreeTextLayout(layout);
+    uiFreeAttributedString(text);
+
+    y += SCREEN_CAPTION_HEIGHT;
+    fill_screen_rect(params, x, y, screen->columns * screen_cell_width,
+                     screen->rows * screen_cell_height, screen_palette[0]);
+    if (!screen->valid || !screen->text_mode) {
+        return;
+    }
+
+    for (int row = 0; row < screen->rows; row++) {
+        const uint16_t *cells = screen->cells + row * screen->columns;
+        double row_y = y + row * screen_cell_height;
+
+        /* Background runs first; black is already there */
+        for (int start = 0; start < screen->columns;) {
+            int background = (cells[start] >> 12) & 0x07;
+            int end = start + 1;
+
+            while (end < screen->columns && ((cells[end] >> 12) & 0x07) == background) {
+                end++;
+            }
+            if (background != 0) {
+                fill_screen_rect(params, x + start * screen_cell_width, row_y,
+                                 (end - start) * screen_cell_width, screen_cell_height,
+                                 screen_palette[background]);
+            }
+            start = end;
+        }
+        if (tile->layouts[row]) {
+            uiDrawText(params->Context, tile->layouts[row], x, row_y);
+        }
+    }
+}
+
+/* Only the tiles inside the clip rectangle are drawn */
+static void screen_area_draw(uiAreaHandler *handler, uiArea *area, uiAreaDrawParams *params) {
+    for (int i = 0; i < screen_tile_count; i++) {
+        double x = (i % screen_grid_columns) * (screen_tile_width + SCREEN_TILE_GAP);
+        double y = (i / screen_grid_columns) * (screen_tile_height + SCREEN_TILE_GAP);
+
+        if (x > params->ClipX + params->ClipWidth || x + screen_tile_width < params->ClipX ||
+            y > params->ClipY + params->ClipHeight || y + screen_tile_height < params->ClipY) {
+            continue;
+        }
+        draw_screen_tile(params, i, x, y);
+    }
+}
+
+static void screen_area_mouse_event(uiAreaHandler *handler, uiArea *area,
+                                    uiAreaMouseEvent *event) {
+}
+
+static void screen_area_mouse_crossed(uiAreaHandler *handler, uiArea *area, int left) {
+}
+
+static void screen_area_drag_broken(uiAreaHandler *handler, uiArea *area) {
+}
+
+static int screen_area_key_event(uiAreaHandler *handler, uiArea *area, uiAreaKeyEvent *event) {
+    return 0;
+}
+
+/* Tiles as large as the largest screen, in a roughly square grid */
+static void update_screen_grid(void) {
+    int columns = 80, rows = 25;
+    int count = screen_count();
+
+    for (int i = 0; i < count; i++) {
+        const ScreenMirror *screen = screen_at(i);
+        if (screen->columns > columns) {
+            columns = screen->columns;
+        }
+        if (screen->rows > rows) {
+            rows = screen->rows;
+        }
+    }
+    screen_grid_columns = (int)ceil(sqrt((double)count));
+    if (screen_grid_columns < 1) {
+        screen_grid_columns = 1;
+    }
+    screen_tile_width = columns * screen_cell_width;
+    screen_tile_height = SCREEN_CAPTION_HEIGHT + rows * screen_cell_height;
+
+    int grid_rows = (count + screen_grid_columns - 1) / screen_grid_columns;
+    uiAreaSetSize(app.screen_area,
+                  (int)ceil(screen_grid_columns * (screen_tile_width + SCREEN_TILE_GAP)),
+                  grid_rows > 0 ? (int)ceil(grid_rows * (screen_tile_height + SCREEN_TILE_GAP))
+                                : 1);
+}
+
+static void update_screen_status(void) {
+    char status[192];
+    uint64_t frames = 0, changed = 0;
+
+    for (int i = 0; i < screen_count(); i++) {
+        frames += screen_at(i)->frames;
+        changed += screen_at(i)->changed_frames;
+    }
+    snprintf(status, sizeof(status),
+             "%d screen(s); %llu frames read, %llu changed, %llu rows laid out",
+             screen_count(), (unsigned long long)frames, (unsigned long long)changed,
+             (unsigned long long)screen_rows_laid_out);
+    uiLabelSetText(app.screen_status_label, status);
+}
+
+/* Fetch frames while the tab is shown; lay out changed rows and redraw only then */
+static int refresh_screen(void *data) {
+    bool redraw;
+    bool resize;
+    uint64_t now;
+
+    if (uiTabSelected(app.main_tab) != screen_tab_index) {
+        return 1;
+    }
+    if (screen_cell_width <= 0.0) {
+        measure_screen_cell();
+    }
+    resize = screen_poll(uiSpinboxValue(app.screen_fps_spinbox));
+    redraw = resize;
+
+    for (int i = 0; i < screen_count(); i++) {
+        const ScreenMirror *screen = screen_at(i);
+        ScreenTile *tile = &screen_tiles[i];
+        uint64_t dirty = screen_take_dirty(i);
+
+        if (i >= screen_tile_count || tile->session_id != screen->session_id ||
+            tile->columns != screen->columns) {
+            clear_screen_tile(tile);
+            tile->session_id = screen->session_id;
+            tile->columns = screen->columns;
+            dirty = ~0ULL;
+            resize = true;
+        }
+        for (int row = 0; row < SCREEN_MAX_ROWS && dirty; row++) {
+            if (!(dirty & (1ULL << row))) {
+                continue;
+            }
+            dirty &= ~(1ULL << row);
+            free_screen_row(tile, row);
+            if (screen->valid && screen->text_mode && row < screen->rows) {
+                lay_out_screen_row(tile, screen, row);
+            }
+            redraw = true;
+        }
+    }
+    for (int i = screen_count(); i < screen_tile_count; i++) {
+        clear_screen_tile(&screen_tiles[i]);
+    }
+    screen_tile_count = screen_count();
+
+    if (resize) {
+        update_screen_grid();
+    }
+    if (redraw) {
+        uiAreaQueueRedrawAll(app.screen_area);
+    }
+
+    now = trace_now();
+    if (now - screen_status_ns >= (uint64_t)SCREEN_STATUS_MS * 1000000ULL) {
+        screen_status_ns = now;
+        update_screen_status();
+    }
+    return 1;
+}
+
+/* Create the screen tab */
+static uiControl *create_screen_tab(void) {
+    uiBox *vbox = uiNewVerticalBox();
+    uiBoxSetPadded(vbox, 1);
+
+    uiBox *header = uiNewHorizontalBox();
+    uiBoxSetPadded(header, 1);
+
+    app.screen_fps_spinbox = uiNewSpinbox(1, 60);
+    uiSpinboxSetValue(app.screen_fps_spinbox, SCREEN_DEFAULT_FPS);
+    uiBoxAppend(header, uiControl(create_labeled_control("Frames per second:",
+                                                         uiControl(app.screen_fps_spinbox))), 0);
+
+    app.screen_status_label = uiNewLabel("No screens");
+    uiBoxAppend(header, uiControl(app.screen_status_label), 1);
+
+    for (int i = 0; i < SCREEN_MAX_MIRRORS; i++) {
+        screen_tiles[i].session_id = -1;
+    }
+    screen_area_handler.Draw = screen_area_draw;
+    screen_area_handler.MouseEvent = screen_area_mouse_event;
+    screen_area_handler.MouseCrossed = screen_area_mouse_crossed;
+    screen_area_handler.DragBroken = screen_area_drag_broken;
+    screen_area_handler.KeyEvent = screen_area_key_event;
+    app.screen_area = uiNewScrollingArea(&screen_area_handler, 1, 1);
+
+    uiBoxAppend(vbox, uiControl(header), 0);
+    uiBoxAppend(vbox, uiControl(app.screen_area), 1);
+
+    uiTimer(SCREEN_REFRESH_MS, refresh_screen, NULL);
+
+    return uiControl(vbox);
+}
+
+/* Create the main UI */
+void create_ui(void) {
+    /* Create main window */
+    app.main_window = uiNewWindow("DOSEmu2 GUI", 600, 400, 1);
+
+    /* Create main vertical box */
+    app.main_vbox = uiNewVerticalBox();
+    uiBoxSetPadded(app.main_vbox, 1);
+
+    /* Create tab container */
+    app.main_tab = uiNewTab();
+
+    /* Add tabs */
+    uiTabAppend(app.main_tab, "Control", create_control_tab());
+    uiTabAppend(app.main_tab, "Configuration", create_config_tab());
+    uiTabAppend(app.main_tab, "Debugger", create_debugger_tab());
+    uiTabAppend(app.main_tab, "Profile", create_profile_tab());
+    uiTabAppend(app.main_tab, "Memory", create_memory_tab());
+    uiTabAppend(app.main_tab, "Resources", create_resources_tab());
+    screen_tab_index = uiTabNumPages(app.main_tab);
+    uiTabAppend(app.main_tab, "Screen", create_screen_tab());
+
+    /* Add tab container to main box */
+    uiBoxAppend(app.main_vbox, uiControl(app.main_tab), 1);
+
+    /* Set main box as window content */
+    uiWindowSetChild(app.main_window, uiControl(app.main_vbox));
+    uiWindowSetMargined(app.main_window, 1);
+}
+
+/* Called once DOSEmu is controllable, or failed to come up */
+static void on_dosemu_started(DosemuSession *session, bool success, void *data) {
+    if (!success) {
+        uiMsgBoxError(app.main_window, "Error", "Failed to start DOSEmu");
+    }
+}
+
+/* Called once DOSEmu has exited */
+static void on_dosemu_stopped(DosemuSession *session, bool success, void *data) {
+    if (!success) {
+        uiMsgBoxError(app.main_window, "Error", "DOSEmu did not exit cleanly");
+    }
+}
+
+/* Hand the placement fields to the launcher; false if the CPU list is invalid */
+static bool apply_placement_settings(void) {
+    PlacementConfig config;
+    char *cpus = uiEntryText(app.cpu_affinity_entry);
+    char *nice_text = uiEntryText(app.nice_entry);
+    char *cgroup = uiEntryText(app.cgroup_entry);
+    char *cpu_max_text = uiEntryText(app.cpu_max_entry);
+    char *memory_max_text = uiEntryText(app.memory_max_entry);
+    int sched_class = uiComboboxSelected(app.sched_class_combobox);
+    bool ok;
+
+    config.cpus = cpus;
+    config.auto_spread = uiCheckboxChecked(app.auto_spread_checkbox);
+    config.sched_class = sched_class > 0 ? (SchedClass)sched_class : SCHED_CLASS_NORMAL;
+    config.nice = atoi(nice_text);
+    config.cgroup_parent = cgroup;
+    config.cpu_max_percent = atoi(cpu_max_text);
+    config.memory_max_mb = (size_t)strtoul(memory_max_text, NULL, 10);
+    ok = placement_configure(&config);
+    if (!ok) {
+        uiMsgBoxError(app.main_window, "Error", "Invalid CPU affinity list");
+    }
+
+    uiFreeText(cpus);
+    uiFreeText(nice_text);
+    uiFreeText(cgroup);
+    uiFreeText(cpu_max_text);
+    uiFreeText(memory_max_text);
+    return ok;
+}
+
+/* Memory and video settings, merged into the config of every following launch */
+static void apply_dosemurc_settings(void) {
+    DosemurcSettings settings;
+    char *memory_text = uiEntryText(app.memory_size_entry);
+    char *xms_text = uiEntryText(app.xms_size_entry);
+    char *ems_text = uiEntryText(app.ems_size_entry);
+
+    app.memory_size = atoi(memory_text);
+    app.xms_size = atoi(xms_text);
+    app.ems_size = atoi(ems_text);
+    app.use_console = uiCheckboxChecked(app.console_checkbox);
+    app.use_vga = uiCheckboxChecked(app.vga_checkbox);
+
+    settings.memory_kb = app.memory_size;
+    settings.xms_kb = app.xms_size;
+    settings.ems_kb = app.ems_size;
+    settings.console = app.use_console;
+    settings.vga = app.use_vga;
+    dosemurc_configure(&settings);
+
+    uiFreeText(memory_text);
+    uiFreeText(xms_text);
+    uiFreeText(ems_text);
+}
+
+/* Empty means sessions use the drive their config names, unstaged */
+static void apply_drive_setting(void) {
+    if (app.drive_dir) {
+        uiFreeText(app.drive_dir);
+    }
+    app.drive_dir = uiEntryText(app.drive_dir_entry);
+}
+
+/* Keep a binary log of every record beside the captured output, if any */
+static void update_binary_log(const char *dir) {
+    static char current[4096];
+    char path[sizeof(current)];
+
+    path[0] = '\0';
+    if (dir && *dir) {
+        snprintf(path, sizeof(path), "%s/dosemu2-gui.binlog", dir);
+    }
+    if (strcmp(path, current) != 0 && logger_open_file(path)) {
+        snprintf(current, sizeof(current), "%s", path);
+    }
+}
+
+/* UI callback implementations */
+void on_start_button_clicked(uiButton *button, void *data) {
+    const char *dos_path = uiEntryText(app.dos_path_entry);
+    const char *config_path = uiEntryText(app.config_path_entry);
+    char *timeout_text = uiEntryText(app.attach_timeout_entry);
+
+    app.attach_timeout_ms = atoi(timeout_text);
+    uiFreeText(timeout_text);
+    apply_dosemurc_settings();
+    apply_drive_setting();
+
+    if (!apply_placement_settings()) {
+        return;
+    }
+
+    /* Empty means DOSEmu output only goes to the console */
+    if (app.capture_log_dir) {
+        uiFreeText(app.capture_log_dir);
+    }
+    app.capture_log_dir = uiEntryText(app.capture_log_entry);
+    update_binary_log(app.capture_log_dir);
+
+    /* Each click starts another session; the list tracks their progress */
+    if (!pool_start(dos_path, config_path, on_dosemu_started, NULL)) {
+        uiMsgBoxError(app.main_window, "Error", "Failed to start DOSEmu");
+    }
+}
+
+void on_pool_apply_clicked(uiButton *button, void *data) {
+    PoolConfig config;
+    char *size_text = uiEntryText(app.pool_size_entry);
+    char *refill_text = uiEntryText(app.pool_refill_entry);
+    char *budget_text = uiEntryText(app.pool_budget_entry);
+    char *timeout_text = uiEntryText(app.attach_timeout_entry);
+    char *dos_path = uiEntryText(app.dos_path_entry);
+    char *config_path = uiEntryText(app.config_path_entry);
+
+    app.attach_timeout_ms = atoi(timeout_text);
+    apply_dosemurc_settings();
+    apply_drive_setting();
+    apply_placement_settings();
+
+    config.dos_path = dos_path;
+    config.config_path = config_path;
+    config.size = atoi(size_text);
+    config.refill_concurrency = atoi(refill_text);
+    config.memory_budget_kb = (size_t)strtoul(budget_text, NULL, 10) * 1024;
+    pool_configure(&config);
+
+    uiFreeText(size_text);
+    uiFreeText(refill_text);
+    uiFreeText(budget_text);
+    uiFreeText(timeout_text);
+    uiFreeText(dos_path);
+    uiFreeText(config_path);
+}
+
+void on_stop_button_clicked(uiButton *button, void *data) {
+    DosemuSession *session = selected_session();
+
+    if (!session || !stop_dosemu(session, on_dosemu_stopped, NULL)) {
+        uiMsgBoxError(app.main_window, "Error", "Failed to stop DOSEmu");
+    }
+    update_session_controls();
+}
+
+void on_save_log_clicked(uiButton *button, void *data) {
+    char *filename = uiSaveFile(app.main_window);
+    if (filename != NULL) {
+        if (!console_export(filename)) {
+            uiMsgBoxError(app.main_window, "Error", "Failed to save the console log");
+        }
+        uiFreeText(filename);
+    }
+}
+
+void on_save_trace_clicked(uiButton *button, void *data) {
+    char *filename = uiSaveFile(app.main_window);
+    if (filename != NULL) {
+        if (!trace_export_chrome(filename)) {
+            uiMsgBoxError(app.main_window, "Error", "Failed to save the trace");
+        }
+        uiFreeText(filename);
+    }
+}
+
+void on_transcript_record_clicked(uiButton *button, void *data) {
+    char *filename;
+
+    if (transcript_recording()) {
+        transcript_record_stop();
+        uiButtonSetText(app.transcript_record_button, "Record Transcript...");
+        return;
+    }
+
+    filename = uiSaveFile(app.main_window);
+    if (filename == NULL) {
+        return;
+    }
+    if (transcript_record_start(filename)) {
+        uiButtonSetText(app.transcript_record_button, "Stop Recording");
+    } else {
+        uiMsgBoxError(app.main_window, "Error", "Failed to start recording the transcript");
+    }
+    uiFreeText(filename);
+}
+
+static void on_transcript_replayed(const TranscriptReplayStats *stats, void *data) {
+    uiButtonSetText(app.transcript_replay_button, "Replay Transcript...");
+    if (stats->corrupt) {
+        uiMsgBoxError(app.main_window, "Error", "The transcript ends in a damaged event");
+    }
+}
+
+void on_transcript_replay_clicked(uiButton *button, void *data) {
+    char *filename;
+
+    if (transcript_replay_running()) {
+        transcript_replay_stop();
+        return;
+    }
+
+    filename = uiOpenFile(app.main_window);
+    if (filename == NULL) {
+        return;
+    }
+    if (transcript_replay_start(filename, uiCheckboxChecked(app.transcript_realtime_checkbox),
+                                on_transcript_replayed, NULL)) {
+        uiButtonSetText(app.transcript_replay_button, "Stop Replay");
+    } else {
+        uiMsgBoxError(app.main_window, "Error", "Failed to replay the transcript");
+    }
+    uiFreeText(filename);
+}
+
+void on_profile_start_clicked(uiButton *button, void *data) {
+    DosemuSession *session = selected_session();
+    char *rate_text = uiEntryText(app.profile_rate_entry);
+    int rate = atoi(rate_text);
+
+    uiFreeText(rate_text);
+
+    if (!session || dosemu_session_state(session) != SESSION_RUNNING) {
+        uiMsgBoxError(app.main_window, "Error", "Select a running session on the Control tab first");
+        return;
+    }
+    if (rate <= 0 || rate > PROFILE_MAX_RATE_HZ) {
+        uiMsgBoxError(app.main_window, "Error", "Sample rate must be between 1 and 1000 Hz");
+        return;
+    }
+
+    if (!profiler_start(session, rate, uiCheckboxChecked(app.profile_regs_checkbox))) {
+        uiMsgBoxError(app.main_window, "Error", "Failed to start profiling");
+    }
+    update_profile_controls();
+}
+
+void on_profile_stop_clicked(uiButton *button, void *data) {
+    profiler_stop();
+    update_profile_controls();
+}
+
+void on_profile_export_clicked(uiButton *button, void *data) {
+    char *filename = uiSaveFile(app.main_window);
+    bool ok;
+
+    if (filename == NULL) {
+        return;
+    }
+
+    switch ((int)(intptr_t)data) {
+    case PROFILE_EXPORT_FOLDED:
+        ok = profiler_export_folded(filename);
+        break;
+    case PROFILE_EXPORT_PPROF:
+        ok = profiler_export_pprof(filename);
+        break;
+    default:
+        ok = profiler_export_samples(filename);
+        break;
+    }
+
+    if (!ok) {
+        uiMsgBoxError(app.main_window, "Error", "Failed to export the profile");
+    }
+    uiFreeText(filename);
+}
+
+void on_itrace_start_clicked(uiButton *button, void *data) {
+    DosemuSession *session = selected_session();
+    char *filename;
+
+    if (!session || dosemu_session_state(session) != SESSION_RUNNING) {
+        uiMsgBoxError(app.main_window, "Error", "Select a running session on the Control tab first");
+        return;
+    }
+
+    filename = uiSaveFile(app.main_window);
+    if (filename == NULL) {
+        return;
+    }
+    if (!itrace_start(session, filename)) {
+        uiMsgBoxError(app.main_window, "Error", "Failed to start the instruction trace");
+    }
+    uiFreeText(filename);
+    update_profile_controls();
+}
+
+void on_itrace_stop_clicked(uiButton *button, void *data) {
+    itrace_stop();
+    update_itrace_status();
+    update_profile_controls();
+}
+
+void on_memory_browse_clicked(uiButton *button, void *data) {
+    DosemuSession *session = selected_session();
+    char *xms_text = uiEntryText(app.xms_size_entry);
+    long xms_kb = atol(xms_text);
+    char status[128];
+
+    uiFreeText(xms_text);
+
+    if (!session || dosemu_session_state(session) != SESSION_RUNNING) {
+        uiMsgBoxError(app.main_window, "Error", "Select a running session on the Control tab first");
+        return;
+    }
+
+    /* Conventional and upper memory plus the configured XMS */
+    if (xms_kb < 0 || xms_kb > 512 * 1024) {
+        xms_kb = 0;
+    }
+    memory_range = 0x100000 + (uint32_t)xms_kb * 1024;
+    memory_session = dosemu_session_id(session);
+    memory_visible_first = memory_visible_last = 0;
+
+    memview_attach(memory_session, on_memory_page_loaded, NULL);
+    uiAreaSetSize(app.memory_area, MEMORY_VIEW_WIDTH,
+                  (int)(memory_range / MEMORY_ROW_BYTES * MEMORY_ROW_HEIGHT));
+    uiAreaQueueRedrawAll(app.memory_area);
+
+    snprintf(status, sizeof(status), "Session %d, %u KB", memory_session,
+             (unsigned)(memory_range / 1024));
+    uiLabelSetText(app.memory_status_label, status);
+}
+
+void on_memory_goto_clicked(uiButton *button, void *data) {
+    char *text = uiEntryText(app.memory_goto_entry);
+    char *end;
+    unsigned long address = strtoul(text, &end, 16);
+    bool valid = end != text && *end == '\0';
+
+    /* Also accept segment:offset */
+    if (end != text && *end == ':') {
+        char *offset_text = end + 1;
+        unsigned long offset = strtoul(offset_text, &end, 16);
+        valid = end != offset_text && *end == '\0' && address <= 0xFFFF;
+        address = address * 16 + offset;
+    }
+    uiFreeText(text);
+
+    if (!valid || address >= memory_range) {
+        uiMsgBoxError(app.main_window, "Error", "Address is outside the browsed memory");
+        return;
+    }
+
+    uiAreaScrollTo(app.memory_area, 0,
+                   (double)(address / MEMORY_ROW_BYTES) * MEMORY_ROW_HEIGHT,
+                   MEMORY_VIEW_WIDTH, MEMORY_ROW_HEIGHT);
 }
 
 void on_browse_dos_path_clicked(uiButton *button, void *data) {
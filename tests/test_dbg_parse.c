@@ -0,0 +1,148 @@
+#define _GNU_SOURCE
+
+/* Parsers for dosdebug's register, memory dump and disassembly output */
+
+#include "test_support.h"
+#include "../include/dbg_client.h"
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+static void test_regs_dosdebug_layout(void **state) {
+    static const char text[] =
+        "EAX: 00004C00 EBX: 00000001 ECX: 000000FF EDX: 0000FFFF\n"
+        "ESI: 00000010 EDI: 00000020 EBP: 00000030 DS: 0070 ES: 0071 FS: 0072 GS: 0073\n"
+        "SS:SP: 0030:0100 CS:IP: F000:FFF0 FLAGS: 00003202\n";
+    DbgRegs regs;
+
+    assert_true(dbg_parse_regs(text, &regs));
+    assert_int_equal(regs.eax, 0x4C00);
+    assert_int_equal(regs.ebx, 1);
+    assert_int_equal(regs.ecx, 0xFF);
+    assert_int_equal(regs.edx, 0xFFFF);
+    assert_int_equal(regs.esi, 0x10);
+    assert_int_equal(regs.edi, 0x20);
+    assert_int_equal(regs.ebp, 0x30);
+    assert_int_equal(regs.ds, 0x70);
+    assert_int_equal(regs.es, 0x71);
+    assert_int_equal(regs.fs, 0x72);
+    assert_int_equal(regs.gs, 0x73);
+    assert_int_equal(regs.ss, 0x30);
+    assert_int_equal(regs.esp, 0x100);
+    assert_int_equal(regs.cs, 0xF000);
+    assert_int_equal(regs.eip, 0xFFF0);
+    assert_int_equal(regs.eflags, 0x3202);
+}
+
+static void test_regs_other_forms(void **state) {
+    DbgRegs regs;
+
+    /* "=" separators, lower case and names this parser does not know */
+    assert_true(dbg_parse_regs("xyz=5 eax=12345678 cs=1234 ip=0100 VFLAGS(h): 0202", &regs));
+    assert_int_equal(regs.eax, 0x12345678);
+    assert_int_equal(regs.cs, 0x1234);
+    assert_int_equal(regs.eip, 0x100);
+    assert_int_equal(regs.eflags, 0x202);
+
+    /* Segment registers keep 16 bits */
+    assert_true(dbg_parse_regs("CS: 12345 EIP: 00010000", &regs));
+    assert_int_equal(regs.cs, 0x2345);
+    assert_int_equal(regs.eip, 0x10000);
+}
+
+static void test_regs_incomplete(void **state) {
+    DbgRegs regs;
+
+    assert_false(dbg_parse_regs("", &regs));
+    assert_false(dbg_parse_regs("EAX: 00000000 EBX: 00000000\n", &regs));
+    assert_false(dbg_parse_regs("CS:IP: F000:", &regs));
+    assert_int_equal(regs.cs, 0xF000);
+    assert_false(dbg_parse_regs("CS:IP: zzzz:FFF0", &regs));
+    assert_false(dbg_parse_regs("error: no such command", &regs));
+}
+
+static void test_dump(void **state) {
+    static const char text[] =
+        "dump of 0070:0000\n"
+        "0070:0000 41 42 43 44-45 46 47 48  ABCDEFGH\n"
+        "  0070:0008 00 FF 7f 80\n"
+        "0070:000C 10 11";
+    static const uint8_t expected[] = {0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+                                       0x00, 0xFF, 0x7F, 0x80, 0x10, 0x11};
+    uint8_t bytes[32];
+
+    assert_int_equal(dbg_parse_dump(text, bytes, sizeof(bytes)), sizeof(expected));
+    assert_memory_equal(bytes, expected, sizeof(expected));
+
+    /* Stops at the capacity, in the middle of a line */
+    memset(bytes, 0, sizeof(bytes));
+    assert_int_equal(dbg_parse_dump(text, bytes, 3), 3);
+    assert_memory_equal(bytes, expected, 3);
+    assert_int_equal(bytes[3], 0);
+}
+
+static void test_dump_damaged(void **state) {
+    uint8_t bytes[16];
+
+    assert_int_equal(dbg_parse_dump("", bytes, sizeof(bytes)), 0);
+    assert_int_equal(dbg_parse_dump("no address here 41 42\n", bytes, sizeof(bytes)), 0);
+
+    /* A line ends at the first thing that is not a two-digit byte */
+    assert_int_equal(dbg_parse_dump("0070:0000 41 4G 43\n", bytes, sizeof(bytes)), 1);
+    assert_int_equal(dbg_parse_dump("0070:0000 41 424 43\n", bytes, sizeof(bytes)), 1);
+    assert_int_equal(dbg_parse_dump("0070:0000 41 4", bytes, sizeof(bytes)), 1);
+    assert_int_equal(bytes[0], 0x41);
+}
+
+static void test_code(void **state) {
+    static const char text[] =
+        "1234:00FE 90            NOP\n"
+        "1234:0100 B409          MOV AH,09\n"
+        "1234:0102 0000          ADD [BX+SI],AL\n"
+        "1234:0104 CD 21         INT 21\n"
+        "F000:0104 EA5BE000F0    JMP F000:E05B\n";
+    uint8_t bytes[16];
+
+    assert_int_equal(dbg_parse_code(text, 0x1234, 0x100, bytes, sizeof(bytes)), 2);
+    assert_int_equal(bytes[0], 0xB4);
+    assert_int_equal(bytes[1], 0x09);
+
+    /* A mnemonic made of hex digits still ends the bytes */
+    assert_int_equal(dbg_parse_code(text, 0x1234, 0x102, bytes, sizeof(bytes)), 2);
+
+    /* Bytes given in pairs, and the segment telling lines apart */
+    assert_int_equal(dbg_parse_code(text, 0x1234, 0x104, bytes, sizeof(bytes)), 2);
+    assert_int_equal(bytes[0], 0xCD);
+    assert_int_equal(dbg_parse_code(text, 0xF000, 0x104, bytes, sizeof(bytes)), 5);
+    assert_int_equal(bytes[4], 0xF0);
+
+    assert_int_equal(dbg_parse_code(text, 0xF000, 0x104, bytes, 3), 3);
+}
+
+static void test_code_not_found(void **state) {
+    uint8_t bytes[16];
+
+    assert_int_equal(dbg_parse_code("", 0x1234, 0x100, bytes, sizeof(bytes)), 0);
+    assert_int_equal(dbg_parse_code("1234:0101 B409 MOV AH,09\n", 0x1234, 0x100, bytes,
+                                    sizeof(bytes)), 0);
+    assert_int_equal(dbg_parse_code("1234:0100\n", 0x1234, 0x100, bytes, sizeof(bytes)), 0);
+    assert_int_equal(dbg_parse_code("1234:0100 B40 MOV AH,0\n", 0x1234, 0x100, bytes,
+                                    sizeof(bytes)), 0);
+    assert_int_equal(dbg_parse_code("1234:0100:B409\n", 0x1234, 0x100, bytes, sizeof(bytes)), 0);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_regs_dosdebug_layout),
+        cmocka_unit_test(test_regs_other_forms),
+        cmocka_unit_test(test_regs_incomplete),
+        cmocka_unit_test(test_dump),
+        cmocka_unit_test(test_dump_damaged),
+        cmocka_unit_test(test_code),
+        cmocka_unit_test(test_code_not_found),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,238 @@
+#define _GNU_SOURCE
+
+/* Launch configs: merging the Configuration tab settings into a dosemurc, and validation */
+
+#include "test_support.h"
+#include "../include/dosemurc.h"
+#include "../include/headless.h"
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+static const DosemurcSettings no_settings = {0};
+
+/* Write text to a config file called name and build a launch config from it */
+static bool launch_config(const char *name, const char *text, const char *drive,
+                          char *path, size_t size) {
+    char source[PATH_MAX], resolved[PATH_MAX];
+
+    test_path(source, sizeof(source), name);
+    assert_true(test_write_file(source, text));
+    return dosemurc_launch_config(source, drive, path, size, resolved, sizeof(resolved));
+}
+
+static void test_merge(void **state) {
+    static const char text[] =
+        "# the user's own settings\n"
+        "$_cpu = \"80486\"\n"
+        "  $_dpmi = (0x1000)\n"
+        "$_xms=(1024)\n"
+        "$_hdimage = \"drives/c\"";
+    DosemurcSettings settings = {.memory_kb = 8192, .ems_kb = 2048, .vga = true};
+    char path[PATH_MAX], merged[4096];
+
+    dosemurc_configure(&settings);
+    assert_true(launch_config("merge.conf", text, "/dos/c", path, sizeof(path)));
+    assert_true(path[0] != '\0');
+    assert_true(test_read_file(path, merged, sizeof(merged)));
+
+    /* Overridden assignments are commented out, the rest kept as written */
+    assert_non_null(strstr(merged, "$_cpu = \"80486\"\n"));
+    assert_non_null(strstr(merged, "# replaced by the GUI settings below:   $_dpmi = (0x1000)\n"));
+    assert_non_null(strstr(merged, "# replaced by the GUI settings below: $_hdimage = \"drives/c\"\n"));
+    assert_non_null(strstr(merged, "\n$_xms=(1024)\n"));
+
+    assert_non_null(strstr(merged, "\n$_dpmi = (8192)\n"));
+    assert_non_null(strstr(merged, "\n$_ems = (2048)\n"));
+    assert_non_null(strstr(merged, "\n$_video = \"vga\"\n"));
+    assert_non_null(strstr(merged, "\n$_hdimage = \"/dos/c\"\n"));
+    assert_null(strstr(merged, "$_console"));
+    dosemurc_configure(&no_settings);
+}
+
+/* The same inputs give the same file, from the cache the second time */
+static void test_cached(void **state) {
+    DosemurcSettings settings = {.xms_kb = 4096};
+    DosemurcStats before, after;
+    char first[PATH_MAX], second[PATH_MAX], other[PATH_MAX], source[PATH_MAX];
+
+    dosemurc_configure(&settings);
+    assert_true(launch_config("cached.conf", "$_cpu = \"80386\"\n", NULL, first, sizeof(first)));
+
+    dosemurc_stats(&before);
+    test_path(source, sizeof(source), "cached.conf");
+    assert_true(dosemurc_launch_config(source, NULL, second, sizeof(second), other,
+                                       sizeof(other)));
+    dosemurc_stats(&after);
+    assert_string_equal(first, second);
+    assert_int_equal(after.hits, before.hits + 1);
+
+    /* Other settings, another file */
+    settings.xms_kb = 8192;
+    dosemurc_configure(&settings);
+    assert_true(dosemurc_launch_config(source, NULL, other, sizeof(other), second,
+                                       sizeof(second)));
+    assert_true(strcmp(first, other) != 0);
+    dosemurc_configure(&no_settings);
+}
+
+/* A file under the same name and size is only reused if it really holds the config */
+static void test_reuse_checks_contents(void **state) {
+    DosemurcSettings settings = {.ems_kb = 1024};
+    DosemurcStats before, after;
+    char first[PATH_MAX], second[PATH_MAX], expected[4096], text[4096];
+    size_t length;
+
+    dosemurc_configure(&settings);
+    assert_true(launch_config("reuse-a.conf", "$_cpu = \"80286\"\n", NULL, first, sizeof(first)));
+    assert_true(test_read_file(first, expected, sizeof(expected)));
+    length = strlen(expected);
+    memset(text, '#', length);
+    text[length] = '\0';
+    assert_true(test_write_file(first, text));
+
+    /* Another source with the same text merges to the same name */
+    dosemurc_stats(&before);
+    assert_true(launch_config("reuse-b.conf", "$_cpu = \"80286\"\n", NULL, second,
+                              sizeof(second)));
+    dosemurc_stats(&after);
+    assert_string_equal(first, second);
+    assert_int_equal(after.generated, before.generated + 1);
+    assert_true(test_read_file(second, text, sizeof(text)));
+    assert_string_equal(text, expected);
+    dosemurc_configure(&no_settings);
+}
+
+/* Nothing to merge: DOSEmu reads the file itself */
+static void test_nothing_to_merge(void **state) {
+    char path[PATH_MAX];
+
+    dosemurc_configure(&no_settings);
+    assert_true(launch_config("plain.conf", "$_cpu = \"80386\"\n", "", path, sizeof(path)));
+    assert_string_equal(path, "");
+}
+
+static void test_validation(void **state) {
+    static const struct {
+        const char *name;
+        const char *text;
+    } invalid[] = {
+        {"quote.conf", "$_cpu = \"80386\n"},
+        {"paren.conf", "$_dpmi = ((0x1000)\n"},
+        {"close.conf", "$_dpmi = 0x1000)(\n"},
+        {"assign.conf", "$_dpmi 0x1000\n"},
+        {"dollar.conf", "$ = 5\n"},
+        {"endif.conf", "$_cpu = \"80386\"\nendif\n"},
+        {"if.conf", "if (1)\n  $_cpu = \"80386\"\n"},
+    };
+    char path[PATH_MAX];
+
+    dosemurc_configure(&no_settings);
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(*invalid); i++) {
+        if (launch_config(invalid[i].name, invalid[i].text, NULL, path, sizeof(path))) {
+            fail_msg("%s validated", invalid[i].name);
+        }
+    }
+
+    /* Quotes and parentheses in comments and strings do not count */
+    assert_true(launch_config("valid.conf",
+                              "# it's \"fine\" (really\n"
+                              "$_title = \"a (b\" # )\n"
+                              "ifdef foo\n"
+                              "  if (1)\n"
+                              "    $_cpu = \"80386\"\n"
+                              "  endif\n"
+                              "endif\n",
+                              NULL, path, sizeof(path)));
+}
+
+static void test_invalid_settings_and_drive(void **state) {
+    DosemurcSettings settings = {.ems_kb = 100};
+    char missing[PATH_MAX], path[PATH_MAX], source[PATH_MAX];
+
+    dosemurc_configure(&settings);
+    assert_false(launch_config("ems.conf", "", NULL, path, sizeof(path)));
+    settings.ems_kb = 0;
+    settings.memory_kb = DOSEMURC_MAX_MEMORY_KB + 1;
+    dosemurc_configure(&settings);
+    assert_false(launch_config("memory.conf", "", NULL, path, sizeof(path)));
+    dosemurc_configure(&no_settings);
+
+    /* $_hdimage is split on spaces */
+    assert_false(launch_config("drive.conf", "", "/dos/my drive", path, sizeof(path)));
+    assert_false(launch_config("drive.conf", "", "/dos/\"c\"", path, sizeof(path)));
+
+    test_path(missing, sizeof(missing), "missing.conf");
+    assert_false(dosemurc_launch_config(missing, NULL, path, sizeof(path), source,
+                                        sizeof(source)));
+}
+
+/* The user's own file may be missing; it reads as empty */
+static void test_default_source(void **state) {
+    char home[PATH_MAX], path[PATH_MAX], source[PATH_MAX], expected[PATH_MAX + 16];
+    DosemurcSettings settings = {.console = true};
+    char merged[1024];
+
+    test_path(home, sizeof(home), "");
+    setenv("HOME", home, 1);
+    dosemurc_configure(&settings);
+    assert_true(dosemurc_launch_config(NULL, NULL, path, sizeof(path), source, sizeof(source)));
+    snprintf(expected, sizeof(expected), "%s/.dosemurc", home);
+    assert_string_equal(source, expected);
+    assert_true(test_read_file(path, merged, sizeof(merged)));
+    assert_non_null(strstr(merged, "$_console = (on)\n"));
+    dosemurc_configure(&no_settings);
+}
+
+static void on_change(const char *source, void *data) {
+    snprintf(data, PATH_MAX, "%s", source);
+}
+
+/* Editing a config file someone launched from reports it and drops what was built from it */
+static void test_change_callback(void **state) {
+    static char changed[PATH_MAX];
+    static bool done;
+    DosemurcSettings settings = {.vga = true};
+    DosemurcStats before, after;
+    char source[PATH_MAX], resolved[PATH_MAX], path[PATH_MAX];
+
+    assert_true(dosemurc_add_change_callback(on_change, changed));
+
+    /* New settings change every config */
+    changed[0] = 'x';
+    dosemurc_configure(&settings);
+    assert_string_equal(changed, "");
+
+    assert_true(launch_config("watched.conf", "$_cpu = \"80386\"\n", NULL, path, sizeof(path)));
+    test_path(source, sizeof(source), "watched.conf");
+    assert_non_null(realpath(source, resolved));
+    dosemurc_stats(&before);
+    assert_true(test_write_file(source, "$_cpu = \"80486\"\n"));
+
+    done = false;
+    for (int waited = 0; waited < TEST_TIMEOUT_MS && strcmp(changed, resolved) != 0;
+         waited += 10) {
+        headless_run_until(&done, 10);
+    }
+    assert_string_equal(changed, resolved);
+    dosemurc_stats(&after);
+    assert_true(after.invalidated > before.invalidated);
+    dosemurc_configure(&no_settings);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_merge),
+        cmocka_unit_test(test_cached),
+        cmocka_unit_test(test_reuse_checks_contents),
+        cmocka_unit_test(test_nothing_to_merge),
+        cmocka_unit_test(test_validation),
+        cmocka_unit_test(test_invalid_settings_and_drive),
+        cmocka_unit_test(test_default_source),
+        cmocka_unit_test(test_change_callback),
+    };
+
+    return cmocka_run_group_tests(tests, test_setup, test_teardown);
+}
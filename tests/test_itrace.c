@@ -0,0 +1,186 @@
+#define _GNU_SOURCE
+
+/* Instruction trace files: round trips through the writer and reader, and damaged files */
+
+#include "test_support.h"
+#include "../include/itrace.h"
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Enough records for several blocks */
+#define RECORDS 200000
+
+/* Record i: mostly small steps, with jumps, full-width values and odd opcode lengths */
+static void make_record(uint64_t i, ItraceRecord *record) {
+    memset(record, 0, sizeof(*record));
+    record->cs = i % 1000 == 999 ? 0xF000 : 0x1234;
+    record->ip = (uint32_t)(i % 7919 == 0 ? 0xFFFFFFF0u : 0x100 + i % 300);
+    record->opcode_length = (uint8_t)(i % (ITRACE_MAX_OPCODE + 1));
+    for (int j = 0; j < record->opcode_length; j++) {
+        record->opcode[j] = (uint8_t)(i * 31 + (uint64_t)j);
+    }
+    record->regs.cs = record->cs;
+    record->regs.eip = record->ip + record->opcode_length;
+    record->regs.eax = (uint32_t)(i % 2 ? 0xFFFFFFFFu : i);
+    record->regs.ecx = (uint32_t)(0xFFFF - i);
+    record->regs.esp = 0xFFFE - (uint32_t)(i % 16) * 2;
+    record->regs.eflags = i % 3 ? 0x0202 : 0x0246;
+    record->regs.ds = record->regs.ss = 0x1234;
+    record->regs.es = (uint16_t)(i % 500 == 0 ? 0xB800 : 0x1234);
+}
+
+/* Field by field, since the padding of a decoded record is not defined */
+static void assert_same_record(const ItraceRecord *a, const ItraceRecord *b) {
+    assert_int_equal(a->cs, b->cs);
+    assert_int_equal(a->ip, b->ip);
+    assert_int_equal(a->opcode_length, b->opcode_length);
+    assert_memory_equal(a->opcode, b->opcode, a->opcode_length);
+    assert_memory_equal(&a->regs, &b->regs, sizeof(a->regs));
+}
+
+static bool write_trace(const char *path, uint64_t count) {
+    ItraceWriter *writer = itrace_writer_open(path);
+    ItraceRecord record;
+    bool ok = writer != NULL;
+
+    for (uint64_t i = 0; ok && i < count; i++) {
+        make_record(i, &record);
+        ok = itrace_writer_add(writer, &record);
+    }
+    return writer && itrace_writer_close(writer) && ok;
+}
+
+/* Records read back that match make_record(), stopping at the first that does not */
+static uint64_t read_trace(const char *path, bool *failed) {
+    ItraceReader *reader = itrace_reader_open(path);
+    ItraceRecord record, expected;
+    uint64_t count = 0;
+
+    assert_non_null(reader);
+    while (itrace_reader_next(reader, &record)) {
+        make_record(count, &expected);
+        assert_same_record(&record, &expected);
+        count++;
+    }
+    *failed = itrace_reader_failed(reader);
+    itrace_reader_close(reader);
+    return count;
+}
+
+static off_t file_size(const char *path) {
+    struct stat info;
+
+    assert_int_equal(stat(path, &info), 0);
+    return info.st_size;
+}
+
+static void test_round_trip(void **state) {
+    char path[PATH_MAX];
+    bool failed;
+
+    test_path(path, sizeof(path), "round-trip.itrace");
+    assert_true(write_trace(path, RECORDS));
+    assert_int_equal(read_trace(path, &failed), RECORDS);
+    assert_false(failed);
+}
+
+static void test_empty_trace(void **state) {
+    char path[PATH_MAX];
+    bool failed;
+
+    test_path(path, sizeof(path), "empty.itrace");
+    assert_true(write_trace(path, 0));
+    assert_int_equal(file_size(path), strlen(ITRACE_MAGIC));
+    assert_int_equal(read_trace(path, &failed), 0);
+    assert_false(failed);
+}
+
+static void test_bad_magic(void **state) {
+    char path[PATH_MAX];
+
+    test_path(path, sizeof(path), "magic.itrace");
+    assert_true(test_write_file(path, "DGITRC0\nwhatever follows"));
+    assert_null(itrace_reader_open(path));
+    assert_true(test_write_file(path, "DGI"));
+    assert_null(itrace_reader_open(path));
+}
+
+/* A trace cut short loses its last block, which is reported, but keeps the others */
+static void test_truncated(void **state) {
+    char path[PATH_MAX];
+    uint64_t count;
+    bool failed;
+
+    test_path(path, sizeof(path), "truncated.itrace");
+    assert_true(write_trace(path, RECORDS));
+    assert_int_equal(truncate(path, file_size(path) - 10), 0);
+
+    count = read_trace(path, &failed);
+    assert_true(failed);
+    assert_true(count > 0 && count < RECORDS);
+
+    /* Down to part of the first block header */
+    assert_int_equal(truncate(path, (off_t)strlen(ITRACE_MAGIC) + 5), 0);
+    assert_int_equal(read_trace(path, &failed), 0);
+    assert_true(failed);
+}
+
+static void test_corrupt_block(void **state) {
+    char path[PATH_MAX];
+    uint8_t byte;
+    off_t offset;
+    bool failed;
+    int fd;
+
+    test_path(path, sizeof(path), "corrupt.itrace");
+    assert_true(write_trace(path, RECORDS));
+
+    /* Flip a byte inside the first block's compressed data */
+    offset = (off_t)strlen(ITRACE_MAGIC) + 64;
+    fd = open(path, O_RDWR);
+    assert_true(fd >= 0);
+    assert_int_equal(pread(fd, &byte, 1, offset), 1);
+    byte ^= 0xFF;
+    assert_int_equal(pwrite(fd, &byte, 1, offset), 1);
+    close(fd);
+
+    assert_int_equal(read_trace(path, &failed), 0);
+    assert_true(failed);
+}
+
+/* A block header claiming more than the file holds */
+static void test_oversized_block(void **state) {
+    static const uint8_t header[] = {0xFF, 0xFF, 0xFF, 0x7F, 0x10, 0, 0, 0, 1, 0, 0, 0};
+    char path[PATH_MAX];
+    bool failed;
+    FILE *file;
+
+    test_path(path, sizeof(path), "oversized.itrace");
+    file = fopen(path, "w");
+    assert_non_null(file);
+    fputs(ITRACE_MAGIC, file);
+    fwrite(header, 1, sizeof(header), file);
+    fclose(file);
+
+    assert_int_equal(read_trace(path, &failed), 0);
+    assert_true(failed);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_round_trip),
+        cmocka_unit_test(test_empty_trace),
+        cmocka_unit_test(test_bad_magic),
+        cmocka_unit_test(test_truncated),
+        cmocka_unit_test(test_corrupt_block),
+        cmocka_unit_test(test_oversized_block),
+    };
+
+    return cmocka_run_group_tests(tests, test_setup, test_teardown);
+}
@@ -0,0 +1,101 @@
+#define _GNU_SOURCE
+
+/* Log-scale latency histograms and the percentiles read from them */
+
+#include "test_support.h"
+#include "../include/latency.h"
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+/* A bucket's upper bound is at most this far above the samples in it */
+#define BUCKET_ERROR (1.0 + 1.0 / LATENCY_SUBBUCKETS)
+
+/* Whether a percentile estimate bounds the exact value from above, within a bucket */
+static bool close_above(double estimate, double exact) {
+    return estimate >= exact && estimate <= exact * BUCKET_ERROR;
+}
+
+static void test_empty(void **state) {
+    LatencyHistogram histogram = {0};
+
+    assert_true(latency_percentile(&histogram, 0.5) == 0.0);
+    assert_true(latency_percentile(&histogram, 1.0) == 0.0);
+    assert_true(latency_mean(&histogram) == 0.0);
+}
+
+static void test_single_sample(void **state) {
+    LatencyHistogram histogram = {0};
+
+    latency_record(&histogram, 3.7);
+
+    /* Never more than was observed, even though the bucket reaches higher */
+    assert_true(latency_percentile(&histogram, 0.0) == 3.7);
+    assert_true(latency_percentile(&histogram, 0.5) == 3.7);
+    assert_true(latency_percentile(&histogram, 1.0) == 3.7);
+    assert_true(latency_mean(&histogram) == 3.7);
+}
+
+static void test_uniform(void **state) {
+    LatencyHistogram histogram = {0};
+
+    for (int ms = 1; ms <= 1000; ms++) {
+        latency_record(&histogram, (double)ms);
+    }
+
+    assert_int_equal(histogram.total, 1000);
+    assert_true(close_above(latency_percentile(&histogram, 0.5), 500.0));
+    assert_true(close_above(latency_percentile(&histogram, 0.9), 900.0));
+    assert_true(close_above(latency_percentile(&histogram, 0.99), 990.0));
+    assert_true(latency_percentile(&histogram, 1.0) == 1000.0);
+    assert_true(close_above(latency_percentile(&histogram, 0.0), 1.0));
+    assert_true(latency_mean(&histogram) == 500.5);
+}
+
+/* Percentiles never decrease with the fraction asked for */
+static void test_monotonic(void **state) {
+    LatencyHistogram histogram = {0};
+    double previous = 0.0;
+
+    for (int i = 0; i < 10000; i++) {
+        latency_record(&histogram, (double)((i * 7919) % 10007) / 100.0);
+    }
+    for (int percent = 0; percent <= 100; percent++) {
+        double value = latency_percentile(&histogram, percent / 100.0);
+
+        assert_true(value >= previous);
+        previous = value;
+    }
+    assert_true(previous == histogram.max_ms);
+}
+
+static void test_out_of_range(void **state) {
+    LatencyHistogram histogram = {0};
+
+    /* Under a microsecond, zero and negative all land in the first bucket */
+    latency_record(&histogram, 0.0005);
+    latency_record(&histogram, 0.0);
+    latency_record(&histogram, -1.0);
+    assert_int_equal(histogram.counts[0], 3);
+    assert_true(latency_percentile(&histogram, 1.0) <= 0.001);
+
+    /* Beyond the last octave everything shares the last bucket */
+    latency_record(&histogram, 1e9);
+    latency_record(&histogram, 1e12);
+    assert_int_equal(histogram.counts[LATENCY_BUCKETS - 1], 2);
+    assert_true(latency_percentile(&histogram, 1.0) == 1e12);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_empty),
+        cmocka_unit_test(test_single_sample),
+        cmocka_unit_test(test_uniform),
+        cmocka_unit_test(test_monotonic),
+        cmocka_unit_test(test_out_of_range),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,326 @@
+#define _GNU_SOURCE
+
+/* Staged drives: what harvesting writes back, deletes and leaves alone */
+
+#include "test_support.h"
+#include "../include/overlay.h"
+#include "../include/headless.h"
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* A base drive and its staged copy */
+typedef struct Fixture {
+    char base[PATH_MAX];
+    DriveOverlay *overlay;
+    bool staged;
+    bool harvested;
+    bool success;
+} Fixture;
+
+static int next_session = 1;
+
+static void on_staged(DriveOverlay *overlay, bool success, void *data) {
+    Fixture *fixture = data;
+
+    fixture->success = success;
+    fixture->staged = true;
+}
+
+static void on_harvested(DriveOverlay *overlay, bool success, void *data) {
+    Fixture *fixture = data;
+
+    fixture->success = success;
+    fixture->harvested = true;
+}
+
+/* Harvest on the worker and wait for it; whether everything was written back */
+static bool harvest(Fixture *fixture) {
+    fixture->harvested = false;
+    assert_true(overlay_harvest(fixture->overlay, on_harvested, fixture));
+    assert_true(headless_run_until(&fixture->harvested, TEST_TIMEOUT_MS));
+    return fixture->success;
+}
+
+/* Create name under directory with text in it, dated well before the test */
+static void make_file(const char *directory, const char *name, const char *text) {
+    static const struct timespec old[2] = {{946684800, 0}, {946684800, 0}};
+    char path[PATH_MAX * 2];
+
+    snprintf(path, sizeof(path), "%s/%s", directory, name);
+    assert_true(test_write_file(path, text));
+    assert_int_equal(utimensat(AT_FDCWD, path, old, 0), 0);
+}
+
+/* The file's text, or "(absent)" */
+static const char *contents(const char *directory, const char *name) {
+    static char text[256];
+    char path[PATH_MAX * 2];
+
+    snprintf(path, sizeof(path), "%s/%s", directory, name);
+    if (!test_read_file(path, text, sizeof(text))) {
+        return "(absent)";
+    }
+    return text;
+}
+
+static void overlay_file(const Fixture *fixture, const char *name, const char *text) {
+    char path[PATH_MAX * 2];
+
+    snprintf(path, sizeof(path), "%s/%s", overlay_path(fixture->overlay), name);
+    assert_true(test_write_file(path, text));
+}
+
+static void overlay_remove(const Fixture *fixture, const char *name) {
+    char path[PATH_MAX * 2];
+
+    snprintf(path, sizeof(path), "%s/%s", overlay_path(fixture->overlay), name);
+    assert_int_equal(unlink(path), 0);
+}
+
+/* A base drive with a few files and a directory, staged */
+static int stage_drive(void **state) {
+    Fixture *fixture = calloc(1, sizeof(*fixture));
+    char directory[PATH_MAX * 2];
+    int session = next_session++;
+
+    if (!fixture) {
+        return -1;
+    }
+    snprintf(directory, sizeof(directory), "drive-%d", session);
+    test_path(fixture->base, sizeof(fixture->base), directory);
+    snprintf(directory, sizeof(directory), "%s/GAMES", fixture->base);
+    if (mkdir(fixture->base, 0755) != 0 || mkdir(directory, 0755) != 0) {
+        free(fixture);
+        return -1;
+    }
+    make_file(fixture->base, "AUTOEXEC.BAT", "@echo off\n");
+    make_file(fixture->base, "CONFIG.SYS", "files=30\n");
+    make_file(fixture->base, "OLD.TXT", "old\n");
+    make_file(fixture->base, "GAMES/SAVE.DAT", "level 1\n");
+
+    fixture->overlay = overlay_create(fixture->base, session);
+    if (!fixture->overlay || !overlay_stage(fixture->overlay, on_staged, fixture) ||
+        !headless_run_until(&fixture->staged, TEST_TIMEOUT_MS) || !fixture->success) {
+        overlay_close(fixture->overlay, false);
+        free(fixture);
+        return -1;
+    }
+    *state = fixture;
+    return 0;
+}
+
+static int close_drive(void **state) {
+    Fixture *fixture = *state;
+
+    overlay_close(fixture->overlay, false);
+    free(fixture);
+    return 0;
+}
+
+static void test_staged_copy(void **state) {
+    Fixture *fixture = *state;
+    OverlayStats stats;
+
+    assert_string_equal(contents(overlay_path(fixture->overlay), "CONFIG.SYS"), "files=30\n");
+    assert_string_equal(contents(overlay_path(fixture->overlay), "GAMES/SAVE.DAT"), "level 1\n");
+    overlay_stats(fixture->overlay, &stats);
+    assert_int_equal(stats.files, 4);
+    assert_int_equal(stats.directories, 1);
+
+    /* Nothing changed, nothing to do */
+    assert_true(harvest(fixture));
+    overlay_stats(fixture->overlay, &stats);
+    assert_int_equal(stats.harvested_files, 0);
+    assert_int_equal(stats.deleted_files, 0);
+    assert_int_equal(stats.conflicts, 0);
+}
+
+/* Changed, new and deleted files all reach the base drive */
+static void test_write_back(void **state) {
+    Fixture *fixture = *state;
+    char directory[PATH_MAX * 2];
+    OverlayStats stats;
+
+    overlay_file(fixture, "CONFIG.SYS", "files=40\n");
+    overlay_file(fixture, "GAMES/SAVE.DAT", "level 2\n");
+    overlay_file(fixture, "NEW.TXT", "new\n");
+    snprintf(directory, sizeof(directory), "%s/NEWDIR", overlay_path(fixture->overlay));
+    assert_int_equal(mkdir(directory, 0755), 0);
+    overlay_file(fixture, "NEWDIR/INNER.TXT", "inner\n");
+    overlay_remove(fixture, "OLD.TXT");
+
+    assert_true(harvest(fixture));
+    assert_string_equal(contents(fixture->base, "CONFIG.SYS"), "files=40\n");
+    assert_string_equal(contents(fixture->base, "GAMES/SAVE.DAT"), "level 2\n");
+    assert_string_equal(contents(fixture->base, "NEW.TXT"), "new\n");
+    assert_string_equal(contents(fixture->base, "NEWDIR/INNER.TXT"), "inner\n");
+    assert_string_equal(contents(fixture->base, "OLD.TXT"), "(absent)");
+    assert_string_equal(contents(fixture->base, "AUTOEXEC.BAT"), "@echo off\n");
+
+    overlay_stats(fixture->overlay, &stats);
+    assert_int_equal(stats.harvested_files, 4);
+    assert_int_equal(stats.deleted_files, 1);
+    assert_int_equal(stats.conflicts, 0);
+}
+
+/* Files changed on both sides keep the base drive's copy */
+static void test_conflicts(void **state) {
+    Fixture *fixture = *state;
+    char path[PATH_MAX * 2];
+    OverlayStats stats;
+
+    /* Changed in both */
+    overlay_file(fixture, "CONFIG.SYS", "files=40\n");
+    snprintf(path, sizeof(path), "%s/CONFIG.SYS", fixture->base);
+    assert_true(test_write_file(path, "files=50 from the host\n"));
+    /* Deleted by DOS, changed on the host */
+    overlay_remove(fixture, "OLD.TXT");
+    snprintf(path, sizeof(path), "%s/OLD.TXT", fixture->base);
+    assert_true(test_write_file(path, "edited on the host\n"));
+    /* Created on both sides */
+    overlay_file(fixture, "NEW.TXT", "from DOS\n");
+    make_file(fixture->base, "NEW.TXT", "from the host\n");
+    /* And one clean change alongside them */
+    overlay_file(fixture, "GAMES/SAVE.DAT", "level 2\n");
+
+    assert_false(harvest(fixture));
+    assert_string_equal(contents(fixture->base, "CONFIG.SYS"), "files=50 from the host\n");
+    assert_string_equal(contents(fixture->base, "OLD.TXT"), "edited on the host\n");
+    assert_string_equal(contents(fixture->base, "NEW.TXT"), "from the host\n");
+    assert_string_equal(contents(fixture->base, "GAMES/SAVE.DAT"), "level 2\n");
+
+    overlay_stats(fixture->overlay, &stats);
+    assert_int_equal(stats.conflicts, 3);
+    assert_int_equal(stats.harvested_files, 1);
+    assert_int_equal(stats.deleted_files, 0);
+}
+
+/* A file the host already deleted is not a conflict when DOS deleted it too */
+static void test_deleted_on_both_sides(void **state) {
+    Fixture *fixture = *state;
+    char path[PATH_MAX * 2];
+    OverlayStats stats;
+
+    overlay_remove(fixture, "OLD.TXT");
+    snprintf(path, sizeof(path), "%s/OLD.TXT", fixture->base);
+    assert_int_equal(unlink(path), 0);
+
+    assert_true(harvest(fixture));
+    overlay_stats(fixture->overlay, &stats);
+    assert_int_equal(stats.conflicts, 0);
+    assert_int_equal(stats.deleted_files, 0);
+}
+
+/* Directories DOS deleted go too, deepest first, unless the host added to them */
+static void test_deleted_directories(void **state) {
+    Fixture *fixture = *state;
+    char path[PATH_MAX * 2];
+    struct stat info;
+    OverlayStats stats;
+
+    snprintf(path, sizeof(path), "%s/GAMES/OLD", fixture->base);
+    assert_int_equal(mkdir(path, 0755), 0);
+    make_file(path, "SCORES.DAT", "100\n");
+    snprintf(path, sizeof(path), "%s/KEEP", fixture->base);
+    assert_int_equal(mkdir(path, 0755), 0);
+    overlay_close(fixture->overlay, false);
+    fixture->staged = false;
+    fixture->overlay = overlay_create(fixture->base, next_session++);
+    assert_non_null(fixture->overlay);
+    assert_true(overlay_stage(fixture->overlay, on_staged, fixture));
+    assert_true(headless_run_until(&fixture->staged, TEST_TIMEOUT_MS));
+
+    /* DOS removes GAMES with everything in it, and KEEP, which the host fills meanwhile */
+    overlay_remove(fixture, "GAMES/OLD/SCORES.DAT");
+    overlay_remove(fixture, "GAMES/SAVE.DAT");
+    snprintf(path, sizeof(path), "%s/GAMES/OLD", overlay_path(fixture->overlay));
+    assert_int_equal(rmdir(path), 0);
+    snprintf(path, sizeof(path), "%s/GAMES", overlay_path(fixture->overlay));
+    assert_int_equal(rmdir(path), 0);
+    snprintf(path, sizeof(path), "%s/KEEP", overlay_path(fixture->overlay));
+    assert_int_equal(rmdir(path), 0);
+    make_file(fixture->base, "KEEP/HOST.TXT", "from the host\n");
+
+    assert_true(harvest(fixture));
+    snprintf(path, sizeof(path), "%s/GAMES", fixture->base);
+    assert_int_not_equal(stat(path, &info), 0);
+    assert_string_equal(contents(fixture->base, "KEEP/HOST.TXT"), "from the host\n");
+    overlay_stats(fixture->overlay, &stats);
+    assert_int_equal(stats.deleted_files, 4);
+}
+
+/* Links are pointed at the staged copy; links leaving the drive are not staged */
+static void test_links(void **state) {
+    Fixture *fixture = *state;
+    char path[PATH_MAX * 2], target[PATH_MAX * 2];
+    ssize_t length;
+
+    snprintf(path, sizeof(path), "%s/SAVE.LNK", fixture->base);
+    assert_int_equal(symlink("GAMES/SAVE.DAT", path), 0);
+    snprintf(path, sizeof(path), "%s/ESCAPE.LNK", fixture->base);
+    assert_int_equal(symlink("/etc/passwd", path), 0);
+    overlay_close(fixture->overlay, false);
+    fixture->staged = false;
+    fixture->overlay = overlay_create(fixture->base, next_session++);
+    assert_non_null(fixture->overlay);
+    assert_true(overlay_stage(fixture->overlay, on_staged, fixture));
+    assert_true(headless_run_until(&fixture->staged, TEST_TIMEOUT_MS));
+
+    snprintf(path, sizeof(path), "%s/SAVE.LNK", overlay_path(fixture->overlay));
+    length = readlink(path, target, sizeof(target) - 1);
+    assert_true(length > 0);
+    target[length] = '\0';
+    snprintf(path, sizeof(path), "%s/GAMES/SAVE.DAT", overlay_path(fixture->overlay));
+    assert_string_equal(target, path);
+    snprintf(path, sizeof(path), "%s/ESCAPE.LNK", overlay_path(fixture->overlay));
+    assert_int_not_equal(access(path, F_OK), 0);
+}
+
+/* A plain file is no drive */
+static void test_not_a_directory(void **state) {
+    Fixture *fixture = *state;
+    char path[PATH_MAX * 2];
+
+    snprintf(path, sizeof(path), "%s/CONFIG.SYS", fixture->base);
+    assert_null(overlay_create(path, next_session++));
+}
+
+/* If the overlay cannot be read whole, missing files prove nothing and none are deleted */
+static void test_unreadable_overlay(void **state) {
+    Fixture *fixture = *state;
+    char moved[PATH_MAX * 2];
+    OverlayStats stats;
+
+    overlay_remove(fixture, "OLD.TXT");
+    snprintf(moved, sizeof(moved), "%s.moved", overlay_path(fixture->overlay));
+    assert_int_equal(rename(overlay_path(fixture->overlay), moved), 0);
+
+    assert_false(harvest(fixture));
+    overlay_stats(fixture->overlay, &stats);
+    assert_int_equal(stats.deleted_files, 0);
+    assert_string_equal(contents(fixture->base, "OLD.TXT"), "old\n");
+    assert_string_equal(contents(fixture->base, "CONFIG.SYS"), "files=30\n");
+
+    assert_int_equal(rename(moved, overlay_path(fixture->overlay)), 0);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(test_staged_copy, stage_drive, close_drive),
+        cmocka_unit_test_setup_teardown(test_write_back, stage_drive, close_drive),
+        cmocka_unit_test_setup_teardown(test_conflicts, stage_drive, close_drive),
+        cmocka_unit_test_setup_teardown(test_deleted_on_both_sides, stage_drive, close_drive),
+        cmocka_unit_test_setup_teardown(test_deleted_directories, stage_drive, close_drive),
+        cmocka_unit_test_setup_teardown(test_links, stage_drive, close_drive),
+        cmocka_unit_test_setup_teardown(test_not_a_directory, stage_drive, close_drive),
+        cmocka_unit_test_setup_teardown(test_unreadable_overlay, stage_drive, close_drive),
+    };
+
+    return cmocka_run_group_tests(tests, test_setup, test_teardown);
+}
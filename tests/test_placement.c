@@ -0,0 +1,134 @@
+#define _GNU_SOURCE
+
+/* Placement: CPU affinity lists and when the configuration counts as changed */
+
+#include "test_support.h"
+#include "../include/placement.h"
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+static bool has_cpu(const Placement *placement, int cpu) {
+    return (placement->cpus[cpu / 64] >> (cpu % 64)) & 1;
+}
+
+static int cpu_count(const Placement *placement) {
+    int count = 0;
+
+    for (int cpu = 0; cpu < PLACEMENT_MAX_CPUS; cpu++) {
+        count += has_cpu(placement, cpu);
+    }
+    return count;
+}
+
+/* Configure just a CPU list and prepare a launch with it */
+static bool prepare_with(const char *cpus, Placement *placement) {
+    PlacementConfig config = {.cpus = cpus};
+
+    if (!placement_configure(&config)) {
+        return false;
+    }
+    assert_true(placement_prepare(1, placement));
+    return true;
+}
+
+static void test_cpu_lists(void **state) {
+    Placement placement;
+
+    assert_true(prepare_with("2-3,6", &placement));
+    assert_true(placement.pin);
+    assert_int_equal(cpu_count(&placement), 3);
+    assert_true(has_cpu(&placement, 2) && has_cpu(&placement, 3) && has_cpu(&placement, 6));
+    placement_release(&placement);
+
+    /* Spaces, a trailing newline as read from sysfs, and overlapping ranges */
+    assert_true(prepare_with("0, 1-2,2-4\n", &placement));
+    assert_int_equal(cpu_count(&placement), 5);
+    placement_release(&placement);
+
+    /* Both ends of the range, across words of the bitmap */
+    assert_true(prepare_with("63-64,1023", &placement));
+    assert_int_equal(cpu_count(&placement), 3);
+    assert_true(has_cpu(&placement, 63) && has_cpu(&placement, 64) &&
+                has_cpu(&placement, PLACEMENT_MAX_CPUS - 1));
+    placement_release(&placement);
+
+    assert_true(prepare_with("0-1023", &placement));
+    assert_int_equal(cpu_count(&placement), PLACEMENT_MAX_CPUS);
+    placement_release(&placement);
+}
+
+/* A list that does not parse is refused and the previous one stays */
+static void test_invalid_cpu_lists(void **state) {
+    static const char *const invalid[] = {
+        "a", "1-", "-1", "3-2", "1024", "0-1024", "1,x", "1.5",
+    };
+    Placement placement;
+
+    assert_true(prepare_with("5", &placement));
+    placement_release(&placement);
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(*invalid); i++) {
+        if (prepare_with(invalid[i], &placement)) {
+            fail_msg("\"%s\" was accepted", invalid[i]);
+        }
+    }
+
+    assert_true(placement_prepare(1, &placement));
+    assert_true(placement.pin);
+    assert_int_equal(cpu_count(&placement), 1);
+    assert_true(has_cpu(&placement, 5));
+    placement_release(&placement);
+}
+
+static void test_unpinned(void **state) {
+    Placement placement;
+
+    assert_true(prepare_with(NULL, &placement));
+    assert_false(placement.pin);
+    assert_int_equal(placement.core, -1);
+    assert_int_equal(placement.cgroup_procs_fd, -1);
+    placement_release(&placement);
+
+    assert_true(prepare_with("", &placement));
+    assert_false(placement.pin);
+    placement_release(&placement);
+}
+
+/* Only a configuration that differs bumps the generation */
+static void test_generation(void **state) {
+    PlacementConfig config = {.cpus = "1-2", .sched_class = SCHED_CLASS_BATCH, .nice = 5};
+    int generation;
+
+    assert_true(placement_configure(&config));
+    generation = placement_generation();
+    assert_true(placement_configure(&config));
+    assert_int_equal(placement_generation(), generation);
+
+    config.cpus = "1,2";
+    assert_true(placement_configure(&config));
+    assert_int_not_equal(placement_generation(), generation);
+    generation = placement_generation();
+
+    config.nice = 0;
+    assert_true(placement_configure(&config));
+    assert_int_not_equal(placement_generation(), generation);
+    generation = placement_generation();
+
+    /* Refused, so nothing changed */
+    config.cpus = "bad";
+    assert_false(placement_configure(&config));
+    assert_int_equal(placement_generation(), generation);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_cpu_lists),
+        cmocka_unit_test(test_invalid_cpu_lists),
+        cmocka_unit_test(test_unpinned),
+        cmocka_unit_test(test_generation),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
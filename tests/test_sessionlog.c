@@ -0,0 +1,177 @@
+#define _GNU_SOURCE
+
+/* Session logs: line index and trigram-indexed search, across block boundaries */
+
+#include "test_support.h"
+#include "../include/sessionlog.h"
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+/* Lines of the logs below, leaving the last block partial */
+#define LINES (3 * SESSIONLOG_BLOCK_LINES + 100)
+
+/* Lines holding the needle: either side of each block boundary, and in the partial block */
+static const uint64_t needle_lines[] = {
+    SESSIONLOG_BLOCK_LINES - 1, SESSIONLOG_BLOCK_LINES, 2 * SESSIONLOG_BLOCK_LINES - 1,
+    3 * SESSIONLOG_BLOCK_LINES + 50,
+};
+
+static bool is_needle_line(uint64_t line) {
+    for (size_t i = 0; i < sizeof(needle_lines) / sizeof(*needle_lines); i++) {
+        if (needle_lines[i] == line) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void append_lines(SessionLog *log, uint64_t first, uint64_t last) {
+    char line[128];
+
+    for (uint64_t i = first; i < last; i++) {
+        int length = snprintf(line, sizeof(line), "%llu C:\\>run level %llu %s\n",
+                              (unsigned long long)i, (unsigned long long)(i % 977),
+                              is_needle_line(i) ? "General Protection Fault" : "ok");
+        sessionlog_append(log, line, (size_t)length);
+    }
+    sessionlog_flush(log);
+}
+
+/* Index everything flushed so far */
+static void index_all(SessionLog *log, uint64_t lines) {
+    for (int i = 0; i < 1000 && sessionlog_lines(log) < lines; i++) {
+        sessionlog_update_all();
+    }
+    assert_int_equal(sessionlog_lines(log), lines);
+}
+
+static SessionLogSearch *search_all(SessionLog *log, const char *query) {
+    SessionLogSearch *search = sessionlog_search_start(log, query);
+
+    assert_non_null(search);
+    while (!sessionlog_search_caught_up(search)) {
+        sessionlog_search_step(search, 64 * 1024);
+    }
+    return search;
+}
+
+/* Whether match index is line number line */
+static void assert_match(const SessionLogSearch *search, uint64_t index, uint64_t line) {
+    char prefix[32];
+    size_t length;
+    const char *text = sessionlog_search_match(search, index, &length);
+    int prefix_length = snprintf(prefix, sizeof(prefix), "%llu ", (unsigned long long)line);
+
+    assert_non_null(text);
+    assert_true(length > (size_t)prefix_length);
+    assert_memory_equal(text, prefix, (size_t)prefix_length);
+}
+
+static void test_lines(void **state) {
+    SessionLog *log = sessionlog_open(1, NULL);
+    uint64_t boundary = SESSIONLOG_BLOCK_LINES;
+    const char *text;
+    size_t length;
+
+    assert_non_null(log);
+    append_lines(log, 0, LINES);
+
+    /* A line without its newline yet is not indexed */
+    sessionlog_append(log, "unfinished", 10);
+    sessionlog_flush(log);
+    index_all(log, LINES);
+
+    text = sessionlog_line(log, 0, &length);
+    assert_int_equal(length, strlen("0 C:\\>run level 0 ok"));
+    assert_memory_equal(text, "0 C:\\>run level 0 ok", length);
+    text = sessionlog_line(log, boundary, &length);
+    assert_memory_equal(text, "4096 C:\\>run level 188 General Protection Fault", length);
+    text = sessionlog_line(log, LINES - 1, &length);
+    assert_memory_equal(text, "12387 C:\\>run level 663 ok", length);
+    sessionlog_line(log, LINES, &length);
+    assert_int_equal(length, 0);
+
+    sessionlog_append(log, " now\n", 5);
+    sessionlog_flush(log);
+    index_all(log, LINES + 1);
+    text = sessionlog_line(log, LINES, &length);
+    assert_memory_equal(text, "unfinished now", length);
+
+    sessionlog_release(log);
+}
+
+static void test_search_across_blocks(void **state) {
+    SessionLog *log = sessionlog_open(2, NULL);
+    SessionLogSearch *search;
+
+    assert_non_null(log);
+    append_lines(log, 0, LINES);
+    index_all(log, LINES);
+
+    /* Case is ignored; the match order is the line order */
+    search = search_all(log, "protection fault");
+    assert_int_equal(sessionlog_search_count(search), 4);
+    for (uint64_t i = 0; i < 4; i++) {
+        assert_match(search, i, needle_lines[i]);
+    }
+
+    /* The third complete block holds no trigram of the query and is never read */
+    assert_true(sessionlog_search_scanned(search) < sessionlog_bytes(log));
+    sessionlog_search_free(search);
+
+    /* Too short for trigrams: every line is read */
+    search = search_all(log, "Ok");
+    assert_int_equal(sessionlog_search_count(search), LINES - 4);
+    assert_int_equal(sessionlog_search_scanned(search), sessionlog_bytes(log));
+    sessionlog_search_free(search);
+
+    search = search_all(log, "no such text");
+    assert_int_equal(sessionlog_search_count(search), 0);
+    sessionlog_search_free(search);
+
+    sessionlog_release(log);
+}
+
+/* A search keeps up with lines indexed after it started, including ones that complete a block */
+static void test_search_follows_log(void **state) {
+    SessionLog *log = sessionlog_open(3, NULL);
+    SessionLogSearch *search;
+    uint64_t first = SESSIONLOG_BLOCK_LINES - 10;
+    size_t length;
+
+    assert_non_null(log);
+    append_lines(log, 0, first);
+    index_all(log, first);
+
+    search = search_all(log, "GENERAL PROTECTION");
+    assert_int_equal(sessionlog_search_count(search), 0);
+
+    append_lines(log, first, LINES);
+    index_all(log, LINES);
+    assert_false(sessionlog_search_caught_up(search));
+    while (!sessionlog_search_caught_up(search)) {
+        sessionlog_search_step(search, 1024);
+    }
+    assert_int_equal(sessionlog_search_count(search), 4);
+    for (uint64_t i = 0; i < 4; i++) {
+        assert_match(search, i, needle_lines[i]);
+    }
+    sessionlog_search_match(search, 4, &length);
+    assert_int_equal(length, 0);
+
+    sessionlog_search_free(search);
+    sessionlog_release(log);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_lines),
+        cmocka_unit_test(test_search_across_blocks),
+        cmocka_unit_test(test_search_follows_log),
+    };
+
+    return cmocka_run_group_tests(tests, test_setup, test_teardown);
+}
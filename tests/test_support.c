@@ -0,0 +1,62 @@
+#define _GNU_SOURCE
+
+#include "test_support.h"
+#include "../include/headless.h"
+#include "../include/io_loop.h"
+#include <ftw.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+AppState app;
+
+static char runtime_dir[] = "/tmp/dosemu2-test-XXXXXX";
+
+int test_setup(void **state) {
+    char dir[sizeof(runtime_dir) + 16];
+
+    headless_enable();
+    if (!mkdtemp(runtime_dir)) {
+        return -1;
+    }
+    snprintf(dir, sizeof(dir), "%s/dosemu2", runtime_dir);
+    if (mkdir(dir, 0700) != 0 || setenv("XDG_RUNTIME_DIR", runtime_dir, 1) != 0) {
+        return -1;
+    }
+    return io_loop_start() ? 0 : -1;
+}
+
+static int remove_entry(const char *path, const struct stat *info, int type, struct FTW *ftw) {
+    return remove(path);
+}
+
+int test_teardown(void **state) {
+    return nftw(runtime_dir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+void test_path(char *path, size_t size, const char *name) {
+    snprintf(path, size, "%s/%s", runtime_dir, name);
+}
+
+bool test_write_file(const char *path, const char *text) {
+    FILE *file = fopen(path, "w");
+    bool ok;
+
+    if (!file) {
+        return false;
+    }
+    ok = fputs(text, file) >= 0;
+    return fclose(file) == 0 && ok;
+}
+
+bool test_read_file(const char *path, char *buffer, size_t size) {
+    FILE *file = fopen(path, "r");
+    size_t length;
+
+    if (!file) {
+        return false;
+    }
+    length = fread(buffer, 1, size - 1, file);
+    buffer[length] = '\0';
+    fclose(file);
+    return true;
+}
@@ -0,0 +1,27 @@
+#ifndef DOSEMU2_GUI_TEST_SUPPORT_H
+#define DOSEMU2_GUI_TEST_SUPPORT_H
+
+#include "../include/common.h"
+#include <limits.h>
+
+/* Upper bound on any wait for a worker or the I/O thread */
+#define TEST_TIMEOUT_MS 10000
+
+/*
+ * Group setup and teardown for cmocka_run_group_tests(): route main_queue()
+ * to headless_run_until(), point XDG_RUNTIME_DIR at a fresh directory and
+ * start the I/O thread; the teardown removes the directory again.
+ */
+int test_setup(void **state);
+int test_teardown(void **state);
+
+/* name under the private runtime directory */
+void test_path(char *path, size_t size, const char *name);
+
+/* Create path with text in it; false if it could not be written */
+bool test_write_file(const char *path, const char *text);
+
+/* The contents of path, or false if it cannot be read */
+bool test_read_file(const char *path, char *buffer, size_t size);
+
+#endif /* DOSEMU2_GUI_TEST_SUPPORT_H */
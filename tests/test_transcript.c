@@ -0,0 +1,235 @@
+#define _GNU_SOURCE
+
+/* Session transcripts: every event type through the recorder and reader, and damaged files */
+
+#include "test_support.h"
+#include "../include/transcript.h"
+#include "../include/readiness.h"
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Output longer than the recorder's buffer, which is written around it */
+#define LONG_OUTPUT_BYTES (TRANSCRIPT_BUFFER_BYTES + 4096)
+
+static char *long_output(void) {
+    char *text = malloc(LONG_OUTPUT_BYTES + 1);
+
+    assert_non_null(text);
+    for (size_t i = 0; i < LONG_OUTPUT_BYTES; i++) {
+        text[i] = (char)('a' + i % 26);
+    }
+    text[LONG_OUTPUT_BYTES] = '\0';
+    return text;
+}
+
+/* One event of each type for session 3, then the long output */
+static void record_session(const char *path, const char *output) {
+    ShutdownResult results[2] = {
+        {.name = "DOSEmu", .outcome = SHUTDOWN_TERMINATED, .elapsed_ms = 1000.25},
+        {.name = "dosdebug", .outcome = SHUTDOWN_ALREADY_EXITED, .elapsed_ms = 0},
+    };
+    ExitInfo exit = {.pid = 4321, .status = -1, .signal = 9, .user_ms = 12.5,
+                     .system_ms = 3.75, .max_rss_kb = 65536};
+
+    assert_true(transcript_record_start(path));
+    assert_true(transcript_recording());
+    transcript_launch(3, 4321, "dir c:\\");
+    transcript_endpoint(3, READINESS_READY, "/run/dosemu2/dosemu.dbgin.4321", 18.5);
+    transcript_command(3, TRANSCRIPT_COMMAND_MEM, 0xB800, 0x10, 128, "d b800:0010 80");
+    transcript_output(3, "B800:0010 41 07 42 07");
+    transcript_command(3, TRANSCRIPT_COMMAND_REGS, 0, 0, 0, "r");
+    transcript_output(3, output);
+    transcript_output(3, NULL);
+    transcript_stop(3);
+    transcript_shutdown(3, results, 2, 1002.5);
+    transcript_exited(3, &exit);
+    assert_int_equal(transcript_recorded_events(), 10);
+    transcript_record_stop();
+    assert_false(transcript_recording());
+}
+
+static void expect_event(TranscriptReader *reader, TranscriptEvent *event,
+                         TranscriptEventType type) {
+    assert_true(transcript_reader_next(reader, event));
+    assert_int_equal(event->type, type);
+    assert_int_equal(event->session, 3);
+}
+
+static void test_round_trip(void **state) {
+    char path[PATH_MAX];
+    char *output = long_output();
+    TranscriptReader *reader;
+    TranscriptEvent event;
+    uint64_t last_ns = 0;
+
+    test_path(path, sizeof(path), "round-trip.transcript");
+    record_session(path, output);
+    reader = transcript_reader_open(path);
+    assert_non_null(reader);
+
+    expect_event(reader, &event, TRANSCRIPT_LAUNCH);
+    assert_int_equal(event.pid, 4321);
+    assert_string_equal(event.text, "dir c:\\");
+    last_ns = event.time_ns;
+
+    expect_event(reader, &event, TRANSCRIPT_ENDPOINT);
+    assert_int_equal(event.readiness, READINESS_READY);
+    assert_string_equal(event.text, "/run/dosemu2/dosemu.dbgin.4321");
+    assert_true(event.elapsed_ms == 18.5);
+    assert_true(event.time_ns >= last_ns);
+
+    expect_event(reader, &event, TRANSCRIPT_COMMAND);
+    assert_int_equal(event.kind, TRANSCRIPT_COMMAND_MEM);
+    assert_int_equal(event.segment, 0xB800);
+    assert_int_equal(event.offset, 0x10);
+    assert_int_equal(event.len, 128);
+    assert_string_equal(event.text, "d b800:0010 80");
+
+    expect_event(reader, &event, TRANSCRIPT_OUTPUT);
+    assert_string_equal(event.text, "B800:0010 41 07 42 07");
+
+    expect_event(reader, &event, TRANSCRIPT_COMMAND);
+    assert_int_equal(event.kind, TRANSCRIPT_COMMAND_REGS);
+    assert_string_equal(event.text, "r");
+
+    expect_event(reader, &event, TRANSCRIPT_OUTPUT);
+    assert_string_equal(event.text, output);
+
+    expect_event(reader, &event, TRANSCRIPT_OUTPUT);
+    assert_null(event.text);
+
+    expect_event(reader, &event, TRANSCRIPT_STOP);
+
+    expect_event(reader, &event, TRANSCRIPT_SHUTDOWN);
+    assert_int_equal(event.result_count, 2);
+    assert_true(event.total_ms == 1002.5);
+    assert_string_equal(event.results[0].name, "DOSEmu");
+    assert_int_equal(event.results[0].outcome, SHUTDOWN_TERMINATED);
+    assert_true(event.results[0].elapsed_ms == 1000.25);
+    assert_string_equal(event.results[1].name, "dosdebug");
+    assert_int_equal(event.results[1].outcome, SHUTDOWN_ALREADY_EXITED);
+
+    expect_event(reader, &event, TRANSCRIPT_EXITED);
+    assert_int_equal(event.exit.pid, 4321);
+    assert_int_equal(event.exit.status, -1);
+    assert_int_equal(event.exit.signal, 9);
+    assert_true(event.exit.user_ms == 12.5);
+    assert_true(event.exit.system_ms == 3.75);
+    assert_int_equal(event.exit.max_rss_kb, 65536);
+
+    assert_false(transcript_reader_next(reader, &event));
+    assert_false(transcript_reader_failed(reader));
+    transcript_reader_close(reader);
+    free(output);
+}
+
+/* Events of a type this reader does not know are skipped, not treated as damage */
+static void test_unknown_event_skipped(void **state) {
+    static const uint8_t unknown[] = {99, 0, 3, 2, 'x', 'y'};
+    char path[PATH_MAX];
+    TranscriptReader *reader;
+    TranscriptEvent event;
+    FILE *file;
+
+    test_path(path, sizeof(path), "unknown.transcript");
+    assert_true(transcript_record_start(path));
+    transcript_stop(3);
+    transcript_record_stop();
+
+    file = fopen(path, "a");
+    assert_non_null(file);
+    fwrite(unknown, 1, sizeof(unknown), file);
+    fclose(file);
+
+    reader = transcript_reader_open(path);
+    assert_non_null(reader);
+    expect_event(reader, &event, TRANSCRIPT_STOP);
+    assert_false(transcript_reader_next(reader, &event));
+    assert_false(transcript_reader_failed(reader));
+    transcript_reader_close(reader);
+}
+
+/* Cutting the file anywhere inside an event fails on that event, after the ones before it */
+static void test_truncated(void **state) {
+    char path[PATH_MAX];
+    char *output = long_output();
+    struct stat info;
+    TranscriptReader *reader;
+    TranscriptEvent event;
+    int count = 0;
+
+    test_path(path, sizeof(path), "truncated.transcript");
+    record_session(path, output);
+    assert_int_equal(stat(path, &info), 0);
+
+    /* Into the fields of the last event, then into the long output */
+    assert_int_equal(truncate(path, info.st_size - 2), 0);
+    reader = transcript_reader_open(path);
+    assert_non_null(reader);
+    while (transcript_reader_next(reader, &event)) {
+        count++;
+    }
+    assert_int_equal(count, 9);
+    assert_true(transcript_reader_failed(reader));
+    transcript_reader_close(reader);
+
+    assert_int_equal(truncate(path, (off_t)strlen(TRANSCRIPT_MAGIC) + 200), 0);
+    reader = transcript_reader_open(path);
+    assert_non_null(reader);
+    count = 0;
+    while (transcript_reader_next(reader, &event)) {
+        count++;
+    }
+    assert_int_equal(count, 5);
+    assert_true(transcript_reader_failed(reader));
+    transcript_reader_close(reader);
+    free(output);
+}
+
+static void test_damaged(void **state) {
+    /* A COMMAND of kind 7, and an EXITED whose varint runs off the end of the file */
+    static const uint8_t bad_kind[] = {TRANSCRIPT_COMMAND, 0, 3, 3, 7, 'r', 0};
+    static const uint8_t bad_varint[] = {TRANSCRIPT_EXITED, 0x80, 0x80};
+    char path[PATH_MAX];
+    TranscriptReader *reader;
+    TranscriptEvent event;
+    FILE *file;
+
+    test_path(path, sizeof(path), "damaged.transcript");
+    for (int i = 0; i < 2; i++) {
+        file = fopen(path, "w");
+        assert_non_null(file);
+        fputs(TRANSCRIPT_MAGIC, file);
+        if (i == 0) {
+            fwrite(bad_kind, 1, sizeof(bad_kind), file);
+        } else {
+            fwrite(bad_varint, 1, sizeof(bad_varint), file);
+        }
+        fclose(file);
+
+        reader = transcript_reader_open(path);
+        assert_non_null(reader);
+        assert_false(transcript_reader_next(reader, &event));
+        assert_true(transcript_reader_failed(reader));
+        transcript_reader_close(reader);
+    }
+
+    assert_true(test_write_file(path, "DGTRNS0\n"));
+    assert_null(transcript_reader_open(path));
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_round_trip),
+        cmocka_unit_test(test_unknown_event_skipped),
+        cmocka_unit_test(test_truncated),
+        cmocka_unit_test(test_damaged),
+    };
+
+    return cmocka_run_group_tests(tests, test_setup, test_teardown);
+}
@@ -0,0 +1,164 @@
+/*
+ * Summarise an instruction trace recorded from the Profile tab: how many
+ * instructions ran, the most frequent opcodes and the code segments they
+ * ran in. With --dump, print every record instead:
+ *
+ *   1234:0100  B4 09             EAX=00000900 EBX=00000000 ... FLAGS=00000202
+ *
+ * Usage: dosemu2-itrace [--dump] [--top N] FILE
+ */
+
+#include "../include/common.h"
+#include "../include/itrace.h"
+#include "../include/trace.h"
+#include <errno.h>
+
+/* Opcodes are counted after their prefixes; 0F xx gets its own slot */
+#define OPCODE_SLOTS 512
+#define OPCODE_UNKNOWN OPCODE_SLOTS
+
+AppState app;
+
+static uint64_t opcode_counts[OPCODE_SLOTS + 1];
+static uint64_t segment_counts[65536];
+
+static bool is_prefix(uint8_t byte) {
+    switch (byte) {
+    case 0x26: case 0x2E: case 0x36: case 0x3E: case 0x64: case 0x65:
+    case 0x66: case 0x67: case 0xF0: case 0xF2: case 0xF3:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static int opcode_slot(const ItraceRecord *record) {
+    size_t i = 0;
+
+    while (i < record->opcode_length && is_prefix(record->opcode[i])) {
+        i++;
+    }
+    if (i >= record->opcode_length) {
+        return OPCODE_UNKNOWN;
+    }
+    if (record->opcode[i] == 0x0F) {
+        return i + 1 < record->opcode_length ? 0x100 | record->opcode[i + 1] : OPCODE_UNKNOWN;
+    }
+    return record->opcode[i];
+}
+
+static void dump_record(const ItraceRecord *record) {
+    const DbgRegs *r = &record->regs;
+    char bytes[ITRACE_MAX_OPCODE * 3 + 1] = "";
+
+    for (size_t i = 0; i < record->opcode_length; i++) {
+        snprintf(bytes + i * 3, sizeof(bytes) - i * 3, "%02X ", record->opcode[i]);
+    }
+    printf("%04X:%04X  %-18s EAX=%08X EBX=%08X ECX=%08X EDX=%08X ESI=%08X EDI=%08X "
+           "EBP=%08X ESP=%08X DS=%04X ES=%04X SS=%04X FLAGS=%08X\n",
+           record->cs, (unsigned)record->ip, bytes, r->eax, r->ebx, r->ecx, r->edx, r->esi,
+           r->edi, r->ebp, r->esp, r->ds, r->es, r->ss, r->eflags);
+}
+
+/* Index of the largest count not yet printed, or -1 */
+static int take_largest(uint64_t *counts, int slots) {
+    int best = -1;
+
+    for (int i = 0; i < slots; i++) {
+        if (counts[i] > 0 && (best < 0 || counts[i] > counts[best])) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+static void print_summary(uint64_t total, int top, double ms) {
+    printf("%llu instructions decoded in %.1f ms\n\n", (unsigned long long)total, ms);
+
+    printf("%-10s %12s %7s\n", "opcode", "count", "%");
+    for (int shown = 0; shown < top; shown++) {
+        int slot = take_largest(opcode_counts, OPCODE_SLOTS + 1);
+        char name[16];
+
+        if (slot < 0) {
+            break;
+        }
+        if (slot == OPCODE_UNKNOWN) {
+            snprintf(name, sizeof(name), "unknown");
+        } else if (slot & 0x100) {
+            snprintf(name, sizeof(name), "0F %02X", slot & 0xFF);
+        } else {
+            snprintf(name, sizeof(name), "%02X", slot);
+        }
+        printf("%-10s %12llu %6.2f%%\n", name, (unsigned long long)opcode_counts[slot],
+               (double)opcode_counts[slot] * 100.0 / (double)total);
+        opcode_counts[slot] = 0;
+    }
+
+    printf("\n%-10s %12s %7s\n", "segment", "count", "%");
+    for (int shown = 0; shown < top; shown++) {
+        int segment = take_largest(segment_counts, 65536);
+
+        if (segment < 0) {
+            break;
+        }
+        printf("%04X       %12llu %6.2f%%\n", segment, (unsigned long long)segment_counts[segment],
+               (double)segment_counts[segment] * 100.0 / (double)total);
+        segment_counts[segment] = 0;
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *path = NULL;
+    bool dump = false;
+    int top = 20;
+    ItraceReader *reader;
+    ItraceRecord record;
+    uint64_t total = 0;
+    uint64_t start;
+    bool ok;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--dump") == 0) {
+            dump = true;
+        } else if (strcmp(argv[i], "--top") == 0 && i + 1 < argc) {
+            top = atoi(argv[++i]);
+        } else if (!path && argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            path = NULL;
+            break;
+        }
+    }
+    if (!path) {
+        fprintf(stderr, "usage: %s [--dump] [--top N] FILE\n", argv[0]);
+        return 2;
+    }
+
+    reader = itrace_reader_open(path);
+    if (!reader) {
+        fprintf(stderr, "%s: %s\n", path, errno ? strerror(errno) : "not an instruction trace");
+        return 1;
+    }
+
+    start = trace_now();
+    while (itrace_reader_next(reader, &record)) {
+        if (dump) {
+            dump_record(&record);
+        } else {
+            opcode_counts[opcode_slot(&record)]++;
+            segment_counts[record.cs]++;
+        }
+        total++;
+    }
+    ok = !itrace_reader_failed(reader);
+    itrace_reader_close(reader);
+
+    if (!dump && total > 0) {
+        print_summary(total, top, (double)(trace_now() - start) / 1e6);
+    }
+    if (!ok) {
+        fprintf(stderr, "%s: damaged after %llu instructions\n", path, (unsigned long long)total);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,39 @@
+/*
+ * Print a binary log written by the logger as text, one line per record:
+ *
+ *   2026-10-16 14:02:11.402113 INFO  [3] DOSEmu started with PID 4242
+ *
+ * Usage: dosemu2-logdecode [FILE]   (standard input without FILE)
+ */
+
+#include "../include/common.h"
+#include "../include/logger.h"
+#include <errno.h>
+
+AppState app;
+
+int main(int argc, char **argv) {
+    FILE *in = stdin;
+    bool ok;
+
+    if (argc > 2) {
+        fprintf(stderr, "usage: %s [FILE]\n", argv[0]);
+        return 2;
+    }
+    if (argc == 2) {
+        in = fopen(argv[1], "rb");
+        if (!in) {
+            fprintf(stderr, "%s: %s\n", argv[1], strerror(errno));
+            return 1;
+        }
+    }
+
+    ok = logger_decode(in, stdout);
+    if (!ok) {
+        fprintf(stderr, "%s: not a complete binary log\n", argc == 2 ? argv[1] : "stdin");
+    }
+    if (in != stdin) {
+        fclose(in);
+    }
+    return ok ? 0 : 1;
+}